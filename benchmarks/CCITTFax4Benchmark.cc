@@ -0,0 +1,175 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * CCITTFax4Benchmark.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Encodes synthetic pages, and the binary PBM files given as arguments, with CCITTFax4Encoder
+// and with the reference encoder. Fails if the outputs differ.
+
+#include "CCITTFax4Encoder.hh"
+#include "CCITTFax4ReferenceEncoder.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Page {
+	std::string name;
+	uint32_t width;
+	uint32_t height;
+	// Rows of (width + 7) / 8 bytes, set bits are black
+	std::vector<uint8_t> data;
+
+	Page(const std::string& _name, uint32_t _width, uint32_t _height)
+		: name(_name), width(_width), height(_height), data(rowbytes() * _height, 0) {}
+	uint32_t rowbytes() const { return (width + 7) / 8; }
+	void fill(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2) {
+		for(uint32_t y = y1; y < y2 && y < height; ++y) {
+			for(uint32_t x = x1; x < x2 && x < width; ++x) {
+				data[y * rowbytes() + x / 8] |= 0x80 >> (x % 8);
+			}
+		}
+	}
+};
+
+// Lines of word-like blocks of glyph-sized strokes, as on a scanned 600 dpi text page
+static Page textPage(uint32_t width, uint32_t height) {
+	Page page("text", width, height);
+	std::mt19937 rng(1);
+	for(uint32_t y = 300; y + 100 < height - 300; y += 100) {
+		uint32_t x = 300;
+		while(x + 400 < width - 300) {
+			uint32_t wordEnd = x + 100 + rng() % 300;
+			for(; x < wordEnd; x += 8 + rng() % 30) {
+				uint32_t top = y + rng() % 25;
+				page.fill(x, top, x + 4 + rng() % 6, y + 60 + rng() % 10);
+			}
+			x += 40;
+		}
+	}
+	return page;
+}
+
+static Page noisePage(uint32_t width, uint32_t height, int blackPercent) {
+	Page page("noise " + std::to_string(blackPercent) + "%", width, height);
+	std::mt19937 rng(2);
+	for(uint32_t y = 0; y < height; ++y) {
+		for(uint32_t x = 0; x < width; ++x) {
+			if(int(rng() % 100) < blackPercent) {
+				page.fill(x, y, x + 1, y + 1);
+			}
+		}
+	}
+	return page;
+}
+
+// Stripes whose edges fall on every bit position, at widths which are no multiple of the word size
+static Page stripesPage(uint32_t width, uint32_t height) {
+	Page page("stripes " + std::to_string(width), width, height);
+	for(uint32_t y = 0; y < height; ++y) {
+		for(uint32_t x = y % 7; x < width; x += 3 + y % 67) {
+			page.fill(x, y, x + 1 + y % 5, y + 1);
+		}
+	}
+	return page;
+}
+
+static bool readPbm(const std::string& filename, std::vector<Page>& pages) {
+	std::ifstream file(filename, std::ios::binary);
+	std::string magic;
+	uint32_t width = 0, height = 0;
+	if(!(file >> magic >> width >> height) || magic != "P4" || width == 0 || height == 0) {
+		return false;
+	}
+	file.get();
+	Page page(filename, width, height);
+	file.read(reinterpret_cast<char*>(page.data.data()), page.data.size());
+	if(!file) {
+		return false;
+	}
+	pages.push_back(page);
+	return true;
+}
+
+static std::vector<uint8_t> encode(CCITTFax4Encoder& encoder, const Page& page) {
+	std::vector<uint8_t> output;
+	encoder.begin(page.width, [&output](const uint8_t* data, std::size_t size) {
+		output.insert(output.end(), data, data + size);
+	});
+	for(uint32_t y = 0; y < page.height; ++y) {
+		encoder.encodeRow(page.data.data() + y * page.rowbytes());
+	}
+	encoder.finish();
+	return output;
+}
+
+static std::vector<uint8_t> encodeReference(CCITTFax4ReferenceEncoder& encoder, const Page& page) {
+	uint32_t size = 0;
+	uint8_t* data = encoder.encode(page.data.data(), page.width, page.height, page.rowbytes(), size);
+	return std::vector<uint8_t>(data, data + size);
+}
+
+template<class F>
+static double millisecondsPerRun(int runs, F f) {
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < runs; ++i) {
+		f();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / runs;
+}
+
+int main(int argc, char* argv[]) {
+	// A letter page at 600 dpi
+	const uint32_t width = 5100, height = 6600;
+	std::vector<Page> pages;
+	pages.push_back(Page("blank", width, height));
+	pages.push_back(textPage(width, height));
+	pages.push_back(noisePage(width, height, 5));
+	pages.push_back(noisePage(width, height, 50));
+	for(uint32_t stripesWidth : {1, 7, 63, 64, 65, 129, 5101}) {
+		pages.push_back(stripesPage(stripesWidth, 200));
+	}
+	for(int i = 1; i < argc; ++i) {
+		if(!readPbm(argv[i], pages)) {
+			std::fprintf(stderr, "Not a binary PBM file: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	CCITTFax4Encoder encoder;
+	CCITTFax4ReferenceEncoder reference;
+	bool identical = true;
+	std::printf("%-24s %12s %14s %14s\n", "page", "bytes", "reference ms", "encoder ms");
+	for(const Page& page : pages) {
+		std::vector<uint8_t> output = encode(encoder, page);
+		std::vector<uint8_t> referenceOutput = encodeReference(reference, page);
+		if(output != referenceOutput) {
+			std::printf("%-24s output differs from the reference (%zu instead of %zu bytes)\n", page.name.c_str(), output.size(), referenceOutput.size());
+			identical = false;
+			continue;
+		}
+		int runs = page.height >= 1000 ? 5 : 50;
+		double referenceTime = millisecondsPerRun(runs, [&] { encodeReference(reference, page); });
+		double time = millisecondsPerRun(runs, [&] { encode(encoder, page); });
+		std::printf("%-24s %12zu %14.2f %14.2f\n", page.name.c_str(), output.size(), referenceTime, time);
+	}
+	return identical ? 0 : 1;
+}
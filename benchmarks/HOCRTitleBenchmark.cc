@@ -0,0 +1,130 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRTitleBenchmark.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Parses the titles of synthetic pages, lines and words with HOCRItem::Title::parse and the way
+// they were parsed before, from the split title properties with sscanf. Fails if the results
+// differ.
+
+#include "HOCRDocument.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static HOCRItem::Title referenceParse(const HOCRItem& item) {
+	HOCRItem::Title title;
+	for(const auto& prop : item.titleProperties()) {
+		if(prop.first == "bbox") {
+			std::sscanf(prop.second.c_str(), "%d %d %d %d", &title.bbox.x1, &title.bbox.y1, &title.bbox.x2, &title.bbox.y2);
+		} else if(prop.first == "baseline") {
+			double slope;
+			std::sscanf(prop.second.c_str(), "%lf %d", &slope, &title.baseline);
+		} else if(prop.first == "x_fsize") {
+			title.fontSize = std::atof(prop.second.c_str());
+		} else if(prop.first == "image") {
+			title.image = prop.second;
+			if(title.image.size() >= 2 && (title.image.front() == '\'' || title.image.front() == '"') && title.image.back() == title.image.front()) {
+				title.image = title.image.substr(1, title.image.size() - 2);
+			}
+		} else if(prop.first == "pageno") {
+			title.pageNr = std::atoi(prop.second.c_str());
+		} else if(prop.first == "rot") {
+			title.angle = std::atof(prop.second.c_str());
+		} else if(prop.first == "res") {
+			title.resolution = std::atoi(prop.second.c_str());
+		}
+	}
+	return title;
+}
+
+static bool operator==(const HOCRItem::Title& a, const HOCRItem::Title& b) {
+	return a.bbox.x1 == b.bbox.x1 && a.bbox.y1 == b.bbox.y1 && a.bbox.x2 == b.bbox.x2 && a.bbox.y2 == b.bbox.y2 &&
+	       a.baseline == b.baseline && a.fontSize == b.fontSize && a.image == b.image && a.pageNr == b.pageNr &&
+	       a.angle == b.angle && a.resolution == b.resolution;
+}
+
+// The titles of the words, lines and pages of a recognized document, as written by tesseract
+static std::vector<std::string> documentTitles() {
+	std::vector<std::string> titles;
+	std::mt19937 rng(1);
+	auto bbox = [&rng] {
+		int x = rng() % 5000, y = rng() % 6500;
+		return "bbox " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(x + rng() % 400) + " " + std::to_string(y + rng() % 80);
+	};
+	for(int page = 1; page <= 20; ++page) {
+		titles.push_back("image '/home/user/scans/batch; 2017/scan_" + std::to_string(page) + ".png'; bbox 0 0 5100 6600; pageno " + std::to_string(page) + "; rot 0.35; res 600");
+		for(int line = 0; line < 60; ++line) {
+			titles.push_back(bbox() + "; baseline 0.002 -" + std::to_string(rng() % 20) + "; x_size 52; x_descenders 11; x_ascenders 13");
+			for(int word = 0; word < 12; ++word) {
+				titles.push_back(bbox() + "; x_wconf " + std::to_string(rng() % 100) + "; x_font Times_New_Roman; x_fsize " + std::to_string(8 + rng() % 8) + ".5");
+			}
+		}
+	}
+	// Irregular spacing and separators
+	titles.push_back("  bbox\t1 2 3 4 ;;x_fsize 12 ;  image \"a;b.png\" ");
+	titles.push_back("");
+	return titles;
+}
+
+template<class F>
+static double millisecondsPerRun(int runs, F f) {
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < runs; ++i) {
+		f();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / runs;
+}
+
+int main() {
+	std::vector<std::string> titles = documentTitles();
+	std::vector<std::unique_ptr<HOCRItem>> items;
+	for(const std::string& title : titles) {
+		items.emplace_back(new HOCRItem("span", {{"class", "ocrx_word"}, {"title", title}}));
+	}
+
+	bool identical = true;
+	for(const auto& item : items) {
+		std::string title = item->attribute("title");
+		if(!(HOCRItem::Title::parse(title.c_str()) == referenceParse(*item))) {
+			std::printf("Parsed differently from the reference: \"%s\"\n", title.c_str());
+			identical = false;
+		}
+	}
+
+	const int runs = 20;
+	// Keeps the parsing from being optimized away
+	volatile int sink = 0;
+	double referenceTime = millisecondsPerRun(runs, [&] {
+		for(const auto& item : items) {
+			sink += referenceParse(*item).bbox.x1;
+		}
+	});
+	double time = millisecondsPerRun(runs, [&] {
+		for(const std::string& title : titles) {
+			sink += HOCRItem::Title::parse(title.c_str()).bbox.x1;
+		}
+	});
+	std::printf("%zu titles: reference %.2f ms, Title::parse %.2f ms\n", titles.size(), referenceTime, time);
+	return identical ? 0 : 1;
+}
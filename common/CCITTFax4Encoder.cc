@@ -30,6 +30,7 @@
  */
 
 #include "CCITTFax4Encoder.hh"
+#include <algorithm>
 #include <cassert>
 #include <vector>
 
@@ -283,7 +284,13 @@ const CCITTFax4Encoder::TableEntry CCITTFax4Encoder::vcodes[7] = {
 	{ 7, 0x02, 0 }  /* 0000 010 */
 };
 
+// Encoded data is passed to the sink in chunks of this size
+static constexpr std::size_t sinkChunkSize = 65536;
+
 struct CCITTFax4Encoder::EncoderState {
+	Sink sink;
+	uint32_t width = 0;
+	std::vector<uint8_t> refline;
 	std::vector<uint8_t> buf;
 	uint8_t data = 0;
 	uint8_t bit = 8;
@@ -295,28 +302,40 @@ CCITTFax4Encoder::~CCITTFax4Encoder() {
 	delete m_state;
 }
 
-uint8_t* CCITTFax4Encoder::encode(const uint8_t *buffer, uint32_t width, uint32_t height, uint32_t rowbytes, uint32_t &outputSize) {
-	m_state->buf.resize(0);
+void CCITTFax4Encoder::begin(uint32_t width, const Sink& sink) {
+	m_state->sink = sink;
+	m_state->width = width;
+	// The reference line of the first row is all white
+	m_state->refline.assign((width + 7) / 8, 0);
+	m_state->buf.clear();
+	m_state->buf.reserve(sinkChunkSize);
 	m_state->data = 0;
 	m_state->bit = 8;
+}
 
-	uint8_t whiteline[rowbytes];
-	std::fill_n(whiteline, rowbytes, 0);
-
-	const uint8_t* refline = whiteline;
-	for(uint32_t y = 0; y < height; ++y) {
-		encode2DRow(buffer, refline, width);
-		refline = buffer;
-		buffer += rowbytes;
+void CCITTFax4Encoder::encodeRow(const uint8_t* row) {
+	encode2DRow(row, m_state->refline.data(), m_state->width);
+	std::copy(row, row + m_state->refline.size(), m_state->refline.begin());
+	if(m_state->buf.size() >= sinkChunkSize) {
+		flushbuffer();
 	}
+}
+
+void CCITTFax4Encoder::finish() {
 	putbits(EOL, 12);
 	putbits(EOL, 12);
 	if(m_state->bit != 8) {
 		flushbits();
 	}
+	flushbuffer();
+	m_state->sink = nullptr;
+}
 
-	outputSize = m_state->buf.size();
-	return m_state->buf.data();
+void CCITTFax4Encoder::flushbuffer() {
+	if(!m_state->buf.empty()) {
+		m_state->sink(m_state->buf.data(), m_state->buf.size());
+		m_state->buf.clear();
+	}
 }
 
 void CCITTFax4Encoder::putspan(int32_t span, const TableEntry* tab) {
@@ -357,14 +376,60 @@ void CCITTFax4Encoder::flushbits() {
 	m_state->bit = 8;
 }
 
-static inline uint8_t pixel(const uint8_t* line, uint32_t i) {
-	return !(((line[i>>3]) >> (7 - (i&7))) & 1);
+// Positions past the end of the line read as white, the line is not accessed there
+static inline uint8_t pixel(const uint8_t* line, uint32_t i, uint32_t length) {
+	return i < length && !(((line[i>>3]) >> (7 - (i&7))) & 1);
 }
 
+// Number of leading zero bits, x must not be zero
+static inline int clz64(uint64_t x) {
+#if defined(__GNUC__)
+	return __builtin_clzll(x);
+#else
+	int n = 0;
+	for(; !(x & (uint64_t(1) << 63)); x <<= 1) {
+		++n;
+	}
+	return n;
+#endif
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+	// Big endian, so that the leftmost pixel is the most significant bit
+	return (uint64_t(p[0]) << 56) | (uint64_t(p[1]) << 48) | (uint64_t(p[2]) << 40) | (uint64_t(p[3]) << 32) |
+	       (uint64_t(p[4]) << 24) | (uint64_t(p[5]) << 16) | (uint64_t(p[6]) << 8) | uint64_t(p[7]);
+}
+
+// Returns the position of the first pixel of the given color in [start, length), or length if there is none.
+// Runs are skipped a word at a time: the bits are flipped such that pixels of the searched color are set,
+// and the first set bit is located by counting the leading zeros.
 static inline uint32_t findpixel(const uint8_t* line, uint32_t start, uint32_t length, uint8_t color) {
-	for(uint32_t pos = start; pos < length; ++pos) {
-		if(pixel(line, pos) == color) {
-			return pos;
+	if(start >= length) {
+		return length;
+	}
+	uint8_t flip = color ? 0xFF : 0x00;
+	uint32_t pos = start;
+	// Up to the next byte boundary
+	if(pos & 7) {
+		uint8_t bits = (line[pos >> 3] ^ flip) & (0xFF >> (pos & 7));
+		if(bits) {
+			return std::min((pos & ~7u) + clz64(bits) - 56, length);
+		}
+		pos = (pos | 7) + 1;
+	}
+	// Whole words which lie within the line
+	uint64_t flip64 = color ? ~uint64_t(0) : uint64_t(0);
+	for(; pos + 64 <= length; pos += 64) {
+		uint64_t bits = load64(line + (pos >> 3)) ^ flip64;
+		if(bits) {
+			return pos + clz64(bits);
+		}
+	}
+	// Remaining bytes, the last one possibly containing padding bits
+	for(; pos < length; pos += 8) {
+		uint8_t bits = line[pos >> 3] ^ flip;
+		if(bits) {
+			return std::min(pos + clz64(bits) - 56, length);
 		}
 	}
 	return length;
@@ -374,7 +439,7 @@ void CCITTFax4Encoder::encode2DRow(const uint8_t* codeline, const uint8_t* refli
 	uint32_t a0 = 0;
 	uint32_t a1 = findpixel(codeline, 0, linebits, 1);
 	uint32_t b1 = findpixel(refline, 0, linebits, 1);
-	uint32_t b2 = findpixel(refline, b1 + 1, linebits, !pixel(refline, b1));
+	uint32_t b2 = findpixel(refline, b1 + 1, linebits, !pixel(refline, b1, linebits));
 
 	while(true) {
 		if (b2 < a1) {
@@ -389,9 +454,9 @@ void CCITTFax4Encoder::encode2DRow(const uint8_t* codeline, const uint8_t* refli
 				a0 = a1;
 			} else {
 				/* horizontal mode */
-				uint32_t a2 = findpixel(codeline, a1 + 1, linebits, !pixel(codeline, a1));
+				uint32_t a2 = findpixel(codeline, a1 + 1, linebits, !pixel(codeline, a1, linebits));
 				putbits(horizcode.code, horizcode.length);
-				if (a0+a1 == 0 || pixel(codeline, a0) == 0) {
+				if (a0+a1 == 0 || pixel(codeline, a0, linebits) == 0) {
 					putspan(a1-a0, whiteCodes);
 					putspan(a2-a1, blackCodes);
 				} else {
@@ -404,13 +469,13 @@ void CCITTFax4Encoder::encode2DRow(const uint8_t* codeline, const uint8_t* refli
 		if (a0 >= linebits)
 			break;
 		// Next changing pixel on codeline right of a0
-		a1 = findpixel(codeline, a0 + 1, linebits, !pixel(codeline, a0));
+		a1 = findpixel(codeline, a0 + 1, linebits, !pixel(codeline, a0, linebits));
 		// Next changing pixel on refline right of a0 and of opposite color than a0
-		b1 = findpixel(refline, a0 + 1, linebits, !pixel(refline, a0));
-		if(pixel(refline, b1) == pixel(codeline, a0)) {
-			b1 = findpixel(refline, b1 + 1, linebits, !pixel(codeline, a0));
+		b1 = findpixel(refline, a0 + 1, linebits, !pixel(refline, a0, linebits));
+		if(pixel(refline, b1, linebits) == pixel(codeline, a0, linebits)) {
+			b1 = findpixel(refline, b1 + 1, linebits, !pixel(codeline, a0, linebits));
 		}
 		// Next changing pixel on refline right of b1
-		b2 = findpixel(refline, b1 + 1, linebits, !pixel(refline, b1));
+		b2 = findpixel(refline, b1 + 1, linebits, !pixel(refline, b1, linebits));
 	}
 }
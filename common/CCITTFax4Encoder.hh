@@ -32,13 +32,24 @@
 #ifndef FAX4ENCODER_HH
 #define FAX4ENCODER_HH
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 
+// CCITT Group 4 encoder. The image is fed one row at a time, and the encoded data is handed
+// to the sink in chunks as it is produced, so the whole image never needs to be in memory.
 class CCITTFax4Encoder {
 public:
+	typedef std::function<void(const uint8_t* data, std::size_t size)> Sink;
+
 	CCITTFax4Encoder();
 	~CCITTFax4Encoder();
-	uint8_t* encode(const uint8_t* buffer, uint32_t width, uint32_t height, uint32_t rowbytes, uint32_t& outputSize);
+	// Starts a new image, the encoder can be reused once the previous image is finished
+	void begin(uint32_t width, const Sink& sink);
+	// Rows are packed one bit per pixel, most significant bit first
+	void encodeRow(const uint8_t* row);
+	// Writes the end of facsimile block and passes the remaining data to the sink
+	void finish();
 
 private:
 	struct EncoderState;
@@ -46,6 +57,7 @@ private:
 	EncoderState* m_state;
 
 	void encode2DRow(const uint8_t* codeline, const uint8_t* refline, uint32_t linebits);
+	void flushbuffer();
 	inline void putspan(int32_t span, const TableEntry* tab);
 	inline void putbits(uint16_t bits, uint16_t length);
 	inline void flushbits();
@@ -0,0 +1,129 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * FlateEncoder.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FlateEncoder.hh"
+#include <algorithm>
+#include <zlib.h>
+
+constexpr std::size_t FlateEncoder::dictionarySize;
+
+// The output is handed to the sink in chunks of this size
+static constexpr std::size_t sinkChunkSize = 65536;
+
+struct FlateEncoder::EncoderState {
+	Sink sink;
+	int flags;
+	z_stream stream;
+	bool initialized = false;
+	uint32_t checksum;
+	std::size_t inputSize;
+	Bytef buf[sinkChunkSize];
+};
+
+FlateEncoder::FlateEncoder() {
+	m_state = new EncoderState;
+}
+
+FlateEncoder::~FlateEncoder() {
+	if(m_state->initialized) {
+		deflateEnd(&m_state->stream);
+	}
+	delete m_state;
+}
+
+void FlateEncoder::begin(int level, const Sink& sink, int chunkFlags, const uint8_t* dictionary, std::size_t dictionarySize) {
+	if(m_state->initialized) {
+		deflateReset(&m_state->stream);
+		deflateParams(&m_state->stream, level, Z_DEFAULT_STRATEGY);
+	} else {
+		m_state->stream.zalloc = Z_NULL;
+		m_state->stream.zfree = Z_NULL;
+		m_state->stream.opaque = Z_NULL;
+		// Raw deflate, the zlib header and trailer are written here so that chunks can be concatenated
+		deflateInit2(&m_state->stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		m_state->initialized = true;
+	}
+	m_state->sink = sink;
+	m_state->flags = chunkFlags;
+	m_state->checksum = adler32(0, Z_NULL, 0);
+	m_state->inputSize = 0;
+	if(dictionarySize > 0) {
+		std::size_t size = std::min(dictionarySize, FlateEncoder::dictionarySize);
+		deflateSetDictionary(&m_state->stream, dictionary + dictionarySize - size, size);
+	}
+	if(chunkFlags & FirstChunk) {
+		// CMF: deflate with 32 KiB window, FLG: compression level hint and check bits
+		int levelHint = level == Z_DEFAULT_COMPRESSION ? 2 : level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+		uint8_t header[2] = { 0x78, uint8_t(levelHint << 6) };
+		header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+		sink(header, sizeof(header));
+	}
+}
+
+void FlateEncoder::write(const uint8_t* data, std::size_t size) {
+	// avail_in is only 32 bits wide
+	while(size > 0) {
+		uInt n = uInt(std::min<std::size_t>(size, 1 << 30));
+		m_state->checksum = adler32(m_state->checksum, data, n);
+		m_state->inputSize += n;
+		m_state->stream.next_in = const_cast<Bytef*>(data);
+		m_state->stream.avail_in = n;
+		deflate(Z_NO_FLUSH);
+		data += n;
+		size -= n;
+	}
+}
+
+uint32_t FlateEncoder::finish() {
+	m_state->stream.next_in = Z_NULL;
+	m_state->stream.avail_in = 0;
+	// Chunks other than the last one end with an empty stored block, which aligns them to a byte boundary
+	deflate(m_state->flags & LastChunk ? Z_FINISH : Z_SYNC_FLUSH);
+	if(m_state->flags == WholeStream) {
+		writeTrailer(m_state->checksum, m_state->sink);
+	}
+	m_state->sink = nullptr;
+	return m_state->checksum;
+}
+
+std::size_t FlateEncoder::inputSize() const {
+	return m_state->inputSize;
+}
+
+uint32_t FlateEncoder::combineChecksums(uint32_t checksum1, uint32_t checksum2, std::size_t size2) {
+	return adler32_combine(checksum1, checksum2, z_off_t(size2));
+}
+
+void FlateEncoder::writeTrailer(uint32_t checksum, const Sink& sink) {
+	uint8_t trailer[4] = { uint8_t(checksum >> 24), uint8_t(checksum >> 16), uint8_t(checksum >> 8), uint8_t(checksum) };
+	sink(trailer, sizeof(trailer));
+}
+
+void FlateEncoder::deflate(int flush) {
+	z_stream& stream = m_state->stream;
+	do {
+		stream.next_out = m_state->buf;
+		stream.avail_out = sinkChunkSize;
+		::deflate(&stream, flush);
+		std::size_t size = sinkChunkSize - stream.avail_out;
+		if(size > 0) {
+			m_state->sink(m_state->buf, size);
+		}
+	} while(stream.avail_out == 0);
+}
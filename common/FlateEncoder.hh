@@ -0,0 +1,67 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * FlateEncoder.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLATEENCODER_HH
+#define FLATEENCODER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Encoder for zlib streams (RFC 1950), as read by the PDF FlateDecode filter. The input is fed
+// in pieces, so that it never needs to be contiguous, and the compressed data is handed to the
+// sink as it is produced.
+//
+// A stream can also be compressed in chunks in parallel, as done by pigz: each chunk is deflated
+// on its own, primed with the input preceding it, and ends on a byte boundary, so that the
+// chunks only need to be concatenated. The checksums of the chunks are then combined with
+// combineChecksums and written after the last chunk with writeTrailer.
+class FlateEncoder {
+public:
+	typedef std::function<void(const uint8_t* data, std::size_t size)> Sink;
+	enum ChunkFlags { FirstChunk = 1, LastChunk = 2, WholeStream = FirstChunk | LastChunk };
+
+	FlateEncoder();
+	~FlateEncoder();
+	FlateEncoder(const FlateEncoder&) = delete;
+	FlateEncoder& operator=(const FlateEncoder&) = delete;
+
+	// Starts a new stream or chunk, the encoder can be reused once the previous one is finished.
+	// The dictionary is the input preceding the chunk, of which at most the last 32 KiB are used.
+	void begin(int level, const Sink& sink, int chunkFlags = WholeStream, const uint8_t* dictionary = nullptr, std::size_t dictionarySize = 0);
+	void write(const uint8_t* data, std::size_t size);
+	// Passes the remaining data to the sink and returns the checksum of the input of the chunk.
+	// For a whole stream the trailer is written as well.
+	uint32_t finish();
+	// Size of the input of the current chunk
+	std::size_t inputSize() const;
+
+	static uint32_t combineChecksums(uint32_t checksum1, uint32_t checksum2, std::size_t size2);
+	static void writeTrailer(uint32_t checksum, const Sink& sink);
+	// Size of the preceding input used to prime a chunk
+	static constexpr std::size_t dictionarySize = 32768;
+
+private:
+	struct EncoderState;
+	EncoderState* m_state;
+
+	void deflate(int flush);
+};
+
+#endif // FLATEENCODER_HH
@@ -0,0 +1,1265 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRDocument.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HOCRDocument.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+
+static const char* const s_whitespace = " \t\r\n";
+
+static std::string trimmed(const std::string& str) {
+	std::size_t start = str.find_first_not_of(s_whitespace);
+	if(start == std::string::npos) {
+		return std::string();
+	}
+	std::size_t end = str.find_last_not_of(s_whitespace);
+	return str.substr(start, end - start + 1);
+}
+
+static inline bool isTitleSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool isTitleKey(const char* key, std::size_t len, const char* name) {
+	return std::strlen(name) == len && std::strncmp(key, name, len) == 0;
+}
+
+static void appendEscaped(std::string& out, const std::string& str, bool attribute) {
+	for(char c : str) {
+		switch(c) {
+		case '&':
+			out += "&amp;";
+			break;
+		case '<':
+			out += "&lt;";
+			break;
+		case '>':
+			out += "&gt;";
+			break;
+		case '"':
+			out += attribute ? "&quot;" : "\"";
+			break;
+		default:
+			out += c;
+		}
+	}
+}
+
+
+HOCRItem::BBox HOCRItem::BBox::united(const BBox& other) const {
+	return BBox(std::min(x1, other.x1), std::min(y1, other.y1), std::max(x2, other.x2), std::max(y2, other.y2));
+}
+
+std::string HOCRItem::BBox::toString() const {
+	return std::to_string(x1) + " " + std::to_string(y1) + " " + std::to_string(x2) + " " + std::to_string(y2);
+}
+
+HOCRItem::Title HOCRItem::Title::parse(const char* title) {
+	Title result;
+	const char* p = title;
+	while(*p) {
+		while(isTitleSpace(*p) || *p == ';') {
+			++p;
+		}
+		const char* key = p;
+		while(*p && !isTitleSpace(*p) && *p != ';') {
+			++p;
+		}
+		std::size_t keyLen = p - key;
+		while(isTitleSpace(*p)) {
+			++p;
+		}
+		const char* value = p;
+		// Semicolons within a quoted value (i.e. the image filename) don't end the property
+		char quote = 0;
+		for(; *p && (quote || *p != ';'); ++p) {
+			if(quote && *p == quote) {
+				quote = 0;
+			} else if(!quote && (*p == '\'' || *p == '"')) {
+				quote = *p;
+			}
+		}
+
+		char* next;
+		if(isTitleKey(key, keyLen, "bbox")) {
+			result.bbox.x1 = std::strtol(value, &next, 10);
+			result.bbox.y1 = std::strtol(next, &next, 10);
+			result.bbox.x2 = std::strtol(next, &next, 10);
+			result.bbox.y2 = std::strtol(next, &next, 10);
+		} else if(isTitleKey(key, keyLen, "baseline")) {
+			std::strtod(value, &next); // slope
+			result.baseline = std::strtol(next, &next, 10);
+		} else if(isTitleKey(key, keyLen, "x_fsize")) {
+			result.fontSize = std::strtod(value, &next);
+		} else if(isTitleKey(key, keyLen, "image")) {
+			const char* end = p;
+			while(end > value && isTitleSpace(end[-1])) {
+				--end;
+			}
+			if(end - value >= 2 && (*value == '\'' || *value == '"') && end[-1] == *value) {
+				++value;
+				--end;
+			}
+			result.image.assign(value, end);
+		} else if(isTitleKey(key, keyLen, "pageno")) {
+			result.pageNr = std::strtol(value, &next, 10);
+		} else if(isTitleKey(key, keyLen, "rot")) {
+			result.angle = std::strtod(value, &next);
+		} else if(isTitleKey(key, keyLen, "res")) {
+			result.resolution = std::strtol(value, &next, 10);
+		}
+	}
+	return result;
+}
+
+
+HOCRItem::HOCRItem(const std::string& tag, const AttributeList& attributes)
+	: HOCRItem(tag, attributes, true) {}
+
+HOCRItem::HOCRItem(const std::string& tag, const AttributeList& attributes, bool parseTitle)
+	: m_tag(tag), m_attributes(attributes) {
+	m_class = attribute("class");
+	if(parseTitle) {
+		this->parseTitle();
+	}
+}
+
+HOCRItem::~HOCRItem() {
+	for(HOCRItem* child : m_children) {
+		delete child;
+	}
+}
+
+bool HOCRItem::hasAttribute(const std::string& name) const {
+	for(const auto& attr : m_attributes) {
+		if(attr.first == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string HOCRItem::attribute(const std::string& name) const {
+	for(const auto& attr : m_attributes) {
+		if(attr.first == name) {
+			return attr.second;
+		}
+	}
+	return std::string();
+}
+
+void HOCRItem::setAttribute(const std::string& name, const std::string& value) {
+	auto it = std::find_if(m_attributes.begin(), m_attributes.end(), [&name](const std::pair<std::string, std::string>& attr) {
+		return attr.first == name;
+	});
+	if(it != m_attributes.end()) {
+		it->second = value;
+	} else {
+		m_attributes.push_back(std::make_pair(name, value));
+	}
+	if(name == "class") {
+		m_class = value;
+	} else if(name == "title") {
+		parseTitle();
+	}
+}
+
+void HOCRItem::removeAttribute(const std::string& name) {
+	auto it = std::find_if(m_attributes.begin(), m_attributes.end(), [&name](const std::pair<std::string, std::string>& attr) {
+		return attr.first == name;
+	});
+	if(it == m_attributes.end()) {
+		return;
+	}
+	m_attributes.erase(it);
+	if(name == "class") {
+		m_class.clear();
+	} else if(name == "title") {
+		parseTitle();
+	}
+}
+
+HOCRItem::AttributeList HOCRItem::titleProperties() const {
+	AttributeList props;
+	std::string title = attribute("title");
+	std::size_t pos = 0, n = title.size();
+	while(pos < n) {
+		// Split at semicolons which are not part of a quoted value (i.e. the image filename)
+		std::size_t end = pos;
+		char quote = 0;
+		for(; end < n && (quote || title[end] != ';'); ++end) {
+			if(quote && title[end] == quote) {
+				quote = 0;
+			} else if(!quote && (title[end] == '\'' || title[end] == '"')) {
+				quote = title[end];
+			}
+		}
+		std::string prop = trimmed(title.substr(pos, end - pos));
+		if(!prop.empty()) {
+			std::size_t split = prop.find_first_of(s_whitespace);
+			props.push_back(std::make_pair(prop.substr(0, split), split == std::string::npos ? std::string() : trimmed(prop.substr(split))));
+		}
+		pos = end + 1;
+	}
+	return props;
+}
+
+std::string HOCRItem::titleProperty(const std::string& key) const {
+	for(const auto& prop : titleProperties()) {
+		if(prop.first == key) {
+			return prop.second;
+		}
+	}
+	return std::string();
+}
+
+std::string HOCRItem::titleWithProperty(const std::string& key, const std::string& value) const {
+	AttributeList props = titleProperties();
+	auto it = std::find_if(props.begin(), props.end(), [&key](const std::pair<std::string, std::string>& prop) {
+		return prop.first == key;
+	});
+	if(it != props.end()) {
+		it->second = value;
+	} else {
+		props.push_back(std::make_pair(key, value));
+	}
+	std::string title;
+	for(const auto& prop : props) {
+		if(!title.empty()) {
+			title += "; ";
+		}
+		title += prop.first + " " + prop.second;
+	}
+	return title;
+}
+
+void HOCRItem::setTitleProperty(const std::string& key, const std::string& value) {
+	setAttribute("title", titleWithProperty(key, value));
+}
+
+void HOCRItem::setBBox(const BBox& bbox) {
+	setTitleProperty("bbox", bbox.toString());
+}
+
+void HOCRItem::parseTitle() {
+	for(const auto& attr : m_attributes) {
+		if(attr.first == "title") {
+			applyTitle(Title::parse(attr.second.c_str()));
+			return;
+		}
+	}
+	applyTitle(Title());
+}
+
+void HOCRItem::applyTitle(const Title& title) {
+	m_bbox = title.bbox;
+	m_baseline = title.baseline;
+	m_fontSize = title.fontSize;
+}
+
+bool HOCRItem::isLine() const {
+	return m_class == "ocr_line" || m_class == "ocr_textfloat" || m_class == "ocr_header" || m_class == "ocr_caption";
+}
+
+bool HOCRItem::hasWords() const {
+	if(isWord()) {
+		return true;
+	}
+	for(const HOCRItem* child : m_children) {
+		if(child->hasWords()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+HOCRPage* HOCRItem::page() const {
+	const HOCRItem* item = this;
+	while(item->m_parent) {
+		item = item->m_parent;
+	}
+	return item->isPage() ? static_cast<HOCRPage*>(const_cast<HOCRItem*>(item)) : nullptr;
+}
+
+int HOCRItem::index() const {
+	if(!m_parent) {
+		return -1;
+	}
+	auto it = std::find(m_parent->m_children.begin(), m_parent->m_children.end(), this);
+	return int(it - m_parent->m_children.begin());
+}
+
+void HOCRItem::appendChild(HOCRItem* item) {
+	item->m_parent = this;
+	m_children.push_back(item);
+}
+
+void HOCRItem::insertChild(int i, HOCRItem* item) {
+	item->m_parent = this;
+	m_children.insert(m_children.begin() + i, item);
+}
+
+HOCRItem* HOCRItem::takeChild(int i) {
+	HOCRItem* item = m_children[i];
+	m_children.erase(m_children.begin() + i);
+	item->m_parent = nullptr;
+	return item;
+}
+
+std::string HOCRItem::toHtml(int indent) const {
+	std::string out;
+	writeHtml(out, indent);
+	return out;
+}
+
+void HOCRItem::writeHtml(std::string& out, int indent) const {
+	out.append(indent, ' ');
+	out += "<" + m_tag;
+	for(const auto& attr : m_attributes) {
+		out += " " + attr.first + "=\"";
+		appendEscaped(out, attr.second, true);
+		out += "\"";
+	}
+	out += ">";
+	if(isWord()) {
+		out += m_bold ? "<strong>" : "";
+		out += m_italic ? "<em>" : "";
+		appendEscaped(out, m_text, false);
+		out += m_italic ? "</em>" : "";
+		out += m_bold ? "</strong>" : "";
+	} else if(!m_children.empty()) {
+		out += "\n";
+		for(const HOCRItem* child : m_children) {
+			child->writeHtml(out, indent + 1);
+		}
+		out.append(indent, ' ');
+	}
+	out += "</" + m_tag + ">\n";
+}
+
+
+HOCRPage::HOCRPage(const AttributeList& attributes)
+	: HOCRItem("div", attributes, false) {
+	parseTitle();
+}
+
+void HOCRPage::applyTitle(const Title& title) {
+	HOCRItem::applyTitle(title);
+	m_sourceFile = title.image;
+	m_pageNr = title.pageNr;
+	m_angle = title.angle;
+	m_resolution = title.resolution;
+}
+
+
+void HOCRSpatialIndex::build(const std::vector<HOCRItem*>& items) {
+	m_items = items;
+	m_bboxes.clear();
+	m_cellStart.clear();
+	m_entries.clear();
+	m_cols = m_rows = 0;
+	if(items.empty()) {
+		return;
+	}
+	m_bboxes.reserve(items.size());
+	m_extent = items.front()->bbox();
+	for(const HOCRItem* item : items) {
+		m_bboxes.push_back(item->bbox());
+		m_extent = m_extent.united(item->bbox());
+	}
+	// About one item per cell, with cells roughly as wide as they are high
+	int n = int(items.size());
+	int width = std::max(1, m_extent.width());
+	int height = std::max(1, m_extent.height());
+	m_cols = std::max(1, std::min(n, int(std::sqrt(double(n) * width / height) + 0.5)));
+	m_rows = std::max(1, (n + m_cols - 1) / m_cols);
+	m_cellWidth = std::max(1, (width + m_cols - 1) / m_cols);
+	m_cellHeight = std::max(1, (height + m_rows - 1) / m_rows);
+
+	// Count the entries per cell, then fill them in
+	m_cellStart.assign(m_cols * m_rows + 1, 0);
+	int col1, row1, col2, row2;
+	for(const HOCRItem::BBox& bbox : m_bboxes) {
+		cellRange(bbox, col1, row1, col2, row2);
+		for(int row = row1; row <= row2; ++row) {
+			for(int col = col1; col <= col2; ++col) {
+				++m_cellStart[row * m_cols + col + 1];
+			}
+		}
+	}
+	for(int i = 1, m = m_cellStart.size(); i < m; ++i) {
+		m_cellStart[i] += m_cellStart[i - 1];
+	}
+	m_entries.resize(m_cellStart.back());
+	std::vector<int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+	for(int i = 0; i < n; ++i) {
+		cellRange(m_bboxes[i], col1, row1, col2, row2);
+		for(int row = row1; row <= row2; ++row) {
+			for(int col = col1; col <= col2; ++col) {
+				m_entries[fill[row * m_cols + col]++] = i;
+			}
+		}
+	}
+}
+
+bool HOCRSpatialIndex::cellRange(const HOCRItem::BBox& bbox, int& col1, int& row1, int& col2, int& row2) const {
+	if(m_cols == 0 || bbox.x2 < m_extent.x1 || bbox.x1 > m_extent.x2 || bbox.y2 < m_extent.y1 || bbox.y1 > m_extent.y2) {
+		return false;
+	}
+	col1 = std::max(0, (bbox.x1 - m_extent.x1) / m_cellWidth);
+	row1 = std::max(0, (bbox.y1 - m_extent.y1) / m_cellHeight);
+	col2 = std::min(m_cols - 1, (bbox.x2 - m_extent.x1) / m_cellWidth);
+	row2 = std::min(m_rows - 1, (bbox.y2 - m_extent.y1) / m_cellHeight);
+	return true;
+}
+
+std::vector<HOCRItem*> HOCRSpatialIndex::itemsAt(int x, int y) const {
+	std::vector<HOCRItem*> items;
+	int col, row;
+	if(!cellRange(HOCRItem::BBox(x, y, x, y), col, row, col, row)) {
+		return items;
+	}
+	// Entries are stored in item order
+	int cell = row * m_cols + col;
+	for(int i = m_cellStart[cell], end = m_cellStart[cell + 1]; i < end; ++i) {
+		const HOCRItem::BBox& bbox = m_bboxes[m_entries[i]];
+		if(x >= bbox.x1 && x <= bbox.x2 && y >= bbox.y1 && y <= bbox.y2) {
+			items.push_back(m_items[m_entries[i]]);
+		}
+	}
+	return items;
+}
+
+std::vector<HOCRItem*> HOCRSpatialIndex::itemsIntersecting(const HOCRItem::BBox& bbox) const {
+	std::vector<int> matches;
+	int col1, row1, col2, row2;
+	if(!cellRange(bbox, col1, row1, col2, row2)) {
+		return std::vector<HOCRItem*>();
+	}
+	for(int row = row1; row <= row2; ++row) {
+		for(int col = col1; col <= col2; ++col) {
+			int cell = row * m_cols + col;
+			for(int i = m_cellStart[cell], end = m_cellStart[cell + 1]; i < end; ++i) {
+				if(bbox.intersects(m_bboxes[m_entries[i]])) {
+					matches.push_back(m_entries[i]);
+				}
+			}
+		}
+	}
+	// Items spanning several cells are found more than once
+	std::sort(matches.begin(), matches.end());
+	matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+	std::vector<HOCRItem*> items;
+	items.reserve(matches.size());
+	for(int i : matches) {
+		items.push_back(m_items[i]);
+	}
+	return items;
+}
+
+
+static inline bool isWordSeparator(char c) {
+	unsigned char u = c;
+	return u < 0x80 && !std::isalnum(u);
+}
+
+// The range of the word text without the surrounding ASCII punctuation and whitespace
+static void wordCore(const std::string& text, std::size_t& start, std::size_t& end) {
+	start = 0;
+	end = text.size();
+	while(start < end && isWordSeparator(text[start])) {
+		++start;
+	}
+	while(end > start && isWordSeparator(text[end - 1])) {
+		--end;
+	}
+}
+
+static bool coreEquals(const std::string& text, const std::string& core) {
+	std::size_t start, end;
+	wordCore(text, start, end);
+	return text.compare(start, end - start, core) == 0;
+}
+
+static void appendUtf8(std::string& out, unsigned long cp) {
+	if(cp < 0x80) {
+		out += char(cp);
+	} else if(cp < 0x800) {
+		out += char(0xC0 | (cp >> 6));
+		out += char(0x80 | (cp & 0x3F));
+	} else if(cp < 0x10000) {
+		out += char(0xE0 | (cp >> 12));
+		out += char(0x80 | ((cp >> 6) & 0x3F));
+		out += char(0x80 | (cp & 0x3F));
+	} else {
+		out += char(0xF0 | (cp >> 18));
+		out += char(0x80 | ((cp >> 12) & 0x3F));
+		out += char(0x80 | ((cp >> 6) & 0x3F));
+		out += char(0x80 | (cp & 0x3F));
+	}
+}
+
+// The key under which words are indexed: the core of the text in lower case
+static std::string wordKey(const std::string& text) {
+	std::size_t start, end;
+	wordCore(text, start, end);
+	std::string key;
+	key.reserve(end - start);
+	for(std::size_t i = start; i < end;) {
+		unsigned char c = text[i];
+		if(c < 0x80) {
+			key += char(std::tolower(c));
+			++i;
+			continue;
+		}
+		std::size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+		unsigned long cp = len == 4 ? c & 0x07 : len == 3 ? c & 0x0F : c & 0x1F;
+		bool valid = len > 1 && i + len <= end;
+		for(std::size_t j = 1; valid && j < len; ++j) {
+			unsigned char cont = text[i + j];
+			valid = (cont & 0xC0) == 0x80;
+			cp = (cp << 6) | (cont & 0x3F);
+		}
+		if(!valid) {
+			// Not UTF-8, keep the byte as is
+			key += text[i++];
+			continue;
+		}
+		if(cp <= static_cast<unsigned long>(WCHAR_MAX)) {
+			cp = std::towlower(static_cast<wint_t>(cp));
+		}
+		appendUtf8(key, cp);
+		i += len;
+	}
+	return key;
+}
+
+
+class HOCRDocument::Operation {
+public:
+	virtual ~Operation() {}
+	// Swaps the state stored in the operation with the one of the document, so the same call undoes and redoes it
+	virtual void toggle(HOCRDocument* document) = 0;
+};
+
+class HOCRDocument::TextOperation : public HOCRDocument::Operation {
+public:
+	TextOperation(HOCRItem* item, const std::string& text) : m_item(item), m_text(text) {}
+	void toggle(HOCRDocument* document) override {
+		std::string text = m_item->text();
+		bool word = m_item->isWord();
+		if(word) {
+			document->unindexWord(m_item);
+		}
+		m_item->setText(m_text);
+		if(word) {
+			document->indexWord(m_item);
+		}
+		m_text.swap(text);
+		if(document->m_observer) {
+			document->m_observer->itemChanged(m_item);
+		}
+	}
+
+private:
+	HOCRItem* m_item;
+	std::string m_text;
+};
+
+class HOCRDocument::AttributeOperation : public HOCRDocument::Operation {
+public:
+	AttributeOperation(HOCRItem* item, const std::string& name, const std::string& value)
+		: m_item(item), m_name(name), m_value(value) {}
+	const HOCRItem* item() const { return m_item; }
+	void toggle(HOCRDocument* document) override {
+		bool present = m_item->hasAttribute(m_name);
+		std::string value = m_item->attribute(m_name);
+		if(m_name == "id") {
+			auto it = document->m_idIndex.find(value);
+			if(it != document->m_idIndex.end() && it->second == m_item) {
+				document->m_idIndex.erase(it);
+			}
+		}
+		if(m_present) {
+			m_item->setAttribute(m_name, m_value);
+		} else {
+			m_item->removeAttribute(m_name);
+		}
+		if(m_name == "id" && m_present && !m_value.empty()) {
+			document->m_idIndex[m_value] = m_item;
+		}
+		if(m_name == "title") {
+			document->invalidateSpatialIndex(m_item);
+		}
+		m_value.swap(value);
+		m_present = present;
+		if(document->m_observer) {
+			document->m_observer->itemChanged(m_item);
+		}
+	}
+
+private:
+	HOCRItem* m_item;
+	std::string m_name;
+	std::string m_value;
+	bool m_present = true;
+};
+
+// Inserts or removes an item. The operation owns the item while it is not part of the document.
+class HOCRDocument::StructureOperation : public HOCRDocument::Operation {
+public:
+	// Removes the item
+	StructureOperation(HOCRItem* item) : m_item(item), m_attached(true) {}
+	// Inserts the item at the index of the parent, or of the pages if the parent is null
+	StructureOperation(HOCRItem* parent, int index, HOCRItem* item) : m_parent(parent), m_index(index), m_item(item), m_attached(false) {}
+	~StructureOperation() {
+		if(!m_attached) {
+			delete m_item;
+		}
+	}
+	void toggle(HOCRDocument* document) override {
+		if(m_attached) {
+			m_parent = m_item->parent();
+			if(m_parent) {
+				m_index = m_item->index();
+			} else {
+				m_index = std::find(document->m_pages.begin(), document->m_pages.end(), m_item) - document->m_pages.begin();
+			}
+			document->detachItem(m_item);
+		} else {
+			document->attachItem(m_parent, m_index, m_item);
+		}
+		m_attached = !m_attached;
+	}
+
+private:
+	HOCRItem* m_parent = nullptr;
+	int m_index = 0;
+	HOCRItem* m_item;
+	bool m_attached;
+};
+
+
+HOCRDocument::~HOCRDocument() {
+	m_observer = nullptr;
+	clear();
+}
+
+void HOCRDocument::addPage(HOCRPage* page, bool cleanGraphics) {
+	preparePage(page, nextPageId(), cleanGraphics);
+	addPreparedPage(page);
+}
+
+void HOCRDocument::preparePage(HOCRPage* page, int pageId, bool cleanGraphics) {
+	std::string pageIdStr = std::to_string(pageId);
+	page->setAttribute("id", "page_" + pageIdStr);
+	normalizeItem(page, pageIdStr);
+
+	if(cleanGraphics) {
+		// Discard graphic elements which intersect with text block or which are too small
+		std::vector<HOCRItem*> textBlocks;
+		for(HOCRItem* block : page->children()) {
+			if(!block->isGraphic()) {
+				textBlocks.push_back(block);
+			}
+		}
+		HOCRSpatialIndex textBlockIndex(textBlocks);
+		for(int i = page->childCount() - 1; i >= 0; --i) {
+			HOCRItem* block = page->child(i);
+			if(!block->isGraphic()) {
+				continue;
+			}
+			const HOCRItem::BBox& bbox = block->bbox();
+			bool deleteGraphic = bbox.width() < 10 || bbox.height() < 10 || !textBlockIndex.itemsIntersecting(bbox).empty();
+			if(deleteGraphic) {
+				delete page->takeChild(i);
+			}
+		}
+	}
+	page->m_preparedHtml = page->toHtml();
+}
+
+void HOCRDocument::addPreparedPage(HOCRPage* page) {
+	journal({"page", page->label(), page->m_preparedHtml});
+	std::string().swap(page->m_preparedHtml);
+	// Pages restored from the journal keep their ids, ids handed out later must not collide with them
+	std::string id = page->id();
+	int pageId = std::atoi(id.c_str() + id.rfind('_') + 1);
+	int counter = m_pageIdCounter;
+	while(pageId > counter && !m_pageIdCounter.compare_exchange_weak(counter, pageId));
+	page->m_sequence = ++m_pageSequence;
+	attachItem(nullptr, pageCount(), page);
+}
+
+bool HOCRDocument::normalizeItem(HOCRItem* item, const std::string& pageId) {
+	// Renumber ids of the form <type>_<page>_<nr> so that they are unique across pages
+	std::string id = item->id();
+	std::size_t nrPos = id.rfind('_');
+	std::size_t pagePos = nrPos == std::string::npos || nrPos == 0 ? std::string::npos : id.rfind('_', nrPos - 1);
+	if(pagePos != std::string::npos && pagePos > 0) {
+		item->setAttribute("id", id.substr(0, pagePos) + "_" + pageId + id.substr(nrPos));
+	}
+	if(item->isWord()) {
+		return true;
+	}
+	bool haveWords = false;
+	for(int i = item->childCount() - 1; i >= 0; --i) {
+		HOCRItem* child = item->child(i);
+		if(normalizeItem(child, pageId)) {
+			haveWords = true;
+		} else if(!(item->isPage() && child->itemClass() == "ocr_carea")) {
+			// Keep text-less content areas as graphics
+			delete item->takeChild(i);
+		}
+	}
+	if(item->isLine() && item->childCount() > 0) {
+		// Ensure correct hyphen char is used on last word of line
+		HOCRItem* word = item->child(item->childCount() - 1);
+		std::string text = word->text();
+		std::size_t end = text.find_last_not_of(s_whitespace);
+		if(end != std::string::npos && text[end] == '-') {
+			word->setText(text.substr(0, end + 1));
+		} else if(end != std::string::npos && end >= 2 && text.compare(end - 2, 3, "\xE2\x80\x94") == 0) {
+			word->setText(text.substr(0, end - 2) + "-");
+		}
+	}
+	return haveWords;
+}
+
+void HOCRDocument::removePage(HOCRPage* page) {
+	removeItem(page);
+}
+
+void HOCRDocument::clear() {
+	m_bboxOperation = nullptr;
+	clearSteps(m_undoStack);
+	clearSteps(m_redoStack);
+	for(HOCRPage* page : m_pages) {
+		delete page;
+	}
+	m_pages.clear();
+	m_idIndex.clear();
+	m_wordIndex.clear();
+	m_spatialIndex.clear();
+	// The page id counter is not reset, as pages prepared in the meantime may still be added
+	m_pageSequence = 0;
+	if(m_journal) {
+		m_journal->reset();
+	}
+	if(m_observer) {
+		m_observer->historyChanged();
+	}
+}
+
+bool HOCRDocument::replay(const std::vector<HOCRJournal::Record>& records, const std::function<HOCRPage*(const std::string&)>& parsePage) {
+	for(const HOCRJournal::Record& record : records) {
+		const std::string& type = record[0];
+		int argc = int(record.size()) - 1;
+		HOCRItem* item = argc >= 1 ? itemById(record[1]) : nullptr;
+		if(type == "page" && argc == 2) {
+			HOCRPage* page = parsePage(record[2]);
+			if(!page) {
+				return false;
+			}
+			page->setLabel(record[1]);
+			page->m_preparedHtml = record[2];
+			addPreparedPage(page);
+		} else if(type == "saved" && argc == 0) {
+			continue;
+		} else if(type == "undo" && argc == 0) {
+			undo();
+		} else if(type == "redo" && argc == 0) {
+			redo();
+		} else if(type == "merge" && argc >= 1) {
+			std::vector<HOCRItem*> words;
+			for(int i = 1; i <= argc; ++i) {
+				words.push_back(itemById(record[i]));
+				if(!words.back()) {
+					return false;
+				}
+			}
+			mergeWords(words);
+		} else if(type == "replace" && argc == 3) {
+			replaceWords(record[1], record[2], record[3] == "1");
+		} else if(!item) {
+			return false;
+		} else if(type == "enable" && argc == 2) {
+			setItemEnabled(item, record[2] == "1");
+		} else if(type == "text" && argc == 2) {
+			setItemText(item, record[2]);
+		} else if(type == "attr" && argc == 3) {
+			setItemAttribute(item, record[2], record[3]);
+		} else if(type == "bbox" && argc == 5) {
+			setItemBBox(item, HOCRItem::BBox(std::atoi(record[2].c_str()), std::atoi(record[3].c_str()), std::atoi(record[4].c_str()), std::atoi(record[5].c_str())));
+		} else if(type == "remove" && argc == 1) {
+			removeItem(item);
+		} else if(type == "graphic" && argc == 5 && item->isPage()) {
+			addGraphic(static_cast<HOCRPage*>(item), HOCRItem::BBox(std::atoi(record[2].c_str()), std::atoi(record[3].c_str()), std::atoi(record[4].c_str()), std::atoi(record[5].c_str())));
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+void HOCRDocument::markSaved() {
+	journal({"saved"});
+}
+
+bool HOCRDocument::hasUnsavedEdits(const std::vector<HOCRJournal::Record>& records) {
+	return !records.empty() && records.back()[0] != "saved";
+}
+
+HOCRItem* HOCRDocument::itemById(const std::string& id) const {
+	auto it = m_idIndex.find(id);
+	return it != m_idIndex.end() ? it->second : nullptr;
+}
+
+std::vector<HOCRItem*> HOCRDocument::itemsAt(const HOCRPage* page, int x, int y) const {
+	return spatialIndex(page).itemsAt(x, y);
+}
+
+std::vector<HOCRItem*> HOCRDocument::itemsIntersecting(const HOCRPage* page, const HOCRItem::BBox& bbox) const {
+	return spatialIndex(page).itemsIntersecting(bbox);
+}
+
+static void collectSpatialItems(HOCRItem* item, std::vector<HOCRItem*>& items) {
+	for(HOCRItem* child : item->children()) {
+		items.push_back(child);
+		collectSpatialItems(child, items);
+	}
+}
+
+const HOCRSpatialIndex& HOCRDocument::spatialIndex(const HOCRPage* page) const {
+	auto it = m_spatialIndex.find(page);
+	if(it == m_spatialIndex.end()) {
+		std::vector<HOCRItem*> items;
+		collectSpatialItems(const_cast<HOCRPage*>(page), items);
+		it = m_spatialIndex.insert(std::make_pair(page, HOCRSpatialIndex(items))).first;
+	}
+	return it->second;
+}
+
+void HOCRDocument::invalidateSpatialIndex(const HOCRItem* item) {
+	HOCRPage* page = item->page();
+	if(page) {
+		m_spatialIndex.erase(page);
+	}
+}
+
+void HOCRDocument::setItemEnabled(HOCRItem* item, bool enabled) {
+	journal({"enable", item->id(), enabled ? "1" : "0"});
+	item->setEnabled(enabled);
+	if(m_observer) {
+		m_observer->itemChanged(item);
+	}
+}
+
+void HOCRDocument::setItemText(HOCRItem* item, const std::string& text) {
+	journal({"text", item->id(), text});
+	beginStep();
+	apply(new TextOperation(item, text));
+	endStep();
+}
+
+void HOCRDocument::setItemAttribute(HOCRItem* item, const std::string& name, const std::string& value) {
+	journal({"attr", item->id(), name, value});
+	beginStep();
+	apply(new AttributeOperation(item, name, value));
+	endStep();
+}
+
+void HOCRDocument::setItemTitleProperty(HOCRItem* item, const std::string& key, const std::string& value) {
+	setItemAttribute(item, "title", item->titleWithProperty(key, value));
+}
+
+void HOCRDocument::setItemBBox(HOCRItem* item, const HOCRItem::BBox& bbox) {
+	journal({"bbox", item->id(), std::to_string(bbox.x1), std::to_string(bbox.y1), std::to_string(bbox.x2), std::to_string(bbox.y2)});
+	if(m_bboxOperation && m_bboxOperation->item() == item) {
+		// The operation keeps the title from before the first change
+		item->setBBox(bbox);
+		invalidateSpatialIndex(item);
+		if(m_observer) {
+			m_observer->itemChanged(item);
+		}
+		return;
+	}
+	beginStep();
+	AttributeOperation* operation = new AttributeOperation(item, "title", item->titleWithProperty("bbox", bbox.toString()));
+	apply(operation);
+	endStep();
+	m_bboxOperation = operation;
+}
+
+bool HOCRDocument::setItemId(HOCRItem* item, const std::string& id) {
+	if(id.empty() || m_idIndex.find(id) != m_idIndex.end()) {
+		return false;
+	}
+	setItemAttribute(item, "id", id);
+	return true;
+}
+
+void HOCRDocument::indexItem(HOCRItem* item) {
+	std::string id = item->id();
+	if(!id.empty()) {
+		m_idIndex[id] = item;
+	}
+	if(item->isWord()) {
+		indexWord(item);
+	}
+	for(HOCRItem* child : item->children()) {
+		indexItem(child);
+	}
+}
+
+void HOCRDocument::unindexItem(const HOCRItem* item) {
+	auto it = m_idIndex.find(item->id());
+	if(it != m_idIndex.end() && it->second == item) {
+		m_idIndex.erase(it);
+	}
+	if(item->isWord()) {
+		unindexWord(item);
+	}
+	for(const HOCRItem* child : item->children()) {
+		unindexItem(child);
+	}
+}
+
+void HOCRDocument::indexWord(HOCRItem* word) {
+	std::string key = wordKey(word->text());
+	if(!key.empty()) {
+		m_wordIndex[key].insert(word);
+	}
+}
+
+void HOCRDocument::unindexWord(const HOCRItem* word) {
+	auto it = m_wordIndex.find(wordKey(word->text()));
+	if(it != m_wordIndex.end()) {
+		it->second.erase(const_cast<HOCRItem*>(word));
+		if(it->second.empty()) {
+			m_wordIndex.erase(it);
+		}
+	}
+}
+
+bool HOCRDocument::DocumentOrder::operator()(const HOCRItem* a, const HOCRItem* b) const {
+	const HOCRPage* pageA = a->page();
+	const HOCRPage* pageB = b->page();
+	if(pageA != pageB) {
+		// Pages are only ever appended, or reinserted where they were removed from, so the order in
+		// which they were added is the order in the document
+		return pageA->m_sequence < pageB->m_sequence;
+	}
+	return a->m_pageOrder < b->m_pageOrder;
+}
+
+// Numbers the items in document order. Inserting items leaves the relative order of the others
+// unchanged, so renumbering does not disturb the word index.
+void HOCRDocument::numberItems(HOCRItem* item, int& order) {
+	item->m_pageOrder = order++;
+	for(HOCRItem* child : item->children()) {
+		numberItems(child, order);
+	}
+}
+
+const std::set<HOCRItem*, HOCRDocument::DocumentOrder>* HOCRDocument::indexedWords(const std::string& text) const {
+	std::string key = wordKey(text);
+	if(key.empty()) {
+		return nullptr;
+	}
+	auto it = m_wordIndex.find(key);
+	return it != m_wordIndex.end() ? &it->second : nullptr;
+}
+
+bool HOCRDocument::matchesWord(const std::string& wordText, const std::string& text, bool matchCase) {
+	if(matchCase) {
+		std::size_t start, end;
+		wordCore(text, start, end);
+		return end > start && coreEquals(wordText, text.substr(start, end - start));
+	}
+	std::string key = wordKey(text);
+	return !key.empty() && wordKey(wordText) == key;
+}
+
+std::vector<HOCRItem*> HOCRDocument::findWords(const std::string& text, bool matchCase) const {
+	std::vector<HOCRItem*> words;
+	const std::set<HOCRItem*, DocumentOrder>* matches = indexedWords(text);
+	if(!matches) {
+		return words;
+	}
+	std::size_t start, end;
+	wordCore(text, start, end);
+	std::string core = text.substr(start, end - start);
+	for(HOCRItem* word : *matches) {
+		if(!matchCase || coreEquals(word->text(), core)) {
+			words.push_back(word);
+		}
+	}
+	return words;
+}
+
+HOCRItem* HOCRDocument::findWord(const std::string& text, bool matchCase, const HOCRItem* from, bool backwards) const {
+	const std::set<HOCRItem*, DocumentOrder>* matches = indexedWords(text);
+	if(!matches) {
+		return nullptr;
+	}
+	std::size_t start, end;
+	wordCore(text, start, end);
+	std::string core = text.substr(start, end - start);
+	auto accept = [&](const HOCRItem* word) {
+		return !matchCase || coreEquals(word->text(), core);
+	};
+	HOCRItem* key = const_cast<HOCRItem*>(from);
+	// Search up to the end (or start) of the document, then wrap around to the item
+	if(!backwards) {
+		auto pos = from ? matches->upper_bound(key) : matches->begin();
+		for(auto it = pos; it != matches->end(); ++it) {
+			if(accept(*it)) {
+				return *it;
+			}
+		}
+		for(auto it = matches->begin(); it != pos; ++it) {
+			if(accept(*it)) {
+				return *it;
+			}
+		}
+	} else {
+		auto pos = from ? matches->lower_bound(key) : matches->end();
+		for(auto it = pos; it != matches->begin();) {
+			if(accept(*--it)) {
+				return *it;
+			}
+		}
+		for(auto it = matches->end(); it != pos;) {
+			if(accept(*--it)) {
+				return *it;
+			}
+		}
+	}
+	return nullptr;
+}
+
+bool HOCRDocument::replaceWord(HOCRItem* word, const std::string& text, const std::string& replacement, bool matchCase) {
+	std::string wordText = word->text();
+	if(!matchesWord(wordText, text, matchCase)) {
+		return false;
+	}
+	std::size_t start, end;
+	wordCore(wordText, start, end);
+	setItemText(word, wordText.substr(0, start) + replacement + wordText.substr(end));
+	return true;
+}
+
+int HOCRDocument::replaceWords(const std::string& text, const std::string& replacement, bool matchCase) {
+	// The matches are collected first, as replacing them updates the index
+	std::vector<HOCRItem*> words = findWords(text, matchCase);
+	if(words.empty()) {
+		return 0;
+	}
+	journal({"replace", text, replacement, matchCase ? "1" : "0"});
+	beginStep();
+	for(HOCRItem* word : words) {
+		replaceWord(word, text, replacement, matchCase);
+	}
+	endStep();
+	return int(words.size());
+}
+
+void HOCRDocument::attachItem(HOCRItem* parent, int index, HOCRItem* item) {
+	if(!parent) {
+		index = std::min(index, pageCount());
+	}
+	if(m_observer) {
+		m_observer->itemAboutToBeInserted(parent, index, item);
+	}
+	if(parent) {
+		parent->insertChild(index, item);
+	} else {
+		m_pages.insert(m_pages.begin() + index, static_cast<HOCRPage*>(item));
+	}
+	int order = 0;
+	numberItems(item->page(), order);
+	indexItem(item);
+	invalidateSpatialIndex(item);
+	if(m_observer) {
+		m_observer->itemInserted(item);
+	}
+}
+
+void HOCRDocument::detachItem(HOCRItem* item) {
+	if(m_observer) {
+		m_observer->itemAboutToBeRemoved(item);
+	}
+	unindexItem(item);
+	invalidateSpatialIndex(item);
+	if(item->parent()) {
+		item->parent()->takeChild(item->index());
+	} else {
+		m_pages.erase(std::find(m_pages.begin(), m_pages.end(), item));
+	}
+	if(m_observer) {
+		m_observer->itemRemoved(item);
+	}
+}
+
+void HOCRDocument::removeItem(HOCRItem* item) {
+	std::string id = item->id();
+	// Also drop text containers which become empty, they would otherwise turn into graphics
+	while(item->parent() && !item->parent()->isPage() && item->parent()->childCount() == 1) {
+		item = item->parent();
+	}
+	if(!item->parent() && !item->isPage()) {
+		return;
+	}
+	journal({"remove", id});
+	beginStep();
+	apply(new StructureOperation(item));
+	endStep();
+}
+
+HOCRItem* HOCRDocument::mergeWords(const std::vector<HOCRItem*>& words) {
+	if(words.empty()) {
+		return nullptr;
+	}
+	HOCRJournal::Record record = {"merge"};
+	for(const HOCRItem* word : words) {
+		record.push_back(word->id());
+	}
+	journal(record);
+	beginStep();
+	HOCRItem* target = words.front();
+	HOCRItem::BBox bbox = target->bbox();
+	std::string text = target->text();
+	for(int i = 1, n = words.size(); i < n; ++i) {
+		bbox = bbox.united(words[i]->bbox());
+		text += words[i]->text();
+		removeItem(words[i]);
+	}
+	setItemText(target, text);
+	setItemTitleProperty(target, "bbox", bbox.toString());
+	endStep();
+	return target;
+}
+
+HOCRItem* HOCRDocument::addGraphic(HOCRPage* page, const HOCRItem::BBox& bbox) {
+	journal({"graphic", page->id(), std::to_string(bbox.x1), std::to_string(bbox.y1), std::to_string(bbox.x2), std::to_string(bbox.y2)});
+	// Determine a free block id
+	std::string pageId = page->id().substr(page->id().rfind('_') + 1);
+	int blockId = 0;
+	for(HOCRItem* block : page->children()) {
+		std::string id = block->id();
+		std::size_t pos = id.rfind('_');
+		if(pos != std::string::npos) {
+			blockId = std::max(blockId, std::atoi(id.c_str() + pos + 1) + 1);
+		}
+	}
+	std::string id = "block_" + pageId + "_" + std::to_string(blockId);
+	while(m_idIndex.find(id) != m_idIndex.end()) {
+		id = "block_" + pageId + "_" + std::to_string(++blockId);
+	}
+	HOCRItem::AttributeList attrs = {
+		{"class", "ocr_carea"},
+		{"id", id},
+		{"title", "bbox " + bbox.toString()}
+	};
+	HOCRItem* item = new HOCRItem("div", attrs);
+	beginStep();
+	apply(new StructureOperation(page, page->childCount(), item));
+	endStep();
+	return item;
+}
+
+void HOCRDocument::undo() {
+	if(m_undoStack.empty()) {
+		return;
+	}
+	journal({"undo"});
+	m_bboxOperation = nullptr;
+	Step step = m_undoStack.back();
+	m_undoStack.pop_back();
+	for(auto it = step.rbegin(), itEnd = step.rend(); it != itEnd; ++it) {
+		(*it)->toggle(this);
+	}
+	m_redoStack.push_back(step);
+	if(m_observer) {
+		m_observer->historyChanged();
+	}
+}
+
+void HOCRDocument::redo() {
+	if(m_redoStack.empty()) {
+		return;
+	}
+	journal({"redo"});
+	m_bboxOperation = nullptr;
+	Step step = m_redoStack.back();
+	m_redoStack.pop_back();
+	for(Operation* operation : step) {
+		operation->toggle(this);
+	}
+	m_undoStack.push_back(step);
+	if(m_observer) {
+		m_observer->historyChanged();
+	}
+}
+
+void HOCRDocument::journal(const HOCRJournal::Record& record) {
+	if(m_journal && m_stepDepth == 0) {
+		m_journal->append(record);
+	}
+}
+
+void HOCRDocument::beginStep() {
+	if(m_stepDepth++ == 0) {
+		m_bboxOperation = nullptr;
+		clearSteps(m_redoStack);
+		m_undoStack.push_back(Step());
+	}
+}
+
+void HOCRDocument::endStep() {
+	if(--m_stepDepth == 0) {
+		if(m_undoStack.back().empty()) {
+			m_undoStack.pop_back();
+		}
+		if(m_observer) {
+			m_observer->historyChanged();
+		}
+	}
+}
+
+void HOCRDocument::apply(Operation* operation) {
+	operation->toggle(this);
+	m_undoStack.back().push_back(operation);
+}
+
+void HOCRDocument::clearSteps(std::vector<Step>& steps) {
+	for(const Step& step : steps) {
+		for(Operation* operation : step) {
+			delete operation;
+		}
+	}
+	steps.clear();
+}
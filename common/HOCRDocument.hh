@@ -0,0 +1,352 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRDocument.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOCRDOCUMENT_HH
+#define HOCRDOCUMENT_HH
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "HOCRJournal.hh"
+
+class HOCRPage;
+
+// A node of the hOCR element tree (ocr_page, ocr_carea, ocr_par, ocr_line, ocrx_word).
+// Strings are UTF-8. The numeric title properties are kept parsed alongside the title attribute.
+class HOCRItem {
+public:
+	typedef std::vector<std::pair<std::string, std::string>> AttributeList;
+
+	struct BBox {
+		int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+
+		BBox() {}
+		BBox(int _x1, int _y1, int _x2, int _y2) : x1(_x1), y1(_y1), x2(_x2), y2(_y2) {}
+		int width() const { return x2 - x1; }
+		int height() const { return y2 - y1; }
+		bool intersects(const BBox& other) const {
+			return x1 < other.x2 && other.x1 < x2 && y1 < other.y2 && other.y1 < y2;
+		}
+		BBox united(const BBox& other) const;
+		std::string toString() const;
+	};
+
+	// The title properties which are kept parsed. Pages use the image, pageno, rot and res properties.
+	struct Title {
+		BBox bbox;
+		int baseline = 0;
+		double fontSize = 0.;
+		std::string image;
+		int pageNr = 0;
+		double angle = 0.;
+		int resolution = 0;
+
+		// Parses the title attribute in a single pass, properties which are not listed above are skipped
+		static Title parse(const char* title);
+	};
+
+	HOCRItem(const std::string& tag, const AttributeList& attributes);
+	virtual ~HOCRItem();
+
+	const std::string& tag() const { return m_tag; }
+	const std::string& itemClass() const { return m_class; }
+	std::string id() const { return attribute("id"); }
+	const AttributeList& attributes() const { return m_attributes; }
+	bool hasAttribute(const std::string& name) const;
+	std::string attribute(const std::string& name) const;
+	void setAttribute(const std::string& name, const std::string& value);
+	void removeAttribute(const std::string& name);
+	// The title attribute split into its "key value" properties
+	AttributeList titleProperties() const;
+	std::string titleProperty(const std::string& key) const;
+	// The title attribute with the property set to the value
+	std::string titleWithProperty(const std::string& key, const std::string& value) const;
+	void setTitleProperty(const std::string& key, const std::string& value);
+
+	const BBox& bbox() const { return m_bbox; }
+	void setBBox(const BBox& bbox);
+	int baseline() const { return m_baseline; }
+	double fontSize() const { return m_fontSize; }
+
+	const std::string& text() const { return m_text; }
+	void setText(const std::string& text) { m_text = text; }
+	bool isBold() const { return m_bold; }
+	bool isItalic() const { return m_italic; }
+	void setFontFlags(bool bold, bool italic) { m_bold = bold; m_italic = italic; }
+
+	bool isEnabled() const { return m_enabled; }
+	void setEnabled(bool enabled) { m_enabled = enabled; }
+
+	bool isPage() const { return m_class == "ocr_page"; }
+	bool isWord() const { return m_class == "ocrx_word"; }
+	bool isLine() const;
+	bool isParagraph() const { return m_class == "ocr_par"; }
+	// Content areas without any text
+	bool isGraphic() const { return m_class == "ocr_graphic" || (m_class == "ocr_carea" && m_children.empty()); }
+	bool hasWords() const;
+
+	HOCRItem* parent() const { return m_parent; }
+	HOCRPage* page() const;
+	int index() const;
+	const std::vector<HOCRItem*>& children() const { return m_children; }
+	int childCount() const { return int(m_children.size()); }
+	HOCRItem* child(int i) const { return i >= 0 && i < int(m_children.size()) ? m_children[i] : nullptr; }
+	// Takes ownership of the item
+	void appendChild(HOCRItem* item);
+	void insertChild(int i, HOCRItem* item);
+	// Releases ownership of the i-th child
+	HOCRItem* takeChild(int i);
+
+	// Serializes the item and its children, indented by the specified number of spaces per level
+	std::string toHtml(int indent = 0) const;
+
+protected:
+	// For subclasses which parse the title themselves, as applyTitle() is not dispatched to them
+	// while the base is constructed
+	HOCRItem(const std::string& tag, const AttributeList& attributes, bool parseTitle);
+
+	std::string m_tag;
+	std::string m_class;
+	AttributeList m_attributes;
+	HOCRItem* m_parent = nullptr;
+	std::vector<HOCRItem*> m_children;
+	std::string m_text;
+	BBox m_bbox;
+	int m_baseline = 0;
+	double m_fontSize = 0.;
+	bool m_bold = false;
+	bool m_italic = false;
+	bool m_enabled = true;
+
+	void parseTitle();
+	virtual void applyTitle(const Title& title);
+	void writeHtml(std::string& out, int indent) const;
+
+private:
+	friend class HOCRDocument;
+
+	// Position of the item in its page in document order, kept up to date by the document, which
+	// orders its word index by it
+	int m_pageOrder = 0;
+};
+
+class HOCRPage : public HOCRItem {
+public:
+	HOCRPage(const AttributeList& attributes);
+
+	// Display label, i.e. "file [page]"
+	const std::string& label() const { return m_label; }
+	void setLabel(const std::string& label) { m_label = label; }
+	const std::string& sourceFile() const { return m_sourceFile; }
+	int pageNr() const { return m_pageNr; }
+	double angle() const { return m_angle; }
+	int resolution() const { return m_resolution; }
+
+private:
+	friend class HOCRDocument;
+
+	std::string m_label;
+	// Order in which the page was added to the document
+	int m_sequence = 0;
+	// The html of the page for its journal record, serialized by preparePage() until the page is added
+	std::string m_preparedHtml;
+	std::string m_sourceFile;
+	int m_pageNr = 0;
+	double m_angle = 0.;
+	int m_resolution = 0;
+
+	void applyTitle(const Title& title) override;
+};
+
+// Uniform grid over the bboxes of a set of items, for point and rectangle queries. Queries return the
+// items in the order in which they were passed to build().
+class HOCRSpatialIndex {
+public:
+	HOCRSpatialIndex() {}
+	explicit HOCRSpatialIndex(const std::vector<HOCRItem*>& items) { build(items); }
+
+	void build(const std::vector<HOCRItem*>& items);
+	// The items whose bbox contains the point, borders included
+	std::vector<HOCRItem*> itemsAt(int x, int y) const;
+	std::vector<HOCRItem*> itemsIntersecting(const HOCRItem::BBox& bbox) const;
+
+private:
+	std::vector<HOCRItem*> m_items;
+	std::vector<HOCRItem::BBox> m_bboxes;
+	HOCRItem::BBox m_extent;
+	int m_cols = 0;
+	int m_rows = 0;
+	int m_cellWidth = 1;
+	int m_cellHeight = 1;
+	// The item indices of cell i are m_entries[m_cellStart[i]] up to m_entries[m_cellStart[i + 1]]
+	std::vector<int> m_cellStart;
+	std::vector<int> m_entries;
+
+	// The range of cells covered by the bbox, false if it lies outside of the grid
+	bool cellRange(const HOCRItem::BBox& bbox, int& col1, int& row1, int& col2, int& row2) const;
+};
+
+// Owns the pages. The edit methods below record operations which can be undone and redone; editing the
+// items directly bypasses the history.
+class HOCRDocument {
+public:
+	// Notified about the changes made through the document. clear() only reports the history change.
+	class Observer {
+	public:
+		virtual ~Observer() {}
+		// The parent is null for pages
+		virtual void itemAboutToBeInserted(const HOCRItem* /*parent*/, int /*index*/, const HOCRItem* /*item*/) {}
+		virtual void itemInserted(HOCRItem* /*item*/) {}
+		virtual void itemAboutToBeRemoved(HOCRItem* /*item*/) {}
+		// The item is detached but still alive
+		virtual void itemRemoved(HOCRItem* /*item*/) {}
+		virtual void itemChanged(HOCRItem* /*item*/) {}
+		virtual void historyChanged() {}
+	};
+
+	HOCRDocument() {}
+	~HOCRDocument();
+	HOCRDocument(const HOCRDocument&) = delete;
+	HOCRDocument& operator=(const HOCRDocument&) = delete;
+
+	int pageCount() const { return int(m_pages.size()); }
+	HOCRPage* page(int i) const { return m_pages[i]; }
+	const std::vector<HOCRPage*>& pages() const { return m_pages; }
+
+	// Takes ownership of the page, renumbers its ids, drops text containers without words and
+	// fixes the hyphen of line-ending words. If cleanGraphics is set, graphics which are too
+	// small or which intersect text blocks are discarded.
+	void addPage(HOCRPage* page, bool cleanGraphics);
+	// The above split in two: preparePage() only touches the page and may run on any thread, with
+	// the page id taken from nextPageId(). It also serializes the page for the journal, so that
+	// addPreparedPage(), which then takes ownership of the page, does not need to.
+	int nextPageId() { return ++m_pageIdCounter; }
+	static void preparePage(HOCRPage* page, int pageId, bool cleanGraphics);
+	void addPreparedPage(HOCRPage* page);
+	void removePage(HOCRPage* page);
+	// Deletes all pages and the history
+	void clear();
+
+	void setObserver(Observer* observer) { m_observer = observer; }
+	// Pages added through and edits made through the document are appended to the journal
+	void setJournal(HOCRJournal* journal) { m_journal = journal; }
+	// Repeats the pages and edits of the journal records, the pages being parsed from their html by
+	// parsePage. Returns false if the records do not match the document.
+	bool replay(const std::vector<HOCRJournal::Record>& records, const std::function<HOCRPage*(const std::string&)>& parsePage);
+	// Records in the journal that the document was saved
+	void markSaved();
+	// Whether the journal records contain edits made after the document was last saved
+	static bool hasUnsavedEdits(const std::vector<HOCRJournal::Record>& records);
+
+	HOCRItem* itemById(const std::string& id) const;
+	// The blocks, paragraphs, lines and words of the page whose bbox contains the point, in document
+	// order, i.e. enclosing items first
+	std::vector<HOCRItem*> itemsAt(const HOCRPage* page, int x, int y) const;
+	std::vector<HOCRItem*> itemsIntersecting(const HOCRPage* page, const HOCRItem::BBox& bbox) const;
+
+	// Not recorded in the history
+	void setItemEnabled(HOCRItem* item, bool enabled);
+	void setItemText(HOCRItem* item, const std::string& text);
+	void setItemAttribute(HOCRItem* item, const std::string& name, const std::string& value);
+	void setItemTitleProperty(HOCRItem* item, const std::string& key, const std::string& value);
+	// Consecutive bbox changes of the same item, i.e. while dragging its selection, are undone in one step
+	void setItemBBox(HOCRItem* item, const HOCRItem::BBox& bbox);
+	// Changes the id of the item, fails if the id is empty or already taken
+	bool setItemId(HOCRItem* item, const std::string& id);
+	// Removes the item, along with any ancestors which are left without children. Removed items are
+	// kept alive by the history until they can no longer be restored.
+	void removeItem(HOCRItem* item);
+	// Merges the (sibling) words into the first one, which is returned
+	HOCRItem* mergeWords(const std::vector<HOCRItem*>& words);
+	// Adds a graphic region to the page and returns the new item
+	HOCRItem* addGraphic(HOCRPage* page, const HOCRItem::BBox& bbox);
+
+	// Words are matched as a whole, ignoring surrounding punctuation and, unless matchCase is set, case.
+	// The words matching the text, in document order
+	std::vector<HOCRItem*> findWords(const std::string& text, bool matchCase) const;
+	// The first matching word after (or before) the item, wrapping around at the end of the document.
+	// Searches from the start (or end) if the item is null.
+	HOCRItem* findWord(const std::string& text, bool matchCase, const HOCRItem* from, bool backwards) const;
+	// Whether the text of the word matches the search text
+	static bool matchesWord(const std::string& wordText, const std::string& text, bool matchCase);
+	// Replaces the matching text of the word, keeping the surrounding punctuation. Returns false if the word does not match.
+	bool replaceWord(HOCRItem* word, const std::string& text, const std::string& replacement, bool matchCase);
+	// Replaces all matches in one step and returns their number
+	int replaceWords(const std::string& text, const std::string& replacement, bool matchCase);
+
+	bool canUndo() const { return !m_undoStack.empty(); }
+	bool canRedo() const { return !m_redoStack.empty(); }
+	void undo();
+	void redo();
+
+private:
+	class Operation;
+	class TextOperation;
+	class AttributeOperation;
+	class StructureOperation;
+	// The operations of one edit, which are undone and redone together
+	typedef std::vector<Operation*> Step;
+
+	std::vector<HOCRPage*> m_pages;
+	std::atomic<int> m_pageIdCounter{0};
+	int m_pageSequence = 0;
+	// Maps the ids of all items of all pages to the items
+	std::unordered_map<std::string, HOCRItem*> m_idIndex;
+	struct DocumentOrder {
+		bool operator()(const HOCRItem* a, const HOCRItem* b) const;
+	};
+	// Maps the normalized text of all words to the words
+	std::unordered_map<std::string, std::set<HOCRItem*, DocumentOrder>> m_wordIndex;
+	// Built when a page is first queried, dropped when its items change
+	mutable std::unordered_map<const HOCRItem*, HOCRSpatialIndex> m_spatialIndex;
+	Observer* m_observer = nullptr;
+	HOCRJournal* m_journal = nullptr;
+	std::vector<Step> m_undoStack;
+	std::vector<Step> m_redoStack;
+	int m_stepDepth = 0;
+	// The bbox change which further bbox changes of the same item are merged into
+	AttributeOperation* m_bboxOperation = nullptr;
+
+	static bool normalizeItem(HOCRItem* item, const std::string& pageId);
+	void indexItem(HOCRItem* item);
+	void unindexItem(const HOCRItem* item);
+	void indexWord(HOCRItem* word);
+	void unindexWord(const HOCRItem* word);
+	// The words indexed under the key of the text, or null
+	const std::set<HOCRItem*, DocumentOrder>* indexedWords(const std::string& text) const;
+	static void numberItems(HOCRItem* item, int& order);
+	const HOCRSpatialIndex& spatialIndex(const HOCRPage* page) const;
+	void invalidateSpatialIndex(const HOCRItem* item);
+	void attachItem(HOCRItem* parent, int index, HOCRItem* item);
+	void detachItem(HOCRItem* item);
+	// Journals the edit, unless it is part of an enclosing edit
+	void journal(const HOCRJournal::Record& record);
+	void beginStep();
+	void endStep();
+	// Applies the operation and records it in the current step
+	void apply(Operation* operation);
+	static void clearSteps(std::vector<Step>& steps);
+};
+
+#endif // HOCRDOCUMENT_HH
@@ -0,0 +1,243 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRJournal.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HOCRJournal.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/locking.h>
+#define fsync _commit
+#define ftruncate _chsize
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// The lock is released by the system when the process terminates, whichever way it does
+static bool lockFile(int fd) {
+#ifdef _WIN32
+	lseek(fd, 0, SEEK_SET);
+	return _locking(fd, _LK_NBLCK, 1) == 0;
+#else
+	return flock(fd, LOCK_EX | LOCK_NB) == 0;
+#endif
+}
+
+static void unlockFile(int fd) {
+#ifdef _WIN32
+	lseek(fd, 0, SEEK_SET);
+	_locking(fd, _LK_UNLCK, 1);
+#else
+	flock(fd, LOCK_UN);
+#endif
+}
+
+// Records are stored as "<length> <fields>\n", the fields being separated by tabs. The length
+// of the fields allows to detect a record which was only partially written.
+static std::string encodeRecord(const HOCRJournal::Record& record) {
+	std::string fields;
+	for(std::size_t i = 0, n = record.size(); i < n; ++i) {
+		if(i > 0) {
+			fields += '\t';
+		}
+		for(char c : record[i]) {
+			switch(c) {
+			case '\\': fields += "\\\\"; break;
+			case '\t': fields += "\\t"; break;
+			case '\n': fields += "\\n"; break;
+			default: fields += c;
+			}
+		}
+	}
+	return std::to_string(fields.size()) + " " + fields + "\n";
+}
+
+static HOCRJournal::Record decodeFields(const std::string& fields) {
+	HOCRJournal::Record record(1);
+	for(std::size_t i = 0, n = fields.size(); i < n; ++i) {
+		char c = fields[i];
+		if(c == '\t') {
+			record.push_back(std::string());
+		} else if(c == '\\' && i + 1 < n) {
+			c = fields[++i];
+			record.back() += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+		} else {
+			record.back() += c;
+		}
+	}
+	return record;
+}
+
+HOCRJournal::HOCRJournal(const std::string& filename, const std::function<void()>& failureHandler)
+	: m_filename(filename), m_failureHandler(failureHandler) {
+	m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_BINARY, S_IRUSR | S_IWUSR);
+	if(m_fd == -1) {
+		fail(std::strerror(errno));
+	} else {
+		lockFile(m_fd);
+	}
+	m_thread = std::thread(&HOCRJournal::run, this);
+}
+
+HOCRJournal::~HOCRJournal() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_cond.notify_one();
+	m_thread.join();
+	if(m_fd != -1) {
+		unlockFile(m_fd);
+		close(m_fd);
+	}
+	std::remove(m_filename.c_str());
+}
+
+void HOCRJournal::append(const Record& record) {
+	std::string data = encodeRecord(record);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(!m_error.empty()) {
+			return;
+		}
+		m_pending += data;
+	}
+	m_cond.notify_one();
+}
+
+void HOCRJournal::reset() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.clear();
+		m_reset = true;
+	}
+	m_cond.notify_one();
+}
+
+void HOCRJournal::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(true) {
+		m_cond.wait(lock, [this] { return m_quit || m_reset || !m_pending.empty(); });
+		if(m_pending.empty() && !m_reset) {
+			break;
+		}
+		// Everything which was queued in the meantime is written and synced in one go
+		std::string data;
+		data.swap(m_pending);
+		bool reset = m_reset;
+		m_reset = false;
+		lock.unlock();
+		if(reset && m_fd != -1 && ftruncate(m_fd, 0) != 0) {
+			fail(std::strerror(errno));
+		}
+		if(!data.empty()) {
+			write(data);
+		}
+		lock.lock();
+	}
+}
+
+void HOCRJournal::write(const std::string& data) {
+	if(m_fd == -1) {
+		return;
+	}
+	const char* pos = data.data();
+	std::size_t remaining = data.size();
+	while(remaining > 0) {
+		int written = ::write(m_fd, pos, remaining);
+		if(written < 0 && errno == EINTR) {
+			continue;
+		} else if(written <= 0) {
+			fail(std::strerror(written < 0 ? errno : ENOSPC));
+			return;
+		}
+		pos += written;
+		remaining -= written;
+	}
+	if(fsync(m_fd) != 0) {
+		fail(std::strerror(errno));
+	}
+}
+
+std::string HOCRJournal::error() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_error;
+}
+
+// A journal which is missing records would restore a wrong document, so none is kept
+void HOCRJournal::fail(const std::string& error) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_error = error;
+		m_pending.clear();
+	}
+	if(m_fd != -1) {
+		unlockFile(m_fd);
+		close(m_fd);
+		m_fd = -1;
+	}
+	std::remove(m_filename.c_str());
+	if(m_failureHandler) {
+		m_failureHandler();
+	}
+}
+
+std::vector<HOCRJournal::Record> HOCRJournal::read(const std::string& filename) {
+	std::vector<Record> records;
+	std::ifstream file(filename, std::ios::binary);
+	std::string line;
+	while(std::getline(file, line)) {
+		std::size_t sep = line.find(' ');
+		if(sep == std::string::npos || sep == 0 || file.eof()) {
+			// Malformed, or not terminated by a newline
+			continue;
+		}
+		char* end;
+		unsigned long length = std::strtoul(line.c_str(), &end, 10);
+		if(end != line.c_str() + sep || length != line.size() - sep - 1) {
+			continue;
+		}
+		records.push_back(decodeFields(line.substr(sep + 1)));
+	}
+	return records;
+}
+
+bool HOCRJournal::isOrphan(const std::string& filename) {
+	int fd = open(filename.c_str(), O_RDWR | O_BINARY);
+	if(fd == -1) {
+		return false;
+	}
+	bool orphan = lockFile(fd);
+	if(orphan) {
+		unlockFile(fd);
+	}
+	close(fd);
+	return orphan;
+}
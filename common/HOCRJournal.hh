@@ -0,0 +1,80 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRJournal.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOCRJOURNAL_HH
+#define HOCRJOURNAL_HH
+
+#include <condition_variable>
+#include <mutex>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Write-behind log of the pages added to and the edits made to a HOCRDocument, from which the
+// document can be restored after a crash. Records are written and synced to disk on a
+// background thread, one line per record.
+//
+// Each process has its own journal, which it keeps locked while it runs and removes when it
+// terminates normally. A journal which can be locked was thus left behind by a crashed process.
+class HOCRJournal {
+public:
+	// The record type followed by its arguments
+	typedef std::vector<std::string> Record;
+
+	// Creates and locks the file, which must be specific to the process. If the journal cannot be
+	// written, the file is removed and failureHandler is called once, possibly from the writing
+	// thread.
+	HOCRJournal(const std::string& filename, const std::function<void()>& failureHandler = nullptr);
+	// Removes the file
+	~HOCRJournal();
+	HOCRJournal(const HOCRJournal&) = delete;
+	HOCRJournal& operator=(const HOCRJournal&) = delete;
+
+	const std::string& filename() const { return m_filename; }
+	// Queues the record for writing and returns immediately
+	void append(const Record& record);
+	// Discards all records
+	void reset();
+	// Why the journal could not be written, empty as long as it works
+	std::string error() const;
+
+	// Reads the records of the journal, records which were cut short are skipped
+	static std::vector<Record> read(const std::string& filename);
+	// Whether the journal is not locked by a running process
+	static bool isOrphan(const std::string& filename);
+
+private:
+	std::string m_filename;
+	int m_fd = -1;
+	std::function<void()> m_failureHandler;
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::string m_pending;
+	bool m_reset = false;
+	bool m_quit = false;
+	std::string m_error;
+
+	void run();
+	void write(const std::string& data);
+	void fail(const std::string& error);
+};
+
+#endif // HOCRJOURNAL_HH
@@ -0,0 +1,207 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * ImageDensity.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageDensity.hh"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace ImageDensity {
+
+static bool readBytes(std::istream& stream, uint8_t* data, std::size_t size) {
+	return bool(stream.read(reinterpret_cast<char*>(data), size));
+}
+
+static uint32_t bigEndian(const uint8_t* data, int size) {
+	uint32_t value = 0;
+	for(int i = 0; i < size; ++i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+// TIFF structure, as in TIFF files and in the Exif data of JPEG files
+class TiffReader {
+public:
+	TiffReader(std::istream& stream) : m_stream(stream) {}
+
+	// Walks the chain of image file directories, one per page
+	std::vector<int> read() {
+		std::vector<int> pages;
+		uint8_t header[8];
+		if(!readBytes(m_stream, header, 8)) {
+			return pages;
+		}
+		if(std::memcmp(header, "II*\0", 4) == 0) {
+			m_littleEndian = true;
+		} else if(std::memcmp(header, "MM\0*", 4) == 0) {
+			m_littleEndian = false;
+		} else {
+			return pages;
+		}
+		std::set<uint32_t> visited;
+		uint32_t offset = value(header + 4, 4);
+		// Guard against directory chains which loop
+		while(offset != 0 && visited.insert(offset).second) {
+			int dpi = 0;
+			if(!readDirectory(offset, dpi, offset)) {
+				break;
+			}
+			pages.push_back(dpi);
+		}
+		return pages;
+	}
+
+private:
+	std::istream& m_stream;
+	bool m_littleEndian = true;
+
+	uint32_t value(const uint8_t* data, int size) const {
+		if(!m_littleEndian) {
+			return bigEndian(data, size);
+		}
+		uint32_t value = 0;
+		for(int i = size - 1; i >= 0; --i) {
+			value = (value << 8) | data[i];
+		}
+		return value;
+	}
+
+	bool readDirectory(uint32_t offset, int& dpi, uint32_t& nextOffset) {
+		static constexpr uint16_t tagXResolution = 282;
+		static constexpr uint16_t tagResolutionUnit = 296;
+		static constexpr uint16_t typeRational = 5;
+		uint8_t count[2];
+		if(!m_stream.seekg(offset) || !readBytes(m_stream, count, 2)) {
+			return false;
+		}
+		std::vector<uint8_t> entries(value(count, 2) * 12);
+		uint8_t next[4];
+		if(!readBytes(m_stream, entries.data(), entries.size()) || !readBytes(m_stream, next, 4)) {
+			return false;
+		}
+		nextOffset = value(next, 4);
+		double resolution = 0.;
+		// Inches unless specified otherwise
+		int unit = 2;
+		for(std::size_t pos = 0; pos < entries.size(); pos += 12) {
+			const uint8_t* entry = &entries[pos];
+			uint16_t tag = value(entry, 2);
+			if(tag == tagXResolution && value(entry + 2, 2) == typeRational) {
+				uint8_t rational[8];
+				if(!m_stream.seekg(value(entry + 8, 4)) || !readBytes(m_stream, rational, 8)) {
+					return false;
+				}
+				uint32_t denominator = value(rational + 4, 4);
+				resolution = denominator != 0 ? double(value(rational, 4)) / denominator : 0.;
+			} else if(tag == tagResolutionUnit) {
+				unit = value(entry + 8, 2);
+			}
+		}
+		if(unit == 2) {
+			dpi = std::round(resolution);
+		} else if(unit == 3) {
+			dpi = std::round(resolution * 2.54);
+		} else {
+			dpi = 0;
+		}
+		return true;
+	}
+};
+
+static int readPng(std::istream& stream) {
+	uint8_t chunk[8];
+	// Up to the first image data, which the density has to precede
+	while(readBytes(stream, chunk, 8) && std::memcmp(chunk + 4, "IDAT", 4) != 0) {
+		uint32_t size = bigEndian(chunk, 4);
+		if(std::memcmp(chunk + 4, "pHYs", 4) == 0 && size == 9) {
+			uint8_t phys[9];
+			if(!readBytes(stream, phys, 9)) {
+				return 0;
+			}
+			// Unit 1 is the meter, 0 only specifies the aspect ratio
+			return phys[8] == 1 ? std::round(bigEndian(phys, 4) * 0.0254) : 0;
+		}
+		// Data and CRC
+		if(!stream.seekg(size + 4, std::ios::cur)) {
+			break;
+		}
+	}
+	return 0;
+}
+
+static int readJpeg(std::istream& stream) {
+	int exifDpi = 0;
+	uint8_t marker[4];
+	while(readBytes(stream, marker, 4) && marker[0] == 0xFF) {
+		// Start of scan, or end of image: the header is over
+		if(marker[1] == 0xDA || marker[1] == 0xD9) {
+			break;
+		}
+		uint32_t size = bigEndian(marker + 2, 2);
+		if(size < 2) {
+			break;
+		}
+		std::vector<uint8_t> data(size - 2);
+		if(marker[1] == 0xE0 || marker[1] == 0xE1) {
+			if(!readBytes(stream, data.data(), data.size())) {
+				break;
+			}
+			if(marker[1] == 0xE0 && data.size() >= 12 && std::memcmp(data.data(), "JFIF\0", 5) == 0) {
+				// Unit 1 is the inch, 2 the centimeter, 0 only specifies the aspect ratio
+				uint8_t unit = data[7];
+				uint32_t density = bigEndian(&data[8], 2);
+				if(unit == 1) {
+					return density;
+				} else if(unit == 2) {
+					return std::round(density * 2.54);
+				}
+			} else if(marker[1] == 0xE1 && data.size() > 6 && std::memcmp(data.data(), "Exif\0\0", 6) == 0) {
+				std::istringstream exif(std::string(data.begin() + 6, data.end()));
+				std::vector<int> pages = TiffReader(exif).read();
+				exifDpi = pages.empty() ? 0 : pages.front();
+			}
+		} else if(!stream.seekg(data.size(), std::ios::cur)) {
+			break;
+		}
+	}
+	return exifDpi;
+}
+
+std::vector<int> read(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	uint8_t magic[8];
+	if(!readBytes(file, magic, 8)) {
+		return std::vector<int>();
+	}
+	if(std::memcmp(magic, "\x89PNG\r\n\x1A\n", 8) == 0) {
+		return std::vector<int>(1, readPng(file));
+	} else if(magic[0] == 0xFF && magic[1] == 0xD8) {
+		file.seekg(2);
+		return std::vector<int>(1, readJpeg(file));
+	}
+	file.seekg(0);
+	return TiffReader(file).read();
+}
+
+}
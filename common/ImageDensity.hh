@@ -0,0 +1,35 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * ImageDensity.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGEDENSITY_HH
+#define IMAGEDENSITY_HH
+
+#include <string>
+#include <vector>
+
+namespace ImageDensity {
+
+// Reads the horizontal density (in DPI) of each page of a TIFF, PNG or JPEG file from its
+// headers, without decoding any pixels. Pages without an absolute density get 0, files of other
+// formats yield no pages.
+std::vector<int> read(const std::string& filename);
+
+}
+
+#endif // IMAGEDENSITY_HH
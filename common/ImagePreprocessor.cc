@@ -0,0 +1,412 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * ImagePreprocessor.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImagePreprocessor.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ImagePreprocessor {
+
+static constexpr int BandHeight = 64;
+
+static void toGray(const uint8_t* rgb32, int width, int height, int stride, uint8_t* gray) {
+	#pragma omp parallel for
+	for(int y = 0; y < height; ++y) {
+		const uint32_t* in = reinterpret_cast<const uint32_t*>(rgb32 + y * stride);
+		uint8_t* out = gray + y * width;
+		#pragma omp simd
+		for(int x = 0; x < width; ++x) {
+			uint32_t p = in[x];
+			// ITU-R BT.601 luma in 8 bit fixed point
+			out[x] = (77 * ((p >> 16) & 0xFF) + 150 * ((p >> 8) & 0xFF) + 29 * (p & 0xFF)) >> 8;
+		}
+	}
+}
+
+uint8_t otsuThreshold(const uint8_t* gray, int width, int height, int stride) {
+	uint64_t hist[256] = {};
+	#pragma omp parallel for reduction(+:hist[:256])
+	for(int y = 0; y < height; ++y) {
+		const uint8_t* row = gray + y * stride;
+		for(int x = 0; x < width; ++x) {
+			++hist[row[x]];
+		}
+	}
+	double total = double(width) * height;
+	double sumAll = 0;
+	for(int i = 0; i < 256; ++i) {
+		sumAll += i * double(hist[i]);
+	}
+	double sumBack = 0, weightBack = 0, bestVar = -1;
+	int best = 127;
+	for(int t = 0; t < 256; ++t) {
+		weightBack += hist[t];
+		if(weightBack == 0) {
+			continue;
+		}
+		double weightFore = total - weightBack;
+		if(weightFore == 0) {
+			break;
+		}
+		sumBack += t * double(hist[t]);
+		double meanBack = sumBack / weightBack;
+		double meanFore = (sumAll - sumBack) / weightFore;
+		double var = weightBack * weightFore * (meanBack - meanFore) * (meanBack - meanFore);
+		if(var > bestVar) {
+			bestVar = var;
+			best = t;
+		}
+	}
+	return best;
+}
+
+// mask: 1 = black
+static void thresholdOtsu(const uint8_t* gray, int width, int height, uint8_t* mask) {
+	uint8_t t = otsuThreshold(gray, width, height, width);
+	#pragma omp parallel for
+	for(int y = 0; y < height; ++y) {
+		const uint8_t* in = gray + y * width;
+		uint8_t* out = mask + y * width;
+		#pragma omp simd
+		for(int x = 0; x < width; ++x) {
+			out[x] = in[x] <= t;
+		}
+	}
+}
+
+static void thresholdSauvola(const uint8_t* gray, int width, int height, int window, double k, uint8_t* mask) {
+	int r = std::max(1, window / 2);
+	int nBands = (height + BandHeight - 1) / BandHeight;
+	// Each band keeps running column sums over the vertical window, and slides horizontally over them
+	#pragma omp parallel for
+	for(int band = 0; band < nBands; ++band) {
+		int yStart = band * BandHeight;
+		int yEnd = std::min(height, yStart + BandHeight);
+		std::vector<uint32_t> colSum(width, 0);
+		std::vector<uint32_t> colSq(width, 0);
+		int top = std::max(0, yStart - r);
+		int bottom = std::min(height - 1, yStart + r);
+		for(int y = top; y <= bottom; ++y) {
+			const uint8_t* row = gray + y * width;
+			for(int x = 0; x < width; ++x) {
+				colSum[x] += row[x];
+				colSq[x] += row[x] * row[x];
+			}
+		}
+		for(int y = yStart; y < yEnd; ++y) {
+			if(y > yStart) {
+				if(y + r < height) {
+					const uint8_t* row = gray + (y + r) * width;
+					for(int x = 0; x < width; ++x) {
+						colSum[x] += row[x];
+						colSq[x] += row[x] * row[x];
+					}
+					++bottom;
+				}
+				if(y - r - 1 >= 0) {
+					const uint8_t* row = gray + (y - r - 1) * width;
+					for(int x = 0; x < width; ++x) {
+						colSum[x] -= row[x];
+						colSq[x] -= row[x] * row[x];
+					}
+					++top;
+				}
+			}
+			int rows = bottom - top + 1;
+			uint64_t sum = 0, sq = 0;
+			int left = 0, right = std::min(width - 1, r);
+			for(int x = 0; x <= right; ++x) {
+				sum += colSum[x];
+				sq += colSq[x];
+			}
+			const uint8_t* in = gray + y * width;
+			uint8_t* out = mask + y * width;
+			for(int x = 0; x < width; ++x) {
+				if(x > 0) {
+					if(x + r < width) {
+						sum += colSum[x + r];
+						sq += colSq[x + r];
+						++right;
+					}
+					if(x - r - 1 >= 0) {
+						sum -= colSum[x - r - 1];
+						sq -= colSq[x - r - 1];
+						++left;
+					}
+				}
+				double n = double(rows) * (right - left + 1);
+				double mean = sum / n;
+				double var = std::max(0., sq / n - mean * mean);
+				double t = mean * (1. + k * (std::sqrt(var) / 128. - 1.));
+				out[x] = in[x] <= t;
+			}
+		}
+	}
+}
+
+// Clears black pixels without any black 8-neighbour
+static void despeckle(uint8_t* mask, int width, int height, uint8_t* gray) {
+	std::vector<uint8_t> src(mask, mask + width * height);
+	#pragma omp parallel for
+	for(int y = 0; y < height; ++y) {
+		for(int x = 0; x < width; ++x) {
+			if(!src[y * width + x]) {
+				continue;
+			}
+			bool neighbour = false;
+			for(int ny = std::max(0, y - 1), nyEnd = std::min(height - 1, y + 1); ny <= nyEnd && !neighbour; ++ny) {
+				for(int nx = std::max(0, x - 1), nxEnd = std::min(width - 1, x + 1); nx <= nxEnd; ++nx) {
+					if((nx != x || ny != y) && src[ny * width + nx]) {
+						neighbour = true;
+						break;
+					}
+				}
+			}
+			if(!neighbour) {
+				mask[y * width + x] = 0;
+				if(gray) {
+					gray[y * width + x] = 255;
+				}
+			}
+		}
+	}
+}
+
+// Clears the black regions connected to the image edges, i.e. scanner shadows and page borders
+static void removeBorder(uint8_t* mask, int width, int height, uint8_t* gray) {
+	std::vector<int> stack;
+	auto seed = [&](int x, int y) {
+		int idx = y * width + x;
+		if(mask[idx]) {
+			mask[idx] = 0;
+			stack.push_back(idx);
+		}
+	};
+	for(int x = 0; x < width; ++x) {
+		seed(x, 0);
+		seed(x, height - 1);
+	}
+	for(int y = 0; y < height; ++y) {
+		seed(0, y);
+		seed(width - 1, y);
+	}
+	while(!stack.empty()) {
+		int idx = stack.back();
+		stack.pop_back();
+		if(gray) {
+			gray[idx] = 255;
+		}
+		int x = idx % width;
+		int y = idx / width;
+		if(x > 0) seed(x - 1, y);
+		if(x < width - 1) seed(x + 1, y);
+		if(y > 0) seed(x, y - 1);
+		if(y < height - 1) seed(x, y + 1);
+	}
+}
+
+static void pack(const uint8_t* mask, int width, int height, uint8_t* out, int bytesPerLine) {
+	#pragma omp parallel for
+	for(int y = 0; y < height; ++y) {
+		const uint8_t* in = mask + y * width;
+		uint8_t* row = out + y * bytesPerLine;
+		int x = 0;
+		for(int byte = 0; byte < width / 8; ++byte, x += 8) {
+			uint8_t value = 0;
+			for(int bit = 0; bit < 8; ++bit) {
+				value |= (!in[x + bit]) << (7 - bit);
+			}
+			row[byte] = value;
+		}
+		if(x < width) {
+			uint8_t value = 0;
+			for(int bit = 0; x + bit < width; ++bit) {
+				value |= (!in[x + bit]) << (7 - bit);
+			}
+			row[width / 8] = value;
+		}
+	}
+}
+
+// Downsamples to roughly 1000 pixels along the longer side, averaging the luma of the
+// center row of each block
+static std::vector<uint8_t> downsample(const uint8_t* rgb32, int width, int height, int stride, int& factor, int& w, int& h) {
+	factor = std::max(1, (std::max(width, height) + 999) / 1000);
+	w = width / factor;
+	h = height / factor;
+	if(w < 16 || h < 16) {
+		return std::vector<uint8_t>();
+	}
+	std::vector<uint8_t> gray(w * h);
+	#pragma omp parallel for
+	for(int y = 0; y < h; ++y) {
+		const uint32_t* in = reinterpret_cast<const uint32_t*>(rgb32 + (y * factor + factor / 2) * stride);
+		uint8_t* out = gray.data() + y * w;
+		for(int x = 0; x < w; ++x) {
+			int sum = 0;
+			for(int i = 0; i < factor; ++i) {
+				uint32_t p = in[x * factor + i];
+				sum += (77 * ((p >> 16) & 0xFF) + 150 * ((p >> 8) & 0xFF) + 29 * (p & 0xFF)) >> 8;
+			}
+			out[x] = sum / factor;
+		}
+	}
+	return gray;
+}
+
+double estimateSkew(const uint8_t* rgb32, int width, int height, int stride, double maxAngle) {
+	int factor, w, h;
+	std::vector<uint8_t> gray = downsample(rgb32, width, height, stride, factor, w, h);
+	if(gray.empty()) {
+		return 0.;
+	}
+	std::vector<uint8_t> mask(w * h);
+	thresholdOtsu(gray.data(), w, h, mask.data());
+	// Borders and the fill areas of an already rotated page would dominate the profiles
+	removeBorder(mask.data(), w, h, nullptr);
+
+	// Only use the lower edges of the foreground, which mostly lie on the text baselines
+	std::vector<float> xs, ys;
+	for(int y = 0; y < h - 1; ++y) {
+		for(int x = 0; x < w; ++x) {
+			if(mask[y * w + x] && !mask[(y + 1) * w + x]) {
+				xs.push_back(x - 0.5f * w);
+				ys.push_back(y - 0.5f * h);
+			}
+		}
+	}
+	if(xs.size() < 100 || xs.size() > mask.size() / 4) {
+		return 0.;
+	}
+
+	// The projection of these pixels onto the vertical axis of the page rotated by the
+	// skew angle is sharpest (highest sum of squares) when the text lines are aligned with it
+	int nPoints = xs.size();
+	int halfBins = int(std::ceil(0.5 * std::sqrt(double(w) * w + double(h) * h))) + 1;
+	auto score = [&](double angle) {
+		float s = std::sin(angle / 180. * M_PI);
+		float c = std::cos(angle / 180. * M_PI);
+		std::vector<int> bins(2 * halfBins + 1, 0);
+		for(int i = 0; i < nPoints; ++i) {
+			++bins[int(halfBins + 0.5f + ys[i] * c - xs[i] * s)];
+		}
+		double sum = 0.;
+		for(int count : bins) {
+			sum += double(count) * count;
+		}
+		return sum;
+	};
+	double best = 0.;
+	double range = maxAngle;
+	for(double step : {1., 0.1, 0.02}) {
+		int nSteps = int(std::lround(range / step));
+		std::vector<double> scores(2 * nSteps + 1);
+		#pragma omp parallel for
+		for(int i = 0; i <= 2 * nSteps; ++i) {
+			scores[i] = score(best + (i - nSteps) * step);
+		}
+		best += (std::max_element(scores.begin(), scores.end()) - scores.begin() - nSteps) * step;
+		range = step;
+	}
+	return -best;
+}
+
+bool contentBounds(const uint8_t* rgb32, int width, int height, int stride, int& x, int& y, int& w, int& h) {
+	int factor, sw, sh;
+	std::vector<uint8_t> gray = downsample(rgb32, width, height, stride, factor, sw, sh);
+	if(gray.empty()) {
+		return false;
+	}
+	std::vector<uint8_t> mask(sw * sh);
+	thresholdOtsu(gray.data(), sw, sh, mask.data());
+	// An (almost) blank page yields a meaningless threshold
+	uint8_t t = otsuThreshold(gray.data(), sw, sh, sw);
+	if(*std::max_element(gray.begin(), gray.end()) - t < 32) {
+		return false;
+	}
+	removeBorder(mask.data(), sw, sh, nullptr);
+	despeckle(mask.data(), sw, sh, nullptr);
+
+	int x1 = sw, y1 = sh, x2 = -1, y2 = -1;
+	for(int iy = 0; iy < sh; ++iy) {
+		const uint8_t* row = mask.data() + iy * sw;
+		for(int ix = 0; ix < sw; ++ix) {
+			if(row[ix]) {
+				x1 = std::min(x1, ix);
+				x2 = std::max(x2, ix);
+				y1 = std::min(y1, iy);
+				y2 = iy;
+			}
+		}
+	}
+	if(x2 < 0) {
+		return false;
+	}
+	// Map back to full resolution, keeping a small margin around the content
+	int margin = std::max(width, height) / 100 + factor;
+	x = std::max(0, x1 * factor - margin);
+	y = std::max(0, y1 * factor - margin);
+	w = std::min(width, (x2 + 1) * factor + margin) - x;
+	h = std::min(height, (y2 + 1) * factor + margin) - y;
+	return double(w) * h < 0.9 * double(width) * height;
+}
+
+Image process(const uint8_t* rgb32, int width, int height, int stride, const Options& options) {
+	Image image;
+	image.width = width;
+	image.height = height;
+	if(width <= 0 || height <= 0) {
+		return image;
+	}
+	std::vector<uint8_t> gray(width * height);
+	toGray(rgb32, width, height, stride, gray.data());
+	if(!options.isActive()) {
+		image.bytesPerLine = width;
+		image.data = std::move(gray);
+		return image;
+	}
+
+	std::vector<uint8_t> mask(width * height);
+	if(options.binarization == Binarization::Sauvola) {
+		thresholdSauvola(gray.data(), width, height, options.sauvolaWindow, options.sauvolaK, mask.data());
+	} else {
+		thresholdOtsu(gray.data(), width, height, mask.data());
+	}
+	bool binary = options.binarization != Binarization::None;
+	uint8_t* grayOut = binary ? nullptr : gray.data();
+	if(options.removeBorder) {
+		removeBorder(mask.data(), width, height, grayOut);
+	}
+	if(options.despeckle) {
+		despeckle(mask.data(), width, height, grayOut);
+	}
+	if(binary) {
+		image.bytesPerPixel = 0;
+		image.bytesPerLine = (width + 7) / 8;
+		image.data.resize(image.bytesPerLine * height);
+		pack(mask.data(), width, height, image.data.data(), image.bytesPerLine);
+	} else {
+		image.bytesPerLine = width;
+		image.data = std::move(gray);
+	}
+	return image;
+}
+
+} // ImagePreprocessor
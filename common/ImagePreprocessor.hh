@@ -0,0 +1,71 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * ImagePreprocessor.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGEPREPROCESSOR_HH
+#define IMAGEPREPROCESSOR_HH
+
+#include <cstdint>
+#include <vector>
+
+namespace ImagePreprocessor {
+
+enum class Binarization { None, Otsu, Sauvola };
+
+struct Options {
+	Binarization binarization = Binarization::None;
+	bool despeckle = false;
+	bool removeBorder = false;
+	bool cropToContent = false;
+	int sauvolaWindow = 31;
+	double sauvolaK = 0.34;
+
+	bool isActive() const {
+		return binarization != Binarization::None || despeckle || removeBorder;
+	}
+};
+
+struct Image {
+	std::vector<uint8_t> data;
+	int width = 0;
+	int height = 0;
+	int bytesPerLine = 0;
+	// 1 for 8 bit grayscale, 0 for 1 bit (MSB first, 1 = white), as expected by TessBaseAPI::SetImage
+	int bytesPerPixel = 1;
+};
+
+// Converts a 32 bit RGB image to grayscale, and binarizes and cleans it as specified by options.
+// Despeckling and border removal operate on a binarized mask, if no binarization is requested
+// the affected pixels are whitened in the grayscale output.
+Image process(const uint8_t* rgb32, int width, int height, int stride, const Options& options);
+
+// Returns the global Otsu threshold of a grayscale image
+uint8_t otsuThreshold(const uint8_t* gray, int width, int height, int stride);
+
+// Estimates the skew of the text in a 32 bit RGB image from the horizontal projection profiles
+// of a downsampled, binarized copy. Returns the clockwise rotation (in degrees) which straightens
+// the text, within [-maxAngle, maxAngle].
+double estimateSkew(const uint8_t* rgb32, int width, int height, int stride, double maxAngle = 15.);
+
+// Determines the bounding box of the content of a 32 bit RGB image, ignoring white margins,
+// dark borders and specks. Returns false if the content covers (nearly) the entire image.
+bool contentBounds(const uint8_t* rgb32, int width, int height, int stride, int& x, int& y, int& w, int& h);
+
+}
+
+#endif // IMAGEPREPROCESSOR_HH
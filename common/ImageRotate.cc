@@ -0,0 +1,256 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * ImageRotate.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageRotate.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ImageRotate {
+
+static constexpr int TileSize = 32;
+
+static inline void fillRow(uint32_t* row, int count, uint32_t fill) {
+	std::fill(row, row + count, fill);
+}
+
+#if defined(__SSE2__)
+// Transposes the 4x4 block whose rows start at in[0..3] into the rows out[0..3]
+static inline void transpose4x4(const uint32_t* const in[4], uint32_t* const out[4]) {
+	__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[0]));
+	__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[1]));
+	__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[2]));
+	__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[3]));
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[0]), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[1]), _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[2]), _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out[3]), _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+// Copies the w x h block at (x0, y0) of the rotated image, where pixel (X, Y) of the rotated
+// image is origin[X * dX + Y * dY] and |dY| == 1, i.e. source columns become destination rows.
+static void transposeBlock(const uint32_t* origin, ptrdiff_t dX, ptrdiff_t dY, int x0, int y0, int w, int h, uint32_t* dst, ptrdiff_t dstStride) {
+	int y = 0;
+#if defined(__SSE2__)
+	for(; y + 4 <= h; y += 4) {
+		uint32_t* out[4];
+		for(int j = 0; j < 4; ++j) {
+			// Rows of the source block run towards increasing Y when dY == 1, and towards decreasing Y otherwise
+			out[j] = dst + (dY == 1 ? y + j : y + 3 - j) * dstStride;
+		}
+		ptrdiff_t rowStart = dY == 1 ? y0 + y : y0 + y + 3;
+		int x = 0;
+		for(; x + 4 <= w; x += 4) {
+			const uint32_t* in[4];
+			for(int i = 0; i < 4; ++i) {
+				in[i] = origin + (x0 + x + i) * dX + rowStart * dY;
+			}
+			uint32_t* outx[4] = {out[0] + x, out[1] + x, out[2] + x, out[3] + x};
+			transpose4x4(in, outx);
+		}
+		for(; x < w; ++x) {
+			for(int j = 0; j < 4; ++j) {
+				dst[(y + j) * dstStride + x] = origin[(x0 + x) * dX + (y0 + y + j) * dY];
+			}
+		}
+	}
+#endif
+	for(; y < h; ++y) {
+		const uint32_t* in = origin + x0 * dX + (y0 + y) * dY;
+		uint32_t* out = dst + y * dstStride;
+		for(int x = 0; x < w; ++x) {
+			out[x] = in[x * dX];
+		}
+	}
+}
+
+static void rotateRightAngle(const uint32_t* src, int srcWidth, int srcHeight, ptrdiff_t srcStride,
+                             uint32_t* dst, int dstWidth, int dstHeight, ptrdiff_t dstStride,
+                             int quarterTurns, int offsetX, int offsetY, uint32_t fill) {
+	int rotWidth = quarterTurns % 2 == 0 ? srcWidth : srcHeight;
+	int rotHeight = quarterTurns % 2 == 0 ? srcHeight : srcWidth;
+
+	// Pixel (X, Y) of the rotated image is origin[X * dX + Y * dY]
+	const uint32_t* origin;
+	ptrdiff_t dX, dY;
+	switch(quarterTurns) {
+	case 0:
+		origin = src;
+		dX = 1;
+		dY = srcStride;
+		break;
+	case 1:
+		origin = src + (srcHeight - 1) * srcStride;
+		dX = -srcStride;
+		dY = 1;
+		break;
+	case 2:
+		origin = src + (srcHeight - 1) * srcStride + srcWidth - 1;
+		dX = -1;
+		dY = -srcStride;
+		break;
+	default:
+		origin = src + srcWidth - 1;
+		dX = srcStride;
+		dY = -1;
+		break;
+	}
+
+	// Destination area covered by the rotated image
+	int x0 = std::max(0, -offsetX);
+	int x1 = std::min(dstWidth, rotWidth - offsetX);
+	int y0 = std::max(0, -offsetY);
+	int y1 = std::min(dstHeight, rotHeight - offsetY);
+	if(x0 >= x1 || y0 >= y1) {
+		for(int y = 0; y < dstHeight; ++y) {
+			fillRow(dst + y * dstStride, dstWidth, fill);
+		}
+		return;
+	}
+	for(int y = 0; y < dstHeight; ++y) {
+		uint32_t* row = dst + y * dstStride;
+		if(y < y0 || y >= y1) {
+			fillRow(row, dstWidth, fill);
+		} else {
+			fillRow(row, x0, fill);
+			fillRow(row + x1, dstWidth - x1, fill);
+		}
+	}
+
+	int w = x1 - x0;
+	int h = y1 - y0;
+	if(dX == 1 || dX == -1) {
+		// Source rows map to destination rows
+		#pragma omp parallel for
+		for(int y = 0; y < h; ++y) {
+			const uint32_t* in = origin + (offsetX + x0) * dX + (offsetY + y0 + y) * dY;
+			uint32_t* out = dst + (y0 + y) * dstStride + x0;
+			if(dX == 1) {
+				std::memcpy(out, in, w * sizeof(uint32_t));
+			} else {
+				std::reverse_copy(in - w + 1, in + 1, out);
+			}
+		}
+	} else {
+		// Source columns map to destination rows: process in tiles to keep both sides in cache
+		int nTileRows = (h + TileSize - 1) / TileSize;
+		#pragma omp parallel for
+		for(int tileRow = 0; tileRow < nTileRows; ++tileRow) {
+			int ty = tileRow * TileSize;
+			int th = std::min(TileSize, h - ty);
+			for(int tx = 0; tx < w; tx += TileSize) {
+				int tw = std::min(TileSize, w - tx);
+				transposeBlock(origin, dX, dY, offsetX + x0 + tx, offsetY + y0 + ty, tw, th, dst + (y0 + ty) * dstStride + x0 + tx, dstStride);
+			}
+		}
+	}
+}
+
+// Interpolates each of the four channels of a and b with weight w / 256 of b
+static inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t w) {
+	uint32_t rb = ((((a & 0x00FF00FF) * (256 - w)) + ((b & 0x00FF00FF) * w)) >> 8) & 0x00FF00FF;
+	uint32_t ag = ((((a >> 8) & 0x00FF00FF) * (256 - w)) + (((b >> 8) & 0x00FF00FF) * w)) & 0xFF00FF00;
+	return rb | ag;
+}
+
+static void rotateBilinear(const uint32_t* src, int srcWidth, int srcHeight, ptrdiff_t srcStride,
+                           uint32_t* dst, int dstWidth, int dstHeight, ptrdiff_t dstStride,
+                           double angle, double x, double y, uint32_t fill) {
+	// Inverse mapping from destination to source coordinates, in 16.16 fixed point
+	double c = std::cos(angle / 180. * M_PI);
+	double s = std::sin(angle / 180. * M_PI);
+	int64_t stepX = std::llround(c * 65536.);
+	int64_t stepY = std::llround(-s * 65536.);
+	#pragma omp parallel for
+	for(int row = 0; row < dstHeight; ++row) {
+		double u = x + 0.5;
+		double v = y + row + 0.5;
+		int64_t sx = std::llround((c * u + s * v + 0.5 * srcWidth - 0.5) * 65536.);
+		int64_t sy = std::llround((-s * u + c * v + 0.5 * srcHeight - 0.5) * 65536.);
+		uint32_t* out = dst + row * dstStride;
+		for(int col = 0; col < dstWidth; ++col, sx += stepX, sy += stepY) {
+			int64_t ix = sx >> 16;
+			int64_t iy = sy >> 16;
+			uint32_t fx = (sx >> 8) & 0xFF;
+			uint32_t fy = (sy >> 8) & 0xFF;
+			uint32_t p00, p01, p10, p11;
+			if(ix >= 0 && iy >= 0 && ix + 1 < srcWidth && iy + 1 < srcHeight) {
+				const uint32_t* p = src + iy * srcStride + ix;
+				p00 = p[0];
+				p01 = p[1];
+				p10 = p[srcStride];
+				p11 = p[srcStride + 1];
+			} else if(ix < -1 || iy < -1 || ix >= srcWidth || iy >= srcHeight) {
+				out[col] = fill;
+				continue;
+			} else {
+				// Along the image border, blend with the fill color
+				bool x0in = ix >= 0, x1in = ix + 1 < srcWidth;
+				bool y0in = iy >= 0, y1in = iy + 1 < srcHeight;
+				p00 = x0in && y0in ? src[iy * srcStride + ix] : fill;
+				p01 = x1in && y0in ? src[iy * srcStride + ix + 1] : fill;
+				p10 = x0in && y1in ? src[(iy + 1) * srcStride + ix] : fill;
+				p11 = x1in && y1in ? src[(iy + 1) * srcStride + ix + 1] : fill;
+			}
+			out[col] = lerp(lerp(p00, p01, fx), lerp(p10, p11, fx), fy);
+		}
+	}
+}
+
+bool isRightAngle(double angle, int& quarterTurns) {
+	double a = std::fmod(angle, 360.);
+	if(a < 0) {
+		a += 360.;
+	}
+	double turns = std::round(a / 90.);
+	if(std::abs(a - turns * 90.) > 1e-6) {
+		return false;
+	}
+	quarterTurns = int(turns) % 4;
+	return true;
+}
+
+void rotate(const uint8_t* src, int srcWidth, int srcHeight, int srcStride,
+            uint8_t* dst, int dstWidth, int dstHeight, int dstStride,
+            double angle, double x, double y, uint32_t fill) {
+	const uint32_t* srcPixels = reinterpret_cast<const uint32_t*>(src);
+	uint32_t* dstPixels = reinterpret_cast<uint32_t*>(dst);
+	int quarterTurns;
+	if(isRightAngle(angle, quarterTurns)) {
+		int rotWidth = quarterTurns % 2 == 0 ? srcWidth : srcHeight;
+		int rotHeight = quarterTurns % 2 == 0 ? srcHeight : srcWidth;
+		int offsetX = int(std::lround(x + 0.5 * rotWidth));
+		int offsetY = int(std::lround(y + 0.5 * rotHeight));
+		rotateRightAngle(srcPixels, srcWidth, srcHeight, srcStride / 4, dstPixels, dstWidth, dstHeight, dstStride / 4, quarterTurns, offsetX, offsetY, fill);
+	} else {
+		rotateBilinear(srcPixels, srcWidth, srcHeight, srcStride / 4, dstPixels, dstWidth, dstHeight, dstStride / 4, angle, x, y, fill);
+	}
+}
+
+} // ImageRotate
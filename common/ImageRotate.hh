@@ -0,0 +1,41 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * ImageRotate.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGEROTATE_HH
+#define IMAGEROTATE_HH
+
+#include <cstdint>
+
+namespace ImageRotate {
+
+// Renders the region of the source image rotated clockwise by angle (in degrees) into dst.
+// (x, y) is the position of the top-left corner of dst relative to the center of the rotated
+// image. Pixels are 32 bit, strides are in bytes. Pixels not covered by the image are set to fill.
+// Multiples of 90 degrees are handled by a lossless transpose/flip, other angles are
+// resampled with bilinear interpolation.
+void rotate(const uint8_t* src, int srcWidth, int srcHeight, int srcStride,
+            uint8_t* dst, int dstWidth, int dstHeight, int dstStride,
+            double angle, double x, double y, uint32_t fill);
+
+// Returns whether angle (in degrees) is a multiple of 90 degrees, and if so the number of clockwise quarter turns
+bool isRightAngle(double angle, int& quarterTurns);
+
+}
+
+#endif // IMAGEROTATE_HH
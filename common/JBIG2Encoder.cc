@@ -0,0 +1,271 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * JBIG2Encoder.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JBIG2Encoder.hh"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Probability estimation state machine of the MQ coder (T.88 Table E.1)
+struct JBIG2Encoder::QeEntry {
+	uint16_t qe;
+	uint8_t nmps;
+	uint8_t nlps;
+	uint8_t switchMps;
+};
+
+const JBIG2Encoder::QeEntry JBIG2Encoder::qeTable[] = {
+	{ 0x5601,  1,  1, 1 }, { 0x3401,  2,  6, 0 }, { 0x1801,  3,  9, 0 }, { 0x0AC1,  4, 12, 0 },
+	{ 0x0521,  5, 29, 0 }, { 0x0221, 38, 33, 0 }, { 0x5601,  7,  6, 1 }, { 0x5401,  8, 14, 0 },
+	{ 0x4801,  9, 14, 0 }, { 0x3801, 10, 14, 0 }, { 0x3001, 11, 17, 0 }, { 0x2401, 12, 18, 0 },
+	{ 0x1C01, 13, 20, 0 }, { 0x1601, 29, 21, 0 }, { 0x5601, 15, 14, 1 }, { 0x5401, 16, 14, 0 },
+	{ 0x5101, 17, 15, 0 }, { 0x4801, 18, 16, 0 }, { 0x3801, 19, 17, 0 }, { 0x3401, 20, 18, 0 },
+	{ 0x3001, 21, 19, 0 }, { 0x2801, 22, 19, 0 }, { 0x2401, 23, 20, 0 }, { 0x2201, 24, 21, 0 },
+	{ 0x1C01, 25, 22, 0 }, { 0x1801, 26, 23, 0 }, { 0x1601, 27, 24, 0 }, { 0x1401, 28, 25, 0 },
+	{ 0x1201, 29, 26, 0 }, { 0x1101, 30, 27, 0 }, { 0x0AC1, 31, 28, 0 }, { 0x09C1, 32, 29, 0 },
+	{ 0x08A1, 33, 30, 0 }, { 0x0521, 34, 31, 0 }, { 0x0441, 35, 32, 0 }, { 0x02A1, 36, 33, 0 },
+	{ 0x0221, 37, 34, 0 }, { 0x0141, 38, 35, 0 }, { 0x0111, 39, 36, 0 }, { 0x0085, 40, 37, 0 },
+	{ 0x0049, 41, 38, 0 }, { 0x0025, 42, 39, 0 }, { 0x0015, 43, 40, 0 }, { 0x0009, 44, 41, 0 },
+	{ 0x0005, 45, 42, 0 }, { 0x0001, 45, 43, 0 }, { 0x5601, 46, 46, 0 }
+};
+
+// Segment types (T.88 7.3)
+static constexpr uint8_t segmentImmediateLosslessGenericRegion = 39;
+static constexpr uint8_t segmentPageInformation = 48;
+
+// Context of the SLTP bit of the typical prediction for template 0 (T.88 6.2.5.7)
+static constexpr uint16_t tpgdContext = 0x9B25;
+
+struct JBIG2Encoder::EncoderState {
+	Sink sink;
+	uint32_t width;
+	uint32_t height;
+	std::size_t bytesPerLine;
+	// The current row and the two rows above, with the pixels past the width cleared and one
+	// byte of padding, so that the context can be read past the right edge
+	std::vector<uint8_t> line0;
+	std::vector<uint8_t> line1;
+	std::vector<uint8_t> line2;
+	bool ltp;
+
+	// Arithmetic coder registers (T.88 E.2)
+	uint32_t a;
+	uint32_t c;
+	int ct;
+	uint8_t b;
+	bool haveByte;
+	std::vector<uint8_t> stateIndex;
+	std::vector<uint8_t> mps;
+	std::vector<uint8_t> coded;
+};
+
+static inline int pixel(const std::vector<uint8_t>& line, uint32_t x) {
+	return (line[x >> 3] >> (7 - (x & 7))) & 1;
+}
+
+static void putUInt32(std::vector<uint8_t>& buf, uint32_t value) {
+	buf.push_back(value >> 24);
+	buf.push_back(value >> 16);
+	buf.push_back(value >> 8);
+	buf.push_back(value);
+}
+
+static void putSegmentHeader(std::vector<uint8_t>& buf, uint32_t number, uint8_t type, uint32_t dataLength) {
+	putUInt32(buf, number);
+	buf.push_back(type); // One byte page association, not deferred
+	buf.push_back(0); // No referred-to segments
+	buf.push_back(1); // Page association
+	putUInt32(buf, dataLength);
+}
+
+JBIG2Encoder::JBIG2Encoder() {
+	m_state = new EncoderState;
+}
+
+JBIG2Encoder::~JBIG2Encoder() {
+	delete m_state;
+}
+
+void JBIG2Encoder::begin(uint32_t width, uint32_t height, const Sink& sink) {
+	m_state->sink = sink;
+	m_state->width = width;
+	m_state->height = height;
+	m_state->bytesPerLine = (width + 7) / 8;
+	m_state->line0.assign(m_state->bytesPerLine + 1, 0);
+	m_state->line1.assign(m_state->bytesPerLine + 1, 0);
+	m_state->line2.assign(m_state->bytesPerLine + 1, 0);
+	m_state->ltp = false;
+
+	m_state->a = 0x8000;
+	m_state->c = 0;
+	m_state->ct = 12;
+	m_state->b = 0;
+	m_state->haveByte = false;
+	m_state->stateIndex.assign(65536, 0);
+	m_state->mps.assign(65536, 0);
+	m_state->coded.clear();
+}
+
+void JBIG2Encoder::encodeRow(const uint8_t* row) {
+	EncoderState* s = m_state;
+	// JBIG2 codes black pixels as set bits
+	for(std::size_t i = 0; i < s->bytesPerLine; ++i) {
+		s->line0[i] = ~row[i];
+	}
+	if(s->width % 8 != 0) {
+		s->line0[s->bytesPerLine - 1] &= 0xFF << (8 - s->width % 8);
+	}
+
+	// Rows identical to the row above are only flagged
+	bool ltp = std::memcmp(s->line0.data(), s->line1.data(), s->bytesPerLine) == 0;
+	encodeBit(tpgdContext, ltp != s->ltp);
+	s->ltp = ltp;
+	if(!ltp) {
+		// The context is composed of the template 0 pixels, with the adaptive pixels at their
+		// nominal positions (T.88 6.2.5.3), tracked as sliding windows over the three rows:
+		//   w2 = (x-2 .. x+2, y-2), w1 = (x-3 .. x+3, y-1), w0 = (x-4 .. x-1, y)
+		uint32_t w2 = (pixel(s->line2, 0) << 1) | pixel(s->line2, 1);
+		uint32_t w1 = (pixel(s->line1, 0) << 2) | (pixel(s->line1, 1) << 1) | pixel(s->line1, 2);
+		uint32_t w0 = 0;
+		for(uint32_t x = 0; x < s->width; ++x) {
+			w2 = ((w2 << 1) | pixel(s->line2, x + 2)) & 0x1F;
+			w1 = ((w1 << 1) | pixel(s->line1, x + 3)) & 0x7F;
+			int bit = pixel(s->line0, x);
+			encodeBit((w2 << 11) | (w1 << 4) | w0, bit);
+			w0 = ((w0 << 1) | bit) & 0xF;
+		}
+	}
+	std::swap(s->line2, s->line1);
+	std::swap(s->line1, s->line0);
+}
+
+void JBIG2Encoder::finish() {
+	flushCoder();
+
+	std::vector<uint8_t> buf;
+	putSegmentHeader(buf, 0, segmentPageInformation, 19);
+	putUInt32(buf, m_state->width);
+	putUInt32(buf, m_state->height);
+	putUInt32(buf, 0); // Unknown resolution
+	putUInt32(buf, 0);
+	buf.push_back(0x01); // Eventually lossless, default pixel value 0, OR combination
+	buf.push_back(0); // Not striped
+	buf.push_back(0);
+
+	putSegmentHeader(buf, 1, segmentImmediateLosslessGenericRegion, 17 + 1 + 8 + m_state->coded.size());
+	putUInt32(buf, m_state->width);
+	putUInt32(buf, m_state->height);
+	putUInt32(buf, 0); // Region position
+	putUInt32(buf, 0);
+	buf.push_back(0); // OR combination
+	buf.push_back(0x08); // Arithmetic coding, template 0, typical prediction
+	static const uint8_t atPixels[] = { 3, 0xFF, 0xFD, 0xFF, 2, 0xFE, 0xFE, 0xFE }; // (3,-1), (-3,-1), (2,-2), (-2,-2)
+	buf.insert(buf.end(), atPixels, atPixels + sizeof(atPixels));
+
+	m_state->sink(buf.data(), buf.size());
+	m_state->sink(m_state->coded.data(), m_state->coded.size());
+	m_state->coded.clear();
+	m_state->coded.shrink_to_fit();
+}
+
+inline void JBIG2Encoder::encodeBit(uint16_t context, int bit) {
+	EncoderState* s = m_state;
+	const QeEntry& entry = qeTable[s->stateIndex[context]];
+	s->a -= entry.qe;
+	if(bit == s->mps[context]) {
+		if((s->a & 0x8000) != 0) {
+			s->c += entry.qe;
+			return;
+		}
+		if(s->a < entry.qe) {
+			s->a = entry.qe;
+		} else {
+			s->c += entry.qe;
+		}
+		s->stateIndex[context] = entry.nmps;
+	} else {
+		if(s->a < entry.qe) {
+			s->c += entry.qe;
+		} else {
+			s->a = entry.qe;
+		}
+		if(entry.switchMps) {
+			s->mps[context] ^= 1;
+		}
+		s->stateIndex[context] = entry.nlps;
+	}
+	renormalize();
+}
+
+inline void JBIG2Encoder::renormalize() {
+	EncoderState* s = m_state;
+	do {
+		s->a <<= 1;
+		s->c <<= 1;
+		if(--s->ct == 0) {
+			byteOut();
+		}
+	} while((s->a & 0x8000) == 0);
+}
+
+// Emits the byte B and takes the next one from C, stuffing a zero bit after 0xFF (T.88 E.2.8)
+inline void JBIG2Encoder::byteOut() {
+	EncoderState* s = m_state;
+	bool stuff = s->b == 0xFF;
+	if(!stuff && s->c >= 0x8000000) {
+		// Carry into B
+		++s->b;
+		if(s->b == 0xFF) {
+			s->c &= 0x7FFFFFF;
+			stuff = true;
+		}
+	}
+	if(s->haveByte) {
+		s->coded.push_back(s->b);
+	}
+	s->haveByte = true;
+	if(stuff) {
+		s->b = s->c >> 20;
+		s->c &= 0xFFFFF;
+		s->ct = 7;
+	} else {
+		s->b = s->c >> 19;
+		s->c &= 0x7FFFF;
+		s->ct = 8;
+	}
+}
+
+// T.88 E.2.9, followed by the 0xFFAC end marker
+void JBIG2Encoder::flushCoder() {
+	EncoderState* s = m_state;
+	uint32_t tempc = s->c + s->a;
+	s->c |= 0xFFFF;
+	if(s->c >= tempc) {
+		s->c -= 0x8000;
+	}
+	s->c <<= s->ct;
+	byteOut();
+	s->c <<= s->ct;
+	byteOut();
+	s->coded.push_back(s->b);
+	if(s->b != 0xFF) {
+		s->coded.push_back(0xFF);
+	}
+	s->coded.push_back(0xAC);
+}
@@ -0,0 +1,58 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * JBIG2Encoder.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JBIG2ENCODER_HH
+#define JBIG2ENCODER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Lossless JBIG2 encoder, coding the image as a single arithmetic coded generic region (ITU T.88,
+// template 0 with typical prediction). The output is the embedded stream format used by the PDF
+// JBIG2Decode filter, that is without file header and without end of page segment.
+class JBIG2Encoder {
+public:
+	typedef std::function<void(const uint8_t* data, std::size_t size)> Sink;
+
+	JBIG2Encoder();
+	~JBIG2Encoder();
+	// Starts a new image, the encoder can be reused once the previous image is finished
+	void begin(uint32_t width, uint32_t height, const Sink& sink);
+	// Rows are packed one bit per pixel, most significant bit first, set bits being white as for
+	// the other bilevel images
+	void encodeRow(const uint8_t* row);
+	// Passes the segments to the sink. Since the segment header holds the length of the coded
+	// data, the latter is only kept in memory until then.
+	void finish();
+
+private:
+	struct EncoderState;
+	struct QeEntry;
+	EncoderState* m_state;
+
+	inline void encodeBit(uint16_t context, int bit);
+	inline void renormalize();
+	inline void byteOut();
+	void flushCoder();
+
+	static const QeEntry qeTable[];
+};
+
+#endif // JBIG2ENCODER_HH
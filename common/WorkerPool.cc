@@ -0,0 +1,65 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * WorkerPool.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WorkerPool.hh"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threadCount) {
+	if(threadCount <= 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for(int i = 0; i < threadCount; ++i) {
+		m_threads.push_back(std::thread(&WorkerPool::run, this));
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_cond.notify_all();
+	for(std::thread& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::enqueue(std::function<void()>&& task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_cond.notify_one();
+}
+
+void WorkerPool::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(true) {
+		m_cond.wait(lock, [this] { return m_quit || !m_tasks.empty(); });
+		if(m_tasks.empty()) {
+			break;
+		}
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * WorkerPool.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_HH
+#define WORKERPOOL_HH
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of threads running the submitted tasks in submission order
+class WorkerPool {
+public:
+	// Zero threads means one thread per core
+	WorkerPool(int threadCount = 0);
+	// Waits for the queued tasks to complete
+	~WorkerPool();
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	int threadCount() const { return m_threads.size(); }
+
+	// Queues the task, its result (or exception) is delivered through the returned future
+	template<class F>
+	std::future<typename std::result_of<F()>::type> submit(F task) {
+		typedef typename std::result_of<F()>::type Result;
+		std::shared_ptr<std::packaged_task<Result()>> packagedTask = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+		std::future<Result> future = packagedTask->get_future();
+		enqueue([packagedTask] { (*packagedTask)(); });
+		return future;
+	}
+
+private:
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_quit = false;
+
+	void enqueue(std::function<void()>&& task);
+	void run();
+};
+
+#endif // WORKERPOOL_HH
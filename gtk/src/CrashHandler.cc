@@ -18,6 +18,7 @@
  */
 
 #include "CrashHandler.hh"
+#include "OutputEditorHOCR.hh"
 #include "Utils.hh"
 
 CrashHandler::CrashHandler(int argc, char* argv[])
@@ -41,7 +42,16 @@ void CrashHandler::on_startup() {
 	m_textview = m_builder("textview:backtrace");
 	m_refreshButton = m_builder("button:backtrace.regenerate");
 	m_dialog->set_title(Glib::ustring::compose("%1 %2", PACKAGE_NAME, _("Crash Handler")));
-	if(!m_saveFile.empty()) {
+	if(!m_saveFile.empty() && m_saveFile == OutputEditorHOCR::journalFilename(m_pid)) {
+		if(!Glib::file_test(m_saveFile, Glib::FILE_TEST_EXISTS)) {
+			// Removed when the journal could not be written
+			m_builder("label:crashhandler.autosave").as<Gtk::Label>()->set_text(_("Your work could not be recorded for recovery and is lost."));
+		} else if(HOCRDocument::hasUnsavedEdits(HOCRJournal::read(m_saveFile))) {
+			m_builder("label:crashhandler.autosave").as<Gtk::Label>()->set_text(Glib::ustring::compose(_("Your work will be recovered the next time %1 is started."), PACKAGE_NAME));
+		} else {
+			m_builder("label:crashhandler.autosave").as<Gtk::Label>()->set_text(_("There was no unsaved work."));
+		}
+	} else if(!m_saveFile.empty()) {
 		m_builder("label:crashhandler.autosave").as<Gtk::Label>()->set_markup(Glib::ustring::compose(_("Your work has been saved under <b>%1</b>."), m_saveFile));
 	} else {
 		m_builder("label:crashhandler.autosave").as<Gtk::Label>()->set_text(_("There was no unsaved work."));
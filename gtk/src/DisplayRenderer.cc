@@ -18,10 +18,13 @@
  */
 
 #include "DisplayRenderer.hh"
+#include "ImageDensity.hh"
+#include "ImageRotate.hh"
 #include "Utils.hh"
 
 #include <poppler-document.h>
 #include <poppler-page.h>
+#include <cmath>
 
 void DisplayRenderer::adjustImage(const Cairo::RefPtr<Cairo::ImageSurface> &surf, int brightness, int contrast, bool invert) const {
 	if(brightness == 0 && contrast == 0 && !invert) {
@@ -59,6 +62,14 @@ void DisplayRenderer::adjustImage(const Cairo::RefPtr<Cairo::ImageSurface> &surf
 	}
 }
 
+ImageRenderer::ImageRenderer(const std::string& filename) : DisplayRenderer(filename) {
+	std::vector<int> dpis = ImageDensity::read(m_filename);
+	// Densities below 100 DPI are mostly defaults written by software, treat them as unknown
+	if(!dpis.empty() && dpis.front() >= 100) {
+		m_nativeDpi = dpis.front();
+	}
+}
+
 Cairo::RefPtr<Cairo::ImageSurface> ImageRenderer::render(int /*page*/, double resolution) const {
 	Glib::RefPtr<Gdk::Pixbuf> pixbuf;
 	try {
@@ -81,7 +92,9 @@ Cairo::RefPtr<Cairo::ImageSurface> ImageRenderer::render(int /*page*/, double re
 		ctx->set_source_rgba(1., 1., 1., 1.);
 		ctx->paint();
 	}
-	ctx->scale(scale, scale);
+	if(scale != 1.) {
+		ctx->scale(scale, scale);
+	}
 	try {
 		Gdk::Cairo::set_source_pixbuf(ctx, pixbuf);
 	} catch(const std::exception&) {
@@ -92,6 +105,21 @@ Cairo::RefPtr<Cairo::ImageSurface> ImageRenderer::render(int /*page*/, double re
 	return surf;
 }
 
+int ImageRenderer::getDpi(int /*page*/, double resolution) const {
+	return Utils::round(m_nativeDpi * resolution / 100.);
+}
+
+int ImageRenderer::getRecommendedResolution(int page) const {
+	static constexpr int minDpi = 250;
+	static constexpr int maxDpi = 600;
+	static constexpr int targetDpi = 300;
+	int dpi = getDpi(page, 100.);
+	if(dpi == 0 || (dpi >= minDpi && dpi <= maxDpi)) {
+		return 100;
+	}
+	return Utils::round(targetDpi * 100. / dpi);
+}
+
 PDFRenderer::PDFRenderer(const std::string& filename) : DisplayRenderer(filename) {
 	m_document = poppler_document_new_from_file(Glib::filename_to_uri(m_filename).c_str(), 0, 0);
 }
@@ -132,3 +160,55 @@ Cairo::RefPtr<Cairo::ImageSurface> PDFRenderer::render(int page, double resoluti
 int PDFRenderer::getNPages() const {
 	return m_document ? poppler_document_get_n_pages(m_document) : 1;
 }
+
+bool PageRasterizer::setPage(const std::string& filename, int page, double resolution, double angle, int brightness, int contrast, bool invert) {
+	if(filename != m_filename || !m_renderer) {
+		delete m_renderer;
+#ifdef G_OS_WIN32
+		if(Glib::ustring(filename.substr(filename.length() - 4)).lowercase() == ".pdf") {
+#else
+		if(Utils::get_content_type(filename) == "application/pdf") {
+#endif
+			m_renderer = new PDFRenderer(filename);
+		} else {
+			m_renderer = new ImageRenderer(filename);
+		}
+		m_filename = filename;
+		m_image.clear();
+	} else if(m_image && page == m_page && resolution == m_resolution &&
+	          brightness == m_brightness && contrast == m_contrast && invert == m_invert) {
+		m_angle = angle;
+		return true;
+	}
+	m_page = page;
+	m_resolution = resolution;
+	m_angle = angle;
+	m_brightness = brightness;
+	m_contrast = contrast;
+	m_invert = invert;
+	m_image = m_renderer->render(page, resolution);
+	if(!m_image) {
+		return false;
+	}
+	// Adjusted once for the whole page, getRegion then only crops
+	m_renderer->adjustImage(m_image, brightness, contrast, invert);
+	return true;
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> PageRasterizer::getRegion(const Geometry::Rectangle& rect) const {
+	// Same geometry as the displayer: the region is given relative to the top-left corner of
+	// the bounding box of the rotated page, which is centered on the origin
+	int w = m_image->get_width();
+	int h = m_image->get_height();
+	Geometry::Rotation R(m_angle / 180. * M_PI);
+	int width = std::abs(R(0, 0) * w) + std::abs(R(0, 1) * h);
+	int height = std::abs(R(1, 0) * w) + std::abs(R(1, 1) * h);
+	Cairo::RefPtr<Cairo::ImageSurface> surf = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, std::ceil(rect.width), std::ceil(rect.height));
+	m_image->flush();
+	surf->flush();
+	ImageRotate::rotate(m_image->get_data(), w, h, m_image->get_stride(),
+	                    surf->get_data(), surf->get_width(), surf->get_height(), surf->get_stride(),
+	                    m_angle, rect.x - 0.5 * width, rect.y - 0.5 * height, 0xFFFFFFFF);
+	surf->mark_dirty();
+	return surf;
+}
@@ -21,6 +21,7 @@
 #define DISPLAYRENDERER_HH
 
 #include "common.hh"
+#include "Geometry.hh"
 
 typedef struct _PopplerDocument PopplerDocument;
 
@@ -30,6 +31,8 @@ public:
 	virtual ~DisplayRenderer() {}
 	virtual Cairo::RefPtr<Cairo::ImageSurface> render(int page, double resolution) const = 0;
 	virtual int getNPages() const = 0;
+	// Effective DPI of a page rendered at the specified resolution, 0 if unknown
+	virtual int getDpi(int page, double resolution) const = 0;
 
 	void adjustImage(const Cairo::RefPtr<Cairo::ImageSurface>& surf, int brightness, int contrast, bool invert) const;
 
@@ -39,11 +42,18 @@ protected:
 
 class ImageRenderer : public DisplayRenderer {
 public:
-	ImageRenderer(const std::string& filename) : DisplayRenderer(filename) {}
+	ImageRenderer(const std::string& filename);
 	Cairo::RefPtr<Cairo::ImageSurface> render(int page, double resolution) const override;
 	int getNPages() const override {
 		return 1;
 	}
+	int getDpi(int page, double resolution) const override;
+	// Resolution (in percent) which brings the page into the DPI range tesseract works best at
+	int getRecommendedResolution(int page) const;
+
+private:
+	// Read from the file headers
+	int m_nativeDpi = 0;
 };
 
 class PDFRenderer : public DisplayRenderer {
@@ -52,10 +62,37 @@ public:
 	~PDFRenderer();
 	Cairo::RefPtr<Cairo::ImageSurface> render(int page, double resolution) const override;
 	int getNPages() const override;
+	int getDpi(int /*page*/, double resolution) const override {
+		return resolution;
+	}
 
 private:
 	PopplerDocument* m_document;
 	mutable Glib::Threads::Mutex m_mutex;
 };
 
+// Renders regions of source pages for the PDF export, independently of the displayer
+class PageRasterizer {
+public:
+	~PageRasterizer() {
+		delete m_renderer;
+	}
+	// Renders the page of the file rotated by angle (in degrees) with the brightness, contrast and
+	// invert settings of its source, the last page is kept so that rendering the same page again is free
+	bool setPage(const std::string& filename, int page, double resolution, double angle, int brightness = 0, int contrast = 0, bool invert = false);
+	// Returns the region of the rotated page, relative to its top-left corner
+	Cairo::RefPtr<Cairo::ImageSurface> getRegion(const Geometry::Rectangle& rect) const;
+
+private:
+	DisplayRenderer* m_renderer = nullptr;
+	std::string m_filename;
+	int m_page = 0;
+	double m_resolution = 0.;
+	double m_angle = 0.;
+	int m_brightness = 0;
+	int m_contrast = 0;
+	bool m_invert = false;
+	Cairo::RefPtr<Cairo::ImageSurface> m_image;
+};
+
 #endif // IMAGERENDERER_HH
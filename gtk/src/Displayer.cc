@@ -21,6 +21,8 @@
 #include "Config.hh"
 #include "Displayer.hh"
 #include "DisplayRenderer.hh"
+#include "ImagePreprocessor.hh"
+#include "ImageRotate.hh"
 #include "Recognizer.hh"
 #include "SourceManager.hh"
 #include "Utils.hh"
@@ -160,7 +162,10 @@ bool Displayer::setCurrentPage(int page) {
 			if(source->resolution == -1) source->resolution = 300;
 		} else {
 			m_renderer = new ImageRenderer(filename);
-			if(source->resolution == -1) source->resolution = 100;
+			if(source->resolution == -1) {
+				source->resolution = 100;
+				source->autoResolution = true;
+			}
 		}
 		Utils::set_spin_blocked(m_brispin, source->brightness, m_connection_briSpinChanged);
 		Utils::set_spin_blocked(m_conspin, source->contrast, m_connection_conSpinChanged);
@@ -170,11 +175,19 @@ bool Displayer::setCurrentPage(int page) {
 		m_connection_invcheckToggled.block(false);
 		m_currentSource = source;
 	}
+	if(source->autoResolution) {
+		// Pages of multipage files can differ in DPI
+		Utils::set_spin_blocked(m_resspin, static_cast<ImageRenderer*>(m_renderer)->getRecommendedResolution(m_pageMap[page].second), m_connection_resSpinChanged);
+	}
 	Utils::set_spin_blocked(m_rotspin, source->angle[m_pageMap[page].second - 1] / M_PI * 180., m_connection_rotSpinChanged);
 	Utils::set_spin_blocked(m_pagespin, page, m_connection_pageSpinChanged);
 	return renderImage();
 }
 
+int Displayer::getCurrentDpi() const {
+	return m_renderer ? m_renderer->getDpi(m_currentSource->page, m_currentSource->resolution) : 0;
+}
+
 bool Displayer::setSources(std::vector<Source*> sources) {
 	if(sources == m_sources) {
 		return true;
@@ -403,6 +416,7 @@ void Displayer::resolutionChanged() {
 	int resolution = m_resspin->get_value_as_int();
 	for(const auto& keyval  : m_pageMap) {
 		keyval.second.first->resolution = resolution;
+		keyval.second.first->autoResolution = false;
 	}
 	queueRenderImage();
 }
@@ -589,6 +603,20 @@ void Displayer::resortItems() {
 	std::sort(m_items.begin(), m_items.end(), DisplayerItem::zIndexCmp);
 }
 
+bool Displayer::deskew() {
+	if(!m_image) {
+		return false;
+	}
+	Cairo::RefPtr<Cairo::ImageSurface> image = getImage(getSceneBoundingRect());
+	double angle = ImagePreprocessor::estimateSkew(image->get_data(), image->get_width(), image->get_height(), image->get_stride());
+	angle = Utils::round(angle * 10.) / 10.;
+	if(std::abs(angle) <= .1) {
+		return false;
+	}
+	setAngle(getCurrentAngle() + angle);
+	return true;
+}
+
 Geometry::Rectangle Displayer::getSceneBoundingRect() const {
 	int w = m_image->get_width();
 	int h = m_image->get_height();
@@ -608,14 +636,12 @@ Geometry::Point Displayer::mapToSceneClamped(const Geometry::Point& p) const {
 
 Cairo::RefPtr<Cairo::ImageSurface> Displayer::getImage(const Geometry::Rectangle &rect) const {
 	Cairo::RefPtr<Cairo::ImageSurface> surf = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, std::ceil(rect.width), std::ceil(rect.height));
-	Cairo::RefPtr<Cairo::Context> ctx = Cairo::Context::create(surf);
-	ctx->set_source_rgba(1., 1., 1., 1.);
-	ctx->paint();
-	ctx->translate(-rect.x, -rect.y);
-	ctx->rotate(m_rotspin->get_value() / 180. * M_PI);
-	ctx->translate(-0.5 * m_image->get_width(), -0.5 * m_image->get_height());
-	ctx->set_source(m_image, 0, 0);
-	ctx->paint();
+	m_image->flush();
+	surf->flush();
+	ImageRotate::rotate(m_image->get_data(), m_image->get_width(), m_image->get_height(), m_image->get_stride(),
+	                    surf->get_data(), surf->get_width(), surf->get_height(), surf->get_stride(),
+	                    m_rotspin->get_value(), rect.x, rect.y, 0xFFFFFFFF);
+	surf->mark_dirty();
 	return surf;
 }
 
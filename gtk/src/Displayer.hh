@@ -58,10 +58,12 @@ public:
 	int getCurrentResolution() {
 		return m_resspin->get_value_as_int();
 	}
+	int getCurrentDpi() const;
 	void setResolution(int resolution);
 	std::string getCurrentImage(int& page) const;
 	Cairo::RefPtr<Cairo::ImageSurface> getImage(const Geometry::Rectangle& rect) const;
 	Geometry::Rectangle getSceneBoundingRect() const;
+	bool deskew();
 	Geometry::Point mapToSceneClamped(const Geometry::Point& p) const;
 	int getNPages() {
 		double min, max;
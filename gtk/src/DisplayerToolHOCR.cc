@@ -44,6 +44,11 @@ bool DisplayerToolHOCR::mousePressEvent(GdkEventButton* event) {
 		m_selection = new DisplayerSelection(this, m_displayer->mapToSceneClamped(Geometry::Point(event->x, event->y)));
 		m_displayer->addItem(m_selection);
 		return true;
+	} else if(event->button == 1) {
+		Geometry::Point p = m_displayer->mapToSceneClamped(Geometry::Point(event->x, event->y));
+		Geometry::Rectangle sceneRect = m_displayer->getSceneBoundingRect();
+		m_signalPositionPicked.emit(Geometry::Point(int(p.x - sceneRect.x), int(p.y - sceneRect.y)));
+		return true;
 	}
 	return false;
 }
@@ -23,6 +23,7 @@
 #include "Displayer.hh"
 
 namespace Geometry {
+class Point;
 class Rectangle;
 }
 
@@ -61,12 +62,17 @@ public:
 	sigc::signal<void, Geometry::Rectangle> signal_selection_geometry_changed() {
 		return m_signalSelectionGeometryChanged;
 	}
+	// A point of the image was clicked while not drawing a selection
+	sigc::signal<void, Geometry::Point> signal_position_picked() {
+		return m_signalPositionPicked;
+	}
 
 private:
 	DisplayerSelection* m_selection = nullptr;
 	bool m_drawingSelection = false;
 	sigc::signal<void, Geometry::Rectangle> m_signalSelectionDrawn;
 	sigc::signal<void, Geometry::Rectangle> m_signalSelectionGeometryChanged;
+	sigc::signal<void, Geometry::Point> m_signalPositionPicked;
 
 	void selectionChanged(const Geometry::Rectangle& rect);
 };
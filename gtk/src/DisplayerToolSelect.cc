@@ -157,16 +157,17 @@ void DisplayerToolSelect::updateRecognitionModeLabel() {
 	MAIN->getRecognizer()->setRecognizeMode(m_selections.empty() ? _("Recognize all") : _("Recognize selection"));
 }
 
-void DisplayerToolSelect::autodetectLayout(bool noDeskew) {
+void DisplayerToolSelect::autodetectLayout() {
 	clearSelections();
 
-	double avgDeskew = 0.;
-	int nDeskew = 0;
+	// Straighten the page first, so that the layout only needs to be analyzed once
+	m_displayer->deskew();
+
 	std::vector<Geometry::Rectangle> rects;
 	Cairo::RefPtr<Cairo::ImageSurface> img = m_displayer->getImage(m_displayer->getSceneBoundingRect());
 
 	// Perform layout analysis
-	Utils::busyTask([this,&nDeskew,&avgDeskew,&rects,&img] {
+	Utils::busyTask([this,&rects,&img] {
 		tesseract::TessBaseAPI tess;
 		tess.InitForAnalysePage();
 		tess.SetPageSegMode(tesseract::PSM_AUTO_ONLY);
@@ -175,14 +176,7 @@ void DisplayerToolSelect::autodetectLayout(bool noDeskew) {
 		if(it && !it->Empty(tesseract::RIL_BLOCK)) {
 			do {
 				int x1, y1, x2, y2;
-				tesseract::Orientation orient;
-				tesseract::WritingDirection wdir;
-				tesseract::TextlineOrder tlo;
-				float deskew;
 				it->BoundingBox(tesseract::RIL_BLOCK, &x1, &y1, &x2, &y2);
-				it->Orientation(&orient, &wdir, &tlo, &deskew);
-				avgDeskew += deskew;
-				++nDeskew;
 				float width = x2 - x1, height = y2 - y1;
 				if(width > 10 && height > 10) {
 					rects.push_back(Geometry::Rectangle(x1 - 0.5 * img->get_width(), y1 - 0.5 * img->get_height(), width, height));
@@ -193,30 +187,22 @@ void DisplayerToolSelect::autodetectLayout(bool noDeskew) {
 		return true;
 	}, _("Performing layout analysis"));
 
-	// If a somewhat large deskew angle is detected, automatically rotate image and redetect layout,
-	// unless we already attempted to rotate (to prevent endless loops)
-	avgDeskew = Utils::round(((avgDeskew/nDeskew)/M_PI * 180.) * 10.) / 10.;
-	if(std::abs(avgDeskew > .1) && !noDeskew) {
-		m_displayer->setAngle(m_displayer->getCurrentAngle() - avgDeskew);
-		autodetectLayout(true);
-	} else {
-		// Merge overlapping rectangles
-		for(int i = rects.size(); i-- > 1;) {
-			for(int j = i; j-- > 0;) {
-				if(rects[j].overlaps(rects[i])) {
-					rects[j] = rects[j].unite(rects[i]);
-					rects.erase(rects.begin() + i);
-					break;
-				}
+	// Merge overlapping rectangles
+	for(int i = rects.size(); i-- > 1;) {
+		for(int j = i; j-- > 0;) {
+			if(rects[j].overlaps(rects[i])) {
+				rects[j] = rects[j].unite(rects[i]);
+				rects.erase(rects.begin() + i);
+				break;
 			}
 		}
-		for(int i = 0, n = rects.size(); i < n; ++i) {
-			m_selections.push_back(new NumberedDisplayerSelection(this, 1 + i, Geometry::Point(rects[i].x, rects[i].y)));
-			m_selections.back()->setPoint(Geometry::Point(rects[i].x + rects[i].width, rects[i].y + rects[i].height));
-			m_displayer->addItem(m_selections.back());
-		}
-		updateRecognitionModeLabel();
 	}
+	for(int i = 0, n = rects.size(); i < n; ++i) {
+		m_selections.push_back(new NumberedDisplayerSelection(this, 1 + i, Geometry::Point(rects[i].x, rects[i].y)));
+		m_selections.back()->setPoint(Geometry::Point(rects[i].x + rects[i].width, rects[i].y + rects[i].height));
+		m_displayer->addItem(m_selections.back());
+	}
+	updateRecognitionModeLabel();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
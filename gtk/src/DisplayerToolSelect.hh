@@ -59,7 +59,7 @@ private:
 	void reorderSelection(int oldNum, int newNum);
 	void saveSelection(NumberedDisplayerSelection* selection);
 	void updateRecognitionModeLabel();
-	void autodetectLayout(bool noDeskew = false);
+	void autodetectLayout();
 };
 
 class NumberedDisplayerSelection : public DisplayerSelection {
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRSpellChecker.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtkspellmm.h>
+
+#include "HOCRSpellChecker.hh"
+
+
+HOCRSpellChecker::HOCRSpellChecker() {
+	m_dispatcherWordsChecked.connect([this] { m_signal_words_checked.emit(); });
+	m_thread = Glib::Threads::Thread::create([this] { run(); });
+}
+
+HOCRSpellChecker::~HOCRSpellChecker() {
+	m_requestQueue.enqueue({Request::Type::Quit, Key()});
+	m_thread->join();
+}
+
+HOCRSpellChecker::Verdict HOCRSpellChecker::check(const Glib::ustring& lang, const Glib::ustring& word) {
+	Key key(lang, word);
+	Glib::Threads::Mutex::Lock locker(m_cacheMutex);
+	auto it = m_cache.find(key);
+	if(it != m_cache.end()) {
+		return it->second;
+	}
+	m_cache.insert(std::make_pair(key, Verdict::Pending));
+	m_requestQueue.enqueue({Request::Type::Check, key});
+	return Verdict::Pending;
+}
+
+void HOCRSpellChecker::setCorrect(const Glib::ustring& lang, const Glib::ustring& word) {
+	Glib::Threads::Mutex::Lock locker(m_cacheMutex);
+	m_cache[Key(lang, word)] = Verdict::Correct;
+}
+
+void HOCRSpellChecker::run() {
+	// One checker per language, so that mixed-language pages don't keep reloading dictionaries
+	std::map<Glib::ustring, GtkSpell::Checker*> checkers;
+	while(true) {
+		Request request = m_requestQueue.dequeue();
+		if(request.type == Request::Type::Quit) {
+			break;
+		}
+		Verdict verdict;
+		{
+			Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+			GtkSpell::Checker*& checker = checkers[request.key.first];
+			if(!checker) {
+				checker = new GtkSpell::Checker;
+				try {
+					checker->set_language(request.key.first);
+				} catch(const GtkSpell::Error& /*e*/) {
+				}
+			}
+			verdict = checker->check_word(request.key.second) ? Verdict::Correct : Verdict::Misspelled;
+		}
+		{
+			Glib::Threads::Mutex::Lock locker(m_cacheMutex);
+			// Don't override words which were marked as correct in the meantime
+			Verdict& cached = m_cache[request.key];
+			if(cached == Verdict::Pending) {
+				cached = verdict;
+			}
+		}
+		if(m_requestQueue.empty()) {
+			m_dispatcherWordsChecked.emit();
+		}
+	}
+	Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+	for(const auto& pair : checkers) {
+		delete pair.second;
+	}
+}
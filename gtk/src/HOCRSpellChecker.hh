@@ -0,0 +1,63 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRSpellChecker.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOCRSPELLCHECKER_HH
+#define HOCRSPELLCHECKER_HH
+
+#include <map>
+
+#include "Utils.hh"
+
+// Checks the spelling of hOCR words on a worker thread and caches the verdicts per (language, word)
+class HOCRSpellChecker {
+public:
+	enum class Verdict { Pending, Correct, Misspelled };
+
+	HOCRSpellChecker();
+	~HOCRSpellChecker();
+
+	// Returns the cached verdict, or queues the word for checking and returns Pending
+	Verdict check(const Glib::ustring& lang, const Glib::ustring& word);
+	// Marks the word as correct, i.e. after it was added to the dictionary or ignored
+	void setCorrect(const Glib::ustring& lang, const Glib::ustring& word);
+
+	// Emitted in the main thread whenever the queue of pending words has been drained
+	sigc::signal<void> signal_words_checked() {
+		return m_signal_words_checked;
+	}
+
+private:
+	typedef std::pair<Glib::ustring, Glib::ustring> Key;
+	struct Request {
+		enum class Type { Check, Quit } type;
+		Key key;
+	};
+
+	Glib::Threads::Mutex m_cacheMutex;
+	std::map<Key, Verdict> m_cache;
+	Utils::AsyncQueue<Request> m_requestQueue;
+	Glib::Threads::Thread* m_thread = nullptr;
+	// Emitted by the worker, delivered in the main thread unless the checker is destroyed first
+	Glib::Dispatcher m_dispatcherWordsChecked;
+	sigc::signal<void> m_signal_words_checked;
+
+	void run();
+};
+
+#endif // HOCRSPELLCHECKER_HH
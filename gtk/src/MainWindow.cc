@@ -62,7 +62,10 @@ static Glib::Quark notificationHandleKey("handle");
 void MainWindow::signalHandler(int sig) {
 	std::signal(sig, nullptr);
 	std::string filename;
-	if(MAIN->getOutputEditor() && MAIN->getOutputEditor()->getModified()) {
+	if(MAIN->m_crashJournalActive) {
+		// Saving is not safe at this point, the output is recovered from the journal on the next start instead
+		filename = MAIN->m_crashJournal;
+	} else if(MAIN->getOutputEditor() && MAIN->getOutputEditor()->getModified()) {
 		filename = Glib::build_filename(g_get_home_dir(), Glib::ustring::compose("%1_crash-save.txt", PACKAGE_NAME));
 		int i = 0;
 		while(Glib::file_test(filename, Glib::FILE_TEST_EXISTS)) {
@@ -108,6 +111,7 @@ MainWindow::MainWindow()
 	: m_builder("/org/gnome/gimagereader/gimagereader.ui") {
 	s_instance = this;
 
+	m_crashJournal = OutputEditorHOCR::journalFilename(getpid());
 	std::signal(SIGSEGV, signalHandler);
 	std::signal(SIGABRT, signalHandler);
 #ifndef __ARMEL__
@@ -188,6 +192,23 @@ MainWindow::MainWindow()
 #else
 	getWidget("check:config.settings.update")->hide();
 #endif
+
+	// Offer to recover the hOCR output of sessions which crashed, the journals of running sessions are locked
+	std::string journalDir = OutputEditorHOCR::journalDirectory();
+	for(const std::string& name : Glib::Dir(journalDir)) {
+		std::string journal = Glib::build_filename(journalDir, name);
+		if(name.compare(0, 13, "hocr-journal-") != 0 || journal == m_crashJournal || !HOCRJournal::isOrphan(journal)) {
+			continue;
+		}
+		std::vector<HOCRJournal::Record> records = HOCRJournal::read(journal);
+		if(HOCRDocument::hasUnsavedEdits(records) && Utils::question_dialog(_("Recover output"), _("A previous session did not terminate properly. Recover the unsaved hOCR output?"), Utils::Button::Yes|Utils::Button::No) == Utils::Button::Yes) {
+			m_ocrModeCombo->set_active(1);
+			if(!static_cast<OutputEditorHOCR*>(m_outputEditor)->recoverJournal(records)) {
+				Utils::message_dialog(Gtk::MESSAGE_WARNING, _("Recover output"), _("The output could only be partially recovered."));
+			}
+		}
+		std::remove(journal.c_str());
+	}
 }
 
 MainWindow::~MainWindow() {
@@ -332,6 +353,7 @@ void MainWindow::setOCRMode(int idx) {
 		}
 		m_connection_setOCRMode.block(false);
 	} else {
+		m_crashJournalActive = 0;
 		if(m_outputEditor) {
 			m_connection_setOutputEditorLanguage.disconnect();
 			m_connection_setOutputEditorVisibility.disconnect();
@@ -345,6 +367,7 @@ void MainWindow::setOCRMode(int idx) {
 		} else { /*if(idx == 1)*/
 			m_displayerTool = new DisplayerToolHOCR(m_displayer);
 			m_outputEditor = new OutputEditorHOCR(static_cast<DisplayerToolHOCR*>(m_displayerTool));
+			m_crashJournalActive = 1;
 		}
 		m_displayer->setTool(m_displayerTool);
 		m_connection_setOutputEditorLanguage = CONNECT(m_recognizer, languageChanged, [this](const Config::Lang& lang) {
@@ -445,34 +468,39 @@ void MainWindow::languageChanged() {
 	if(code.empty()) {
 		return;
 	}
-	GtkSpell::Checker checker;
-	try {
-		checker.set_language(code);
-	} catch(const GtkSpell::Error& /*e*/) {
-		if(getConfig()->getSetting<SwitchSetting>("dictinstall")->getValue()) {
-			NotificationAction actionDontShowAgain = {_("Don't show again"), [this]{ m_config->getSetting<SwitchSetting>("dictinstall")->setValue(false); return true; }};
-			NotificationAction actionInstall = NotificationAction{_("Install"), [this,lang]{ dictionaryAutoinstall(lang.code); return false; }};
+	bool installed = true;
+	{
+		Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+		GtkSpell::Checker checker;
+		try {
+			checker.set_language(code);
+		} catch(const GtkSpell::Error& /*e*/) {
+			installed = false;
+		}
+	}
+	if(!installed && getConfig()->getSetting<SwitchSetting>("dictinstall")->getValue()) {
+		NotificationAction actionDontShowAgain = {_("Don't show again"), [this]{ m_config->getSetting<SwitchSetting>("dictinstall")->setValue(false); return true; }};
+		NotificationAction actionInstall = NotificationAction{_("Install"), [this,lang]{ dictionaryAutoinstall(lang.code); return false; }};
 #ifdef G_OS_UNIX
-			if(getConfig()->useSystemDataLocations()) {
-				// Try initiating a DBUS connection for PackageKit
-				Glib::RefPtr<Gio::DBus::Proxy> proxy;
-				Glib::ustring service_owner;
-				try {
-					proxy = Gio::DBus::Proxy::create_for_bus_sync(Gio::DBus::BUS_TYPE_SESSION, "org.freedesktop.PackageKit",
-					        "/org/freedesktop/PackageKit", "org.freedesktop.PackageKit.Modify");
-					service_owner = proxy->get_name_owner();
-				} catch(...) {
-				}
-				if(!service_owner.empty()) {
-					actionInstall = MainWindow::NotificationAction{_("Install"), [this,proxy,lang]{ dictionaryAutoinstall(proxy, lang.code); return false; }};
-				} else {
-					actionInstall = {_("Help"), [this]{ showHelp("#InstallSpelling"); return false; }};
-					g_warning("Could not find PackageKit on DBus, dictionary autoinstallation will not work");
-				}
+		if(getConfig()->useSystemDataLocations()) {
+			// Try initiating a DBUS connection for PackageKit
+			Glib::RefPtr<Gio::DBus::Proxy> proxy;
+			Glib::ustring service_owner;
+			try {
+				proxy = Gio::DBus::Proxy::create_for_bus_sync(Gio::DBus::BUS_TYPE_SESSION, "org.freedesktop.PackageKit",
+				        "/org/freedesktop/PackageKit", "org.freedesktop.PackageKit.Modify");
+				service_owner = proxy->get_name_owner();
+			} catch(...) {
+			}
+			if(!service_owner.empty()) {
+				actionInstall = MainWindow::NotificationAction{_("Install"), [this,proxy,lang]{ dictionaryAutoinstall(proxy, lang.code); return false; }};
+			} else {
+				actionInstall = {_("Help"), [this]{ showHelp("#InstallSpelling"); return false; }};
+				g_warning("Could not find PackageKit on DBus, dictionary autoinstallation will not work");
 			}
-#endif
-			addNotification(_("Spelling dictionary missing"), Glib::ustring::compose(_("The spellcheck dictionary for %1 is not installed"), lang.name), {actionInstall, actionDontShowAgain}, &m_notifierHandle);
 		}
+#endif
+		addNotification(_("Spelling dictionary missing"), Glib::ustring::compose(_("The spellcheck dictionary for %1 is not installed"), lang.name), {actionInstall, actionDontShowAgain}, &m_notifierHandle);
 	}
 }
 
@@ -22,6 +22,8 @@
 
 #include "common.hh"
 
+#include <csignal>
+
 #define MAIN MainWindow::getInstance()
 
 class Config;
@@ -116,6 +118,10 @@ private:
 
 	MainWindow::Notification m_notifierHandle = nullptr;
 
+	// Only read by the signal handler, which cannot compute anything safely
+	std::string m_crashJournal;
+	volatile std::sig_atomic_t m_crashJournalActive = 0;
+
 	ProgressMonitor* m_progressMonitor = nullptr;
 
 	std::vector<Gtk::Widget*> m_idlegroup;
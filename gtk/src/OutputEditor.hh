@@ -34,6 +34,9 @@ public:
 		std::string file;
 		double angle;
 		int resolution;
+		// Size of the recognized image, tesseract reports the recognition rectangle as page bbox
+		int imageWidth = 0;
+		int imageHeight = 0;
 	};
 
 	OutputEditor() {}
@@ -17,99 +17,174 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <map>
 #include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include <unistd.h>
 #include <cairomm/cairomm.h>
 #include <pangomm/font.h>
 #include <tesseract/baseapi.h>
 #include <tesseract/ocrclass.h>
 #include <libxml++/libxml++.h>
+#include <podofo/base/PdfArray.h>
 #include <podofo/base/PdfDictionary.h>
 #include <podofo/base/PdfFilter.h>
 #include <podofo/base/PdfStream.h>
 #include <podofo/doc/PdfFont.h>
 #include <podofo/doc/PdfIdentityEncoding.h>
 #include <podofo/doc/PdfImage.h>
+#include <podofo/doc/PdfMemDocument.h>
 #include <podofo/doc/PdfPage.h>
 #include <podofo/doc/PdfPainter.h>
 #include <podofo/doc/PdfStreamedDocument.h>
+#include <podofo/doc/PdfXObject.h>
 
 #include "CCITTFax4Encoder.hh"
 #include "DisplayerToolHOCR.hh"
 #include "FileDialogs.hh"
+#include "FlateEncoder.hh"
+#include "JBIG2Encoder.hh"
 #include "MainWindow.hh"
 #include "OutputEditorHOCR.hh"
 #include "Recognizer.hh"
 #include "SourceManager.hh"
 #include "Utils.hh"
+#include "WorkerPool.hh"
 
 
-const Glib::RefPtr<Glib::Regex> OutputEditorHOCR::s_bboxRx = Glib::Regex::create("bbox\\s+(\\d+)\\s+(\\d+)\\s+(\\d+)\\s+(\\d+)");
-const Glib::RefPtr<Glib::Regex> OutputEditorHOCR::s_pageTitleRx = Glib::Regex::create("image\\s+'(.+)';\\s+bbox\\s+\\d+\\s+\\d+\\s+\\d+\\s+\\d+;\\s+pageno\\s+(\\d+);\\s+rot\\s+(\\d+\\.?\\d*);\\s+res\\s+(\\d+\\.?\\d*)");
-const Glib::RefPtr<Glib::Regex> OutputEditorHOCR::s_idRx = Glib::Regex::create("(\\w+)_\\d+_(\\d+)");
-const Glib::RefPtr<Glib::Regex> OutputEditorHOCR::s_fontSizeRx = Glib::Regex::create("x_fsize\\s+(\\d+)");
-const Glib::RefPtr<Glib::Regex> OutputEditorHOCR::s_baseLineRx = Glib::Regex::create("baseline\\s+(-?\\d+\\.?\\d*)\\s+(-?\\d+)");
+static inline Geometry::Rectangle toRectangle(const HOCRItem::BBox& bbox) {
+	return Geometry::Rectangle(bbox.x1, bbox.y1, bbox.width(), bbox.height());
+}
 
-static inline Glib::ustring getAttribute(const xmlpp::Element* element, const Glib::ustring& name) {
-	if(!element)
-		return Glib::ustring();
-	xmlpp::Attribute* attrib = element->get_attribute(name);
-	return attrib ? attrib->get_value() : Glib::ustring();
+// Text blocks are not shown, their paragraphs are listed directly below the page
+static bool isDisplayed(const HOCRItem* item) {
+	return item->isPage() || item->isGraphic() || item->isParagraph() || item->isLine() || item->isWord();
 }
 
-static inline Glib::ustring getElementText(const xmlpp::Element* element) {
-	if(!element)
-		return Glib::ustring();
-	Glib::ustring text;
-	for(xmlpp::Node* node : element->get_children()) {
-		if(dynamic_cast<xmlpp::TextNode*>(node)) {
-			text += static_cast<xmlpp::TextNode*>(node)->get_content();
-		} else if(dynamic_cast<xmlpp::Element*>(node)) {
-			text += getElementText(static_cast<xmlpp::Element*>(node));
-		}
+static HOCRItem* displayParent(const HOCRItem* item) {
+	HOCRItem* parent = item->parent();
+	while(parent && !isDisplayed(parent)) {
+		parent = parent->parent();
 	}
-	return Utils::string_trim(text);
+	return parent;
 }
 
-static inline xmlpp::Element* getFirstChildElement(xmlpp::Node* node, const Glib::ustring& name = Glib::ustring()) {
-	if(!node)
-		return nullptr;
-	xmlpp::Node* child = node->get_first_child(name);
-	while(child && !dynamic_cast<xmlpp::Element*>(child)) {
-		child = child->get_next_sibling();
+// The number of rows the item is displayed as
+static int displayRowCount(const HOCRItem* item) {
+	if(isDisplayed(item)) {
+		return 1;
+	} else if(item->itemClass() != "ocr_carea") {
+		return 0;
+	}
+	int count = 0;
+	for(const HOCRItem* child : item->children()) {
+		count += displayRowCount(child);
 	}
-	return child ? dynamic_cast<xmlpp::Element*>(child) : nullptr;
+	return count;
 }
 
-static inline xmlpp::Element* getNextSiblingElement(xmlpp::Node* node, const Glib::ustring& name = Glib::ustring()) {
-	if(!node)
-		return nullptr;
-	xmlpp::Node* child = node->get_next_sibling();
-	if(name != "") {
-		while(child && (child->get_name() != name || !dynamic_cast<xmlpp::Element*>(child))) {
-			child = child->get_next_sibling();
-		}
-	} else {
-		while(child && !dynamic_cast<xmlpp::Element*>(child)) {
-			child = child->get_next_sibling();
-		}
+// The row at which the index-th child of parent is displayed, below the displayed ancestor of the child
+static int displayRowAt(const HOCRItem* parent, int index) {
+	int row = 0;
+	for(int i = 0; i < index; ++i) {
+		row += displayRowCount(parent->child(i));
 	}
-	return child ? dynamic_cast<xmlpp::Element*>(child) : nullptr;
+	if(!isDisplayed(parent) && parent->parent()) {
+		row += displayRowAt(parent->parent(), parent->index());
+	}
+	return row;
 }
 
-static inline Glib::ustring getDocumentXML(xmlpp::Document* doc) {
-	Glib::ustring xml = doc->write_to_string();
-	// Strip entity declaration
-	if(xml.substr(0, 5) == "<?xml") {
-		std::size_t pos = xml.find("?>\n");
-		xml = xml.substr(pos + 3);
+// Renders the source of the page at the given resolution, without going through the displayer,
+// but with the brightness, contrast and invert settings of the source as the displayer shows it
+static bool rasterizePage(PageRasterizer& rasterizer, const HOCRPage* page, int resolution) {
+	if(page->sourceFile().empty()) {
+		return false;
 	}
-	return xml;
+	const Source* source = MAIN->getSourceManager()->getSource(page->sourceFile());
+	if(!source) {
+		return rasterizer.setPage(page->sourceFile(), page->pageNr(), resolution, page->angle());
+	}
+	return rasterizer.setPage(page->sourceFile(), page->pageNr(), resolution, page->angle(), source->brightness, source->contrast, source->invert);
+}
+
+// Maps a page recorded by the PoDoFoPDFPainter to the user space of its source PDF page. The hOCR
+// page is the source page as rendered by poppler, that is its crop box turned by /Rotate, which is
+// then rotated by the angle of the page about its center, see PageRasterizer::getRegion.
+static Cairo::Matrix sourcePageTransform(PoDoFo::PdfPage* page, double angle, double pageHeight) {
+	PoDoFo::PdfRect box = page->GetCropBox();
+	int rotation = ((page->GetRotation() % 360) + 360) % 360;
+	double width = rotation % 180 == 0 ? box.GetWidth() : box.GetHeight();
+	double height = rotation % 180 == 0 ? box.GetHeight() : box.GetWidth();
+	double alpha = angle / 180. * M_PI;
+	double rotatedWidth = std::abs(std::cos(alpha) * width) + std::abs(std::sin(alpha) * height);
+	double rotatedHeight = std::abs(std::sin(alpha) * width) + std::abs(std::cos(alpha) * height);
+
+	Cairo::Matrix transform(1, 0, 0, -1, -0.5 * rotatedWidth, pageHeight - 0.5 * rotatedHeight);
+	Cairo::Matrix rotate = Cairo::rotation_matrix(-alpha);
+	transform.multiply(transform, rotate);
+	Cairo::Matrix center = Cairo::translation_matrix(0.5 * width, 0.5 * height);
+	transform.multiply(transform, center);
+	Cairo::Matrix userSpace(1, 0, 0, -1, box.GetLeft(), box.GetBottom() + box.GetHeight());
+	if(rotation == 90) {
+		userSpace = Cairo::Matrix(0, 1, 1, 0, box.GetLeft(), box.GetBottom());
+	} else if(rotation == 180) {
+		userSpace = Cairo::Matrix(-1, 0, 0, 1, box.GetLeft() + box.GetWidth(), box.GetBottom());
+	} else if(rotation == 270) {
+		userSpace = Cairo::Matrix(0, -1, -1, 0, box.GetLeft() + box.GetWidth(), box.GetBottom() + box.GetHeight());
+	}
+	transform.multiply(transform, userSpace);
+	return transform;
 }
 
-static inline Glib::ustring getElementXML(const xmlpp::Element* element) {
-	xmlpp::Document doc;
-	doc.create_root_node_by_import(element);
-	return getDocumentXML(&doc);
+// Parses the element at which the reader is positioned, up to and including its end tag
+static HOCRItem* parseItem(xmlpp::TextReader& reader) {
+	HOCRItem::AttributeList attrs;
+	if(reader.move_to_first_attribute()) {
+		do {
+			attrs.push_back(std::make_pair(std::string(reader.get_name()), std::string(reader.get_value())));
+		} while(reader.move_to_next_attribute());
+		reader.move_to_element();
+	}
+	HOCRItem* item;
+	if(reader.get_attribute("class") == "ocr_page") {
+		item = new HOCRPage(attrs);
+	} else {
+		item = new HOCRItem(reader.get_local_name(), attrs);
+	}
+	if(reader.is_empty_element()) {
+		return item;
+	}
+	int depth = reader.get_depth();
+	Glib::ustring text;
+	bool bold = false, italic = false;
+	while(reader.read()) {
+		int type = reader.get_node_type();
+		if(type == xmlpp::TextReader::EndElement && reader.get_depth() == depth) {
+			break;
+		}
+		if(item->isWord()) {
+			if(type == xmlpp::TextReader::Element) {
+				bold |= reader.get_local_name() == "strong";
+				italic |= reader.get_local_name() == "em";
+			} else if(type == xmlpp::TextReader::Text || type == xmlpp::TextReader::SignificantWhitespace) {
+				text += reader.get_value();
+			}
+		} else if(type == xmlpp::TextReader::Element && reader.get_depth() == depth + 1 && reader.get_attribute("class").substr(0, 3) == "ocr") {
+			item->appendChild(parseItem(reader));
+		}
+	}
+	if(item->isWord()) {
+		item->setText(Utils::string_trim(text));
+		item->setFontFlags(bold, italic);
+	}
+	return item;
 }
 
 
@@ -220,74 +295,385 @@ public:
 }
 #endif
 
+// Glyph advances of a PDF font, measured once per glyph and font size. The text widths are summed
+// up from them, as PdfFontMetrics::StringWidth does over the UTF-16 code units of the text, but
+// without converting the text for PoDoFo. Shared by the pages of an export.
+class PoDoFoGlyphWidths {
+public:
+	struct Advances {
+		double pointSize;
+		double averageCharWidth;
+		double latin1[256]; // Negative until measured
+		std::unordered_map<uint16_t, double> other;
+	};
+
+	PoDoFoGlyphWidths(PoDoFo::PdfFont* font) : m_font(font) {}
+	Advances* advances(double pointSize) {
+		auto it = m_advances.find(pointSize);
+		if(it == m_advances.end()) {
+			it = m_advances.insert(std::make_pair(pointSize, Advances())).first;
+			Advances& advances = it->second;
+			advances.pointSize = pointSize;
+			m_font->SetFontSize(pointSize);
+			advances.averageCharWidth = m_font->GetFontMetrics()->CharWidth(static_cast<unsigned char>('x'));
+			std::fill_n(advances.latin1, 256, -1.);
+		}
+		return &it->second;
+	}
+	double textWidth(Advances* advances, const Glib::ustring& text) {
+		double width = 0;
+		for(gunichar c : text) {
+			if(c < 0x10000) {
+				width += advance(advances, c);
+			} else {
+				// Surrogate pair
+				c -= 0x10000;
+				width += advance(advances, 0xD800 + (c >> 10));
+				width += advance(advances, 0xDC00 + (c & 0x3FF));
+			}
+		}
+		return width;
+	}
+
+private:
+	PoDoFo::PdfFont* m_font;
+	std::map<double, Advances> m_advances;
+
+	double advance(Advances* advances, uint16_t c) {
+		if(c < 256) {
+			double& advance = advances->latin1[c];
+			if(advance < 0) {
+				advance = measure(advances->pointSize, c);
+			}
+			return advance;
+		}
+		auto it = advances->other.find(c);
+		if(it == advances->other.end()) {
+			it = advances->other.insert(std::make_pair(c, measure(advances->pointSize, c))).first;
+		}
+		return it->second;
+	}
+	double measure(double pointSize, uint16_t c) {
+		// The font is shared with the page being written, which sets its own sizes
+		m_font->SetFontSize(pointSize);
+		return m_font->GetFontMetrics()->UnicodeCharWidth(c);
+	}
+};
+
+// Records the contents of a page while its images are encoded on the worker pool, the page is
+// written to the document once all its images are ready.
 class OutputEditorHOCR::PoDoFoPDFPainter : public OutputEditorHOCR::PDFPainter {
 public:
-	PoDoFoPDFPainter(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter, double scaleFactor)
-		: m_document(document), m_painter(painter), m_scaleFactor(scaleFactor) {
-		m_pageHeight = m_painter->GetPage()->GetPageSize().GetHeight();
+	PoDoFoPDFPainter(WorkerPool& pool, PoDoFoGlyphWidths& glyphWidths, PoDoFo::PdfFont* font, double pageWidth, double pageHeight, double scaleFactor)
+		: m_pool(pool), m_glyphWidths(glyphWidths), m_font(font), m_pageWidth(pageWidth), m_pageHeight(pageHeight), m_scaleFactor(scaleFactor) {
+		m_advances = m_glyphWidths.advances(m_font->GetFontSize());
 	}
 	void setFontSize(double pointSize) override {
-		m_painter->GetFont()->SetFontSize(pointSize);
+		m_advances = m_glyphWidths.advances(pointSize);
+		Operation op;
+		op.type = Operation::SetFontSize;
+		op.pointSize = pointSize;
+		m_operations.push_back(op);
 	}
 	void drawText(double x, double y, const Glib::ustring& text) override {
-		PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(text.c_str()));
-		m_painter->DrawText(x * m_scaleFactor, m_pageHeight - y * m_scaleFactor, pdfString);
+		Operation op;
+		op.type = Operation::DrawText;
+		op.x = x;
+		op.y = y;
+		op.text = text;
+		m_operations.push_back(op);
 	}
 	void drawImage(const Geometry::Rectangle& bbox, const Cairo::RefPtr<Cairo::ImageSurface>& image, const PDFSettings& settings) override {
+		int strips = 1;
+		int chunks = 1;
+		if(settings.compression == PDFSettings::CompressFax4 && settings.fax4Strips) {
+			strips = std::max(1, std::min(m_pool.threadCount(), image->get_height() / minStripHeight));
+		} else if(settings.compression == PDFSettings::CompressZip) {
+			int depth = settings.colorFormat == Image::Format_Mono ? 1 : settings.colorFormat == Image::Format_RGB24 ? 24 : 8;
+			int64_t size = int64_t(image->get_width()) * depth / 8 * image->get_height();
+			chunks = std::max(1, int(std::min(int64_t(m_pool.threadCount()), size / minZipChunkSize)));
+		}
+		for(int i = 0; i < strips; ++i) {
+			Operation op;
+			op.type = Operation::DrawImage;
+			op.bbox = bbox;
+			op.image = m_imageCount++;
+			m_operations.push_back(op);
+		}
+		m_sources.push_back(PendingImage{image, settings, strips, chunks});
+	}
+	// Hands the recorded images to the worker pool. Must be called once the caller dropped its
+	// references to the images, since the reference count of Cairo::RefPtr is not thread safe.
+	void encodeImages() {
+		for(std::size_t n = m_sources.size(); m_encodedSources < n; ++m_encodedSources) {
+			PendingImage* source = &m_sources[m_encodedSources];
+			if(source->strips == 1 && source->chunks == 1) {
+				m_images.push_back(m_pool.submit([source] {
+					EncodedImage encoded = encodeImage(source->image, source->settings);
+					source->image.clear();
+					return encoded;
+				}));
+				continue;
+			}
+			// The image is converted as a whole, so that the dithering does not depend on the strips. The strips,
+			// or the chunks and the task joining them, are queued after the conversion, which is therefore already
+			// running when they wait for it.
+			std::shared_future<std::shared_ptr<Image>> converted = m_pool.submit([source] {
+				std::shared_ptr<Image> img = std::make_shared<Image>(source->image, source->settings.colorFormat, source->settings.conversionFlags);
+				source->image.clear();
+				return img;
+			}).share();
+			if(source->strips > 1) {
+				for(int i = 0; i < source->strips; ++i) {
+					m_images.push_back(m_pool.submit([converted, i, source] {
+						const Image& img = *converted.get();
+						return encodeFax4(img, img.height * i / source->strips, img.height * (i + 1) / source->strips);
+					}));
+				}
+			} else if(source->chunks > 1) {
+				addZipChunks(source, converted);
+			}
+		}
+	}
+	double getAverageCharWidth() const override {
+		return m_advances->averageCharWidth / m_scaleFactor;
+	}
+	double getTextWidth(const Glib::ustring& text) const override {
+		return m_glyphWidths.textWidth(m_advances, text) / m_scaleFactor;
+	}
+	// Waits for the images to be encoded and writes the page, pages need to be written in order
+	void writePage(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter) {
+		PoDoFo::PdfPage* page = document->CreatePage(PoDoFo::PdfRect(0, 0, m_pageWidth, m_pageHeight));
+		painter->SetPage(page);
+		drawOperations(document, painter);
+	}
+	// Writes the contents as an invisible layer on top of an existing page, the transform maps the
+	// recorded page to the user space of the existing page. The existing contents are left as they are.
+	void writeOverlay(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter, PoDoFo::PdfPage* page, const Cairo::Matrix& transform) {
+		PoDoFo::PdfXObject form(PoDoFo::PdfRect(0, 0, m_pageWidth, m_pageHeight), document);
+		painter->SetPage(&form);
+		drawOperations(document, painter);
+
+		// The existing contents are enclosed in q/Q, so that the form is drawn in the default user space
+		PoDoFo::PdfObject* prologue = document->GetObjects()->CreateObject();
+		prologue->GetStream()->Set("q\n");
+		PoDoFo::PdfObject* epilogue = document->GetObjects()->CreateObject();
+		std::ostringstream ops;
+		ops.imbue(std::locale::classic());
+		ops << std::fixed << std::setprecision(6) << "Q\nq 3 Tr " << transform.xx << " " << transform.yx << " " << transform.xy << " " << transform.yy << " "
+		    << transform.x0 << " " << transform.y0 << " cm /" << form.GetIdentifier().GetName() << " Do Q\n";
+		epilogue->GetStream()->Set(ops.str().c_str());
+
+		PoDoFo::PdfArray contents;
+		contents.push_back(prologue->Reference());
+		PoDoFo::PdfObject* pageContents = page->GetObject()->GetIndirectKey("Contents");
+		if(pageContents && pageContents->IsArray()) {
+			for(const PoDoFo::PdfObject& stream : pageContents->GetArray()) {
+				contents.push_back(stream);
+			}
+		} else if(pageContents) {
+			contents.push_back(pageContents->Reference());
+		}
+		contents.push_back(epilogue->Reference());
+		page->GetObject()->GetDictionary().AddKey("Contents", contents);
+		page->AddResource(form.GetIdentifier(), form.GetObjectReference(), "XObject");
+	}
+
+private:
+	struct Operation {
+		enum Type { SetFontSize, DrawText, DrawImage } type;
+		double pointSize;
+		double x;
+		double y;
+		Glib::ustring text;
+		Geometry::Rectangle bbox;
+		std::size_t image;
+	};
+	struct PendingImage {
+		Cairo::RefPtr<Cairo::ImageSurface> image;
+		PDFSettings settings;
+		int strips;
+		int chunks;
+	};
+	// Images may be split into strips, which are stacked to compose the full image
+	struct EncodedImage {
+		int width;
+		int height;
+		int top;
+		int fullHeight;
+		int sampleSize;
+		bool rgb;
+		PDFSettings::Compression compression;
+		std::vector<char> data;
+	};
+	// A chunk of a zlib stream, see FlateEncoder
+	struct DeflatedRows {
+		std::vector<char> data;
+		uint32_t checksum;
+		std::size_t size;
+	};
+
+	WorkerPool& m_pool;
+	PoDoFoGlyphWidths& m_glyphWidths;
+	PoDoFoGlyphWidths::Advances* m_advances;
+	PoDoFo::PdfFont* m_font;
+	double m_pageWidth;
+	double m_pageHeight;
+	double m_scaleFactor;
+	std::vector<Operation> m_operations;
+	std::deque<PendingImage> m_sources;
+	std::size_t m_encodedSources = 0;
+	std::size_t m_imageCount = 0;
+	std::vector<std::future<EncodedImage>> m_images;
+
+	// Bilevel images are only split into strips of at least this many rows
+	static constexpr int minStripHeight = 256;
+	// Images are only deflated in parallel chunks of at least this many bytes
+	static constexpr int minZipChunkSize = 1 << 20;
+
+	void drawOperations(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter) {
+		painter->SetFont(m_font);
+		for(const Operation& op : m_operations) {
+			if(op.type == Operation::SetFontSize) {
+				m_font->SetFontSize(op.pointSize);
+			} else if(op.type == Operation::DrawText) {
+				PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(op.text.c_str()));
+				painter->DrawText(op.x * m_scaleFactor, m_pageHeight - op.y * m_scaleFactor, pdfString);
+			} else if(op.type == Operation::DrawImage) {
+				EncodedImage image = m_images[op.image].get();
+				drawEncodedImage(document, painter, op.bbox, image);
+			}
+		}
+		painter->FinishPage();
+	}
+	void addZipChunks(const PendingImage* source, const std::shared_future<std::shared_ptr<Image>>& converted) {
+		std::vector<std::shared_future<DeflatedRows>> parts;
+		for(int i = 0; i < source->chunks; ++i) {
+			int flags = (i == 0 ? FlateEncoder::FirstChunk : 0) | (i == source->chunks - 1 ? FlateEncoder::LastChunk : 0);
+			parts.push_back(m_pool.submit([converted, i, flags, source] {
+				const Image& img = *converted.get();
+				return deflateRows(img, source->settings.zipLevel, img.height * i / source->chunks, img.height * (i + 1) / source->chunks, flags);
+			}).share());
+		}
+		m_images.push_back(m_pool.submit([converted, parts, source] {
+			EncodedImage encoded = imageInfo(*converted.get(), source->settings);
+			uint32_t checksum = 0;
+			for(std::size_t i = 0, n = parts.size(); i < n; ++i) {
+				const DeflatedRows& part = parts[i].get();
+				encoded.data.insert(encoded.data.end(), part.data.begin(), part.data.end());
+				checksum = i == 0 ? part.checksum : FlateEncoder::combineChecksums(checksum, part.checksum, part.size);
+			}
+			FlateEncoder::writeTrailer(checksum, [&encoded](const uint8_t* data, std::size_t size) {
+				encoded.data.insert(encoded.data.end(), data, data + size);
+			});
+			return encoded;
+		}));
+	}
+
+	// The functions below run on the worker pool
+	// Encodes the rows [top, bottom) of the bilevel image
+	static EncodedImage encodeFax4(const Image& img, int top, int bottom) {
+		EncodedImage encoded;
+		encoded.width = img.width;
+		encoded.height = bottom - top;
+		encoded.top = top;
+		encoded.fullHeight = img.height;
+		encoded.sampleSize = 1;
+		encoded.rgb = false;
+		encoded.compression = PDFSettings::CompressFax4;
+		CCITTFax4Encoder encoder;
+		encoder.begin(img.width, [&encoded](const uint8_t* data, std::size_t size) {
+			encoded.data.insert(encoded.data.end(), data, data + size);
+		});
+		for(int y = top; y < bottom; ++y) {
+			encoder.encodeRow(img.data + y * img.bytesPerLine);
+		}
+		encoder.finish();
+		return encoded;
+	}
+	// Deflates the rows [top, bottom) of the image, as a chunk of a zlib stream
+	static DeflatedRows deflateRows(const Image& img, int level, int top, int bottom, int flags) {
+		DeflatedRows rows;
+		FlateEncoder encoder;
+		// The rows preceding the chunk prime the compressor
+		encoder.begin(level, [&rows](const uint8_t* data, std::size_t size) {
+			rows.data.insert(rows.data.end(), data, data + size);
+		}, flags, img.data, std::size_t(top) * img.bytesPerLine);
+		encoder.write(img.data + std::size_t(top) * img.bytesPerLine, std::size_t(bottom - top) * img.bytesPerLine);
+		rows.checksum = encoder.finish();
+		rows.size = encoder.inputSize();
+		return rows;
+	}
+	static EncodedImage imageInfo(const Image& img, const PDFSettings& settings) {
+		EncodedImage encoded;
+		encoded.width = img.width;
+		encoded.height = img.height;
+		encoded.top = 0;
+		encoded.fullHeight = img.height;
+		encoded.sampleSize = img.sampleSize;
+		encoded.rgb = settings.colorFormat == Image::Format_RGB24;
+		encoded.compression = settings.compression;
+		return encoded;
+	}
+	static EncodedImage encodeImage(const Cairo::RefPtr<Cairo::ImageSurface>& image, const PDFSettings& settings) {
 		Image img(image, settings.colorFormat, settings.conversionFlags);
-#if PODOFO_VERSION >= PODOFO_MAKE_VERSION(0,9,3)
-		PoDoFo::PdfImage pdfImage(m_document);
-#else
-		PoDoFo::PdfImageCompat pdfImage(m_document);
-#endif
-		pdfImage.SetImageColorSpace(settings.colorFormat == Image::Format_RGB24 ? PoDoFo::ePdfColorSpace_DeviceRGB : PoDoFo::ePdfColorSpace_DeviceGray);
+		if(settings.compression == PDFSettings::CompressFax4) {
+			return encodeFax4(img, 0, img.height);
+		}
+		EncodedImage encoded = imageInfo(img, settings);
 		if(settings.compression == PDFSettings::CompressZip) {
-			PoDoFo::PdfMemoryInputStream is(reinterpret_cast<const char*>(img.data), img.bytesPerLine * img.height);
-			pdfImage.SetImageData(img.width, img.height, img.sampleSize, &is, {PoDoFo::ePdfFilter_FlateDecode});
+			encoded.data = deflateRows(img, settings.zipLevel, 0, img.height, FlateEncoder::WholeStream).data;
 		} else if(settings.compression == PDFSettings::CompressJpeg) {
-			PoDoFo::PdfName dctFilterName(PoDoFo::PdfFilterFactory::FilterTypeToName(PoDoFo::ePdfFilter_DCTDecode));
-			pdfImage.GetObject()->GetDictionary().AddKey(PoDoFo::PdfName::KeyFilter, dctFilterName);
 			uint8_t* buf = nullptr;
 			unsigned long bufLen = 0;
 			img.writeJpeg(settings.compressionQuality, buf, bufLen);
-			PoDoFo::PdfMemoryInputStream is(reinterpret_cast<const char*>(buf), bufLen);
-			pdfImage.SetImageDataRaw(img.width, img.height, img.sampleSize, &is);
+			encoded.data.assign(buf, buf + bufLen);
 			std::free(buf);
-		} else if(settings.compression == PDFSettings::CompressFax4) {
-			PoDoFo::PdfName faxFilterName(PoDoFo::PdfFilterFactory::FilterTypeToName(PoDoFo::ePdfFilter_CCITTFaxDecode));
-			pdfImage.GetObject()->GetDictionary().AddKey(PoDoFo::PdfName::KeyFilter, faxFilterName);
+		} else if(settings.compression == PDFSettings::CompressJbig2) {
+			JBIG2Encoder encoder;
+			encoder.begin(img.width, img.height, [&encoded](const uint8_t* data, std::size_t size) {
+				encoded.data.insert(encoded.data.end(), data, data + size);
+			});
+			for(int y = 0; y < img.height; ++y) {
+				encoder.encodeRow(img.data + y * img.bytesPerLine);
+			}
+			encoder.finish();
+		}
+		return encoded;
+	}
+	void drawEncodedImage(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter, const Geometry::Rectangle& bbox, const EncodedImage& image) {
+#if PODOFO_VERSION >= PODOFO_MAKE_VERSION(0,9,3)
+		PoDoFo::PdfImage pdfImage(document);
+#else
+		PoDoFo::PdfImageCompat pdfImage(document);
+#endif
+		pdfImage.SetImageColorSpace(image.rgb ? PoDoFo::ePdfColorSpace_DeviceRGB : PoDoFo::ePdfColorSpace_DeviceGray);
+		PoDoFo::EPdfFilter filter = PoDoFo::ePdfFilter_FlateDecode;
+		if(image.compression == PDFSettings::CompressJpeg) {
+			filter = PoDoFo::ePdfFilter_DCTDecode;
+		} else if(image.compression == PDFSettings::CompressFax4) {
+			filter = PoDoFo::ePdfFilter_CCITTFaxDecode;
 			PoDoFo::PdfDictionary decodeParams;
-			decodeParams.AddKey("Columns", PoDoFo::PdfObject(PoDoFo::pdf_int64(img.width)));
-			decodeParams.AddKey("Rows", PoDoFo::PdfObject(PoDoFo::pdf_int64(img.height)));
+			decodeParams.AddKey("Columns", PoDoFo::PdfObject(PoDoFo::pdf_int64(image.width)));
+			decodeParams.AddKey("Rows", PoDoFo::PdfObject(PoDoFo::pdf_int64(image.height)));
 			decodeParams.AddKey("K", PoDoFo::PdfObject(PoDoFo::pdf_int64(-1))); // K < 0 --- Pure two-dimensional encoding (Group 4)
 			pdfImage.GetObject()->GetDictionary().AddKey("DecodeParms", PoDoFo::PdfObject(decodeParams));
-			CCITTFax4Encoder encoder;
-			uint32_t encodedLen = 0;
-			uint8_t* encoded = encoder.encode(img.data, img.width, img.height, img.bytesPerLine, encodedLen);
-			PoDoFo::PdfMemoryInputStream is(reinterpret_cast<char*>(encoded), encodedLen);
-			pdfImage.SetImageDataRaw(img.width, img.height, img.sampleSize, &is);
+		} else if(image.compression == PDFSettings::CompressJbig2) {
+			filter = PoDoFo::ePdfFilter_JBIG2Decode;
 		}
-		m_painter->DrawImage(bbox.x * m_scaleFactor, m_pageHeight - (bbox.y + bbox.height) * m_scaleFactor, &pdfImage, m_scaleFactor * bbox.width / double(image->get_width()), m_scaleFactor * bbox.height / double(image->get_height()));
-	}
-	double getAverageCharWidth() const override {
-		return m_painter->GetFont()->GetFontMetrics()->CharWidth(static_cast<unsigned char>('x')) / m_scaleFactor;
+		PoDoFo::PdfName filterName(PoDoFo::PdfFilterFactory::FilterTypeToName(filter));
+		pdfImage.GetObject()->GetDictionary().AddKey(PoDoFo::PdfName::KeyFilter, filterName);
+		PoDoFo::PdfMemoryInputStream is(image.data.data(), image.data.size());
+		pdfImage.SetImageDataRaw(image.width, image.height, image.sampleSize, &is);
+		double scaleX = m_scaleFactor * bbox.width / double(image.width);
+		double scaleY = m_scaleFactor * bbox.height / double(image.fullHeight);
+		painter->DrawImage(bbox.x * m_scaleFactor, m_pageHeight - bbox.y * m_scaleFactor - (image.top + image.height) * scaleY, &pdfImage, scaleX, scaleY);
 	}
-	double getTextWidth(const Glib::ustring& text) const override {
-		PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(text.c_str()));
-		return m_painter->GetFont()->GetFontMetrics()->StringWidth(pdfString) / m_scaleFactor;
-	}
-
-private:
-	PoDoFo::PdfDocument* m_document;
-	PoDoFo::PdfPainter* m_painter;
-	double m_scaleFactor;
-	double m_imageScale;
-	double m_pageHeight;
 };
 
 
 OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
-	: m_builder("/org/gnome/gimagereader/editor_hocr.ui") {
+	: m_builder("/org/gnome/gimagereader/editor_hocr.ui"), m_journal(journalFilename(getpid()), [this] { m_journalFailedDispatcher.emit(); }) {
 	m_tool = tool;
 	m_widget = m_builder("box:hocr");
 
@@ -295,6 +681,12 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	Gtk::Button* saveButton = m_builder("button:hocr.save");
 	Gtk::Button* clearButton = m_builder("button:hocr.clear");
 	Gtk::Button* exportButton = m_builder("button:hocr.export");
+	Gtk::Button* undoButton = m_builder("button:hocr.undo");
+	Gtk::Button* redoButton = m_builder("button:hocr.redo");
+	m_toggleSearchButton = m_builder("button:hocr.findreplace");
+	m_searchEntry = m_builder("entry:hocr.search");
+	m_replaceEntry = m_builder("entry:hocr.replace");
+	m_csCheckBox = m_builder("checkbutton:hocr.matchcase");
 	m_itemView = nullptr;
 	m_builder.get_derived("treeview:hocr.items", m_itemView);
 	m_itemStore = Gtk::TreeStore::create(m_itemStoreCols);
@@ -314,12 +706,23 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	if(textRenderer) {
 		itemViewCol->add_attribute(textRenderer->property_foreground(), m_itemStoreCols.textColor);
 		itemViewCol->add_attribute(textRenderer->property_editable(), m_itemStoreCols.editable);
+		// Highlight the words matching the search text
+		itemViewCol->set_cell_data_func(*textRenderer, [this, textRenderer](Gtk::CellRenderer*, const Gtk::TreeIter& iter) {
+			bool match = isSearchMatch(iter);
+			if(match) {
+				textRenderer->property_cell_background() = "#FF0";
+			}
+			textRenderer->property_cell_background_set() = match;
+		});
 	}
 	Gtk::TreeIter rootItem = m_itemStore->append();
 	rootItem->set_value(m_itemStoreCols.text, Glib::ustring(_("Document")));
 	rootItem->set_value(m_itemStoreCols.checkboxVisible, false);
 	rootItem->set_value(m_itemStoreCols.iconVisible, false);
 	m_rootItem = m_itemStore->get_path(rootItem);
+	m_document.setObserver(this);
+	m_document.setJournal(&m_journal);
+	m_journalFailedDispatcher.connect(sigc::mem_fun(this, &OutputEditorHOCR::journalFailed));
 
 	m_propView = m_builder("treeview:hocr.properties");
 	m_propStore = Gtk::TreeStore::create(m_propStoreCols);
@@ -350,6 +753,9 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 
 	Glib::RefPtr<Gtk::AccelGroup> group = MAIN->getWindow()->get_accel_group();
 	saveButton->add_accelerator("clicked", group, GDK_KEY_S, Gdk::CONTROL_MASK, Gtk::AccelFlags(0));
+	undoButton->add_accelerator("clicked", group, GDK_KEY_Z, Gdk::CONTROL_MASK, Gtk::AccelFlags(0));
+	redoButton->add_accelerator("clicked", group, GDK_KEY_Z, Gdk::CONTROL_MASK|Gdk::SHIFT_MASK, Gtk::AccelFlags(0));
+	m_toggleSearchButton->add_accelerator("clicked", group, GDK_KEY_F, Gdk::CONTROL_MASK, Gtk::AccelFlags(0));
 
 	m_pdfExportDialog = m_builder("dialog:pdfoptions");
 	m_pdfExportDialog->set_transient_for(*MAIN->getWindow());
@@ -396,6 +802,10 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	row[m_compressionComboCols.mode] = PDFSettings::CompressJpeg;
 	row[m_compressionComboCols.label] = _("Jpeg (lossy)");
 	row[m_compressionComboCols.sensitive] = true;
+	row = *(compressionModel->append());
+	row[m_compressionComboCols.mode] = PDFSettings::CompressJbig2;
+	row[m_compressionComboCols.label] = _("JBIG2 (lossless)");
+	row[m_compressionComboCols.sensitive] = true;
 	compressionCombo->pack_start(m_compressionComboCols.label);
 	compressionCombo->set_active(-1);
 	Gtk::CellRendererText* compressionTextRenderer = dynamic_cast<Gtk::CellRendererText*>(compressionCombo->get_cells()[0]);
@@ -407,6 +817,21 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	CONNECT(saveButton, clicked, [this] { save(); });
 	CONNECT(clearButton, clicked, [this] { clear(); });
 	CONNECT(exportButton, clicked, [this] { savePDF(); });
+	CONNECT(undoButton, clicked, [this] { undo(); });
+	CONNECT(redoButton, clicked, [this] { redo(); });
+	CONNECT(m_toggleSearchButton, toggled, [this] {
+		m_searchEntry->set_text("");
+		m_replaceEntry->set_text("");
+		m_builder("box:hocr.findreplace")->set_visible(m_toggleSearchButton->get_active());
+	});
+	CONNECT(m_csCheckBox, toggled, [this] { Utils::clear_error_state(m_searchEntry); m_itemView->queue_draw(); });
+	CONNECT(m_searchEntry, changed, [this] { Utils::clear_error_state(m_searchEntry); m_itemView->queue_draw(); });
+	CONNECT(m_searchEntry, activate, [this] { findReplace(false, false); });
+	CONNECT(m_replaceEntry, activate, [this] { findReplace(false, true); });
+	CONNECT(m_builder("button:hocr.searchnext").as<Gtk::Button>(), clicked, [this] { findReplace(false, false); });
+	CONNECT(m_builder("button:hocr.searchprev").as<Gtk::Button>(), clicked, [this] { findReplace(true, false); });
+	CONNECT(m_builder("button:hocr.replace").as<Gtk::Button>(), clicked, [this] { findReplace(false, true); });
+	CONNECT(m_builder("button:hocr.replaceall").as<Gtk::Button>(), clicked, [this] { replaceAll(); });
 	m_connectionCustomFont = CONNECTP(MAIN->getWidget("fontbutton:config.settings.customoutputfont").as<Gtk::FontButton>(), font_name, [this] { setFont(); });
 	m_connectionDefaultFont = CONNECT(MAIN->getWidget("checkbutton:config.settings.defaultoutputfont").as<Gtk::CheckButton>(), toggled, [this] { setFont(); });
 	m_connectionSelectionChanged = CONNECT(m_itemView->get_selection(), changed, [this] { showItemProperties(currentItem()); });
@@ -416,6 +841,11 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	m_connectionPropViewRowEdited = CONNECT(m_propStore, row_changed, [this](const Gtk::TreeModel::Path&, const Gtk::TreeIter& iter) {
 		propertyCellChanged(iter);
 	});
+	CONNECT(m_itemView, test_expand_row, [this](const Gtk::TreeIter& iter, const Gtk::TreePath&) {
+		populateItem(iter);
+		return false;
+	});
+	CONNECT(&m_spellChecker, words_checked, [this] { updatePendingSpellingColors(); });
 	CONNECT(m_itemView, context_menu_requested, [this](GdkEventButton* ev) {
 		showContextMenu(ev);
 	});
@@ -425,6 +855,9 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	CONNECT(m_tool, selection_drawn, [this](const Geometry::Rectangle& rect) {
 		addGraphicRection(rect);
 	});
+	CONNECT(m_tool, position_picked, [this](const Geometry::Point& point) {
+		pickItem(point);
+	});
 
 	CONNECT(m_builder("combo:pdfoptions.mode").as<Gtk::ComboBox>(), changed, [this] { updatePreview(); });
 	CONNECT(imageFormatCombo, changed, [this] { imageFormatChanged(); updatePreview(); });
@@ -452,6 +885,8 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfexportmode", m_builder("combo:pdfoptions.mode")));
 	MAIN->getConfig()->addSetting(new SpinSetting("pdfimagecompressionquality", m_builder("spin:pdfoptions.quality")));
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfimagecompression", m_builder("combo:pdfoptions.compression")));
+	MAIN->getConfig()->addSetting(new SpinSetting("pdfimageziplevel", m_builder("spin:pdfoptions.ziplevel")));
+	MAIN->getConfig()->addSetting(new SwitchSettingT<Gtk::CheckButton>("pdfimagefax4strips", m_builder("checkbox:pdfoptions.fax4strips")));
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfimageformat", m_builder("combo:pdfoptions.imageformat")));
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfimageconversionflags", m_builder("combo:pdfoptions.dithering")));
 	MAIN->getConfig()->addSetting(new SpinSetting("pdfimagedpi", m_builder("spin:pdfoptions.dpi")));
@@ -475,12 +910,18 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
 }
 
 OutputEditorHOCR::~OutputEditorHOCR() {
-	delete m_currentParser;
+	m_document.setObserver(nullptr);
+	m_connectionAddQueuedPages.disconnect();
+	for(HOCRPage* page : m_queuedPages) {
+		delete page;
+	}
 	m_connectionCustomFont.disconnect();
 	m_connectionDefaultFont.disconnect();
 	MAIN->getConfig()->removeSetting("pdfexportmode");
 	MAIN->getConfig()->removeSetting("pdfimagecompressionquality");
 	MAIN->getConfig()->removeSetting("pdfimagecompression");
+	MAIN->getConfig()->removeSetting("pdfimageziplevel");
+	MAIN->getConfig()->removeSetting("pdfimagefax4strips");
 	MAIN->getConfig()->removeSetting("pdfimageformat");
 	MAIN->getConfig()->removeSetting("pdfimagedpi");
 	MAIN->getConfig()->removeSetting("pdffont");
@@ -510,14 +951,17 @@ void OutputEditorHOCR::imageFormatChanged() {
 			compressionCombo->set_active(PDFSettings::CompressZip);
 		}
 		(*compressionStore->children()[PDFSettings::CompressFax4])[m_compressionComboCols.sensitive] = true;
+		(*compressionStore->children()[PDFSettings::CompressJbig2])[m_compressionComboCols.sensitive] = true;
 		(*compressionStore->children()[PDFSettings::CompressJpeg])[m_compressionComboCols.sensitive] = false;
 		m_builder("label:pdfoptions.dithering")->set_sensitive(true);
 		m_builder("combo:pdfoptions.dithering")->set_sensitive(true);
 	} else {
-		if((*compressionCombo->get_active())[m_compressionComboCols.mode] == PDFSettings::CompressFax4) {
+		PDFSettings::Compression compression = (*compressionCombo->get_active())[m_compressionComboCols.mode];
+		if(compression == PDFSettings::CompressFax4 || compression == PDFSettings::CompressJbig2) {
 			compressionCombo->set_active(PDFSettings::CompressZip);
 		}
 		(*compressionStore->children()[PDFSettings::CompressFax4])[m_compressionComboCols.sensitive] = false;
+		(*compressionStore->children()[PDFSettings::CompressJbig2])[m_compressionComboCols.sensitive] = false;
 		(*compressionStore->children()[PDFSettings::CompressJpeg])[m_compressionComboCols.sensitive] = true;
 		m_builder("label:pdfoptions.dithering")->set_sensitive(false);
 		m_builder("combo:pdfoptions.dithering")->set_sensitive(false);
@@ -529,6 +973,9 @@ void OutputEditorHOCR::imageCompressionChanged() {
 	bool jpegCompression = compression == PDFSettings::CompressJpeg;
 	m_builder("spin:pdfoptions.quality").as<Gtk::Widget>()->set_sensitive(jpegCompression);
 	m_builder("label:pdfoptions.quality").as<Gtk::Widget>()->set_sensitive(jpegCompression);
+	m_builder("spin:pdfoptions.ziplevel").as<Gtk::Widget>()->set_sensitive(compression == PDFSettings::CompressZip);
+	m_builder("label:pdfoptions.ziplevel").as<Gtk::Widget>()->set_sensitive(compression == PDFSettings::CompressZip);
+	m_builder("checkbox:pdfoptions.fax4strips").as<Gtk::Widget>()->set_sensitive(compression == PDFSettings::CompressFax4);
 }
 
 OutputEditorHOCR::ReadSessionData* OutputEditorHOCR::initRead(tesseract::TessBaseAPI &tess) {
@@ -539,8 +986,12 @@ OutputEditorHOCR::ReadSessionData* OutputEditorHOCR::initRead(tesseract::TessBas
 void OutputEditorHOCR::read(tesseract::TessBaseAPI &tess, ReadSessionData *data) {
 	tess.SetVariable("hocr_font_info", "true");
 	char* text = tess.GetHOCRText(data->page);
-	Utils::runInMainThreadBlocking([&] { addPage(text, *data); });
+	HOCRPage* page = parsePage(text, *data);
 	delete[] text;
+	if(page) {
+		HOCRDocument::preparePage(page, m_document.nextPageId(), true);
+		queuePage(page);
+	}
 }
 
 void OutputEditorHOCR::readError(const Glib::ustring &errorMsg, ReadSessionData *data) {
@@ -556,122 +1007,95 @@ void OutputEditorHOCR::finalizeRead(ReadSessionData *data) {
 	OutputEditor::finalizeRead(data);
 }
 
-void OutputEditorHOCR::addPage(const Glib::ustring& hocrText, ReadSessionData data) {
-	xmlpp::DomParser parser;
-	parser.parse_memory(hocrText);
-	xmlpp::Document* doc = parser.get_document();
-	if(!doc || !doc->get_root_node())
-		return;
-	xmlpp::Element* pageDiv = dynamic_cast<xmlpp::Element*>(doc->get_root_node());
-	if(!pageDiv || pageDiv->get_name() != "div")
-		return;
+HOCRPage* OutputEditorHOCR::parsePage(const Glib::ustring& hocrText, const ReadSessionData& data) {
+	HOCRPage* page = nullptr;
+	try {
+		xmlpp::TextReader reader(reinterpret_cast<const unsigned char*>(hocrText.data()), hocrText.bytes());
+		while(reader.read() && reader.get_node_type() != xmlpp::TextReader::Element);
+		if(reader.get_node_type() != xmlpp::TextReader::Element || reader.get_local_name() != "div" || reader.get_attribute("class") != "ocr_page") {
+			return nullptr;
+		}
+		page = static_cast<HOCRPage*>(parseItem(reader));
+	} catch(const xmlpp::exception&) {
+		return nullptr;
+	}
+	HOCRItem::BBox bbox = page->bbox();
+	if(data.imageWidth > 0 && data.imageHeight > 0) {
+		bbox = HOCRItem::BBox(0, 0, data.imageWidth, data.imageHeight);
+	}
+	Glib::ustring pageTitle = Glib::ustring::compose("image '%1'; bbox %2; pageno %3; rot %4; res %5",
+	                          data.file, bbox.toString(), data.page, data.angle, data.resolution);
+	page->setAttribute("title", pageTitle);
+	page->setLabel(Glib::ustring::compose("%1 [%2]", Gio::File::create_for_path(data.file)->get_basename(), data.page));
+	return page;
+}
 
-	Glib::MatchInfo matchInfo;
-	Glib::ustring titleAttr = getAttribute(pageDiv, "title");
-	s_bboxRx->match(titleAttr, matchInfo);
-	int x1 = std::atoi(matchInfo.fetch(1).c_str());
-	int y1 = std::atoi(matchInfo.fetch(2).c_str());
-	int x2 = std::atoi(matchInfo.fetch(3).c_str());
-	int y2 = std::atoi(matchInfo.fetch(4).c_str());
-	Glib::ustring pageTitle = Glib::ustring::compose("image '%1'; bbox %2 %3 %4 %5; pageno %6; rot %7; res %8",
-	                          data.file, x1, y1, x2, y2, data.page, data.angle, data.resolution);
-	pageDiv->set_attribute("title", pageTitle);
-	addPage(pageDiv, Gio::File::create_for_path(data.file)->get_basename(), data.page, true);
+void OutputEditorHOCR::queuePage(HOCRPage* page) {
+	Glib::Threads::Mutex::Lock locker(m_queuedPagesMutex);
+	m_queuedPages.push_back(page);
+	// Pages queued before the idle handler runs are added along
+	if(m_queuedPages.size() == 1) {
+		m_connectionAddQueuedPages = Glib::signal_idle().connect([this] { addQueuedPages(); return false; });
+	}
 }
 
-void OutputEditorHOCR::addPage(xmlpp::Element* pageDiv, const Glib::ustring& filename, int page, bool cleanGraphics) {
-	m_connectionItemViewRowEdited.block(true);
-	pageDiv->set_attribute("id", Glib::ustring::compose("page_%1", ++m_idCounter));
-
-	Glib::MatchInfo matchInfo;
-	Glib::ustring titleAttr = getAttribute(pageDiv, "title");
-	s_bboxRx->match(titleAttr, matchInfo);
-	int x1 = std::atoi(matchInfo.fetch(1).c_str());
-	int y1 = std::atoi(matchInfo.fetch(2).c_str());
-	int x2 = std::atoi(matchInfo.fetch(3).c_str());
-	int y2 = std::atoi(matchInfo.fetch(4).c_str());
-
-	Gtk::TreeIter pageItem = m_itemStore->append(m_itemStore->get_iter(m_rootItem)->children());
-	pageItem->set_value(m_itemStoreCols.text, Glib::ustring::compose("%1 [%2]", filename, page));
-	pageItem->set_value(m_itemStoreCols.id, getAttribute(pageDiv, "id"));
-	pageItem->set_value(m_itemStoreCols.bbox, Geometry::Rectangle(x1, y1, x2-x1, y2-y1));
-	pageItem->set_value(m_itemStoreCols.itemClass, Glib::ustring("ocr_page"));
-#if GTKMM_CHECK_VERSION(3,12,0)
-	pageItem->set_value(m_itemStoreCols.icon, Gdk::Pixbuf::create_from_resource("/org/gnome/gimagereader/item_page.png"));
-#else
-	pageItem->set_value(m_itemStoreCols.icon, Glib::wrap(gdk_pixbuf_new_from_resource("/org/gnome/gimagereader/item_page.png", 0)));
-#endif
-	pageItem->set_value(m_itemStoreCols.selected, true);
-	pageItem->set_value(m_itemStoreCols.editable, false);
-	pageItem->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
-	pageItem->set_value(m_itemStoreCols.checkboxVisible, true);
-	pageItem->set_value(m_itemStoreCols.iconVisible, true);
-
-	std::map<Glib::ustring,Glib::ustring> langCache;
-
-	std::vector<std::pair<xmlpp::Element*,Geometry::Rectangle>> graphicElements;
-	xmlpp::Element* element = getFirstChildElement(pageDiv, "div");
-	while(element) {
-		// Boxes without text are images
-		titleAttr = getAttribute(element, "title");
-		if(!addChildItems(getFirstChildElement(element), pageItem, langCache) && s_bboxRx->match(titleAttr, matchInfo)) {
-			x1 = std::atoi(matchInfo.fetch(1).c_str());
-			y1 = std::atoi(matchInfo.fetch(2).c_str());
-			x2 = std::atoi(matchInfo.fetch(3).c_str());
-			y2 = std::atoi(matchInfo.fetch(4).c_str());
-			graphicElements.push_back(std::make_pair(element, Geometry::Rectangle(x1, y1, x2-x1, y2-y1)));
-		}
-		element = getNextSiblingElement(element);
-	}
-
-	// Discard graphic elements which intersect with text block or which are too small
-	int numTextBlocks = pageItem->children().size();
-	for(const std::pair<xmlpp::Element*,Geometry::Rectangle>& pair : graphicElements) {
-		xmlpp::Element* element = pair.first;
-		const Geometry::Rectangle& bbox = pair.second;
-		bool deleteGraphic = false;
-		if(cleanGraphics) {
-			if(bbox.width < 10 || bbox.height < 10) {
-				deleteGraphic = true;
-			} else {
-				for(int i = 0; i < numTextBlocks; ++i) {
-					if(bbox.overlaps((*pageItem->children()[i])[m_itemStoreCols.bbox])) {
-						deleteGraphic = true;
-						break;
-					}
-				}
-			}
-		}
-		if(!deleteGraphic) {
-			Gtk::TreeIter item = m_itemStore->append(pageItem->children());
-			item->set_value(m_itemStoreCols.text, Glib::ustring(_("Graphic")));
-			item->set_value(m_itemStoreCols.selected, true);
-			item->set_value(m_itemStoreCols.editable, false);
-#if GTKMM_CHECK_VERSION(3,12,0)
-			item->set_value(m_itemStoreCols.icon, Gdk::Pixbuf::create_from_resource("/org/gnome/gimagereader/item_halftone.png"));
-#else
-			item->set_value(m_itemStoreCols.icon, Glib::wrap(gdk_pixbuf_new_from_resource("/org/gnome/gimagereader/item_halftone.png", 0)));
-#endif
-			item->set_value(m_itemStoreCols.id, getAttribute(element, "id"));
-			item->set_value(m_itemStoreCols.itemClass, Glib::ustring("ocr_graphic"));
-			item->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
-			item->set_value(m_itemStoreCols.bbox, Geometry::Rectangle(x1, y1, x2-x1, y2-y1));
-			item->set_value(m_itemStoreCols.checkboxVisible, true);
-			item->set_value(m_itemStoreCols.iconVisible, true);
-		} else {
-			element->get_parent()->remove_child(element);
-		}
+void OutputEditorHOCR::addQueuedPages() {
+	std::vector<HOCRPage*> pages;
+	{
+		Glib::Threads::Mutex::Lock locker(m_queuedPagesMutex);
+		pages.swap(m_queuedPages);
 	}
-	pageItem->set_value(m_itemStoreCols.source, getElementXML(pageDiv));
-	m_itemView->expand_to_path(Gtk::TreePath(pageItem));
-	m_itemView->expand_row(Gtk::TreePath(pageItem), true);
+	if(pages.empty()) {
+		return;
+	}
+	// The tree items are added by itemInserted
+	for(HOCRPage* page : pages) {
+		m_document.addPreparedPage(page);
+	}
+	for(HOCRPage* page : pages) {
+		m_itemView->expand_to_path(m_itemStore->get_path(findTreeItem(page)));
+	}
+
 	MAIN->setOutputPaneVisible(true);
 	m_modified = true;
-	m_connectionItemViewRowEdited.block(false);
 	m_builder("button:hocr.save")->set_sensitive(true);
 	m_builder("button:hocr.export")->set_sensitive(true);
 }
 
+std::string OutputEditorHOCR::journalDirectory() {
+	std::string cacheDir = Glib::build_filename(Glib::get_user_cache_dir(), PACKAGE_NAME);
+	g_mkdir_with_parents(cacheDir.c_str(), 0700);
+	return cacheDir;
+}
+
+std::string OutputEditorHOCR::journalFilename(int pid) {
+	return Glib::build_filename(journalDirectory(), Glib::ustring::compose("hocr-journal-%1", pid));
+}
+
+bool OutputEditorHOCR::recoverJournal(const std::vector<HOCRJournal::Record>& records) {
+	// The replayed records are journaled anew
+	bool success = m_document.replay(records, [](const std::string& html) -> HOCRPage* {
+		try {
+			xmlpp::TextReader reader(reinterpret_cast<const unsigned char*>(html.data()), html.size());
+			while(reader.read() && reader.get_node_type() != xmlpp::TextReader::Element);
+			if(reader.get_node_type() != xmlpp::TextReader::Element || reader.get_attribute("class") != "ocr_page") {
+				return nullptr;
+			}
+			return static_cast<HOCRPage*>(parseItem(reader));
+		} catch(const xmlpp::exception&) {
+			return nullptr;
+		}
+	});
+	if(m_document.pageCount() > 0) {
+		m_itemView->expand_row(m_rootItem, false);
+		MAIN->setOutputPaneVisible(true);
+		m_modified = true;
+		m_builder("button:hocr.save")->set_sensitive(true);
+		m_builder("button:hocr.export")->set_sensitive(true);
+	}
+	return success;
+}
+
 Gtk::TreeIter OutputEditorHOCR::currentItem() {
 	std::vector<Gtk::TreePath> items = m_itemView->get_selection()->get_selected_rows();
 	if(!items.empty()) {
@@ -680,91 +1104,158 @@ Gtk::TreeIter OutputEditorHOCR::currentItem() {
 	return Gtk::TreeIter();
 }
 
-bool OutputEditorHOCR::addChildItems(xmlpp::Element* element, Gtk::TreeIter parentItem, std::map<Glib::ustring,Glib::ustring>& langCache) {
-	bool haveWord = false;
-	while(element) {
-		xmlpp::Element* nextElement = getNextSiblingElement(element);
-		Glib::MatchInfo matchInfo;
-		Glib::ustring idAttr = getAttribute(element, "id");
-		if(s_idRx->match(idAttr, matchInfo)) {
-			Glib::ustring newId = Glib::ustring::compose("%1_%2_%3", matchInfo.fetch(1), m_idCounter, matchInfo.fetch(2));
-			element->set_attribute("id", newId);
-		}
-		Glib::ustring titleAttr = getAttribute(element, "title");
-		if(s_bboxRx->match(titleAttr, matchInfo)) {
-			Glib::ustring type = getAttribute(element, "class");
-			Glib::ustring icon;
-			Glib::ustring title;
-			int x1 = std::atoi(matchInfo.fetch(1).c_str());
-			int y1 = std::atoi(matchInfo.fetch(2).c_str());
-			int x2 = std::atoi(matchInfo.fetch(3).c_str());
-			int y2 = std::atoi(matchInfo.fetch(4).c_str());
-			if(type == "ocr_par") {
-				title = _("Paragraph");
-				icon = "par";
-			} else if(type == "ocr_line") {
-				title = _("Textline");
-				icon = "line";
-			} else if(type == "ocrx_word") {
-				title = getElementText(element);
-				icon = "word";
-			}
-			if(title != "") {
-				Gtk::TreeIter item = m_itemStore->append(parentItem->children());
-				if(type == "ocrx_word" || addChildItems(getFirstChildElement(element), item, langCache)) {
-					item->set_value(m_itemStoreCols.selected, true);
-					item->set_value(m_itemStoreCols.id, getAttribute(element, "id"));
-					if(!icon.empty()) {
+HOCRItem* OutputEditorHOCR::itemForTreeItem(const Gtk::TreeIter& item) const {
+	return item ? m_document.itemById(Glib::ustring((*item)[m_itemStoreCols.id])) : nullptr;
+}
+
+Gtk::TreeIter OutputEditorHOCR::findTreeItem(const HOCRItem* item) {
+	if(!isDisplayed(item)) {
+		return Gtk::TreeIter();
+	}
+	Gtk::TreeIter parentItem;
+	int row;
+	if(item->isPage()) {
+		const std::vector<HOCRPage*>& pages = m_document.pages();
+		row = std::find(pages.begin(), pages.end(), item) - pages.begin();
+		if(row == int(pages.size())) {
+			return Gtk::TreeIter();
+		}
+		parentItem = m_itemStore->get_iter(m_rootItem);
+	} else {
+		HOCRItem* parent = displayParent(item);
+		parentItem = parent ? findTreeItem(parent) : Gtk::TreeIter();
+		if(!parentItem || !isPopulated(parentItem)) {
+			return Gtk::TreeIter();
+		}
+		row = displayRowAt(item->parent(), item->index());
+	}
+	return parentItem->children()[row];
+}
+
+bool OutputEditorHOCR::isPopulated(const Gtk::TreeIter& item) const {
+	// Unpopulated items hold a placeholder without id
+	return item->children().empty() || !Glib::ustring((*item->children().begin())[m_itemStoreCols.id]).empty();
+}
+
+void OutputEditorHOCR::addTreeItems(const HOCRItem* item, const Gtk::TreeIter& parentItem, int& row) {
+	Glib::ustring title;
+	Glib::ustring icon;
+	Glib::ustring itemClass = item->itemClass();
+	if(item->isPage()) {
+		title = static_cast<const HOCRPage*>(item)->label();
+		icon = "page";
+	} else if(item->isGraphic()) {
+		title = _("Graphic");
+		icon = "halftone";
+		itemClass = "ocr_graphic";
+	} else if(item->itemClass() == "ocr_carea") {
+		// Text blocks are not shown, their paragraphs are listed directly below the page
+		for(const HOCRItem* child : item->children()) {
+			addTreeItems(child, parentItem, row);
+		}
+		return;
+	} else if(item->isParagraph()) {
+		title = _("Paragraph");
+		icon = "par";
+	} else if(item->isLine()) {
+		title = _("Textline");
+		icon = "line";
+	} else if(item->isWord()) {
+		title = item->text();
+		icon = "word";
+	} else {
+		return;
+	}
+	Gtk::TreeNodeChildren siblings = parentItem->children();
+	Gtk::TreeIter treeItem = row < int(siblings.size()) ? m_itemStore->insert(siblings[row]) : m_itemStore->append(siblings);
+	++row;
+	treeItem->set_value(m_itemStoreCols.selected, item->isEnabled());
+	treeItem->set_value(m_itemStoreCols.id, Glib::ustring(item->id()));
 #if GTKMM_CHECK_VERSION(3,12,0)
-						item->set_value(m_itemStoreCols.icon, Gdk::Pixbuf::create_from_resource(Glib::ustring::compose("/org/gnome/gimagereader/item_%1.png", icon)));
+	treeItem->set_value(m_itemStoreCols.icon, Gdk::Pixbuf::create_from_resource(Glib::ustring::compose("/org/gnome/gimagereader/item_%1.png", icon)));
 #else
-						item->set_value(m_itemStoreCols.icon, Glib::wrap(gdk_pixbuf_new_from_resource(Glib::ustring::compose("/org/gnome/gimagereader/item_%1.png", icon).c_str(), 0)));
+	treeItem->set_value(m_itemStoreCols.icon, Glib::wrap(gdk_pixbuf_new_from_resource(Glib::ustring::compose("/org/gnome/gimagereader/item_%1.png", icon).c_str(), 0)));
 #endif
-					}
-					item->set_value(m_itemStoreCols.bbox, Geometry::Rectangle(x1, y1, x2 - x1, y2 - y1));
-					item->set_value(m_itemStoreCols.itemClass, type);
-					item->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
-					item->set_value(m_itemStoreCols.editable, type == "ocrx_word");
-					haveWord = true;
-					if(type == "ocr_line") {
-						if(s_baseLineRx->match(titleAttr, matchInfo)) {
-							item->set_value(m_itemStoreCols.baseLine, std::atoi(matchInfo.fetch(2).c_str()));
-						}
-					} else if(type == "ocrx_word") {
-						// Ensure correct hyphen char is used on last word of line
-						if(!nextElement) {
-							title = Glib::Regex::create("[-\u2014]\\s*$")->replace(title, 0, "-", static_cast<Glib::RegexMatchFlags>(0));
-							element->remove_child(element->get_first_child());
-							element->add_child_text(title);
-						}
-
-						if(s_fontSizeRx->match(titleAttr, matchInfo)) {
-							item->set_value(m_itemStoreCols.fontSize, std::atof(matchInfo.fetch(1).c_str()));
-						}
-						Glib::ustring lang = getAttribute(element, "lang");
-						auto it = langCache.find(lang);
-						if(it == langCache.end()) {
-							it = langCache.insert(std::make_pair(lang, Utils::getSpellingLanguage(lang))).first;
-						}
-						Glib::ustring spellingLang = it->second;
-						if(m_spell.get_language() != spellingLang) {
-							m_spell.set_language(spellingLang);
-						}
-						if(!m_spell.check_word(trimWord(title))) {
-							item->set_value(m_itemStoreCols.textColor, Glib::ustring("#F00"));
-						}
-					}
-					item->set_value(m_itemStoreCols.text, title);
-					item->set_value(m_itemStoreCols.checkboxVisible, true);
-					item->set_value(m_itemStoreCols.iconVisible, true);
-				} else {
-					m_itemStore->erase(item);
-				}
-			}
+	treeItem->set_value(m_itemStoreCols.itemClass, itemClass);
+	treeItem->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
+	treeItem->set_value(m_itemStoreCols.editable, item->isWord());
+	treeItem->set_value(m_itemStoreCols.text, title);
+	treeItem->set_value(m_itemStoreCols.checkboxVisible, true);
+	treeItem->set_value(m_itemStoreCols.iconVisible, true);
+	if(item->isWord()) {
+		updateSpellingColor(treeItem, item);
+	} else if(item->childCount() > 0) {
+		// The children are added when the item is first expanded, until then a placeholder provides the expander
+		Gtk::TreeIter placeholder = m_itemStore->append(treeItem->children());
+		placeholder->set_value(m_itemStoreCols.checkboxVisible, false);
+		placeholder->set_value(m_itemStoreCols.iconVisible, false);
+	}
+}
+
+void OutputEditorHOCR::populateItem(const Gtk::TreeIter& item) {
+	if(isPopulated(item)) {
+		return;
+	}
+	HOCRItem* element = itemForTreeItem(item);
+	m_connectionItemViewRowEdited.block(true);
+	m_itemStore->erase(item->children().begin());
+	if(element) {
+		int row = 0;
+		for(const HOCRItem* child : element->children()) {
+			addTreeItems(child, item, row);
+		}
+	}
+	m_connectionItemViewRowEdited.block(false);
+}
+
+Glib::ustring OutputEditorHOCR::spellingLanguage(const HOCRItem* item) {
+	Glib::ustring lang = item->attribute("lang");
+	auto it = m_spellingLangCache.find(lang);
+	if(it == m_spellingLangCache.end()) {
+		it = m_spellingLangCache.insert(std::make_pair(lang, Utils::getSpellingLanguage(lang))).first;
+	}
+	return it->second;
+}
+
+void OutputEditorHOCR::updateSpellingColor(const Gtk::TreeIter& item, const HOCRItem* element) {
+	HOCRSpellChecker::Verdict verdict = m_spellChecker.check(spellingLanguage(element), trimWord((*item)[m_itemStoreCols.text]));
+	if(verdict == HOCRSpellChecker::Verdict::Pending) {
+		// Colored once the verdict arrives, see updatePendingSpellingColors
+		m_pendingSpellingItems.push_back(Gtk::TreeRowReference(m_itemStore, m_itemStore->get_path(item)));
+	} else {
+		item->set_value(m_itemStoreCols.textColor, Glib::ustring(verdict == HOCRSpellChecker::Verdict::Misspelled ? "#F00" : "#000"));
+	}
+}
+
+void OutputEditorHOCR::updatePendingSpellingColors() {
+	std::vector<Gtk::TreeRowReference> pendingItems;
+	pendingItems.swap(m_pendingSpellingItems);
+	m_connectionItemViewRowEdited.block(true);
+	for(const Gtk::TreeRowReference& ref : pendingItems) {
+		if(!ref.is_valid()) {
+			continue;
+		}
+		Gtk::TreeIter item = m_itemStore->get_iter(ref.get_path());
+		HOCRItem* element = itemForTreeItem(item);
+		if(element) {
+			updateSpellingColor(item, element);
+		}
+	}
+	m_connectionItemViewRowEdited.block(false);
+}
+
+void OutputEditorHOCR::journalFailed() {
+	Utils::message_dialog(Gtk::MESSAGE_WARNING, _("Journal error"), Glib::ustring::compose(_("The hOCR output can no longer be recorded in the journal %1: %2.\nUnsaved work will be lost if the application crashes."), m_journal.filename(), m_journal.error()));
+}
+
+void OutputEditorHOCR::expandChildren(const Gtk::TreeIter& item) {
+	// Rows are only populated when they are expanded, so expand one level at a time
+	if(!item->children().empty()) {
+		m_itemView->expand_row(m_itemStore->get_path(item), false);
+		for(Gtk::TreeIter child : item->children()) {
+			expandChildren(child);
 		}
-		element = nextElement;
 	}
-	return haveWord;
 }
 
 void OutputEditorHOCR::showItemProperties(Gtk::TreeIter item) {
@@ -776,79 +1267,53 @@ void OutputEditorHOCR::showItemProperties(Gtk::TreeIter item) {
 	m_currentPageItem = Gtk::TreePath();
 	m_currentItem = Gtk::TreePath();
 	m_currentElement = nullptr;
-	delete m_currentParser;
-	m_currentParser = nullptr;
 	Gtk::TreeIter rootIter = m_itemStore->get_iter(m_rootItem);
 	if(!item || item == rootIter) {
 		return;
 	}
+	m_currentElement = itemForTreeItem(item);
+	if(!m_currentElement) {
+		return;
+	}
 	m_currentItem = m_itemStore->get_path(item);
 	Gtk::TreeIter parentItem = item;
 	while(parentItem->parent() != rootIter) {
 		parentItem = parentItem->parent();
 	}
 	m_currentPageItem = m_itemStore->get_path(parentItem);
-	Glib::ustring id = (*item)[m_itemStoreCols.id];
-	m_currentParser = new xmlpp::DomParser();
-	m_currentParser->parse_memory((*parentItem)[m_itemStoreCols.source]);
-	xmlpp::Document* doc = m_currentParser->get_document();
-	if(doc->get_root_node()) {
-		xmlpp::NodeSet nodes = doc->get_root_node()->find(Glib::ustring::compose("//*[@id='%1']", id));
-		m_currentElement = nodes.empty() ? nullptr : dynamic_cast<xmlpp::Element*>(nodes.front());
-	}
-	if(!m_currentElement) {
-		delete m_currentParser;
-		m_currentParser = nullptr;
-		m_currentPageItem = Gtk::TreePath();
-		m_currentItem = Gtk::TreePath();
-	}
 
 	m_connectionPropViewRowEdited.block(true);
-	for(xmlpp::Attribute* attrib : m_currentElement->get_attributes()) {
-		if(attrib->get_name() == "title") {
-			for(Glib::ustring attr : Utils::string_split(attrib->get_value(), ';')) {
-				attr = Utils::string_trim(attr);
-				std::size_t splitPos = attr.find(" ");
-				Gtk::TreeIter item = m_propStore->append();
-				item->set_value(m_propStoreCols.parentAttr, Glib::ustring("title"));
-				item->set_value(m_propStoreCols.name, Utils::string_trim(attr.substr(0, splitPos)));
-				item->set_value(m_propStoreCols.value, Utils::string_trim(attr.substr(splitPos + 1)));
+	for(const auto& attrib : m_currentElement->attributes()) {
+		if(attrib.first == "title") {
+			for(const auto& prop : m_currentElement->titleProperties()) {
+				Gtk::TreeIter propItem = m_propStore->append();
+				propItem->set_value(m_propStoreCols.parentAttr, Glib::ustring("title"));
+				propItem->set_value(m_propStoreCols.name, Glib::ustring(prop.first));
+				propItem->set_value(m_propStoreCols.value, Glib::ustring(prop.second));
 			}
 		} else {
-			Gtk::TreeIter item = m_propStore->append();
-			item->set_value(m_propStoreCols.name, attrib->get_name());
-			item->set_value(m_propStoreCols.value, attrib->get_value());
+			Gtk::TreeIter propItem = m_propStore->append();
+			propItem->set_value(m_propStoreCols.name, Glib::ustring(attrib.first));
+			propItem->set_value(m_propStoreCols.value, Glib::ustring(attrib.second));
 		}
 	}
 	m_connectionPropViewRowEdited.block(false);
-	m_sourceView->get_buffer()->set_text(getElementXML(m_currentElement));
-
-	Glib::MatchInfo matchInfo;
-	xmlpp::Element* pageElement = dynamic_cast<xmlpp::Element*>(m_currentParser->get_document()->get_root_node());
-	Glib::ustring titleAttr = getAttribute(m_currentElement, "title");
-	if(pageElement && pageElement->get_name() == "div" && setCurrentSource(pageElement) && s_bboxRx->match(titleAttr, matchInfo)) {
-		int x1 = std::atoi(matchInfo.fetch(1).c_str());
-		int y1 = std::atoi(matchInfo.fetch(2).c_str());
-		int x2 = std::atoi(matchInfo.fetch(3).c_str());
-		int y2 = std::atoi(matchInfo.fetch(4).c_str());
-		m_tool->setSelection(Geometry::Rectangle(x1, y1, x2-x1, y2-y1));
-	}
-}
-
-bool OutputEditorHOCR::setCurrentSource(xmlpp::Element* pageElement, int* pageDpi, int* overrideDpi) const {
-	Glib::MatchInfo matchInfo;
-	Glib::ustring titleAttr = getAttribute(pageElement, "title");
-	if(s_pageTitleRx->match(titleAttr, matchInfo)) {
-		Glib::ustring filename = matchInfo.fetch(1);
-		int page = std::atoi(matchInfo.fetch(2).c_str());
-		double angle = std::atof(matchInfo.fetch(3).c_str());
-		int res = std::atoi(matchInfo.fetch(4).c_str());
+	m_sourceView->get_buffer()->set_text(m_currentElement->toHtml(1));
+
+	if(setCurrentSource(m_currentElement->page())) {
+		m_tool->setSelection(toRectangle(m_currentElement->bbox()));
+	}
+}
+
+bool OutputEditorHOCR::setCurrentSource(const HOCRPage* page, int* pageDpi) const {
+	if(page && !page->sourceFile().empty()) {
+		std::string filename = page->sourceFile();
+		int pageNr = page->pageNr();
+		double angle = page->angle();
+		int res = page->resolution();
 		if(pageDpi) {
 			*pageDpi = res;
 		}
-		if(overrideDpi) {
-			res = *overrideDpi;
-		}
 
 		MAIN->getSourceManager()->addSources({Gio::File::create_for_path(filename)});
 		while(Gtk::Main::events_pending()) {
@@ -859,8 +1324,8 @@ bool OutputEditorHOCR::setCurrentSource(xmlpp::Element* pageElement, int* pageDp
 		if(MAIN->getDisplayer()->getCurrentImage(dummy) != filename) {
 			return false;
 		}
-		if(MAIN->getDisplayer()->getCurrentPage() != page) {
-			MAIN->getDisplayer()->setCurrentPage(page);
+		if(MAIN->getDisplayer()->getCurrentPage() != pageNr) {
+			MAIN->getDisplayer()->setCurrentPage(pageNr);
 		}
 		if(MAIN->getDisplayer()->getCurrentAngle() != angle) {
 			MAIN->getDisplayer()->setAngle(angle);
@@ -874,12 +1339,18 @@ bool OutputEditorHOCR::setCurrentSource(xmlpp::Element* pageElement, int* pageDp
 }
 
 void OutputEditorHOCR::itemChanged(const Gtk::TreeIter& iter) {
-	if(m_itemStore->get_path(iter) != m_currentItem) {
+	bool isCurrent = m_itemStore->get_path(iter) == m_currentItem;
+	HOCRItem* element = isCurrent ? m_currentElement : itemForTreeItem(iter);
+	bool selected = (*iter)[m_itemStoreCols.selected];
+	// Rows also change when their text or spelling color is updated
+	if(element && selected != element->isEnabled()) {
+		m_document.setItemEnabled(element, selected);
+	}
+	if(!isCurrent) {
 		return;
 	}
 	m_connectionItemViewRowEdited.block(true);
 	bool isWord = (*iter)[m_itemStoreCols.itemClass] == "ocrx_word";
-	bool selected = (*iter)[m_itemStoreCols.selected];
 	if( isWord && selected) {
 		// Update text
 		updateCurrentItemText();
@@ -901,31 +1372,25 @@ void OutputEditorHOCR::propertyCellChanged(const Gtk::TreeIter &iter) {
 }
 
 void OutputEditorHOCR::updateCurrentItemText() {
-	if(m_currentItem) {
+	if(m_currentItem && m_currentElement) {
 		Gtk::TreeIter item = m_itemStore->get_iter(m_currentItem);
 		Glib::ustring newText = (*item)[m_itemStoreCols.text];
-		m_currentElement->remove_child(m_currentElement->get_first_child());
-		m_currentElement->add_child_text(newText);
+		m_document.setItemText(m_currentElement, newText);
 		updateCurrentItem();
 	}
 }
 
 void OutputEditorHOCR::updateCurrentItemAttribute(const Glib::ustring& key, const Glib::ustring& subkey, const Glib::ustring& newvalue, bool update) {
-	if(m_currentItem) {
-		if(subkey.empty()) {
-			m_currentElement->set_attribute(key, newvalue);
-		} else {
-			Glib::ustring value = getAttribute(m_currentElement, key);
-			std::vector<Glib::ustring> subattrs = Utils::string_split(value, ';');
-			for(int i = 0, n = subattrs.size(); i < n; ++i) {
-				Glib::ustring attr = Utils::string_trim(subattrs[i]);
-				std::size_t splitPos = attr.find(" ");
-				if(attr.substr(0, splitPos) == subkey) {
-					subattrs[i] = subkey + " " + newvalue;
-					break;
-				}
+	if(m_currentItem && m_currentElement) {
+		if(key == "id" && subkey.empty()) {
+			// The id also keys the document index and the tree item
+			if(!m_document.setItemId(m_currentElement, newvalue)) {
+				return;
 			}
-			m_currentElement->set_attribute(key, Utils::string_join(subattrs, ";"));
+		} else if(subkey.empty()) {
+			m_document.setItemAttribute(m_currentElement, key, newvalue);
+		} else {
+			m_document.setItemTitleProperty(m_currentElement, subkey, newvalue);
 		}
 		if(update) {
 			updateCurrentItem();
@@ -934,12 +1399,9 @@ void OutputEditorHOCR::updateCurrentItemAttribute(const Glib::ustring& key, cons
 }
 
 void OutputEditorHOCR::updateCurrentItemBBox(const Geometry::Rectangle &rect) {
-	if(m_currentItem) {
-		Gtk::TreeIter item = m_itemStore->get_iter(m_currentItem);
-		m_connectionItemViewRowEdited.block(true);
-		item->set_value(m_itemStoreCols.bbox, rect);
-		m_connectionItemViewRowEdited.block(false);
-		Glib::ustring bboxstr = Glib::ustring::compose("%1 %2 %3 %4", rect.x, rect.y, rect.x + rect.width, rect.y + rect.height);
+	if(m_currentItem && m_currentElement) {
+		HOCRItem::BBox bbox(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height);
+		Glib::ustring bboxstr = bbox.toString();
 		for(Gtk::TreeIter it : m_propStore->children()) {
 			if((*it)[m_propStoreCols.name] == "bbox" and (*it)[m_propStoreCols.parentAttr] == "title") {
 				m_connectionPropViewRowEdited.block(true);
@@ -948,164 +1410,264 @@ void OutputEditorHOCR::updateCurrentItemBBox(const Geometry::Rectangle &rect) {
 				break;
 			}
 		}
-		updateCurrentItemAttribute("title", "bbox", bboxstr, false);
-		Gtk::TreeIter toplevelItem = m_itemStore->get_iter(m_currentPageItem);
-		toplevelItem->set_value(m_itemStoreCols.source, getDocumentXML(m_currentParser->get_document()));
-
-		m_sourceView->get_buffer()->set_text(getElementXML(m_currentElement));
+		m_document.setItemBBox(m_currentElement, bbox);
+		m_sourceView->get_buffer()->set_text(m_currentElement->toHtml(1));
+		m_modified = true;
 	}
 }
 
 void OutputEditorHOCR::updateCurrentItem() {
-	Gtk::TreeIter item = m_itemStore->get_iter(m_currentItem);
-	Glib::ustring spellLang = Utils::getSpellingLanguage(getAttribute(m_currentElement, "lang"));
-	if(m_spell.get_language() != spellLang) {
-		m_spell.set_language(spellLang);
-	}
-	m_connectionItemViewRowEdited.block(true); // prevent row edited signal
-	if(m_spell.check_word(trimWord((*item)[m_itemStoreCols.text]))) {
-		item->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
-	} else {
-		item->set_value(m_itemStoreCols.textColor, Glib::ustring("#F00"));
-	}
-	m_connectionItemViewRowEdited.block(false);
-
-	Gtk::TreeIter toplevelItem = m_itemStore->get_iter(m_currentPageItem);
-	toplevelItem->set_value(m_itemStoreCols.source, getDocumentXML(m_currentParser->get_document()));
+	// The tree item is updated by itemChanged
+	m_sourceView->get_buffer()->set_text(m_currentElement->toHtml(1));
 
-	m_sourceView->get_buffer()->set_text(getElementXML(m_currentElement));
-
-	Glib::MatchInfo matchInfo;
-	xmlpp::Element* pageElement = dynamic_cast<xmlpp::Element*>(m_currentParser->get_document()->get_root_node());
-	Glib::ustring titleAttr = getAttribute(m_currentElement, "title");
-	if(pageElement && pageElement->get_name() == "div" && setCurrentSource(pageElement) && s_bboxRx->match(titleAttr, matchInfo)) {
-		int x1 = std::atoi(matchInfo.fetch(1).c_str());
-		int y1 = std::atoi(matchInfo.fetch(2).c_str());
-		int x2 = std::atoi(matchInfo.fetch(3).c_str());
-		int y2 = std::atoi(matchInfo.fetch(4).c_str());
-		m_tool->setSelection(Geometry::Rectangle(x1, y1, x2-x1, y2-y1));
+	if(setCurrentSource(m_currentElement->page())) {
+		m_tool->setSelection(toRectangle(m_currentElement->bbox()));
 	}
 
 	m_modified = true;
 }
 
 void OutputEditorHOCR::removeCurrentItem() {
-	if(m_currentItem) {
-		g_assert_nonnull(m_currentElement);
-		m_currentElement->get_parent()->remove_child(m_currentElement);
-		Gtk::TreeIter toplevelItem = m_itemStore->get_iter(m_currentPageItem);
-		toplevelItem->set_value(m_itemStoreCols.source, getDocumentXML(m_currentParser->get_document()));
-
-		m_itemStore->erase(m_itemStore->get_iter(m_currentItem));
+	if(m_currentItem && m_currentElement) {
+		HOCRItem* element = m_currentElement;
+		m_currentElement = nullptr;
+		// The tree items are removed by itemAboutToBeRemoved
+		m_document.removeItem(element);
+		m_modified = true;
 		// m_currentItem updated by m_itemView->get_selection()->signal_changed()
 	}
 }
 
 void OutputEditorHOCR::addGraphicRection(const Geometry::Rectangle &rect) {
-	if(!m_currentParser) {
+	if(!m_currentPageItem) {
 		return;
 	}
-	xmlpp::Document* doc = m_currentParser->get_document();
-	xmlpp::Element* pageDiv = dynamic_cast<xmlpp::Element*>(doc ? doc->get_root_node() : nullptr);
-	if(!pageDiv || pageDiv->get_name() != "div")
-		return;
-
-	// Determine a free block id
-	int pageId = 0;
-	int blockId = 0;
-	xmlpp::Element* blockEl = getFirstChildElement(pageDiv, "div");
-	while(blockEl) {
-		Glib::MatchInfo matchInfo;
-		Glib::ustring idAttr = getAttribute(blockEl, "id");
-		if(s_idRx->match(idAttr, matchInfo)) {
-			pageId = std::max(pageId, std::atoi(matchInfo.fetch(1).c_str()) + 1);
-			blockId = std::max(blockId, std::atoi(matchInfo.fetch(2).c_str()) + 1);
-		}
-		blockEl = getNextSiblingElement(blockEl);
-	}
-
-	// Add html element
-	xmlpp::Element* graphicElement = pageDiv->add_child("div");
-	graphicElement->set_attribute("title", Glib::ustring::compose("bbox %1 %2 %3 %4", rect.x, rect.y, rect.x + rect.width, rect.y + rect.height));
-	graphicElement->set_attribute("class", "ocr_carea");
-	graphicElement->set_attribute("id", Glib::ustring::compose("block_%1_%2", pageId, blockId));
 	Gtk::TreeIter toplevelItem = m_itemStore->get_iter(m_currentPageItem);
-	toplevelItem->set_value(m_itemStoreCols.source, getDocumentXML(m_currentParser->get_document()));
+	HOCRItem* pageElement = itemForTreeItem(toplevelItem);
+	if(!pageElement || !pageElement->isPage()) {
+		return;
+	}
+	HOCRItem* graphicElement = m_document.addGraphic(static_cast<HOCRPage*>(pageElement), HOCRItem::BBox(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height));
+	m_modified = true;
 
-	// Add tree item
-	Gtk::TreeIter item = m_itemStore->append(toplevelItem->children());
-	item->set_value(m_itemStoreCols.text, Glib::ustring(_("Graphic")));
-	item->set_value(m_itemStoreCols.selected, true);
-	item->set_value(m_itemStoreCols.editable, false);
-#if GTKMM_CHECK_VERSION(3,12,0)
-	item->set_value(m_itemStoreCols.icon, Gdk::Pixbuf::create_from_resource("/org/gnome/gimagereader/item_halftone.png"));
-#else
-	item->set_value(m_itemStoreCols.icon, Glib::wrap(gdk_pixbuf_new_from_resource("/org/gnome/gimagereader/item_halftone.png", 0)));
-#endif
-	item->set_value(m_itemStoreCols.id, getAttribute(graphicElement, "id"));
-	item->set_value(m_itemStoreCols.itemClass, Glib::ustring("ocr_graphic"));
-	item->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
-	item->set_value(m_itemStoreCols.bbox, rect);
-	item->set_value(m_itemStoreCols.checkboxVisible, true);
-	item->set_value(m_itemStoreCols.iconVisible, true);
+	// Populates the page, which adds the tree item if itemInserted did not
+	m_itemView->expand_row(m_itemStore->get_path(toplevelItem), false);
+	Gtk::TreeIter item = findTreeItem(graphicElement);
+	if(!item) {
+		return;
+	}
 
 	m_itemView->get_selection()->unselect_all();
 	m_itemView->get_selection()->select(item);
 	m_itemView->scroll_to_row(m_itemStore->get_path(item));
 }
 
-Glib::ustring OutputEditorHOCR::trimWord(const Glib::ustring& word, Glib::ustring* prefix, Glib::ustring* suffix) {
-	Glib::RefPtr<Glib::Regex> re = Glib::Regex::create("^(\\W*)(.*\\w)(\\W*)$");
-	Glib::MatchInfo match_info;
-	if(re->match(word, -1, 0, match_info, static_cast<Glib::RegexMatchFlags>(0))) {
-		if(prefix)
-			*prefix = match_info.fetch(1);
-		if(suffix)
-			*suffix = match_info.fetch(3);
-		return match_info.fetch(2);
+void OutputEditorHOCR::findReplace(bool backwards, bool replace) {
+	Utils::clear_error_state(m_searchEntry);
+	std::string searchstr = m_searchEntry->get_text();
+	std::string replacestr = m_replaceEntry->get_text();
+	bool matchCase = m_csCheckBox->get_active();
+	HOCRItem* current = itemForTreeItem(currentItem());
+	if(replace && current && current->isWord() && m_document.replaceWord(current, searchstr, replacestr, matchCase)) {
+		m_modified = true;
+		showItemProperties(currentItem());
+	}
+	HOCRItem* word = m_document.findWord(searchstr, matchCase, current, backwards);
+	if(!word) {
+		Utils::set_error_state(m_searchEntry);
+		return;
 	}
-	return word;
+	selectItem(word);
 }
 
-void OutputEditorHOCR::mergeItems(const std::vector<Gtk::TreePath>& items) {
-	Gtk::TreeIter it = m_itemStore->get_iter(items.front());
-	if(!it) {
+void OutputEditorHOCR::selectItem(const HOCRItem* item) {
+	// Expand the ancestors of the item, which populates them
+	std::vector<const HOCRItem*> ancestors;
+	for(const HOCRItem* parent = displayParent(item); parent; parent = displayParent(parent)) {
+		ancestors.push_back(parent);
+	}
+	m_itemView->expand_row(m_rootItem, false);
+	for(auto it = ancestors.rbegin(), itEnd = ancestors.rend(); it != itEnd; ++it) {
+		Gtk::TreeIter parentItem = findTreeItem(*it);
+		if(!parentItem) {
+			return;
+		}
+		m_itemView->expand_row(m_itemStore->get_path(parentItem), false);
+	}
+	Gtk::TreeIter treeItem = findTreeItem(item);
+	if(!treeItem) {
 		return;
 	}
+	m_itemView->get_selection()->unselect_all();
+	m_itemView->get_selection()->select(treeItem);
+	m_itemView->scroll_to_row(m_itemStore->get_path(treeItem));
+}
 
-	Geometry::Rectangle bbox = (*it)[m_itemStoreCols.bbox];
-	Glib::ustring text = (*it)[m_itemStoreCols.text];
+void OutputEditorHOCR::pickItem(const Geometry::Point& point) {
+	// The displayed image is the one of the page of the current item
+	HOCRPage* page = m_currentElement ? m_currentElement->page() : nullptr;
+	if(!page) {
+		return;
+	}
+	// Select the innermost item below the point
+	std::vector<HOCRItem*> items = m_document.itemsAt(page, int(point.x), int(point.y));
+	for(auto it = items.rbegin(), itEnd = items.rend(); it != itEnd; ++it) {
+		if(isDisplayed(*it) && (*it)->isEnabled()) {
+			selectItem(*it);
+			return;
+		}
+	}
+}
 
-	xmlpp::Document* doc = m_currentParser->get_document();
+void OutputEditorHOCR::replaceAll() {
+	MAIN->pushState(MainWindow::State::Busy, _("Replacing..."));
+	std::string searchstr = m_searchEntry->get_text();
+	std::string replacestr = m_replaceEntry->get_text();
+	if(m_document.replaceWords(searchstr, replacestr, m_csCheckBox->get_active()) == 0) {
+		Utils::set_error_state(m_searchEntry);
+	} else {
+		m_modified = true;
+		showItemProperties(currentItem());
+	}
+	MAIN->popState();
+}
 
-	for(int i = 1, n = items.size(); i < n; ++i) {
-		it = m_itemStore->get_iter(items[i]);
-		if(it) {
-			bbox = bbox.unite((*it)[m_itemStoreCols.bbox]);
-			text += (*it)[m_itemStoreCols.text];
-			Glib::ustring id = (*it)[m_itemStoreCols.id];
-			xmlpp::NodeSet nodes = doc->get_root_node()->find(Glib::ustring::compose("//*[@id='%1']", id));
-			xmlpp::Element* element = nodes.empty() ? nullptr : dynamic_cast<xmlpp::Element*>(nodes.front());
-			element->get_parent()->remove_child(element);
+bool OutputEditorHOCR::isSearchMatch(const Gtk::TreeIter& item) const {
+	if(Glib::ustring((*item)[m_itemStoreCols.itemClass]) != "ocrx_word") {
+		return false;
+	}
+	std::string searchstr = m_searchEntry->get_text();
+	return !searchstr.empty() && HOCRDocument::matchesWord(Glib::ustring((*item)[m_itemStoreCols.text]), searchstr, m_csCheckBox->get_active());
+}
+
+void OutputEditorHOCR::undo() {
+	m_document.undo();
+	m_modified = true;
+	showItemProperties(currentItem());
+}
+
+void OutputEditorHOCR::redo() {
+	m_document.redo();
+	m_modified = true;
+	showItemProperties(currentItem());
+}
+
+void OutputEditorHOCR::itemInserted(HOCRItem* item) {
+	Gtk::TreeIter parentItem;
+	int row;
+	if(item->isPage()) {
+		parentItem = m_itemStore->get_iter(m_rootItem);
+		row = std::find(m_document.pages().begin(), m_document.pages().end(), item) - m_document.pages().begin();
+	} else {
+		HOCRItem* parent = displayParent(item);
+		parentItem = parent ? findTreeItem(parent) : Gtk::TreeIter();
+		row = displayRowAt(item->parent(), item->index());
+	}
+	// Unpopulated items pick up the new children once they are expanded
+	if(parentItem && isPopulated(parentItem)) {
+		m_connectionItemViewRowEdited.block(true);
+		addTreeItems(item, parentItem, row);
+		m_connectionItemViewRowEdited.block(false);
+		updateCurrentItemPaths();
+	}
+}
+
+void OutputEditorHOCR::itemAboutToBeRemoved(HOCRItem* item) {
+	if(item->isPage()) {
+		Gtk::TreeIter treeItem = findTreeItem(item);
+		if(treeItem) {
+			m_itemStore->erase(treeItem);
 		}
+		return;
 	}
+	HOCRItem* parent = displayParent(item);
+	Gtk::TreeIter parentItem = parent ? findTreeItem(parent) : Gtk::TreeIter();
+	if(parentItem && isPopulated(parentItem)) {
+		int row = displayRowAt(item->parent(), item->index());
+		for(int i = displayRowCount(item); i > 0; --i) {
+			m_itemStore->erase(parentItem->children()[row]);
+		}
+	}
+}
 
-	for(int i = 1, n = items.size(); i < n; ++i) {
-		it = m_itemStore->get_iter(items[n - i]);
-		if(it) {
-			m_itemStore->erase(it);
+void OutputEditorHOCR::itemRemoved(HOCRItem* /*item*/) {
+	updateCurrentItemPaths();
+}
+
+void OutputEditorHOCR::itemChanged(HOCRItem* item) {
+	Gtk::TreeIter treeItem = findTreeItem(item);
+	if(!treeItem) {
+		return;
+	}
+	m_connectionItemViewRowEdited.block(true);
+	treeItem->set_value(m_itemStoreCols.id, Glib::ustring(item->id()));
+	treeItem->set_value(m_itemStoreCols.selected, item->isEnabled());
+	if(item->isWord()) {
+		treeItem->set_value(m_itemStoreCols.text, Glib::ustring(item->text()));
+		updateSpellingColor(treeItem, item);
+	}
+	m_connectionItemViewRowEdited.block(false);
+}
+
+void OutputEditorHOCR::historyChanged() {
+	m_builder("button:hocr.undo")->set_sensitive(m_document.canUndo());
+	m_builder("button:hocr.redo")->set_sensitive(m_document.canRedo());
+	// Undoing can restore removed pages
+	m_builder("button:hocr.save")->set_sensitive(m_document.pageCount() > 0);
+	m_builder("button:hocr.export")->set_sensitive(m_document.pageCount() > 0);
+}
+
+void OutputEditorHOCR::updateCurrentItemPaths() {
+	// The paths of the current items shift as rows are inserted and removed
+	Gtk::TreeIter item = m_currentElement ? findTreeItem(m_currentElement) : Gtk::TreeIter();
+	if(!item) {
+		m_currentElement = nullptr;
+		m_currentItem = Gtk::TreePath();
+		m_currentPageItem = Gtk::TreePath();
+		return;
+	}
+	m_currentItem = m_itemStore->get_path(item);
+	m_currentPageItem = m_itemStore->get_path(findTreeItem(m_currentElement->page()));
+}
+
+Glib::ustring OutputEditorHOCR::trimWord(const Glib::ustring& word, Glib::ustring* prefix, Glib::ustring* suffix) {
+	// Strips the leading and trailing non-word characters, i.e. punctuation
+	auto isWordChar = [](gunichar c) { return g_unichar_isalnum(c) || g_unichar_ismark(c) || c == '_'; };
+	Glib::ustring::const_iterator start = word.begin(), end = word.end();
+	while(start != end && !isWordChar(*start)) {
+		++start;
+	}
+	if(start == end) {
+		return word;
+	}
+	do {
+		--end;
+	} while(!isWordChar(*end));
+	++end;
+	if(prefix)
+		*prefix = Glib::ustring(word.begin(), start);
+	if(suffix)
+		*suffix = Glib::ustring(end, word.end());
+	return Glib::ustring(start, end);
+}
+
+void OutputEditorHOCR::mergeItems(const std::vector<Gtk::TreePath>& items) {
+	std::vector<HOCRItem*> words;
+	for(const Gtk::TreePath& path : items) {
+		HOCRItem* word = itemForTreeItem(m_itemStore->get_iter(path));
+		if(!word) {
+			return;
 		}
+		words.push_back(word);
 	}
+	HOCRItem* merged = m_document.mergeWords(words);
+	m_modified = true;
 
 	m_itemView->get_selection()->unselect_all();
-	m_itemView->get_selection()->select(items.front());
-
-	it = m_itemStore->get_iter(items.front());
-	(*it)[m_itemStoreCols.text] = text;
-	(*it)[m_itemStoreCols.bbox] = bbox;
-	updateCurrentItemText();
-	updateCurrentItemAttribute("title", "bbox", Glib::ustring::compose("%1 %2 %3 %4", bbox.x, bbox.y, bbox.x + bbox.width, bbox.y + bbox.height));
-	showItemProperties(m_itemStore->get_iter(m_currentItem));
+	Gtk::TreeIter it = findTreeItem(merged);
+	if(it) {
+		m_itemView->get_selection()->select(it);
+	}
 }
 
 void OutputEditorHOCR::showContextMenu(GdkEventButton* ev) {
@@ -1167,7 +1729,19 @@ void OutputEditorHOCR::showContextMenu(GdkEventButton* ev) {
 	}
 	if(itemClass == "ocrx_word") {
 		Glib::ustring prefix, suffix, trimmed = trimWord((*it)[m_itemStoreCols.text], &prefix, &suffix);
-		for(const Glib::ustring& suggestion : m_spell.get_suggestions(trimmed)) {
+		Glib::ustring spellLang = spellingLanguage(itemForTreeItem(it));
+		std::vector<Glib::ustring> suggestions;
+		bool correct;
+		{
+			// The spell checker thread uses the dictionaries as well
+			Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+			if(m_spell.get_language() != spellLang) {
+				m_spell.set_language(spellLang);
+			}
+			suggestions = m_spell.get_suggestions(trimmed);
+			correct = m_spell.check_word(trimmed);
+		}
+		for(const Glib::ustring& suggestion : suggestions) {
 			Glib::ustring replacement = prefix + suggestion + suffix;
 			Gtk::MenuItem* item = Gtk::manage(new Gtk::MenuItem(replacement));
 			CONNECT(item, activate, [this, replacement, it] { (*it)[m_itemStoreCols.text] = replacement; });
@@ -1178,17 +1752,25 @@ void OutputEditorHOCR::showContextMenu(GdkEventButton* ev) {
 			item->set_sensitive(false);
 			menu.append(*item);
 		}
-		if(!m_spell.check_word(trimWord((*it)[m_itemStoreCols.text]))) {
+		if(!correct) {
 			menu.append(*Gtk::manage(new Gtk::SeparatorMenuItem));
 			Gtk::MenuItem* additem = Gtk::manage(new Gtk::MenuItem(_("Add to dictionary")));
-			CONNECT(additem, activate, [this, it] {
-				m_spell.add_to_dictionary((*it)[m_itemStoreCols.text]);
+			CONNECT(additem, activate, [this, it, spellLang, trimmed] {
+				{
+					Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+					m_spell.add_to_dictionary((*it)[m_itemStoreCols.text]);
+				}
+				m_spellChecker.setCorrect(spellLang, trimmed);
 				it->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
 			});
 			menu.append(*additem);
 			Gtk::MenuItem* ignoreitem = Gtk::manage(new Gtk::MenuItem(_("Ignore word")));
-			CONNECT(ignoreitem, activate, [this, it] {
-				m_spell.ignore_word((*it)[m_itemStoreCols.text]);
+			CONNECT(ignoreitem, activate, [this, it, spellLang, trimmed] {
+				{
+					Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+					m_spell.ignore_word((*it)[m_itemStoreCols.text]);
+				}
+				m_spellChecker.setCorrect(spellLang, trimmed);
 				it->set_value(m_itemStoreCols.textColor, Glib::ustring("#000"));
 			});
 			menu.append(*ignoreitem);
@@ -1202,12 +1784,17 @@ void OutputEditorHOCR::showContextMenu(GdkEventButton* ev) {
 			Gtk::MenuItem* removeItem = Gtk::manage(new Gtk::MenuItem(_("Remove")));
 			menu.append(*removeItem);
 			CONNECT(removeItem, activate, [&] {
-				m_itemStore->erase(it);
+				HOCRItem* pageElement = itemForTreeItem(it);
+				if(pageElement == m_currentElement || (m_currentElement && m_currentElement->page() == pageElement)) {
+					m_currentElement = nullptr;
+				}
+				if(pageElement) {
+					m_document.removeItem(pageElement);
+				}
 				m_connectionPropViewRowEdited.block(true);
 				m_propStore->clear();
 				m_connectionPropViewRowEdited.block(false);
-				m_builder("button:hocr.save")->set_sensitive(!m_itemStore->children().empty());
-				m_builder("button:hocr.export")->set_sensitive(!m_itemStore->children().empty());
+				m_modified = true;
 			});
 		} else {
 			Gtk::MenuItem* removeItem = Gtk::manage(new Gtk::MenuItem(_("Remove")));
@@ -1221,7 +1808,7 @@ void OutputEditorHOCR::showContextMenu(GdkEventButton* ev) {
 		}
 		Gtk::MenuItem* expandItem = Gtk::manage(new Gtk::MenuItem(_("Expand all")));
 		menu.append(*expandItem);
-		CONNECT(expandItem, activate, [this, path] { m_itemView->expand_row(path, true); });
+		CONNECT(expandItem, activate, [this, it] { expandChildren(it); });
 		Gtk::MenuItem* collapseItem = Gtk::manage(new Gtk::MenuItem(_("Collapse all")));
 		menu.append(*collapseItem);
 		CONNECT(collapseItem, activate, [this, path] { m_itemView->collapse_row(path); });
@@ -1251,27 +1838,31 @@ void OutputEditorHOCR::open() {
 		return;
 	}
 	std::string filename = files.front()->get_path();
-	std::string source;
-	try {
-		source = Glib::file_get_contents(filename);
-	} catch(Glib::Error&) {
+	if(!std::ifstream(filename).is_open()) {
 		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Failed to open file"), Glib::ustring::compose(_("The file could not be opened: %1."), filename));
 		return;
 	}
 
-	xmlpp::DomParser parser;
-	parser.parse_memory(source);
-	xmlpp::Document* doc = parser.get_document();
-	xmlpp::Element* div = getFirstChildElement(getFirstChildElement(doc->get_root_node(), "body"), "div");
-	if(!div || getAttribute(div, "class") != "ocr_page") {
-		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Invalid hOCR file"), Glib::ustring::compose(_("The file does not appear to contain valid hOCR HTML: %1"), filename));
-		return;
-	}
+	// Parse and prepare the pages in the background, they are added in batches as they are completed
+	Glib::ustring basename = files.front()->get_basename();
 	int page = 0;
-	while(div) {
-		++page;
-		addPage(div, files.front()->get_basename(), page, false);
-		div = getNextSiblingElement(div, "div");
+	Utils::busyTask([&] {
+		try {
+			xmlpp::TextReader reader(filename);
+			while(reader.read()) {
+				if(reader.get_node_type() == xmlpp::TextReader::Element && reader.get_local_name() == "div" && reader.get_attribute("class") == "ocr_page") {
+					HOCRPage* pageItem = static_cast<HOCRPage*>(parseItem(reader));
+					pageItem->setLabel(Glib::ustring::compose("%1 [%2]", basename, ++page));
+					HOCRDocument::preparePage(pageItem, m_document.nextPageId(), false);
+					queuePage(pageItem);
+				}
+			}
+		} catch(const xmlpp::exception&) {
+		}
+		return page > 0;
+	}, _("Loading hOCR file..."));
+	if(page == 0) {
+		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Invalid hOCR file"), Glib::ustring::compose(_("The file does not appear to contain valid hOCR HTML: %1"), filename));
 	}
 }
 
@@ -1308,13 +1899,14 @@ bool OutputEditorHOCR::save(const std::string& filename) {
 	                           "  </head>\n"
 	                           "<body>\n", tess.Version());
 	file.write(header.data(), header.bytes());
-	for(Gtk::TreeIter item : m_itemStore->children()) {
-		Glib::ustring itemSource = (*item)[m_itemStoreCols.source];
-		file.write(itemSource.data(), itemSource.bytes());
+	for(const HOCRPage* page : m_document.pages()) {
+		std::string pageSource = page->toHtml(1);
+		file.write(pageSource.data(), pageSource.size());
 	}
 	Glib::ustring footer = "</body>\n</html>\n";
 	file.write(footer.data(), footer.bytes());
 	m_modified = false;
+	m_document.markSaved();
 	return true;
 }
 
@@ -1323,7 +1915,9 @@ void OutputEditorHOCR::savePDF() {
 	updatePreview();
 	MAIN->getDisplayer()->addItem(m_preview);
 	bool accepted = false;
-	PoDoFo::PdfStreamedDocument* document = nullptr;
+	bool sourceOverlay = false;
+	std::string outname;
+	PoDoFo::PdfDocument* document = nullptr;
 	PoDoFo::PdfFont* font = nullptr;
 #if PODOFO_VERSION >= PODOFO_MAKE_VERSION(0,9,3)
 	const PoDoFo::PdfEncoding* pdfEncoding = PoDoFo::PdfEncodingFactory::GlobalIdentityEncodingInstance();
@@ -1342,7 +1936,7 @@ void OutputEditorHOCR::savePDF() {
 		std::string ext, base;
 		std::string name = !sources.empty() ? sources.front()->displayname : _("output");
 		Utils::get_filename_parts(name, base, ext);
-		std::string outname = Glib::build_filename(MAIN->getConfig()->getSetting<VarSetting<Glib::ustring>>("outputdir")->getValue(), base + ".pdf");
+		outname = Glib::build_filename(MAIN->getConfig()->getSetting<VarSetting<Glib::ustring>>("outputdir")->getValue(), base + ".pdf");
 		FileDialogs::FileFilter filter = {_("PDF Files"), {"application/pdf"}, {"*.pdf"}};
 		outname = FileDialogs::save_dialog(_("Save PDF Output..."), outname, filter);
 		if(outname.empty()) {
@@ -1351,8 +1945,14 @@ void OutputEditorHOCR::savePDF() {
 		}
 		MAIN->getConfig()->getSetting<VarSetting<Glib::ustring>>("outputdir")->setValue(Glib::path_get_dirname(outname));
 
+		sourceOverlay = m_builder("combo:pdfoptions.mode").as<Gtk::ComboBox>()->get_active_row_number() == 2;
 		try {
-			document = new PoDoFo::PdfStreamedDocument(outname.c_str());
+			if(sourceOverlay) {
+				// The source pages are copied in memory, the document is written once complete
+				document = new PoDoFo::PdfMemDocument();
+			} else {
+				document = new PoDoFo::PdfStreamedDocument(outname.c_str());
+			}
 		} catch(...) {
 			Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Failed to save output"), _("Check that you have writing permissions in the selected folder."));
 			continue;
@@ -1373,7 +1973,9 @@ void OutputEditorHOCR::savePDF() {
 		}
 		if(!font) {
 			Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Error"), _("The PDF library does not support the selected font."));
-			document->Close();
+			if(!sourceOverlay) {
+				static_cast<PoDoFo::PdfStreamedDocument*>(document)->Close();
+			}
 			delete document;
 			continue;
 		}
@@ -1395,95 +1997,205 @@ void OutputEditorHOCR::savePDF() {
 	pdfSettings.conversionFlags = pdfSettings.colorFormat == Image::Format_Mono ? (*m_builder("combo:pdfoptions.dithering").as<Gtk::ComboBox>()->get_active())[m_ditheringComboCols.conversionFlags] : Image::AutoColor;
 	pdfSettings.compression = (*m_builder("combo:pdfoptions.compression").as<Gtk::ComboBox>()->get_active())[m_compressionComboCols.mode];
 	pdfSettings.compressionQuality = m_builder("spin:pdfoptions.quality").as<Gtk::SpinButton>()->get_value();
+	pdfSettings.zipLevel = m_builder("spin:pdfoptions.ziplevel").as<Gtk::SpinButton>()->get_value();
+	pdfSettings.fax4Strips = m_builder("checkbox:pdfoptions.fax4strips").as<Gtk::CheckButton>()->get_active();
 	pdfSettings.useDetectedFontSizes = m_builder("checkbox:pdfoptions.usedetectedfontsizes").as<Gtk::CheckButton>()->get_active();
 	pdfSettings.uniformizeLineSpacing = m_builder("checkbox:pdfoptions.uniformlinespacing").as<Gtk::CheckButton>()->get_active();
 	pdfSettings.preserveSpaceWidth = m_builder("spin:pdfoptions.preserve").as<Gtk::SpinButton>()->get_value();
-	pdfSettings.overlay = m_builder("combo:pdfoptions.mode").as<Gtk::ComboBox>()->get_active_row_number() == 1;
+	pdfSettings.overlay = m_builder("combo:pdfoptions.mode").as<Gtk::ComboBox>()->get_active_row_number() != 0;
 	pdfSettings.detectedFontScaling = m_builder("spin:pdfoptions.fontscale").as<Gtk::SpinButton>()->get_value() / 100.;
+	if(sourceOverlay) {
+		saveSourceOverlay(static_cast<PoDoFo::PdfMemDocument*>(document), font, fontSize, outname, pdfSettings);
+		delete document;
+		return;
+	}
+	// The pages are recorded here while their images are encoded in the background, and written in order
+	WorkerPool pool;
+	PoDoFoGlyphWidths glyphWidths(font);
+	std::deque<PoDoFoPDFPainter*> pendingPages;
+	PageRasterizer rasterizer;
 	std::vector<Glib::ustring> failed;
-	for(Gtk::TreeIter item : m_itemStore->children()) {
-		if(!(*item)[m_itemStoreCols.selected]) {
+	for(const HOCRPage* pageItem : m_document.pages()) {
+		if(!pageItem->isEnabled()) {
 			continue;
 		}
-		Geometry::Rectangle bbox = (*item)[m_itemStoreCols.bbox];
-		xmlpp::DomParser parser;
-		parser.parse_memory((*item)[m_itemStoreCols.source]);
-		xmlpp::Document* doc = parser.get_document();
-		int sourceDpi = -1;
+		Geometry::Rectangle bbox = toRectangle(pageItem->bbox());
+		int sourceDpi = pageItem->resolution();
 		int outputDpi = m_builder("spin:pdfoptions.dpi").as<Gtk::SpinButton>()->get_value();
-		if(doc->get_root_node() && doc->get_root_node()->get_name() == "div" && setCurrentSource(doc->get_root_node(), &sourceDpi, &outputDpi)) {
+		if(rasterizePage(rasterizer, pageItem, outputDpi)) {
 			double docScale = (72. / sourceDpi);
 			double imgScale = double(outputDpi) / sourceDpi;
-			PoDoFo::PdfPage* page = document->CreatePage(PoDoFo::PdfRect(0, 0, bbox.width * docScale, bbox.height * docScale));
-			painter.SetPage(page);
-			painter.SetFont(font);
-
-			PoDoFoPDFPainter pdfprinter(document, &painter, docScale);
-			pdfprinter.setFontSize(fontSize);
-			printChildren(pdfprinter, item, pdfSettings, imgScale);
+			PoDoFoPDFPainter* pdfprinter = new PoDoFoPDFPainter(pool, glyphWidths, font, bbox.width * docScale, bbox.height * docScale, docScale);
+			pdfprinter->setFontSize(fontSize);
+			printChildren(*pdfprinter, pageItem, pdfSettings, rasterizer, imgScale);
 			if(pdfSettings.overlay) {
 				Geometry::Rectangle scaledBBox(imgScale * bbox.x, imgScale * bbox.y, imgScale * bbox.width, imgScale * bbox.height);
-				pdfprinter.drawImage(bbox, m_tool->getSelection(scaledBBox), pdfSettings);
+				pdfprinter->drawImage(bbox, rasterizer.getRegion(scaledBBox), pdfSettings);
+			}
+			pdfprinter->encodeImages();
+			pendingPages.push_back(pdfprinter);
+			// Only render ahead as far as there are threads to encode the pages
+			while(int(pendingPages.size()) > pool.threadCount()) {
+				pendingPages.front()->writePage(document, &painter);
+				delete pendingPages.front();
+				pendingPages.pop_front();
 			}
-			MAIN->getDisplayer()->setResolution(sourceDpi);
-			painter.FinishPage();
 		} else {
-			failed.push_back((*item)[m_itemStoreCols.text]);
+			failed.push_back(pageItem->label());
 		}
 	}
+	for(PoDoFoPDFPainter* pdfprinter : pendingPages) {
+		pdfprinter->writePage(document, &painter);
+		delete pdfprinter;
+	}
 	if(!failed.empty()) {
 		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Errors occurred"), Glib::ustring::compose(_("The following pages could not be rendered:\n%1"), Utils::string_join(failed, "\n")));
 	}
-	document->Close();
+	static_cast<PoDoFo::PdfStreamedDocument*>(document)->Close();
 	delete document;
 }
 
-void OutputEditorHOCR::printChildren(PDFPainter& painter, Gtk::TreeIter item, const PDFSettings& pdfSettings, double imgScale) const {
-	if(!(*item)[m_itemStoreCols.selected]) {
+// Copies the pages of the source PDF files, and writes the text onto them as an invisible layer,
+// without rasterizing them. Consecutive pages of a source are copied at once, so that the objects
+// they share (fonts, images) are only copied once.
+void OutputEditorHOCR::saveSourceOverlay(PoDoFo::PdfMemDocument* document, PoDoFo::PdfFont* font, double fontSize, const std::string& filename, const PDFSettings& pdfSettings) {
+	PoDoFo::PdfPainter painter;
+	// No images are drawn, the pool is only needed by the painter
+	WorkerPool pool(1);
+	PoDoFoGlyphWidths glyphWidths(font);
+	PageRasterizer rasterizer;
+	std::map<std::string, PoDoFo::PdfMemDocument*> sources;
+	std::vector<const HOCRPage*> pages;
+	std::vector<Glib::ustring> failed;
+	bool copied = Utils::busyTask([&] {
+		try {
+			PoDoFo::PdfMemDocument* runSource = nullptr;
+			int runFirst = 0;
+			int runCount = 0;
+			for(const HOCRPage* pageItem : m_document.pages()) {
+				if(!pageItem->isEnabled()) {
+					continue;
+				}
+				auto it = sources.find(pageItem->sourceFile());
+				if(it == sources.end()) {
+					PoDoFo::PdfMemDocument* source = new PoDoFo::PdfMemDocument();
+					try {
+						source->Load(pageItem->sourceFile().c_str());
+					} catch(...) {
+						// Not a PDF, or not readable
+						delete source;
+						source = nullptr;
+					}
+					it = sources.insert(std::make_pair(pageItem->sourceFile(), source)).first;
+				}
+				PoDoFo::PdfMemDocument* source = it->second;
+				if(!source || pageItem->pageNr() < 1 || pageItem->pageNr() > source->GetPageCount()) {
+					failed.push_back(pageItem->label());
+					continue;
+				}
+				if(source != runSource || pageItem->pageNr() - 1 != runFirst + runCount) {
+					if(runCount > 0) {
+						document->InsertPages(*runSource, runFirst, runCount);
+					}
+					runSource = source;
+					runFirst = pageItem->pageNr() - 1;
+					runCount = 0;
+				}
+				++runCount;
+				pages.push_back(pageItem);
+			}
+			if(runCount > 0) {
+				document->InsertPages(*runSource, runFirst, runCount);
+			}
+		} catch(...) {
+			return false;
+		}
+		return true;
+	}, _("Copying source pages..."));
+	if(copied) {
+		for(std::size_t i = 0; i < pages.size(); ++i) {
+			const HOCRPage* pageItem = pages[i];
+			Geometry::Rectangle bbox = toRectangle(pageItem->bbox());
+			double docScale = 72. / pageItem->resolution();
+			PoDoFoPDFPainter pdfprinter(pool, glyphWidths, font, bbox.width * docScale, bbox.height * docScale, docScale);
+			pdfprinter.setFontSize(fontSize);
+			printChildren(pdfprinter, pageItem, pdfSettings, rasterizer);
+			PoDoFo::PdfPage* page = document->GetPage(i);
+			pdfprinter.writeOverlay(document, &painter, page, sourcePageTransform(page, pageItem->angle(), bbox.height * docScale));
+		}
+	}
+	// The copies are complete, closing the sources allows the output to replace one of them
+	for(const auto& source : sources) {
+		delete source.second;
+	}
+	if(!copied) {
+		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Failed to save output"), _("The pages could not be copied from the source PDF files."));
+		return;
+	}
+	bool written = Utils::busyTask([&] {
+		try {
+			document->Write(filename.c_str());
+		} catch(...) {
+			return false;
+		}
+		return true;
+	}, _("Writing PDF..."));
+	if(!written) {
+		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Failed to save output"), _("Check that you have writing permissions in the selected folder."));
+	} else if(!failed.empty()) {
+		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Errors occurred"), Glib::ustring::compose(_("The following pages are not from a PDF file and were skipped:\n%1"), Utils::string_join(failed, "\n")));
+	}
+}
+
+void OutputEditorHOCR::printChildren(PDFPainter& painter, const HOCRItem* item, const PDFSettings& pdfSettings, const PageRasterizer& rasterizer, double imgScale) const {
+	if(!item->isEnabled()) {
 		return;
 	}
-	Glib::ustring itemClass = (*item)[m_itemStoreCols.itemClass];
-	Geometry::Rectangle itemRect = (*item)[m_itemStoreCols.bbox];
-	if(itemClass == "ocr_par" && pdfSettings.uniformizeLineSpacing) {
-		double yInc = double(itemRect.height) / item->children().size();
+	Geometry::Rectangle itemRect = toRectangle(item->bbox());
+	if(item->isParagraph() && pdfSettings.uniformizeLineSpacing) {
+		double yInc = double(itemRect.height) / item->childCount();
 		double y = itemRect.y + yInc;
-		int baseLine = item->children().empty() ? 0 : (*(*item->children().begin()))[m_itemStoreCols.baseLine];
-		for(Gtk::TreeIter lineItem : item->children()) {
+		int baseLine = item->childCount() > 0 ? item->child(0)->baseline() : 0;
+		for(const HOCRItem* lineItem : item->children()) {
 			double x = itemRect.x;
 			double prevWordRight = itemRect.x;
-			for(Gtk::TreeIter wordItem : lineItem->children()) {
-				if((*wordItem)[m_itemStoreCols.selected]) {
-					Geometry::Rectangle wordRect = (*wordItem)[m_itemStoreCols.bbox];
+			for(const HOCRItem* wordItem : lineItem->children()) {
+				if(wordItem->isEnabled()) {
+					Geometry::Rectangle wordRect = toRectangle(wordItem->bbox());
+					Glib::ustring text = wordItem->text();
 					if(pdfSettings.useDetectedFontSizes) {
-						painter.setFontSize((*wordItem)[m_itemStoreCols.fontSize] * pdfSettings.detectedFontScaling);
+						painter.setFontSize(wordItem->fontSize() * pdfSettings.detectedFontScaling);
 					}
 					// If distance from previous word is large, keep the space
 					if(wordRect.x - prevWordRight > pdfSettings.preserveSpaceWidth * painter.getAverageCharWidth()) {
 						x = wordRect.x;
 					}
 					prevWordRight = wordRect.x + wordRect.width;
-					painter.drawText(x, y + baseLine, Glib::ustring((*wordItem)[m_itemStoreCols.text]));
-					x += painter.getTextWidth(Glib::ustring((*wordItem)[m_itemStoreCols.text]) + " ");
+					painter.drawText(x, y + baseLine, text);
+					x += painter.getTextWidth(text + " ");
 				}
 			}
 			y += yInc;
 		}
-	} else if(itemClass == "ocr_line" && !pdfSettings.uniformizeLineSpacing) {
-		int baseLine = (*item)[m_itemStoreCols.baseLine];
+	} else if(item->isLine() && !pdfSettings.uniformizeLineSpacing) {
+		int baseLine = item->baseline();
 		double y = itemRect.y + itemRect.height + baseLine;
-		for(Gtk::TreeIter wordItem : item->children()) {
-			Geometry::Rectangle wordRect = (*wordItem)[m_itemStoreCols.bbox];
+		for(const HOCRItem* wordItem : item->children()) {
+			if(!wordItem->isEnabled()) {
+				continue;
+			}
+			Geometry::Rectangle wordRect = toRectangle(wordItem->bbox());
 			if(pdfSettings.useDetectedFontSizes) {
-				painter.setFontSize((*wordItem)[m_itemStoreCols.fontSize] * pdfSettings.detectedFontScaling);
+				painter.setFontSize(wordItem->fontSize() * pdfSettings.detectedFontScaling);
 			}
-			painter.drawText(wordRect.x, y, Glib::ustring((*wordItem)[m_itemStoreCols.text]));
+			painter.drawText(wordRect.x, y, wordItem->text());
 		}
-	} else if(itemClass == "ocr_graphic" && !pdfSettings.overlay) {
+	} else if(item->isGraphic() && !pdfSettings.overlay) {
 		Geometry::Rectangle scaledItemRect(imgScale * itemRect.x, imgScale * itemRect.y, imgScale * itemRect.width, imgScale * itemRect.height);
-		painter.drawImage(itemRect, m_tool->getSelection(scaledItemRect), pdfSettings);
+		painter.drawImage(itemRect, rasterizer.getRegion(scaledItemRect), pdfSettings);
 	} else {
-		for(Gtk::TreeIter child : item->children()) {
-			printChildren(painter, child, pdfSettings, imgScale);
+		for(const HOCRItem* child : item->children()) {
+			printChildren(painter, child, pdfSettings, rasterizer, imgScale);
 		}
 	}
 }
@@ -1494,24 +2206,20 @@ void OutputEditorHOCR::updatePreview() {
 	}
 	bool visible = m_builder("checkbox:pdfoptions.preview").as<Gtk::CheckButton>()->get_active();
 	m_preview->setVisible(visible);
-	if(m_itemStore->children().empty()|| !visible) {
+	if(m_document.pageCount() == 0 || !visible) {
 		return;
 	}
-	Gtk::TreeIter item = currentItem();
-	if(!item) {
-		item = *m_itemStore->children().begin();
-	} else {
-		while(item->parent()) {
-			item = item->parent();
-		}
+	const HOCRPage* page = m_currentElement ? m_currentElement->page() : nullptr;
+	if(!page) {
+		page = m_document.page(0);
 	}
 
-	Geometry::Rectangle bbox = (*item)[m_itemStoreCols.bbox];
-	xmlpp::DomParser parser;
-	parser.parse_memory((*item)[m_itemStoreCols.source]);
-	xmlpp::Document* doc = parser.get_document();
+	Geometry::Rectangle bbox = toRectangle(page->bbox());
 	int pageDpi = -1;
-	setCurrentSource(doc->get_root_node(), &pageDpi);
+	setCurrentSource(page, &pageDpi);
+	if(!rasterizePage(m_previewRasterizer, page, page->resolution())) {
+		return;
+	}
 
 	Cairo::RefPtr<Cairo::ImageSurface> image = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, bbox.width, bbox.height);
 
@@ -1529,14 +2237,16 @@ void OutputEditorHOCR::updatePreview() {
 	pdfSettings.conversionFlags = pdfSettings.colorFormat == Image::Format_Mono ? (*m_builder("combo:pdfoptions.dithering").as<Gtk::ComboBox>()->get_active())[m_ditheringComboCols.conversionFlags] : Image::AutoColor;
 	pdfSettings.compression = (*m_builder("combo:pdfoptions.compression").as<Gtk::ComboBox>()->get_active())[m_compressionComboCols.mode];
 	pdfSettings.compressionQuality = m_builder("spin:pdfoptions.quality").as<Gtk::SpinButton>()->get_value();
+	pdfSettings.zipLevel = m_builder("spin:pdfoptions.ziplevel").as<Gtk::SpinButton>()->get_value();
+	pdfSettings.fax4Strips = m_builder("checkbox:pdfoptions.fax4strips").as<Gtk::CheckButton>()->get_active();
 	pdfSettings.useDetectedFontSizes = m_builder("checkbox:pdfoptions.usedetectedfontsizes").as<Gtk::CheckButton>()->get_active();
 	pdfSettings.uniformizeLineSpacing = m_builder("checkbox:pdfoptions.uniformlinespacing").as<Gtk::CheckButton>()->get_active();
 	pdfSettings.preserveSpaceWidth = m_builder("spin:pdfoptions.preserve").as<Gtk::SpinButton>()->get_value();
-	pdfSettings.overlay = m_builder("combo:pdfoptions.mode").as<Gtk::ComboBox>()->get_active_row_number() == 1;
+	pdfSettings.overlay = m_builder("combo:pdfoptions.mode").as<Gtk::ComboBox>()->get_active_row_number() != 0;
 	pdfSettings.detectedFontScaling = (pageDpi / 72.) * m_builder("spin:pdfoptions.fontscale").as<Gtk::SpinButton>()->get_value() / 100.;
 	CairoPDFPainter painter(context);
 	if(pdfSettings.overlay) {
-		painter.drawImage(bbox, m_tool->getSelection(bbox), pdfSettings);
+		painter.drawImage(bbox, m_previewRasterizer.getRegion(bbox), pdfSettings);
 		context->save();
 		context->rectangle(0, 0, image->get_width(), image->get_height());
 		context->set_source_rgba(1., 1., 1., 0.5);
@@ -1549,7 +2259,7 @@ void OutputEditorHOCR::updatePreview() {
 		context->fill();
 		context->restore();
 	}
-	printChildren(painter, item, pdfSettings);
+	printChildren(painter, page, pdfSettings, m_previewRasterizer);
 	m_preview->setImage(image);
 	m_preview->setRect(Geometry::Rectangle(-0.5 * image->get_width(), -0.5 * image->get_height(), image->get_width(), image->get_height()));
 }
@@ -1568,13 +2278,15 @@ bool OutputEditorHOCR::clear(bool hide) {
 			return false;
 		}
 	}
-	m_idCounter = 0;
 	m_connectionSelectionChanged.block();
 	Gtk::TreeIter rootIter = m_itemStore->get_iter(m_rootItem);
 	while(!rootIter->children().empty()) {
 		m_itemStore->erase(*rootIter->children()[0]);
 	}
 	m_connectionSelectionChanged.unblock();
+	m_pendingSpellingItems.clear();
+	m_currentElement = nullptr;
+	m_document.clear();
 	m_propStore->clear();
 	m_sourceView->get_buffer()->set_text("");
 	m_tool->clearSelection();
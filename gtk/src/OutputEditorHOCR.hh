@@ -21,7 +21,10 @@
 #define OUTPUTEDITORHOCR_HH
 
 #include "OutputEditor.hh"
+#include "DisplayRenderer.hh"
 #include "Geometry.hh"
+#include "HOCRDocument.hh"
+#include "HOCRSpellChecker.hh"
 #include "Image.hh"
 
 #include <gtksourceviewmm.h>
@@ -29,12 +32,12 @@
 
 class DisplayerImageItem;
 class DisplayerToolHOCR;
-namespace xmlpp {
-class DomParser;
-class Element;
+namespace PoDoFo {
+class PdfFont;
+class PdfMemDocument;
 }
 
-class OutputEditorHOCR : public OutputEditor {
+class OutputEditorHOCR : public OutputEditor, private HOCRDocument::Observer {
 public:
 	OutputEditorHOCR(DisplayerToolHOCR* tool);
 	~OutputEditorHOCR();
@@ -47,21 +50,24 @@ public:
 	void readError(const Glib::ustring& errorMsg, ReadSessionData* data) override;
 	void finalizeRead(ReadSessionData *data) override;
 	bool getModified() const override;
+	// Restores the pages and edits recorded in the journal of a session which did not terminate properly
+	bool recoverJournal(const std::vector<HOCRJournal::Record>& records);
+
+	// The directory holding the journals of all running sessions, and of those which crashed
+	static std::string journalDirectory();
+	// The journal from which the session of the process can be recovered after a crash
+	static std::string journalFilename(int pid);
 
 	bool clear(bool hide = true) override;
 	void open();
 	bool save(const std::string& filename = "") override;
 	void savePDF();
+	void undo();
+	void redo();
 
 private:
 	class TreeView;
 
-	static const Glib::RefPtr<Glib::Regex> s_bboxRx;
-	static const Glib::RefPtr<Glib::Regex> s_pageTitleRx;
-	static const Glib::RefPtr<Glib::Regex> s_idRx;
-	static const Glib::RefPtr<Glib::Regex> s_fontSizeRx;
-	static const Glib::RefPtr<Glib::Regex> s_baseLineRx;
-
 	struct HOCRReadSessionData : ReadSessionData {
 		std::vector<Glib::ustring> errors;
 	};
@@ -69,8 +75,10 @@ private:
 	struct PDFSettings {
 		Image::Format colorFormat;
 		Image::ConversionFlags conversionFlags;
-		enum Compression { CompressZip=0, CompressFax4=1, CompressJpeg=2 } compression; // This order needs to be the same as combo:pdfoptions.compression
+		enum Compression { CompressZip=0, CompressFax4=1, CompressJpeg=2, CompressJbig2=3 } compression; // This order needs to be the same as combo:pdfoptions.compression
 		int compressionQuality;
+		int zipLevel;
+		bool fax4Strips;
 		bool useDetectedFontSizes;
 		bool uniformizeLineSpacing;
 		int preserveSpaceWidth;
@@ -96,11 +104,7 @@ private:
 		Gtk::TreeModelColumn<Glib::RefPtr<Gdk::Pixbuf>> icon;
 		Gtk::TreeModelColumn<Glib::ustring> text;
 		Gtk::TreeModelColumn<Glib::ustring> id;
-		Gtk::TreeModelColumn<Glib::ustring> source;
-		Gtk::TreeModelColumn<Geometry::Rectangle> bbox;
 		Gtk::TreeModelColumn<Glib::ustring> itemClass;
-		Gtk::TreeModelColumn<double> fontSize;
-		Gtk::TreeModelColumn<int> baseLine;
 		Gtk::TreeModelColumn<Glib::ustring> textColor;
 		Gtk::TreeModelColumn<bool> checkboxVisible;
 		Gtk::TreeModelColumn<bool> iconVisible;
@@ -110,11 +114,7 @@ private:
 			add(icon);
 			add(text);
 			add(id);
-			add(source);
-			add(bbox);
 			add(itemClass);
-			add(fontSize);
-			add(baseLine);
 			add(textColor);
 			add(checkboxVisible);
 			add(iconVisible);
@@ -168,18 +168,33 @@ private:
 	Gtk::TreeView* m_propView;
 	Glib::RefPtr<Gtk::TreeStore> m_propStore;
 	Gsv::View* m_sourceView;
-	int m_idCounter = 0;
+	Gtk::ToggleButton* m_toggleSearchButton;
+	Gtk::Entry* m_searchEntry;
+	Gtk::Entry* m_replaceEntry;
+	Gtk::CheckButton* m_csCheckBox;
 	DisplayerToolHOCR* m_tool;
 	GtkSpell::Checker m_spell;
+	HOCRSpellChecker m_spellChecker;
+	std::map<Glib::ustring, Glib::ustring> m_spellingLangCache;
+	// Words whose spelling verdict is still pending
+	std::vector<Gtk::TreeRowReference> m_pendingSpellingItems;
 	bool m_modified = false;
 	Gtk::Dialog* m_pdfExportDialog = nullptr;
 	DisplayerImageItem* m_preview = nullptr;
+	PageRasterizer m_previewRasterizer;
 
+	// Declared before the journal, which may emit it until it is destroyed
+	Glib::Dispatcher m_journalFailedDispatcher;
+	HOCRJournal m_journal;
+	HOCRDocument m_document;
 	Gtk::TreePath m_rootItem;
 	Gtk::TreePath m_currentItem;
 	Gtk::TreePath m_currentPageItem;
-	xmlpp::DomParser* m_currentParser = nullptr;
-	xmlpp::Element* m_currentElement = nullptr;
+	HOCRItem* m_currentElement = nullptr;
+	// Pages prepared off the main thread which are yet to be added
+	Glib::Threads::Mutex m_queuedPagesMutex;
+	std::vector<HOCRPage*> m_queuedPages;
+	sigc::connection m_connectionAddQueuedPages;
 
 	sigc::connection m_connectionCustomFont;
 	sigc::connection m_connectionDefaultFont;
@@ -188,19 +203,36 @@ private:
 	sigc::connection m_connectionPropViewRowEdited;
 
 	Gtk::TreeIter currentItem();
-	void addPage(xmlpp::Element* pageDiv, const Glib::ustring& filename, int page, bool cleanGraphics);
-	bool addChildItems(xmlpp::Element* element, Gtk::TreeIter parentItem, std::map<Glib::ustring, Glib::ustring>& langCache);
-	void printChildren(PDFPainter& painter, Gtk::TreeIter item, const PDFSettings& pdfSettings, double imgScale = 1.) const;
-	bool setCurrentSource(xmlpp::Element* pageElement, int* pageDpi = 0, int* overrideDpi = 0) const;
+	// Parses the hOCR text of a recognized page, may be called from any thread
+	static HOCRPage* parsePage(const Glib::ustring& hocrText, const ReadSessionData& data);
+	// Queues the prepared page for being added in the main thread, may be called from any thread
+	void queuePage(HOCRPage* page);
+	void addQueuedPages();
+	void journalFailed();
+	Gtk::TreeIter findTreeItem(const HOCRItem* item);
+	bool isPopulated(const Gtk::TreeIter& item) const;
+	void addTreeItems(const HOCRItem* item, const Gtk::TreeIter& parentItem, int& row);
+	void populateItem(const Gtk::TreeIter& item);
+	void expandChildren(const Gtk::TreeIter& item);
+	Glib::ustring spellingLanguage(const HOCRItem* item);
+	void updateSpellingColor(const Gtk::TreeIter& item, const HOCRItem* element);
+	void updatePendingSpellingColors();
+	HOCRItem* itemForTreeItem(const Gtk::TreeIter& item) const;
+	void saveSourceOverlay(PoDoFo::PdfMemDocument* document, PoDoFo::PdfFont* font, double fontSize, const std::string& filename, const PDFSettings& pdfSettings);
+	void printChildren(PDFPainter& painter, const HOCRItem* item, const PDFSettings& pdfSettings, const PageRasterizer& rasterizer, double imgScale = 1.) const;
+	bool setCurrentSource(const HOCRPage* page, int* pageDpi = 0) const;
 	void updateCurrentItemText();
 	void updateCurrentItemAttribute(const Glib::ustring& key, const Glib::ustring& subkey, const Glib::ustring& newvalue, bool update=true);
 	void updateCurrentItem();
 	void removeCurrentItem();
 	Glib::ustring trimWord(const Glib::ustring& word, Glib::ustring* prefix = nullptr, Glib::ustring* suffix = nullptr);
 	void mergeItems(const std::vector<Gtk::TreePath>& items);
+	void selectItem(const HOCRItem* item);
+	void findReplace(bool backwards, bool replace);
+	void replaceAll();
+	bool isSearchMatch(const Gtk::TreeIter& item) const;
 
 	void addGraphicRection(const Geometry::Rectangle& rect);
-	void addPage(const Glib::ustring& hocrText, ReadSessionData data);
 	void setFont();
 	void imageFormatChanged();
 	void imageCompressionChanged();
@@ -211,6 +243,14 @@ private:
 	void checkCellEditable(const Glib::ustring& path, Gtk::CellRenderer* renderer);
 	void updatePreview();
 	void updateCurrentItemBBox(const Geometry::Rectangle& rect);
+	void pickItem(const Geometry::Point& point);
+	void updateCurrentItemPaths();
+
+	void itemInserted(HOCRItem* item) override;
+	void itemAboutToBeRemoved(HOCRItem* item) override;
+	void itemRemoved(HOCRItem* item) override;
+	void itemChanged(HOCRItem* item) override;
+	void historyChanged() override;
 };
 
 #endif // OUTPUTEDITORHOCR_HH
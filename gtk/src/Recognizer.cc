@@ -122,6 +122,11 @@ Recognizer::Recognizer() {
 	MAIN->getConfig()->addSetting(new VarSetting<Glib::ustring>("language"));
 	MAIN->getConfig()->addSetting(new ComboSetting("ocrregionstrategy", MAIN->getWidget("comboboxtext:dialog.regions")));
 	MAIN->getConfig()->addSetting(new VarSetting<int>("psm"));
+	MAIN->getConfig()->addSetting(new VarSetting<int>("preprocbinarization"));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preprocdespeckle"));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preprocremoveborder"));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preprocdeskew"));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preproccrop"));
 }
 
 std::vector<Glib::ustring> Recognizer::getAvailableLanguages() const {
@@ -194,6 +199,7 @@ void Recognizer::updateLanguagesMenu() {
 	m_langMenuRadioGroup = Gtk::RadioButtonGroup();
 	m_langMenuCheckGroup = std::vector<std::pair<Gtk::CheckMenuItem*, Glib::ustring>>();
 	m_psmRadioGroup = Gtk::RadioButtonGroup();
+	m_preprocRadioGroup = Gtk::RadioButtonGroup();
 	m_curLang = Config::Lang();
 	Gtk::RadioMenuItem* curitem = nullptr;
 	Gtk::RadioMenuItem* activeitem = nullptr;
@@ -202,7 +208,11 @@ void Recognizer::updateLanguagesMenu() {
 	std::vector<Glib::ustring> parts = Utils::string_split(MAIN->getConfig()->getSetting<VarSetting<Glib::ustring>>("language")->getValue(), ':');
 	Config::Lang curlang = {parts.empty() ? "eng" : parts[0], parts.size() < 2 ? "" : parts[1]};
 
-	std::vector<Glib::ustring> dicts = GtkSpell::Checker::get_language_list();
+	std::vector<Glib::ustring> dicts;
+	{
+		Glib::Threads::Mutex::Lock spellingLocker(Utils::spellingMutex());
+		dicts = GtkSpell::Checker::get_language_list();
+	}
 
 	std::vector<Glib::ustring> availLanguages = getAvailableLanguages();
 
@@ -340,6 +350,48 @@ void Recognizer::updateLanguagesMenu() {
 	psmItem->set_submenu(*psmMenu);
 	m_menuLanguages->append(*psmItem);
 
+	// Add preprocessing items
+	Gtk::Menu* preprocMenu = Gtk::manage(new Gtk::Menu);
+	int activeBinarization = MAIN->getConfig()->getSetting<VarSetting<int>>("preprocbinarization")->getValue();
+
+	struct BinarizationEntry {
+		Glib::ustring label;
+		ImagePreprocessor::Binarization binarization;
+	};
+	std::vector<BinarizationEntry> binarizationModes = {
+		BinarizationEntry{_("No binarization"), ImagePreprocessor::Binarization::None},
+		BinarizationEntry{_("Global binarization (Otsu)"), ImagePreprocessor::Binarization::Otsu},
+		BinarizationEntry{_("Adaptive binarization (Sauvola)"), ImagePreprocessor::Binarization::Sauvola}};
+	for(const auto& entry : binarizationModes) {
+		Gtk::RadioMenuItem* item = Gtk::manage(new Gtk::RadioMenuItem(m_preprocRadioGroup, entry.label));
+		item->set_active(static_cast<int>(entry.binarization) == activeBinarization);
+		CONNECT(item, toggled, [entry, item] {
+			if(item->get_active()) {
+				MAIN->getConfig()->getSetting<VarSetting<int>>("preprocbinarization")->setValue(static_cast<int>(entry.binarization));
+			}
+		});
+		preprocMenu->append(*item);
+	}
+	preprocMenu->append(*Gtk::manage(new Gtk::SeparatorMenuItem()));
+	std::vector<std::pair<Glib::ustring, Glib::ustring>> preprocOptions = {
+		{_("Deskew pages"), "preprocdeskew"},
+		{_("Remove speckles"), "preprocdespeckle"},
+		{_("Remove dark borders"), "preprocremoveborder"},
+		{_("Only recognize content area"), "preproccrop"}};
+	for(const auto& entry : preprocOptions) {
+		Gtk::CheckMenuItem* item = Gtk::manage(new Gtk::CheckMenuItem(entry.first));
+		Glib::ustring key = entry.second;
+		item->set_active(MAIN->getConfig()->getSetting<VarSetting<bool>>(key)->getValue());
+		CONNECT(item, toggled, [key, item] {
+			MAIN->getConfig()->getSetting<VarSetting<bool>>(key)->setValue(item->get_active());
+		});
+		preprocMenu->append(*item);
+	}
+
+	Gtk::MenuItem* preprocItem = Gtk::manage(new Gtk::MenuItem(_("Preprocessing")));
+	preprocItem->set_submenu(*preprocMenu);
+	m_menuLanguages->append(*preprocItem);
+
 	// Add installer item
 	m_menuLanguages->append(*Gtk::manage(new Gtk::SeparatorMenuItem()));
 	Gtk::MenuItem* manageItem = Gtk::manage(new Gtk::MenuItem(_("Manage languages...")));
@@ -457,6 +509,7 @@ void Recognizer::recognize(const std::vector<int> &pages, bool autodetectLayout)
 	if(initTesseract(tess, m_curLang.prefix.c_str())) {
 		Glib::ustring failed;
 		tess.SetPageSegMode(static_cast<tesseract::PageSegMode>(m_currentPsmMode));
+		ImagePreprocessor::Options preprocOptions = getPreprocessingOptions();
 		OutputEditor::ReadSessionData* readSessionData = MAIN->getOutputEditor()->initRead(tess);
 		ProgressMonitor monitor(pages.size());
 		MAIN->showProgress(&monitor);
@@ -478,9 +531,11 @@ void Recognizer::recognize(const std::vector<int> &pages, bool autodetectLayout)
 				readSessionData->file = MAIN->getDisplayer()->getCurrentImage(readSessionData->page);
 				readSessionData->angle = MAIN->getDisplayer()->getCurrentAngle();
 				readSessionData->resolution = MAIN->getDisplayer()->getCurrentResolution();
+				int dpi = MAIN->getDisplayer()->getCurrentDpi();
 				for(const Cairo::RefPtr<Cairo::ImageSurface>& image : MAIN->getDisplayer()->getOCRAreas()) {
-					tess.SetImage(image->get_data(), image->get_width(), image->get_height(), 4, image->get_stride());
-					tess.SetSourceResolution(MAIN->getDisplayer()->getCurrentResolution());
+					readSessionData->imageWidth = image->get_width();
+					readSessionData->imageHeight = image->get_height();
+					setImage(tess, image, preprocOptions, dpi);
 					tess.Recognize(&monitor.desc);
 					if(!monitor.canceled) {
 						MAIN->getOutputEditor()->read(tess, readSessionData);
@@ -502,13 +557,45 @@ void Recognizer::recognize(const std::vector<int> &pages, bool autodetectLayout)
 	}
 }
 
+ImagePreprocessor::Options Recognizer::getPreprocessingOptions() const {
+	ImagePreprocessor::Options options;
+	options.binarization = static_cast<ImagePreprocessor::Binarization>(MAIN->getConfig()->getSetting<VarSetting<int>>("preprocbinarization")->getValue());
+	options.despeckle = MAIN->getConfig()->getSetting<VarSetting<bool>>("preprocdespeckle")->getValue();
+	options.removeBorder = MAIN->getConfig()->getSetting<VarSetting<bool>>("preprocremoveborder")->getValue();
+	options.cropToContent = MAIN->getConfig()->getSetting<VarSetting<bool>>("preproccrop")->getValue();
+	return options;
+}
+
+void Recognizer::setImage(tesseract::TessBaseAPI& tess, const Cairo::RefPtr<Cairo::ImageSurface>& image, ImagePreprocessor::Options options, int dpi) const {
+	if(!options.isActive()) {
+		tess.SetImage(image->get_data(), image->get_width(), image->get_height(), 4, image->get_stride());
+	} else {
+		// Sauvola window of about a tenth of an inch
+		if(dpi > 0) {
+			options.sauvolaWindow = std::max(15, dpi / 10) | 1;
+		}
+		ImagePreprocessor::Image processed = ImagePreprocessor::process(image->get_data(), image->get_width(), image->get_height(), image->get_stride(), options);
+		// SetImage copies the data
+		tess.SetImage(processed.data.data(), processed.width, processed.height, processed.bytesPerPixel, processed.bytesPerLine);
+	}
+	// If the DPI is unknown, let tesseract estimate it
+	if(dpi > 0) {
+		tess.SetSourceResolution(dpi);
+	}
+	// Restrict recognition to the content area, the results remain in image coordinates
+	int x, y, w, h;
+	if(options.cropToContent && ImagePreprocessor::contentBounds(image->get_data(), image->get_width(), image->get_height(), image->get_stride(), x, y, w, h)) {
+		tess.SetRectangle(x, y, w, h);
+	}
+}
+
 bool Recognizer::recognizeImage(const Cairo::RefPtr<Cairo::ImageSurface> &img, OutputDestination dest) {
 	tesseract::TessBaseAPI tess;
 	if(!initTesseract(tess, m_curLang.prefix.c_str())) {
 		Utils::message_dialog(Gtk::MESSAGE_ERROR, _("Recognition errors occurred"), _("Failed to initialize tesseract"));
 		return false;
 	}
-	tess.SetImage(img->get_data(), img->get_width(), img->get_height(), 4, 4 * img->get_width());
+	setImage(tess, img, getPreprocessingOptions(), MAIN->getDisplayer()->getCurrentDpi());
 	ProgressMonitor monitor(1);
 	MAIN->showProgress(&monitor);
 	if(dest == OutputDestination::Buffer) {
@@ -516,6 +603,8 @@ bool Recognizer::recognizeImage(const Cairo::RefPtr<Cairo::ImageSurface> &img, O
 		readSessionData->file = MAIN->getDisplayer()->getCurrentImage(readSessionData->page);
 		readSessionData->angle = MAIN->getDisplayer()->getCurrentAngle();
 		readSessionData->resolution = MAIN->getDisplayer()->getCurrentResolution();
+		readSessionData->imageWidth = img->get_width();
+		readSessionData->imageHeight = img->get_height();
 		Utils::busyTask([&] {
 			tess.Recognize(&monitor.desc);
 			if(!monitor.canceled) {
@@ -549,7 +638,10 @@ bool Recognizer::setPage(int page, bool autodetectLayout) {
 		success = MAIN->getDisplayer()->setCurrentPage(page);
 	}
 	if(autodetectLayout) {
+		// Layout detection deskews the page itself
 		MAIN->getDisplayer()->autodetectOCRAreas();
+	} else if(success && MAIN->getConfig()->getSetting<VarSetting<bool>>("preprocdeskew")->getValue()) {
+		MAIN->getDisplayer()->deskew();
 	}
 	return success;
 }
@@ -22,6 +22,7 @@
 
 #include "common.hh"
 #include "Config.hh"
+#include "ImagePreprocessor.hh"
 
 #include <cairomm/cairomm.h>
 
@@ -65,12 +66,15 @@ private:
 	sigc::signal<void,Config::Lang> m_signal_languageChanged;
 	Gtk::RadioButtonGroup m_langMenuRadioGroup;
 	Gtk::RadioButtonGroup m_psmRadioGroup;
+	Gtk::RadioButtonGroup m_preprocRadioGroup;
 	int m_currentPsmMode;
 	std::vector<std::pair<Gtk::CheckMenuItem*,Glib::ustring>> m_langMenuCheckGroup;
 	MultilingualMenuItem* m_multilingualRadio = nullptr;
 	Config::Lang m_curLang;
 
 	bool initTesseract(tesseract::TessBaseAPI& tess, const char* language = nullptr) const;
+	ImagePreprocessor::Options getPreprocessingOptions() const;
+	void setImage(tesseract::TessBaseAPI& tess, const Cairo::RefPtr<Cairo::ImageSurface>& image, ImagePreprocessor::Options options, int dpi) const;
 	void recognizeButtonClicked();
 	void recognizeCurrentPage();
 	void recognizeMultiplePages();
@@ -127,6 +127,16 @@ std::vector<Source*> SourceManager::getSelectedSources() const {
 	return selectedSources;
 }
 
+const Source* SourceManager::getSource(const std::string& path) const {
+	for(const Gtk::TreeModel::Row& row : m_listView->get_model()->children()) {
+		const Source* source = row.get_value(m_listViewCols.source);
+		if(source && source->file->get_path() == path) {
+			return source;
+		}
+	}
+	return nullptr;
+}
+
 void SourceManager::openSources() {
 	std::vector<Source*> curSrc = getSelectedSources();
 	std::string initialFolder = !curSrc.empty() ? Glib::path_get_dirname(curSrc.front()->file->get_path()) : "";
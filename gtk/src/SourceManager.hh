@@ -33,6 +33,8 @@ struct Source {
 	int brightness = 0;
 	int contrast = 0;
 	int resolution = -1;
+	// The resolution follows the native DPI of each page until it is set by the user
+	bool autoResolution = false;
 	int page = 1;
 	std::vector<double> angle;
 	bool invert = false;
@@ -45,6 +47,8 @@ public:
 
 	void addSources(const std::vector<Glib::RefPtr<Gio::File>>& files);
 	std::vector<Source*> getSelectedSources() const;
+	// The source opened from the file, nullptr if the file is not among the sources
+	const Source* getSource(const std::string& path) const;
 	sigc::signal<void> signal_sourceChanged() {
 		return m_signal_sourceChanged;
 	}
@@ -291,6 +291,11 @@ Glib::ustring Utils::getSpellingLanguage(const Glib::ustring& lang) {
 	return syslocale;
 }
 
+Glib::Threads::Mutex& Utils::spellingMutex() {
+	static Glib::Threads::Mutex mutex;
+	return mutex;
+}
+
 Glib::ustring Utils::resolveFontName(const Glib::ustring& family) {
 	Glib::ustring resolvedName = family;
 
@@ -66,6 +66,8 @@ void handle_drag_drop(const Glib::RefPtr<Gdk::DragContext>& context, int x, int
 Glib::RefPtr<Glib::ByteArray> download(const std::string& url, Glib::ustring& messages, unsigned timeout = 60000);
 
 Glib::ustring getSpellingLanguage(const Glib::ustring& lang = Glib::ustring());
+// Held around every enchant call: all spell checkers of the process share one broker, which is not thread-safe
+Glib::Threads::Mutex& spellingMutex();
 
 Glib::ustring resolveFontName(const Glib::ustring& family);
 
@@ -19,13 +19,24 @@
 
 #include "common.hh"
 #include "CrashHandler.hh"
+#include "OutputEditorHOCR.hh"
+#include <QFile>
 #include <QPushButton>
 
 CrashHandler::CrashHandler(int pid, const QString& savefile, QWidget *parent):
 	QDialog(parent), m_pid(pid) {
 	ui.setupUi(this);
 
-	if(!savefile.isEmpty()) {
+	if(!savefile.isEmpty() && savefile == OutputEditorHOCR::journalFilename(pid)) {
+		if(!QFile::exists(savefile)) {
+			// Removed when the journal could not be written
+			ui.labelAutosave->setText(_("Your work could not be recorded for recovery and is lost."));
+		} else if(HOCRDocument::hasUnsavedEdits(HOCRJournal::read(QFile::encodeName(savefile).constData()))) {
+			ui.labelAutosave->setText(_("Your work will be recovered the next time %1 is started.").arg(PACKAGE_NAME));
+		} else {
+			ui.labelAutosave->setText(_("There was no unsaved work."));
+		}
+	} else if(!savefile.isEmpty()) {
 		ui.labelAutosave->setText(_("Your work has been saved under <b>%1</b>.").arg(savefile));
 	} else {
 		ui.labelAutosave->setText(_("There was no unsaved work."));
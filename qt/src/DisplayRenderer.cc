@@ -17,7 +17,9 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <QFile>
 #include <QImageReader>
+#include <QTransform>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #include <poppler-qt4.h>
 #else
@@ -25,6 +27,8 @@
 #endif
 
 #include "DisplayRenderer.hh"
+#include "ImageDensity.hh"
+#include "ImageRotate.hh"
 #include "Utils.hh"
 
 void DisplayRenderer::adjustImage(QImage &image, int brightness, int contrast, bool invert) const {
@@ -69,16 +73,42 @@ void DisplayRenderer::adjustImage(QImage &image, int brightness, int contrast, b
 
 ImageRenderer::ImageRenderer(const QString &filename) : DisplayRenderer(filename) {
 	m_pageCount = QImageReader(m_filename).imageCount();
+	m_nativeDpi = ImageDensity::read(QFile::encodeName(m_filename).constData());
+	// Densities below 100 DPI are mostly defaults written by software, treat them as unknown
+	for(int& dpi : m_nativeDpi) {
+		if(dpi < 100) {
+			dpi = 0;
+		}
+	}
 }
 
 QImage ImageRenderer::render(int page, double resolution) const {
 	QImageReader reader(m_filename);
 	reader.jumpToImage(page - 1);
 	reader.setBackgroundColor(Qt::white);
-	reader.setScaledSize(reader.size() * resolution / 100.);
+	// Avoid a needless resampling pass when rendering at the native size
+	if(resolution != 100.) {
+		reader.setScaledSize(reader.size() * resolution / 100.);
+	}
 	return reader.read().convertToFormat(QImage::Format_RGB32);
 }
 
+int ImageRenderer::getDpi(int page, double resolution) const {
+	int dpi = page >= 1 && page <= int(m_nativeDpi.size()) ? m_nativeDpi[page - 1] : 0;
+	return qRound(dpi * resolution / 100.);
+}
+
+int ImageRenderer::getRecommendedResolution(int page) const {
+	static constexpr int minDpi = 250;
+	static constexpr int maxDpi = 600;
+	static constexpr int targetDpi = 300;
+	int dpi = getDpi(page, 100.);
+	if(dpi == 0 || (dpi >= minDpi && dpi <= maxDpi)) {
+		return 100;
+	}
+	return qRound(targetDpi * 100. / dpi);
+}
+
 PDFRenderer::PDFRenderer(const QString& filename) : DisplayRenderer(filename) {
 	m_document = Poppler::Document::load(filename);
 	if(m_document) {
@@ -106,3 +136,47 @@ QImage PDFRenderer::render(int page, double resolution) const {
 int PDFRenderer::getNPages() const {
 	return m_document ? m_document->numPages() : 1;
 }
+
+bool PageRasterizer::setPage(const QString& filename, int page, double resolution, double angle, int brightness, int contrast, bool invert) {
+	if(filename != m_filename || !m_renderer) {
+		delete m_renderer;
+		if(filename.endsWith(".pdf", Qt::CaseInsensitive)) {
+			m_renderer = new PDFRenderer(filename);
+		} else {
+			m_renderer = new ImageRenderer(filename);
+		}
+		m_filename = filename;
+		m_image = QImage();
+	} else if(!m_image.isNull() && page == m_page && resolution == m_resolution &&
+	          brightness == m_brightness && contrast == m_contrast && invert == m_invert) {
+		m_angle = angle;
+		return true;
+	}
+	m_page = page;
+	m_resolution = resolution;
+	m_angle = angle;
+	m_brightness = brightness;
+	m_contrast = contrast;
+	m_invert = invert;
+	m_image = m_renderer->render(page, resolution);
+	if(m_image.isNull()) {
+		return false;
+	}
+	// Adjusted once for the whole page, getRegion then only crops
+	m_renderer->adjustImage(m_image, brightness, contrast, invert);
+	return true;
+}
+
+QImage PageRasterizer::getRegion(const QRect& rect) const {
+	// Same geometry as the displayer: the region is given relative to the top-left corner of
+	// the bounding box of the rotated page, which is centered on the origin
+	QRectF pageRect(m_image.width() * -0.5, m_image.height() * -0.5, m_image.width(), m_image.height());
+	QTransform transform;
+	transform.rotate(m_angle);
+	QPoint origin = transform.mapRect(pageRect).toRect().topLeft();
+	QImage image(rect.width(), rect.height(), QImage::Format_RGB32);
+	ImageRotate::rotate(m_image.constBits(), m_image.width(), m_image.height(), m_image.bytesPerLine(),
+	                    image.bits(), image.width(), image.height(), image.bytesPerLine(),
+	                    m_angle, rect.x() + origin.x(), rect.y() + origin.y(), qRgb(0, 0, 0));
+	return image;
+}
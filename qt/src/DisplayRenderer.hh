@@ -20,10 +20,12 @@
 #ifndef DISPLAYRENDERER_HH
 #define DISPLAYRENDERER_HH
 
+#include <QImage>
 #include <QString>
 #include <QMutex>
+#include <vector>
 
-class QImage;
+class QRect;
 namespace Poppler {
 class Document;
 }
@@ -34,6 +36,8 @@ public:
 	virtual ~DisplayRenderer() {}
 	virtual QImage render(int page, double resolution) const = 0;
 	virtual int getNPages() const = 0;
+	// Effective DPI of a page rendered at the specified resolution, 0 if unknown
+	virtual int getDpi(int page, double resolution) const = 0;
 
 	void adjustImage(QImage& image, int brightness, int contrast, bool invert) const;
 
@@ -46,8 +50,14 @@ public:
 	ImageRenderer(const QString& filename) ;
 	QImage render(int page, double resolution) const override;
 	int getNPages() const override{ return m_pageCount; }
+	int getDpi(int page, double resolution) const override;
+	// Resolution (in percent) which brings the page into the DPI range tesseract works best at
+	int getRecommendedResolution(int page) const;
+
 private:
 	int m_pageCount;
+	// Per page, read from the file headers
+	std::vector<int> m_nativeDpi;
 };
 
 class PDFRenderer : public DisplayRenderer {
@@ -56,10 +66,35 @@ public:
 	~PDFRenderer();
 	QImage render(int page, double resolution) const override;
 	int getNPages() const override;
+	int getDpi(int /*page*/, double resolution) const override{ return resolution; }
 
 private:
 	Poppler::Document* m_document;
 	mutable QMutex m_mutex;
 };
 
+// Renders regions of source pages for the PDF export, independently of the displayer
+class PageRasterizer {
+public:
+	~PageRasterizer() {
+		delete m_renderer;
+	}
+	// Renders the page of the file rotated by angle (in degrees) with the brightness, contrast and
+	// invert settings of its source, the last page is kept so that rendering the same page again is free
+	bool setPage(const QString& filename, int page, double resolution, double angle, int brightness = 0, int contrast = 0, bool invert = false);
+	// Returns the region of the rotated page, relative to its top-left corner
+	QImage getRegion(const QRect& rect) const;
+
+private:
+	DisplayRenderer* m_renderer = nullptr;
+	QString m_filename;
+	int m_page = 0;
+	double m_resolution = 0.;
+	double m_angle = 0.;
+	int m_brightness = 0;
+	int m_contrast = 0;
+	bool m_invert = false;
+	QImage m_image;
+};
+
 #endif // IMAGERENDERER_HH
@@ -21,6 +21,8 @@
 #include "Config.hh"
 #include "Displayer.hh"
 #include "DisplayRenderer.hh"
+#include "ImagePreprocessor.hh"
+#include "ImageRotate.hh"
 #include "SourceManager.hh"
 #include "Utils.hh"
 
@@ -104,7 +106,10 @@ bool Displayer::setCurrentPage(int page) {
 			if(source->resolution == -1) source->resolution = 300;
 		} else {
 			m_renderer = new ImageRenderer(source->path);
-			if(source->resolution == -1) source->resolution = 100;
+			if(source->resolution == -1) {
+				source->resolution = 100;
+				source->autoResolution = true;
+			}
 		}
 
 		Utils::setSpinBlocked(ui.spinBoxBrightness, source->brightness);
@@ -115,6 +120,10 @@ bool Displayer::setCurrentPage(int page) {
 		ui.checkBoxInvertColors->blockSignals(false);
 		m_currentSource = source;
 	}
+	if(source->autoResolution) {
+		// Pages of multipage files can differ in DPI
+		Utils::setSpinBlocked(ui.spinBoxResolution, static_cast<ImageRenderer*>(m_renderer)->getRecommendedResolution(m_pageMap[page].second));
+	}
 	Utils::setSpinBlocked(ui.spinBoxRotation, source->angle[m_pageMap[page].second - 1]);
 	Utils::setSpinBlocked(ui.spinBoxPage, page);
 
@@ -135,6 +144,10 @@ int Displayer::getCurrentResolution() const {
 	return ui.spinBoxResolution->value();
 }
 
+int Displayer::getCurrentDpi() const {
+	return m_renderer ? m_renderer->getDpi(m_currentSource->page, m_currentSource->resolution) : 0;
+}
+
 QString Displayer::getCurrentImage(int& page) const {
 	page = m_pageMap[ui.spinBoxPage->value()].second;
 	return m_pageMap[ui.spinBoxPage->value()].first ? m_pageMap[ui.spinBoxPage->value()].first->path : "";
@@ -167,6 +180,7 @@ bool Displayer::setSources(QList<Source*> sources) {
 	m_currentSource = nullptr;
 	m_sources.clear();
 	m_pageMap.clear();
+	m_image = QImage();
 	m_pixmap = QPixmap();
 	m_imageItem = nullptr;
 	ui.actionBestFit->setChecked(true);
@@ -263,7 +277,8 @@ bool Displayer::renderImage() {
 		return false;
 	}
 	m_renderer->adjustImage(image, m_currentSource->brightness, m_currentSource->contrast, m_currentSource->invert);
-	m_pixmap = QPixmap::fromImage(image);
+	m_image = image;
+	m_pixmap = QPixmap::fromImage(m_image);
 	m_imageItem->setPixmap(m_pixmap);
 	m_imageItem->setScale(1.);
 	m_imageItem->setTransformOriginPoint(m_imageItem->boundingRect().center());
@@ -369,6 +384,7 @@ void Displayer::resolutionChanged() {
 	int resolution = ui.spinBoxResolution->value();
 	for(int page : m_pageMap.keys()) {
 		m_pageMap[page].first->resolution = resolution;
+		m_pageMap[page].first->autoResolution = false;
 	}
 	queueRenderImage();
 }
@@ -484,24 +500,32 @@ void Displayer::rotate90() {
 
 QImage Displayer::getImage(const QRectF& rect) {
 	QImage image(rect.width(), rect.height(), QImage::Format_RGB32);
-	image.fill(Qt::black);
-	QPainter painter(&image);
-	painter.setRenderHint(QPainter::SmoothPixmapTransform);
-	QTransform t;
-	t.translate(-rect.x(), -rect.y());
-	t.rotate(ui.spinBoxRotation->value());
-	t.translate(-0.5 * m_pixmap.width(), -0.5 * m_pixmap.height());
-	painter.setTransform(t);
-	painter.drawPixmap(0, 0, m_pixmap);
+	ImageRotate::rotate(m_image.constBits(), m_image.width(), m_image.height(), m_image.bytesPerLine(),
+	                    image.bits(), image.width(), image.height(), image.bytesPerLine(),
+	                    ui.spinBoxRotation->value(), rect.x(), rect.y(), qRgb(0, 0, 0));
 	return image;
 }
 
+bool Displayer::deskew() {
+	if(!m_imageItem) {
+		return false;
+	}
+	QImage image = getImage(getSceneBoundingRect());
+	double angle = ImagePreprocessor::estimateSkew(image.constBits(), image.width(), image.height(), image.bytesPerLine());
+	angle = qRound(angle * 10.) / 10.;
+	if(qAbs(angle) <= .1) {
+		return false;
+	}
+	setAngle(getCurrentAngle() + angle);
+	return true;
+}
+
 QRectF Displayer::getSceneBoundingRect() const {
 	// We cannot use m_imageItem->sceneBoundingRect() since its pixmap
 	// can currently be downscaled and therefore have slightly different
 	// proportions.
-	int width = m_pixmap.width();
-	int height = m_pixmap.height();
+	int width = m_image.width();
+	int height = m_image.height();
 	QRectF rect(width * -0.5, height * -0.5, width, height);
 	QTransform transform;
 	transform.rotate(ui.spinBoxRotation->value());
@@ -52,9 +52,11 @@ public:
 		return m_scale;
 	}
 	int getCurrentResolution() const;
+	int getCurrentDpi() const;
 	QString getCurrentImage(int& page) const;
 	QImage getImage(const QRectF& rect);
 	QRectF getSceneBoundingRect() const;
+	bool deskew();
 	QPointF mapToSceneClamped(const QPoint& p) const;
 	int getNPages() const;
 	bool hasMultipleOCRAreas();
@@ -76,6 +78,7 @@ private:
 	QMap<int, QPair<Source*, int>> m_pageMap;
 	Source* m_currentSource = nullptr;
 	DisplayRenderer* m_renderer = nullptr;
+	QImage m_image;
 	QPixmap m_pixmap;
 	QGraphicsPixmapItem* m_imageItem = nullptr;
 	double m_scale = 1.0;
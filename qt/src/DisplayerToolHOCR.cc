@@ -44,6 +44,10 @@ void DisplayerToolHOCR::mousePressEvent(QMouseEvent *event) {
 		m_selection = new DisplayerSelection(this,  m_displayer->mapToSceneClamped(event->pos()));
 		m_displayer->scene()->addItem(m_selection);
 		event->accept();
+	} else if(event->button() == Qt::LeftButton) {
+		QPointF p = m_displayer->mapToSceneClamped(event->pos()) - m_displayer->getSceneBoundingRect().topLeft();
+		emit positionPicked(p.toPoint());
+		event->accept();
 	}
 }
 
@@ -56,6 +56,8 @@ public:
 signals:
 	void selectionDrawn(QRect rect);
 	void selectionGeometryChanged(QRect rect);
+	// A point of the image was clicked while not drawing a selection
+	void positionPicked(QPoint point);
 
 private:
 	DisplayerSelection* m_selection = nullptr;
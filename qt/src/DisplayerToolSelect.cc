@@ -147,16 +147,17 @@ void DisplayerToolSelect::updateRecognitionModeLabel() {
 	MAIN->getRecognizer()->setRecognizeMode(m_selections.isEmpty() ? _("Recognize all") : _("Recognize selection"));
 }
 
-void DisplayerToolSelect::autodetectLayout(bool noDeskew) {
+void DisplayerToolSelect::autodetectLayout() {
 	clearSelections();
 
-	double avgDeskew = 0.;
-	int nDeskew = 0;
+	// Straighten the page first, so that the layout only needs to be analyzed once
+	m_displayer->deskew();
+
 	QList<QRectF> rects;
 	QImage img = m_displayer->getImage(m_displayer->getSceneBoundingRect());
 
 	// Perform layout analysis
-	Utils::busyTask([this,&nDeskew,&avgDeskew,&rects,&img] {
+	Utils::busyTask([this,&rects,&img] {
 		tesseract::TessBaseAPI tess;
 		tess.InitForAnalysePage();
 		tess.SetPageSegMode(tesseract::PSM_AUTO_ONLY);
@@ -165,14 +166,7 @@ void DisplayerToolSelect::autodetectLayout(bool noDeskew) {
 		if(it && !it->Empty(tesseract::RIL_BLOCK)) {
 			do {
 				int x1, y1, x2, y2;
-				tesseract::Orientation orient;
-				tesseract::WritingDirection wdir;
-				tesseract::TextlineOrder tlo;
-				float deskew;
 				it->BoundingBox(tesseract::RIL_BLOCK, &x1, &y1, &x2, &y2);
-				it->Orientation(&orient, &wdir, &tlo, &deskew);
-				avgDeskew += deskew;
-				++nDeskew;
 				float width = x2 - x1, height = y2 - y1;
 				if(width > 10 && height > 10) {
 					rects.append(QRectF(x1 - 0.5 * img.width(), y1 - 0.5 * img.height(), width, height));
@@ -183,30 +177,22 @@ void DisplayerToolSelect::autodetectLayout(bool noDeskew) {
 		return true;
 	}, _("Performing layout analysis"));
 
-	// If a somewhat large deskew angle is detected, automatically rotate image and redetect layout,
-	// unless we already attempted to rotate (to prevent endless loops)
-	avgDeskew = qRound(((avgDeskew/nDeskew)/M_PI * 180.) * 10.) / 10.;
-	if(qAbs(avgDeskew > .1) && !noDeskew) {
-		m_displayer->setAngle(m_displayer->getCurrentAngle() - avgDeskew);
-		autodetectLayout(true);
-	} else {
-		// Merge overlapping rectangles
-		for(int i = rects.size(); i-- > 1;) {
-			for(int j = i; j-- > 0;) {
-				if(rects[j].intersects(rects[i])) {
-					rects[j] = rects[j].united(rects[i]);
-					rects.removeAt(i);
-					break;
-				}
+	// Merge overlapping rectangles
+	for(int i = rects.size(); i-- > 1;) {
+		for(int j = i; j-- > 0;) {
+			if(rects[j].intersects(rects[i])) {
+				rects[j] = rects[j].united(rects[i]);
+				rects.removeAt(i);
+				break;
 			}
 		}
-		for(int i = 0, n = rects.size(); i < n; ++i) {
-			m_selections.append(new NumberedDisplayerSelection(this, 1 + i, rects[i].topLeft()));
-			m_selections.back()->setPoint(rects[i].bottomRight());
-			m_displayer->scene()->addItem(m_selections.back());
-		}
-		updateRecognitionModeLabel();
 	}
+	for(int i = 0, n = rects.size(); i < n; ++i) {
+		m_selections.append(new NumberedDisplayerSelection(this, 1 + i, rects[i].topLeft()));
+		m_selections.back()->setPoint(rects[i].bottomRight());
+		m_displayer->scene()->addItem(m_selections.back());
+	}
+	updateRecognitionModeLabel();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -66,7 +66,7 @@ private:
 	void updateRecognitionModeLabel();
 
 private slots:
-	void autodetectLayout(bool noDeskew = false);
+	void autodetectLayout();
 };
 
 class NumberedDisplayerSelection : public DisplayerSelection {
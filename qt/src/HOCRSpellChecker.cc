@@ -0,0 +1,85 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRSpellChecker.cc
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QMap>
+#include <QtSpell.hpp>
+
+#include "HOCRSpellChecker.hh"
+
+
+HOCRSpellChecker::HOCRSpellChecker(QObject* parent)
+	: QObject(parent), m_thread(std::bind(&HOCRSpellChecker::run, this)) {
+	m_thread.start();
+}
+
+HOCRSpellChecker::~HOCRSpellChecker() {
+	m_requestQueue.enqueue({Request::Type::Quit, Key()});
+	m_thread.wait();
+}
+
+HOCRSpellChecker::Verdict HOCRSpellChecker::check(const QString& lang, const QString& word) {
+	Key key(lang, word);
+	QMutexLocker locker(&m_cacheMutex);
+	auto it = m_cache.find(key);
+	if(it != m_cache.end()) {
+		return it.value();
+	}
+	m_cache.insert(key, Verdict::Pending);
+	m_requestQueue.enqueue({Request::Type::Check, key});
+	return Verdict::Pending;
+}
+
+void HOCRSpellChecker::setCorrect(const QString& lang, const QString& word) {
+	QMutexLocker locker(&m_cacheMutex);
+	m_cache.insert(Key(lang, word), Verdict::Correct);
+}
+
+void HOCRSpellChecker::run() {
+	// One checker per language, so that mixed-language pages don't keep reloading dictionaries
+	QMap<QString, QtSpell::TextEditChecker*> checkers;
+	while(true) {
+		Request request = m_requestQueue.dequeue();
+		if(request.type == Request::Type::Quit) {
+			break;
+		}
+		Verdict verdict;
+		{
+			QMutexLocker locker(&Utils::spellingMutex());
+			QtSpell::TextEditChecker*& checker = checkers[request.key.first];
+			if(!checker) {
+				checker = new QtSpell::TextEditChecker;
+				checker->setLanguage(request.key.first);
+			}
+			verdict = checker->checkWord(request.key.second) ? Verdict::Correct : Verdict::Misspelled;
+		}
+		{
+			QMutexLocker locker(&m_cacheMutex);
+			// Don't override words which were marked as correct in the meantime
+			Verdict& cached = m_cache[request.key];
+			if(cached == Verdict::Pending) {
+				cached = verdict;
+			}
+		}
+		if(m_requestQueue.empty()) {
+			emit wordsChecked();
+		}
+	}
+	QMutexLocker locker(&Utils::spellingMutex());
+	qDeleteAll(checkers);
+}
@@ -0,0 +1,73 @@
+/* -*- Mode: C++; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*-  */
+/*
+ * HOCRSpellChecker.hh
+ * Copyright (C) 2013-2017 Sandro Mani <manisandro@gmail.com>
+ *
+ * gImageReader is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gImageReader is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOCRSPELLCHECKER_HH
+#define HOCRSPELLCHECKER_HH
+
+#include <functional>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QThread>
+
+#include "Utils.hh"
+
+// Checks the spelling of hOCR words on a worker thread and caches the verdicts per (language, word)
+class HOCRSpellChecker : public QObject {
+	Q_OBJECT
+public:
+	enum class Verdict { Pending, Correct, Misspelled };
+
+	HOCRSpellChecker(QObject* parent = nullptr);
+	~HOCRSpellChecker();
+
+	// Returns the cached verdict, or queues the word for checking and returns Pending
+	Verdict check(const QString& lang, const QString& word);
+	// Marks the word as correct, i.e. after it was added to the dictionary or ignored
+	void setCorrect(const QString& lang, const QString& word);
+
+signals:
+	// Emitted whenever the queue of pending words has been drained
+	void wordsChecked();
+
+private:
+	typedef QPair<QString, QString> Key;
+	struct Request {
+		enum class Type { Check, Quit } type;
+		Key key;
+	};
+	class WorkerThread : public QThread {
+	public:
+		WorkerThread(const std::function<void()> &f) : m_f(f) {}
+	private:
+		std::function<void()> m_f;
+		void run() {
+			m_f();
+		}
+	};
+
+	QMutex m_cacheMutex;
+	QHash<Key, Verdict> m_cache;
+	Utils::AsyncQueue<Request> m_requestQueue;
+	WorkerThread m_thread;
+
+	void run();
+};
+
+#endif // HOCRSPELLCHECKER_HH
@@ -22,6 +22,7 @@
 #include <QDBusConnectionInterface>
 #include <QDesktopServices>
 #include <QDir>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QNetworkProxy>
 #include <QProcess>
@@ -58,7 +59,10 @@ void MainWindow::signalHandler(int signal) {
 	std::signal(signal, nullptr);
 
 	QString filename;
-	if(MAIN->getOutputEditor() && MAIN->getOutputEditor()->getModified()) {
+	if(MAIN->m_crashJournalActive) {
+		// Saving is not safe at this point, the output is recovered from the journal on the next start instead
+		filename = MAIN->m_crashJournal;
+	} else if(MAIN->getOutputEditor() && MAIN->getOutputEditor()->getModified()) {
 		filename = QDir(Utils::documentsFolder()).absoluteFilePath(QString("%1_crash-save.txt").arg(PACKAGE_NAME));
 		int i = 0;
 		while(QFile(filename).exists()) {
@@ -103,6 +107,7 @@ MainWindow::MainWindow(const QStringList& files)
 	: m_idleActions(0) {
 	s_instance = this;
 
+	m_crashJournal = OutputEditorHOCR::journalFilename(QApplication::applicationPid());
 	std::signal(SIGSEGV, signalHandler);
 	std::signal(SIGABRT, signalHandler);
 #ifndef __ARMEL__
@@ -193,6 +198,23 @@ MainWindow::MainWindow(const QStringList& files)
 	}
 #endif
 
+	// Offer to recover the hOCR output of sessions which crashed, the journals of running sessions are locked
+	QDir journalDir(OutputEditorHOCR::journalDirectory());
+	for(const QString& name : journalDir.entryList(QStringList() << "hocr-journal-*", QDir::Files)) {
+		QString journal = journalDir.absoluteFilePath(name);
+		if(journal == m_crashJournal || !HOCRJournal::isOrphan(QFile::encodeName(journal).constData())) {
+			continue;
+		}
+		std::vector<HOCRJournal::Record> records = HOCRJournal::read(QFile::encodeName(journal).constData());
+		if(HOCRDocument::hasUnsavedEdits(records) && QMessageBox::question(this, _("Recover output"), _("A previous session did not terminate properly. Recover the unsaved hOCR output?"), QMessageBox::Yes, QMessageBox::No) == QMessageBox::Yes) {
+			ui.comboBoxOCRMode->setCurrentIndex(1);
+			if(!static_cast<OutputEditorHOCR*>(m_outputEditor)->recoverJournal(records)) {
+				QMessageBox::warning(this, _("Recover output"), _("The output could only be partially recovered."));
+			}
+		}
+		QFile::remove(journal);
+	}
+
 	m_sourceManager->addSources(files);
 }
 
@@ -306,6 +328,7 @@ void MainWindow::setOCRMode(int idx) {
 		}
 		ui.comboBoxOCRMode->blockSignals(false);
 	} else {
+		m_crashJournalActive = 0;
 		delete m_displayerTool;
 		delete m_outputEditor;
 		if(idx == 0) {
@@ -314,6 +337,7 @@ void MainWindow::setOCRMode(int idx) {
 		} else { /*if(idx == 1)*/
 			m_displayerTool = new DisplayerToolHOCR(m_displayer);
 			m_outputEditor = new OutputEditorHOCR(static_cast<DisplayerToolHOCR*>(m_displayerTool));
+			m_crashJournalActive = 1;
 		}
 		m_displayer->setTool(m_displayerTool);
 		connect(m_recognizer, SIGNAL(languageChanged(Config::Lang)), m_outputEditor, SLOT(setLanguage(Config::Lang)));
@@ -434,7 +458,12 @@ void MainWindow::languageChanged() {
 	hideNotification(m_notifierHandle);
 	m_notifierHandle = nullptr;
 	const QString& code = m_recognizer->getSelectedLanguage().code;
-	if(!code.isEmpty() && !QtSpell::checkLanguageInstalled(code) && m_config->getSetting<SwitchSetting>("dictinstall")->getValue()) {
+	bool installed = true;
+	if(!code.isEmpty()) {
+		QMutexLocker locker(&Utils::spellingMutex());
+		installed = QtSpell::checkLanguageInstalled(code);
+	}
+	if(!code.isEmpty() && !installed && m_config->getSetting<SwitchSetting>("dictinstall")->getValue()) {
 		NotificationAction actionDontShowAgain = {_("Don't show again"), m_config, SLOT(disableDictInstall()), true};
 		NotificationAction actionInstall = {_("Install"), this, SLOT(dictionaryAutoinstall()), false};
 #ifdef Q_OS_LINUX
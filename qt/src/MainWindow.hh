@@ -26,6 +26,7 @@
 #include <QStringList>
 #include <QThread>
 #include <QTimer>
+#include <csignal>
 
 #include "common.hh"
 #include "Ui_MainWindow.hh"
@@ -118,6 +119,10 @@ private:
 
 	MainWindow::Notification m_notifierHandle = nullptr;
 
+	// Only read by the signal handler, which cannot compute anything safely
+	QString m_crashJournal;
+	volatile std::sig_atomic_t m_crashJournalActive = 0;
+
 	QWidget* m_progressWidget = nullptr;
 	QProgressBar* m_progressBar = nullptr;
 	QToolButton* m_progressCancelButton = nullptr;
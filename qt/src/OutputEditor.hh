@@ -36,6 +36,9 @@ public:
 		QString file;
 		double angle;
 		int resolution;
+		// Size of the recognized image, tesseract reports the recognition rectangle as page bbox
+		int imageWidth = 0;
+		int imageHeight = 0;
 	};
 
 	OutputEditor(QObject* parent = 0);
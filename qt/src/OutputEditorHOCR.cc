@@ -19,45 +19,148 @@
 
 #include <QApplication>
 #include <QBuffer>
+#include <QDesktopServices>
 #include <QDir>
-#include <QDomDocument>
 #include <QGraphicsPixmapItem>
 #include <QImage>
 #include <QMessageBox>
 #include <QFileInfo>
 #include <QFileDialog>
 #include <QPainter>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QStandardPaths>
+#endif
 #include <QStandardItemModel>
 #include <QSyntaxHighlighter>
-#include <QTextStream>
+#include <QTransform>
+#include <QXmlStreamReader>
+#include <algorithm>
 #include <cstring>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <podofo/base/PdfArray.h>
 #include <podofo/base/PdfDictionary.h>
 #include <podofo/base/PdfFilter.h>
 #include <podofo/base/PdfStream.h>
 #include <podofo/doc/PdfFont.h>
 #include <podofo/doc/PdfIdentityEncoding.h>
 #include <podofo/doc/PdfImage.h>
+#include <podofo/doc/PdfMemDocument.h>
 #include <podofo/doc/PdfPage.h>
 #include <podofo/doc/PdfPainter.h>
 #include <podofo/doc/PdfStreamedDocument.h>
+#include <podofo/doc/PdfXObject.h>
 #include <tesseract/baseapi.h>
 #include <tesseract/ocrclass.h>
 
 #include "CCITTFax4Encoder.hh"
 #include "DisplayerToolHOCR.hh"
+#include "FlateEncoder.hh"
+#include "JBIG2Encoder.hh"
 #include "MainWindow.hh"
 #include "OutputEditorHOCR.hh"
 #include "Recognizer.hh"
 #include "SourceManager.hh"
 #include "Utils.hh"
+#include "WorkerPool.hh"
 #include "ui_PdfExportDialog.h"
 
 
-const QRegExp OutputEditorHOCR::s_bboxRx = QRegExp("bbox\\s+(\\d+)\\s+(\\d+)\\s+(\\d+)\\s+(\\d+)");
-const QRegExp OutputEditorHOCR::s_pageTitleRx = QRegExp("image\\s+'(.+)';\\s+bbox\\s+\\d+\\s+\\d+\\s+\\d+\\s+\\d+;\\s+pageno\\s+(\\d+);\\s+rot\\s+(\\d+\\.?\\d*);\\s+res\\s+(\\d+\\.?\\d*)");
-const QRegExp OutputEditorHOCR::s_idRx = QRegExp("(\\w+)_\\d+_(\\d+)");
-const QRegExp OutputEditorHOCR::s_fontSizeRx = QRegExp("x_fsize\\s+(\\d+)");
-const QRegExp OutputEditorHOCR::s_baseLineRx = QRegExp("baseline\\s+(-?\\d+\\.?\\d*)\\s+(-?\\d+)");
+static inline std::string toUtf8String(const QString& str) {
+	return std::string(str.toUtf8().constData());
+}
+
+static inline QString fromUtf8String(const std::string& str) {
+	return QString::fromUtf8(str.c_str(), str.size());
+}
+
+static inline QRect toQRect(const HOCRItem::BBox& bbox) {
+	return QRect(bbox.x1, bbox.y1, bbox.width(), bbox.height());
+}
+
+// Renders the source of the page at the given resolution, without going through the displayer,
+// but with the brightness, contrast and invert settings of the source as the displayer shows it
+static bool rasterizePage(PageRasterizer& rasterizer, const HOCRPage* page, int resolution) {
+	if(page->sourceFile().empty()) {
+		return false;
+	}
+	QString filename = fromUtf8String(page->sourceFile());
+	const Source* source = MAIN->getSourceManager()->getSource(filename);
+	if(!source) {
+		return rasterizer.setPage(filename, page->pageNr(), resolution, page->angle());
+	}
+	return rasterizer.setPage(filename, page->pageNr(), resolution, page->angle(), source->brightness, source->contrast, source->invert);
+}
+
+// Maps a page recorded by the PoDoFoPDFPainter to the user space of its source PDF page. The hOCR
+// page is the source page as rendered by poppler, that is its crop box turned by /Rotate, which is
+// then rotated by the angle of the page about its center, see PageRasterizer::getRegion.
+static QTransform sourcePageTransform(PoDoFo::PdfPage* page, double angle, double pageHeight) {
+	PoDoFo::PdfRect box = page->GetCropBox();
+	int rotation = ((page->GetRotation() % 360) + 360) % 360;
+	double width = rotation % 180 == 0 ? box.GetWidth() : box.GetHeight();
+	double height = rotation % 180 == 0 ? box.GetHeight() : box.GetWidth();
+	QTransform rotate;
+	rotate.rotate(angle);
+	QPointF origin = rotate.mapRect(QRectF(-0.5 * width, -0.5 * height, width, height)).topLeft();
+
+	QTransform transform(1, 0, 0, -1, 0, pageHeight);
+	transform *= QTransform::fromTranslate(origin.x(), origin.y());
+	transform *= rotate.inverted();
+	transform *= QTransform::fromTranslate(0.5 * width, 0.5 * height);
+	if(rotation == 90) {
+		transform *= QTransform(0, 1, 1, 0, box.GetLeft(), box.GetBottom());
+	} else if(rotation == 180) {
+		transform *= QTransform(-1, 0, 0, 1, box.GetLeft() + box.GetWidth(), box.GetBottom());
+	} else if(rotation == 270) {
+		transform *= QTransform(0, -1, -1, 0, box.GetLeft() + box.GetWidth(), box.GetBottom() + box.GetHeight());
+	} else {
+		transform *= QTransform(1, 0, 0, -1, box.GetLeft(), box.GetBottom() + box.GetHeight());
+	}
+	return transform;
+}
+
+// Parses the element at which the reader is positioned, up to and including its end tag
+static HOCRItem* parseItem(QXmlStreamReader& reader) {
+	HOCRItem::AttributeList attrs;
+	for(const QXmlStreamAttribute& attrib : reader.attributes()) {
+		attrs.push_back(std::make_pair(toUtf8String(attrib.qualifiedName().toString()), toUtf8String(attrib.value().toString())));
+	}
+	HOCRItem* item;
+	if(reader.attributes().value("class") == QLatin1String("ocr_page")) {
+		item = new HOCRPage(attrs);
+	} else {
+		item = new HOCRItem(toUtf8String(reader.name().toString()), attrs);
+	}
+	if(item->isWord()) {
+		QString text;
+		bool bold = false, italic = false;
+		for(int depth = 1; depth > 0 && !reader.atEnd();) {
+			QXmlStreamReader::TokenType token = reader.readNext();
+			if(token == QXmlStreamReader::StartElement) {
+				++depth;
+				bold |= reader.name() == QLatin1String("strong");
+				italic |= reader.name() == QLatin1String("em");
+			} else if(token == QXmlStreamReader::EndElement) {
+				--depth;
+			} else if(token == QXmlStreamReader::Characters) {
+				text += reader.text();
+			}
+		}
+		item->setText(toUtf8String(text.trimmed()));
+		item->setFontFlags(bold, italic);
+	} else {
+		while(reader.readNextStartElement()) {
+			if(reader.attributes().value("class").toString().startsWith("ocr")) {
+				item->appendChild(parseItem(reader));
+			} else {
+				reader.skipCurrentElement();
+			}
+		}
+	}
+	return item;
+}
 
 
 class OutputEditorHOCR::HTMLHighlighter : public QSyntaxHighlighter {
@@ -119,6 +222,325 @@ private:
 };
 
 
+// Text blocks are not shown, their paragraphs are listed directly below the page
+static bool isDisplayed(const HOCRItem* item) {
+	return item->isPage() || item->isGraphic() || item->isParagraph() || item->isLine() || item->isWord();
+}
+
+static int displayChildCount(const HOCRItem* item) {
+	int count = 0;
+	for(const HOCRItem* child : item->children()) {
+		if(isDisplayed(child)) {
+			++count;
+		} else if(child->itemClass() == "ocr_carea") {
+			count += displayChildCount(child);
+		}
+	}
+	return count;
+}
+
+static HOCRItem* displayParent(const HOCRItem* item) {
+	HOCRItem* parent = item->parent();
+	while(parent && !isDisplayed(parent)) {
+		parent = parent->parent();
+	}
+	return parent;
+}
+
+// The number of rows the item is displayed as
+static int displayRowCount(const HOCRItem* item) {
+	if(isDisplayed(item)) {
+		return 1;
+	}
+	return item->itemClass() == "ocr_carea" ? displayChildCount(item) : 0;
+}
+
+// The row at which the index-th child of parent is displayed, below the displayed ancestor of the child
+static int displayRowAt(const HOCRItem* parent, int index) {
+	int row = 0;
+	for(int i = 0; i < index; ++i) {
+		row += displayRowCount(parent->child(i));
+	}
+	if(!isDisplayed(parent) && parent->parent()) {
+		row += displayRowAt(parent->parent(), parent->index());
+	}
+	return row;
+}
+
+// Appends the displayed children of item in row order, text blocks being replaced by their children
+static void collectDisplayChildren(const HOCRItem* item, std::vector<HOCRItem*>& children) {
+	for(HOCRItem* child : item->children()) {
+		if(isDisplayed(child)) {
+			children.push_back(child);
+		} else if(child->itemClass() == "ocr_carea") {
+			collectDisplayChildren(child, children);
+		}
+	}
+}
+
+
+// Exposes the document to the item view. Rows are only created when the view asks for them,
+// i.e. when their parent is expanded, and their data is computed when they are painted.
+class OutputEditorHOCR::HOCRTreeModel : public QAbstractItemModel {
+public:
+	HOCRTreeModel(HOCRDocument* document, HOCRSpellChecker* spellChecker, QObject* parent = nullptr)
+		: QAbstractItemModel(parent), m_document(document), m_spellChecker(spellChecker) {}
+
+	QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override {
+		if(column != 0 || row < 0) {
+			return QModelIndex();
+		}
+		if(!parent.isValid()) {
+			return row == 0 ? documentIndex() : QModelIndex();
+		}
+		HOCRItem* parentItem = itemForIndex(parent);
+		if(!parentItem) {
+			return row < m_document->pageCount() ? createIndex(row, 0, m_document->page(row)) : QModelIndex();
+		}
+		const std::vector<HOCRItem*>& children = displayChildren(parentItem);
+		return row < int(children.size()) ? createIndex(row, 0, children[row]) : QModelIndex();
+	}
+	QModelIndex parent(const QModelIndex& child) const override {
+		HOCRItem* item = itemForIndex(child);
+		if(!item) {
+			return QModelIndex();
+		}
+		if(item->isPage()) {
+			return documentIndex();
+		}
+		return indexForItem(displayParent(item));
+	}
+	int rowCount(const QModelIndex& parent = QModelIndex()) const override {
+		if(!parent.isValid()) {
+			return 1;
+		}
+		HOCRItem* item = itemForIndex(parent);
+		if(!item) {
+			return m_document->pageCount();
+		}
+		return item->isWord() ? 0 : int(displayChildren(item).size());
+	}
+	int columnCount(const QModelIndex& /*parent*/ = QModelIndex()) const override {
+		return 1;
+	}
+	bool hasChildren(const QModelIndex& parent = QModelIndex()) const override {
+		HOCRItem* item = itemForIndex(parent);
+		return !item || (!item->isWord() && item->childCount() > 0);
+	}
+	QVariant data(const QModelIndex& index, int role) const override {
+		if(!index.isValid()) {
+			return QVariant();
+		}
+		HOCRItem* item = itemForIndex(index);
+		if(!item) {
+			return role == Qt::DisplayRole ? QVariant(_("Document")) : QVariant();
+		}
+		switch(role) {
+		case Qt::DisplayRole:
+		case Qt::EditRole:
+			if(item->isPage()) {
+				return fromUtf8String(static_cast<HOCRPage*>(item)->label());
+			} else if(item->isGraphic()) {
+				return _("Graphic");
+			} else if(item->isParagraph()) {
+				return _("Paragraph");
+			} else if(item->isLine()) {
+				return _("Textline");
+			}
+			return fromUtf8String(item->text());
+		case Qt::DecorationRole:
+			return itemIcon(item);
+		case Qt::CheckStateRole:
+			return item->isEnabled() ? Qt::Checked : Qt::Unchecked;
+		case Qt::ForegroundRole:
+			return item->isWord() && isMisspelled(item) ? QVariant(QBrush(Qt::red)) : QVariant();
+		case Qt::BackgroundRole:
+			return item->isWord() && isSearchMatch(item) ? QVariant(QBrush(Qt::yellow)) : QVariant();
+		case ClassRole:
+			return item->isGraphic() ? QString("ocr_graphic") : fromUtf8String(item->itemClass());
+		}
+		return QVariant();
+	}
+	bool setData(const QModelIndex& index, const QVariant& value, int role) override {
+		HOCRItem* item = itemForIndex(index);
+		if(!item) {
+			return false;
+		}
+		// Reported back through itemChanged()
+		if(role == Qt::CheckStateRole) {
+			m_document->setItemEnabled(item, value.toInt() == Qt::Checked);
+		} else if(role == Qt::EditRole && item->isWord()) {
+			m_document->setItemText(item, toUtf8String(value.toString()));
+		} else {
+			return false;
+		}
+		return true;
+	}
+	Qt::ItemFlags flags(const QModelIndex& index) const override {
+		HOCRItem* item = itemForIndex(index);
+		if(!item) {
+			return index.isValid() ? Qt::ItemIsEnabled : Qt::NoItemFlags;
+		}
+		Qt::ItemFlags flags = Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
+		if(item->isEnabled()) {
+			flags |= Qt::ItemIsSelectable;
+		}
+		if(item->isWord()) {
+			flags |= Qt::ItemIsEditable;
+		}
+		return flags;
+	}
+
+	QModelIndex documentIndex() const {
+		return createIndex(0, 0, nullptr);
+	}
+	HOCRItem* itemForIndex(const QModelIndex& index) const {
+		return index.isValid() ? static_cast<HOCRItem*>(index.internalPointer()) : nullptr;
+	}
+	QModelIndex indexForItem(const HOCRItem* item) const {
+		if(!item) {
+			return QModelIndex();
+		}
+		if(item->isPage()) {
+			const std::vector<HOCRPage*>& pages = m_document->pages();
+			int row = std::find(pages.begin(), pages.end(), item) - pages.begin();
+			return createIndex(row, 0, const_cast<HOCRItem*>(item));
+		}
+		const HOCRItem* parent = displayParent(item);
+		if(!parent) {
+			return QModelIndex();
+		}
+		displayChildren(parent);
+		return createIndex(m_displayRows[item], 0, const_cast<HOCRItem*>(item));
+	}
+	// Notifies the view that the displayed data of the item has changed
+	void itemChanged(const QModelIndex& index) {
+		emit dataChanged(index, index);
+	}
+
+	void itemChanged(const HOCRItem* item) {
+		QModelIndex index = indexForItem(item);
+		emit dataChanged(index, index);
+	}
+	// Highlights the words matching the text, the text being empty to highlight none
+	void setSearchText(const std::string& text, bool matchCase) {
+		m_searchText = text;
+		m_searchMatchCase = matchCase;
+	}
+
+	// Forwarded from the document observer
+	void beginInsertItem(const HOCRItem* parent, int index, const HOCRItem* item) {
+		if(!parent) {
+			beginRows(documentIndex(), index, 1, true);
+		} else {
+			const HOCRItem* displayedParent = isDisplayed(parent) ? parent : displayParent(parent);
+			beginRows(indexForItem(displayedParent), displayRowAt(parent, index), displayRowCount(item), true);
+		}
+		clearDisplayChildren();
+	}
+	void endInsertItem() {
+		clearDisplayChildren();
+		if(m_changingRows) {
+			endInsertRows();
+		}
+	}
+	void beginRemoveItem(const HOCRItem* item) {
+		if(item->isPage()) {
+			beginRows(documentIndex(), indexForItem(item).row(), 1, false);
+		} else {
+			beginRows(indexForItem(displayParent(item)), displayRowAt(item->parent(), item->index()), displayRowCount(item), false);
+		}
+		clearDisplayChildren();
+	}
+	void endRemoveItem() {
+		clearDisplayChildren();
+		if(m_changingRows) {
+			endRemoveRows();
+		}
+	}
+	void clear() {
+		beginResetModel();
+		m_document->clear();
+		clearDisplayChildren();
+		endResetModel();
+	}
+	QString spellingLanguage(const HOCRItem* item) const {
+		QString lang = fromUtf8String(item->attribute("lang"));
+		auto it = m_langCache.find(lang);
+		if(it == m_langCache.end()) {
+			it = m_langCache.insert(lang, Utils::getSpellingLanguage(lang));
+		}
+		return it.value();
+	}
+
+private:
+	HOCRDocument* m_document;
+	HOCRSpellChecker* m_spellChecker;
+	mutable QMap<QString, QString> m_langCache;
+	// The displayed children of the items the view asked about and the rows of those children,
+	// discarded whenever items are inserted or removed
+	mutable std::unordered_map<const HOCRItem*, std::vector<HOCRItem*>> m_displayChildren;
+	mutable std::unordered_map<const HOCRItem*, int> m_displayRows;
+	bool m_changingRows = false;
+	std::string m_searchText;
+	bool m_searchMatchCase = false;
+
+	void beginRows(const QModelIndex& parent, int row, int count, bool insert) {
+		// Text blocks without displayed children don't occupy any rows
+		m_changingRows = count > 0;
+		if(!m_changingRows) {
+			return;
+		} else if(insert) {
+			beginInsertRows(parent, row, row + count - 1);
+		} else {
+			beginRemoveRows(parent, row, row + count - 1);
+		}
+	}
+
+	const std::vector<HOCRItem*>& displayChildren(const HOCRItem* item) const {
+		auto it = m_displayChildren.find(item);
+		if(it == m_displayChildren.end()) {
+			it = m_displayChildren.insert(std::make_pair(item, std::vector<HOCRItem*>())).first;
+			collectDisplayChildren(item, it->second);
+			for(int row = 0, n = int(it->second.size()); row < n; ++row) {
+				m_displayRows[it->second[row]] = row;
+			}
+		}
+		return it->second;
+	}
+	void clearDisplayChildren() {
+		m_displayChildren.clear();
+		m_displayRows.clear();
+	}
+
+	static QIcon itemIcon(const HOCRItem* item) {
+		static QIcon pageIcon(":/icons/item_page");
+		static QIcon graphicIcon(":/icons/item_halftone");
+		static QIcon parIcon(":/icons/item_par");
+		static QIcon lineIcon(":/icons/item_line");
+		static QIcon wordIcon(":/icons/item_word");
+		if(item->isPage()) {
+			return pageIcon;
+		} else if(item->isGraphic()) {
+			return graphicIcon;
+		} else if(item->isParagraph()) {
+			return parIcon;
+		} else if(item->isLine()) {
+			return lineIcon;
+		}
+		return wordIcon;
+	}
+	// Words which are still being checked are not highlighted until the verdict arrives
+	bool isMisspelled(const HOCRItem* item) const {
+		QString word = trimWord(fromUtf8String(item->text()));
+		return m_spellChecker->check(spellingLanguage(item), word) == HOCRSpellChecker::Verdict::Misspelled;
+	}
+	bool isSearchMatch(const HOCRItem* item) const {
+		return !m_searchText.empty() && HOCRDocument::matchesWord(item->text(), m_searchText, m_searchMatchCase);
+	}
+};
+
+
 class OutputEditorHOCR::QPainterPDFPainter : public OutputEditorHOCR::PDFPainter {
 public:
 	QPainterPDFPainter(QPainter* painter) : m_painter(painter) {
@@ -181,85 +603,370 @@ public:
 }
 #endif
 
+// Glyph advances of a PDF font, measured once per glyph and font size. The text widths are summed
+// up from them, as PdfFontMetrics::StringWidth does over the UTF-16 code units of the text, but
+// without converting the text for PoDoFo. Shared by the pages of an export.
+class PoDoFoGlyphWidths {
+public:
+	struct Advances {
+		double pointSize;
+		double averageCharWidth;
+		double latin1[256]; // Negative until measured
+		std::unordered_map<ushort, double> other;
+	};
+
+	PoDoFoGlyphWidths(PoDoFo::PdfFont* font) : m_font(font) {}
+	Advances* advances(double pointSize) {
+		auto it = m_advances.find(pointSize);
+		if(it == m_advances.end()) {
+			it = m_advances.insert(std::make_pair(pointSize, Advances())).first;
+			Advances& advances = it->second;
+			advances.pointSize = pointSize;
+			m_font->SetFontSize(pointSize);
+			advances.averageCharWidth = m_font->GetFontMetrics()->CharWidth(static_cast<unsigned char>('x'));
+			std::fill_n(advances.latin1, 256, -1.);
+		}
+		return &it->second;
+	}
+	double textWidth(Advances* advances, const QString& text) {
+		double width = 0;
+		for(const ushort *c = text.utf16(), *end = c + text.size(); c != end; ++c) {
+			width += advance(advances, *c);
+		}
+		return width;
+	}
+
+private:
+	PoDoFo::PdfFont* m_font;
+	std::map<double, Advances> m_advances;
+
+	double advance(Advances* advances, ushort c) {
+		if(c < 256) {
+			double& advance = advances->latin1[c];
+			if(advance < 0) {
+				advance = measure(advances->pointSize, c);
+			}
+			return advance;
+		}
+		auto it = advances->other.find(c);
+		if(it == advances->other.end()) {
+			it = advances->other.insert(std::make_pair(c, measure(advances->pointSize, c))).first;
+		}
+		return it->second;
+	}
+	double measure(double pointSize, ushort c) {
+		// The font is shared with the page being written, which sets its own sizes
+		m_font->SetFontSize(pointSize);
+		return m_font->GetFontMetrics()->UnicodeCharWidth(c);
+	}
+};
+
+// Records the contents of a page while its images are encoded on the worker pool, the page is
+// written to the document once all its images are ready.
 class OutputEditorHOCR::PoDoFoPDFPainter : public OutputEditorHOCR::PDFPainter {
 public:
-	PoDoFoPDFPainter(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter, double scaleFactor)
-		: m_document(document), m_painter(painter), m_scaleFactor(scaleFactor) {
-		m_pageHeight = m_painter->GetPage()->GetPageSize().GetHeight();
+	PoDoFoPDFPainter(WorkerPool& pool, PoDoFoGlyphWidths& glyphWidths, PoDoFo::PdfFont* font, double pageWidth, double pageHeight, double scaleFactor)
+		: m_pool(pool), m_glyphWidths(glyphWidths), m_font(font), m_pageWidth(pageWidth), m_pageHeight(pageHeight), m_scaleFactor(scaleFactor) {
+		m_advances = m_glyphWidths.advances(m_font->GetFontSize());
 	}
 	void setFontSize(double pointSize) override {
-		m_painter->GetFont()->SetFontSize(pointSize);
+		m_advances = m_glyphWidths.advances(pointSize);
+		Operation op;
+		op.type = Operation::SetFontSize;
+		op.pointSize = pointSize;
+		m_operations.push_back(op);
 	}
 	void drawText(double x, double y, const QString& text) override {
-		PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(text.toUtf8().data()));
-		m_painter->DrawText(x * m_scaleFactor, m_pageHeight - y * m_scaleFactor, pdfString);
+		Operation op;
+		op.type = Operation::DrawText;
+		op.x = x;
+		op.y = y;
+		op.text = text;
+		m_operations.push_back(op);
 	}
 	void drawImage(const QRect& bbox, const QImage& image, const PDFSettings& settings) override {
+		if(settings.compression == PDFSettings::CompressFax4 && settings.fax4Strips) {
+			int strips = std::min(m_pool.threadCount(), image.height() / minStripHeight);
+			if(strips > 1) {
+				addFax4Strips(bbox, image, settings, strips);
+				return;
+			}
+		} else if(settings.compression == PDFSettings::CompressZip) {
+			int depth = settings.colorFormat == QImage::Format_Mono ? 1 : settings.colorFormat == QImage::Format_RGB888 ? 24 : 8;
+			qint64 size = qint64(image.width()) * depth / 8 * image.height();
+			int chunks = int(std::min(qint64(m_pool.threadCount()), size / minZipChunkSize));
+			if(chunks > 1) {
+				addZipChunks(bbox, image, settings, chunks);
+				return;
+			}
+		}
+		addImage(bbox, m_pool.submit([image, settings] { return encodeImage(image, settings); }));
+	}
+	double getAverageCharWidth() const override {
+		return m_advances->averageCharWidth / m_scaleFactor;
+	}
+	double getTextWidth(const QString& text) const override {
+		return m_glyphWidths.textWidth(m_advances, text) / m_scaleFactor;
+	}
+	// Waits for the images to be encoded and writes the page, pages need to be written in order
+	void writePage(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter) {
+		PoDoFo::PdfPage* page = document->CreatePage(PoDoFo::PdfRect(0, 0, m_pageWidth, m_pageHeight));
+		painter->SetPage(page);
+		drawOperations(document, painter);
+	}
+	// Writes the contents as an invisible layer on top of an existing page, the transform maps the
+	// recorded page to the user space of the existing page. The existing contents are left as they are.
+	void writeOverlay(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter, PoDoFo::PdfPage* page, const QTransform& transform) {
+		PoDoFo::PdfXObject form(PoDoFo::PdfRect(0, 0, m_pageWidth, m_pageHeight), document);
+		painter->SetPage(&form);
+		drawOperations(document, painter);
+
+		// The existing contents are enclosed in q/Q, so that the form is drawn in the default user space
+		PoDoFo::PdfObject* prologue = document->GetObjects()->CreateObject();
+		prologue->GetStream()->Set("q\n");
+		PoDoFo::PdfObject* epilogue = document->GetObjects()->CreateObject();
+		QString ops = QString("Q\nq 3 Tr %1 %2 %3 %4 %5 %6 cm /%7 Do Q\n")
+		              .arg(transform.m11(), 0, 'f', 6).arg(transform.m12(), 0, 'f', 6)
+		              .arg(transform.m21(), 0, 'f', 6).arg(transform.m22(), 0, 'f', 6)
+		              .arg(transform.dx(), 0, 'f', 4).arg(transform.dy(), 0, 'f', 4)
+		              .arg(QString::fromStdString(form.GetIdentifier().GetName()));
+		epilogue->GetStream()->Set(ops.toLatin1().data());
+
+		PoDoFo::PdfArray contents;
+		contents.push_back(prologue->Reference());
+		PoDoFo::PdfObject* pageContents = page->GetObject()->GetIndirectKey("Contents");
+		if(pageContents && pageContents->IsArray()) {
+			for(const PoDoFo::PdfObject& stream : pageContents->GetArray()) {
+				contents.push_back(stream);
+			}
+		} else if(pageContents) {
+			contents.push_back(pageContents->Reference());
+		}
+		contents.push_back(epilogue->Reference());
+		page->GetObject()->GetDictionary().AddKey("Contents", contents);
+		page->AddResource(form.GetIdentifier(), form.GetObjectReference(), "XObject");
+	}
+
+private:
+	struct Operation {
+		enum Type { SetFontSize, DrawText, DrawImage } type;
+		double pointSize;
+		double x;
+		double y;
+		QString text;
+		QRect bbox;
+		std::size_t image;
+	};
+	// Images may be split into strips, which are stacked to compose the full image
+	struct EncodedImage {
+		int width;
+		int height;
+		int top;
+		int fullHeight;
+		int sampleSize;
+		bool rgb;
+		PDFSettings::Compression compression;
+		QByteArray data;
+	};
+	// A chunk of a zlib stream, see FlateEncoder
+	struct DeflatedRows {
+		QByteArray data;
+		uint32_t checksum;
+		std::size_t size;
+	};
+
+	WorkerPool& m_pool;
+	PoDoFoGlyphWidths& m_glyphWidths;
+	PoDoFoGlyphWidths::Advances* m_advances;
+	PoDoFo::PdfFont* m_font;
+	double m_pageWidth;
+	double m_pageHeight;
+	double m_scaleFactor;
+	std::vector<Operation> m_operations;
+	std::vector<std::future<EncodedImage>> m_images;
+
+	// Bilevel images are only split into strips of at least this many rows
+	static constexpr int minStripHeight = 256;
+	// Images are only deflated in parallel chunks of at least this many bytes
+	static constexpr int minZipChunkSize = 1 << 20;
+
+	void drawOperations(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter) {
+		painter->SetFont(m_font);
+		for(const Operation& op : m_operations) {
+			if(op.type == Operation::SetFontSize) {
+				m_font->SetFontSize(op.pointSize);
+			} else if(op.type == Operation::DrawText) {
+				PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(op.text.toUtf8().data()));
+				painter->DrawText(op.x * m_scaleFactor, m_pageHeight - op.y * m_scaleFactor, pdfString);
+			} else if(op.type == Operation::DrawImage) {
+				EncodedImage image = m_images[op.image].get();
+				drawEncodedImage(document, painter, op.bbox, image);
+			}
+		}
+		painter->FinishPage();
+	}
+	void addImage(const QRect& bbox, std::future<EncodedImage>&& image) {
+		Operation op;
+		op.type = Operation::DrawImage;
+		op.bbox = bbox;
+		op.image = m_images.size();
+		m_operations.push_back(op);
+		m_images.push_back(std::move(image));
+	}
+	// The image is converted as a whole, so that the dithering does not depend on the strips. The strips
+	// are queued after the conversion, which is therefore already running when they wait for it.
+	void addFax4Strips(const QRect& bbox, const QImage& image, const PDFSettings& settings, int strips) {
+		std::shared_future<QImage> converted = m_pool.submit([image, settings] { return preparedImage(image, settings); }).share();
+		for(int i = 0; i < strips; ++i) {
+			int top = image.height() * i / strips;
+			int bottom = image.height() * (i + 1) / strips;
+			addImage(bbox, m_pool.submit([converted, top, bottom] { return encodeFax4(converted.get(), top, bottom); }));
+		}
+	}
+	// As for the strips, the chunks and the task joining them are queued after the conversion, in this order
+	void addZipChunks(const QRect& bbox, const QImage& image, const PDFSettings& settings, int chunks) {
+		std::shared_future<QImage> converted = m_pool.submit([image, settings] { return preparedImage(image, settings); }).share();
+		std::vector<std::shared_future<DeflatedRows>> parts;
+		for(int i = 0; i < chunks; ++i) {
+			int top = image.height() * i / chunks;
+			int bottom = image.height() * (i + 1) / chunks;
+			int flags = (i == 0 ? FlateEncoder::FirstChunk : 0) | (i == chunks - 1 ? FlateEncoder::LastChunk : 0);
+			int level = settings.zipLevel;
+			parts.push_back(m_pool.submit([converted, level, top, bottom, flags] { return deflateRows(converted.get(), level, top, bottom, flags); }).share());
+		}
+		addImage(bbox, m_pool.submit([converted, settings, parts] {
+			EncodedImage encoded = imageInfo(converted.get(), settings);
+			uint32_t checksum = 0;
+			for(std::size_t i = 0, n = parts.size(); i < n; ++i) {
+				const DeflatedRows& part = parts[i].get();
+				encoded.data.append(part.data);
+				checksum = i == 0 ? part.checksum : FlateEncoder::combineChecksums(checksum, part.checksum, part.size);
+			}
+			FlateEncoder::writeTrailer(checksum, [&encoded](const uint8_t* data, std::size_t size) {
+				encoded.data.append(reinterpret_cast<const char*>(data), size);
+			});
+			return encoded;
+		}));
+	}
+
+	// The functions below run on the worker pool
+	static QImage preparedImage(const QImage& image, const PDFSettings& settings) {
 		QImage img = convertedImage(image, settings.colorFormat, settings.conversionFlags);
 		if(settings.colorFormat == QImage::Format_Mono) {
 			img.invertPixels();
 		}
-#if PODOFO_VERSION >= PODOFO_MAKE_VERSION(0,9,3)
-		PoDoFo::PdfImage pdfImage(m_document);
-#else
-		PoDoFo::PdfImageCompat pdfImage(m_document);
-#endif
-		pdfImage.SetImageColorSpace(img.format() == QImage::Format_RGB888 ? PoDoFo::ePdfColorSpace_DeviceRGB : PoDoFo::ePdfColorSpace_DeviceGray);
-		int width = img.width();
-		int height = img.height();
-		int sampleSize = settings.colorFormat == QImage::Format_Mono ? 1 : 8;
+		return img;
+	}
+	// Encodes the rows [top, bottom) of the bilevel image
+	static EncodedImage encodeFax4(const QImage& img, int top, int bottom) {
+		EncodedImage encoded;
+		encoded.width = img.width();
+		encoded.height = bottom - top;
+		encoded.top = top;
+		encoded.fullHeight = img.height();
+		encoded.sampleSize = 1;
+		encoded.rgb = false;
+		encoded.compression = PDFSettings::CompressFax4;
+		CCITTFax4Encoder encoder;
+		encoder.begin(img.width(), [&encoded](const uint8_t* data, std::size_t size) {
+			encoded.data.append(reinterpret_cast<const char*>(data), size);
+		});
+		for(int y = top; y < bottom; ++y) {
+			encoder.encodeRow(img.constScanLine(y));
+		}
+		encoder.finish();
+		return encoded;
+	}
+	// Deflates the rows [top, bottom) of the image, as a chunk of a zlib stream
+	static DeflatedRows deflateRows(const QImage& img, int level, int top, int bottom, int flags) {
+		// QImage has 32-bit aligned scanLines, but the stream holds the rows without padding
+		int bytesPerLine = (img.width() * img.depth() + 7) / 8;
+		// The rows preceding the chunk prime the compressor
+		QByteArray dictionary;
+		int dictionaryRows = (FlateEncoder::dictionarySize + bytesPerLine - 1) / bytesPerLine;
+		for(int y = std::max(0, top - dictionaryRows); y < top; ++y) {
+			dictionary.append(reinterpret_cast<const char*>(img.constScanLine(y)), bytesPerLine);
+		}
+		DeflatedRows rows;
+		FlateEncoder encoder;
+		encoder.begin(level, [&rows](const uint8_t* data, std::size_t size) {
+			rows.data.append(reinterpret_cast<const char*>(data), size);
+		}, flags, reinterpret_cast<const uint8_t*>(dictionary.constData()), dictionary.size());
+		for(int y = top; y < bottom; ++y) {
+			encoder.write(img.constScanLine(y), bytesPerLine);
+		}
+		rows.checksum = encoder.finish();
+		rows.size = encoder.inputSize();
+		return rows;
+	}
+	static EncodedImage imageInfo(const QImage& img, const PDFSettings& settings) {
+		EncodedImage encoded;
+		encoded.width = img.width();
+		encoded.height = img.height();
+		encoded.top = 0;
+		encoded.fullHeight = img.height();
+		encoded.sampleSize = settings.colorFormat == QImage::Format_Mono ? 1 : 8;
+		encoded.rgb = img.format() == QImage::Format_RGB888;
+		encoded.compression = settings.compression;
+		return encoded;
+	}
+	static EncodedImage encodeImage(const QImage& image, const PDFSettings& settings) {
+		QImage img = preparedImage(image, settings);
+		if(settings.compression == PDFSettings::CompressFax4) {
+			return encodeFax4(img, 0, img.height());
+		}
+		EncodedImage encoded = imageInfo(img, settings);
 		if(settings.compression == PDFSettings::CompressZip) {
-			// QImage has 32-bit aligned scanLines, but we need a continuous buffer
-			int numComponents = settings.colorFormat == QImage::Format_RGB888 ? 3 : 1;
-			int bytesPerLine = numComponents * ((width * sampleSize) / 8 + ((width * sampleSize) % 8 != 0));
-			QVector<char> buf(bytesPerLine * height);
-			for(int y = 0; y < height; ++y) {
-				std::memcpy(buf.data() + y * bytesPerLine, img.scanLine(y), bytesPerLine);
-			}
-			PoDoFo::PdfMemoryInputStream is(buf.data(), bytesPerLine * height);
-			pdfImage.SetImageData(width, height, sampleSize, &is, {PoDoFo::ePdfFilter_FlateDecode});
+			encoded.data = deflateRows(img, settings.zipLevel, 0, img.height(), FlateEncoder::WholeStream).data;
 		} else if(settings.compression == PDFSettings::CompressJpeg) {
-			PoDoFo::PdfName dctFilterName(PoDoFo::PdfFilterFactory::FilterTypeToName(PoDoFo::ePdfFilter_DCTDecode));
-			pdfImage.GetObject()->GetDictionary().AddKey(PoDoFo::PdfName::KeyFilter, dctFilterName);
-			QByteArray data;
-			QBuffer buffer(&data);
+			QBuffer buffer(&encoded.data);
 			img.save(&buffer, "jpg", settings.compressionQuality);
-			PoDoFo::PdfMemoryInputStream is(data.data(), data.size());
-			pdfImage.SetImageDataRaw(width, height, sampleSize, &is);
-		} else if(settings.compression == PDFSettings::CompressFax4) {
-			PoDoFo::PdfName faxFilterName(PoDoFo::PdfFilterFactory::FilterTypeToName(PoDoFo::ePdfFilter_CCITTFaxDecode));
-			pdfImage.GetObject()->GetDictionary().AddKey(PoDoFo::PdfName::KeyFilter, faxFilterName);
+		} else if(settings.compression == PDFSettings::CompressJbig2) {
+			JBIG2Encoder encoder;
+			encoder.begin(img.width(), img.height(), [&encoded](const uint8_t* data, std::size_t size) {
+				encoded.data.append(reinterpret_cast<const char*>(data), size);
+			});
+			for(int y = 0; y < encoded.height; ++y) {
+				encoder.encodeRow(img.constScanLine(y));
+			}
+			encoder.finish();
+		}
+		return encoded;
+	}
+	void drawEncodedImage(PoDoFo::PdfDocument* document, PoDoFo::PdfPainter* painter, const QRect& bbox, const EncodedImage& image) {
+#if PODOFO_VERSION >= PODOFO_MAKE_VERSION(0,9,3)
+		PoDoFo::PdfImage pdfImage(document);
+#else
+		PoDoFo::PdfImageCompat pdfImage(document);
+#endif
+		pdfImage.SetImageColorSpace(image.rgb ? PoDoFo::ePdfColorSpace_DeviceRGB : PoDoFo::ePdfColorSpace_DeviceGray);
+		PoDoFo::EPdfFilter filter = PoDoFo::ePdfFilter_FlateDecode;
+		if(image.compression == PDFSettings::CompressJpeg) {
+			filter = PoDoFo::ePdfFilter_DCTDecode;
+		} else if(image.compression == PDFSettings::CompressFax4) {
+			filter = PoDoFo::ePdfFilter_CCITTFaxDecode;
 			PoDoFo::PdfDictionary decodeParams;
-			decodeParams.AddKey("Columns", PoDoFo::PdfObject(PoDoFo::pdf_int64(img.width())));
-			decodeParams.AddKey("Rows", PoDoFo::PdfObject(PoDoFo::pdf_int64(img.height())));
+			decodeParams.AddKey("Columns", PoDoFo::PdfObject(PoDoFo::pdf_int64(image.width)));
+			decodeParams.AddKey("Rows", PoDoFo::PdfObject(PoDoFo::pdf_int64(image.height)));
 			decodeParams.AddKey("K", PoDoFo::PdfObject(PoDoFo::pdf_int64(-1))); // K < 0 --- Pure two-dimensional encoding (Group 4)
 			pdfImage.GetObject()->GetDictionary().AddKey("DecodeParms", PoDoFo::PdfObject(decodeParams));
-			CCITTFax4Encoder encoder;
-			uint32_t encodedLen = 0;
-			uint8_t* encoded = encoder.encode(img.constBits(), img.width(), img.height(), img.bytesPerLine(), encodedLen);
-			PoDoFo::PdfMemoryInputStream is(reinterpret_cast<char*>(encoded), encodedLen);
-			pdfImage.SetImageDataRaw(img.width(), img.height(), sampleSize, &is);
+		} else if(image.compression == PDFSettings::CompressJbig2) {
+			filter = PoDoFo::ePdfFilter_JBIG2Decode;
 		}
-		m_painter->DrawImage(bbox.x() * m_scaleFactor, m_pageHeight - (bbox.y() + bbox.height()) * m_scaleFactor, &pdfImage, m_scaleFactor * bbox.width() / double(image.width()), m_scaleFactor * bbox.height() / double(image.height()));
-	}
-	double getAverageCharWidth() const override {
-		return m_painter->GetFont()->GetFontMetrics()->CharWidth(static_cast<unsigned char>('x')) / m_scaleFactor;
+		PoDoFo::PdfName filterName(PoDoFo::PdfFilterFactory::FilterTypeToName(filter));
+		pdfImage.GetObject()->GetDictionary().AddKey(PoDoFo::PdfName::KeyFilter, filterName);
+		PoDoFo::PdfMemoryInputStream is(image.data.data(), image.data.size());
+		pdfImage.SetImageDataRaw(image.width, image.height, image.sampleSize, &is);
+		double scaleX = m_scaleFactor * bbox.width() / double(image.width);
+		double scaleY = m_scaleFactor * bbox.height() / double(image.fullHeight);
+		painter->DrawImage(bbox.x() * m_scaleFactor, m_pageHeight - bbox.y() * m_scaleFactor - (image.top + image.height) * scaleY, &pdfImage, scaleX, scaleY);
 	}
-	double getTextWidth(const QString& text) const override {
-		PoDoFo::PdfString pdfString(reinterpret_cast<const PoDoFo::pdf_utf8*>(text.toUtf8().data()));
-		return m_painter->GetFont()->GetFontMetrics()->StringWidth(pdfString) / m_scaleFactor;
-	}
-
-private:
-	PoDoFo::PdfDocument* m_document;
-	PoDoFo::PdfPainter* m_painter;
-	double m_scaleFactor;
-	double m_pageHeight;
 };
 
 Q_DECLARE_METATYPE(QList<QRect>)
 
-OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool) {
+OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool)
+	: m_journal(QFile::encodeName(journalFilename(QApplication::applicationPid())).constData(), [this] { QMetaObject::invokeMethod(this, "journalFailed", Qt::QueuedConnection); }) {
 	static int reg = qRegisterMetaType<QList<QRect>>("QList<QRect>");
 	Q_UNUSED(reg);
 
@@ -283,24 +990,47 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool) {
 	m_pdfExportDialogUi.comboBoxImageCompression->addItem(_("Zip (lossless)"), PDFSettings::CompressZip);
 	m_pdfExportDialogUi.comboBoxImageCompression->addItem(_("CCITT Group 4 (lossless)"), PDFSettings::CompressFax4);
 	m_pdfExportDialogUi.comboBoxImageCompression->addItem(_("Jpeg (lossy)"), PDFSettings::CompressJpeg);
+	m_pdfExportDialogUi.comboBoxImageCompression->addItem(_("JBIG2 (lossless)"), PDFSettings::CompressJbig2);
 	m_pdfExportDialogUi.comboBoxImageCompression->setCurrentIndex(-1);
 
 	ui.actionOutputSaveHOCR->setShortcut(Qt::CTRL + Qt::Key_S);
-
-	ui.treeWidgetItems->setContextMenuPolicy(Qt::CustomContextMenu);
-	m_rootItem = new QTreeWidgetItem(QStringList() << _("Document"));
-	ui.treeWidgetItems->addTopLevelItem(m_rootItem);
-	m_rootItem->setExpanded(true);
+	ui.actionOutputUndo->setShortcut(Qt::CTRL + Qt::Key_Z);
+	ui.actionOutputRedo->setShortcut(Qt::CTRL + Qt::SHIFT + Qt::Key_Z);
+	ui.actionOutputReplace->setShortcut(Qt::CTRL + Qt::Key_F);
+	ui.frameOutputSearch->setVisible(false);
+
+	m_treeModel = new HOCRTreeModel(&m_document, &m_spellChecker, m_widget);
+	m_document.setObserver(this);
+	m_document.setJournal(&m_journal);
+	ui.treeViewItems->setModel(m_treeModel);
+	ui.treeViewItems->setContextMenuPolicy(Qt::CustomContextMenu);
+	ui.treeViewItems->expand(m_treeModel->documentIndex());
 
 	connect(ui.actionOutputOpen, SIGNAL(triggered()), this, SLOT(open()));
 	connect(ui.actionOutputSaveHOCR, SIGNAL(triggered()), this, SLOT(save()));
 	connect(ui.actionOutputExportPDF, SIGNAL(triggered()), this, SLOT(savePDF()));
 	connect(ui.actionOutputClear, SIGNAL(triggered()), this, SLOT(clear()));
+	connect(ui.actionOutputUndo, SIGNAL(triggered()), this, SLOT(undo()));
+	connect(ui.actionOutputRedo, SIGNAL(triggered()), this, SLOT(redo()));
+	connect(ui.actionOutputReplace, SIGNAL(toggled(bool)), ui.frameOutputSearch, SLOT(setVisible(bool)));
+	connect(ui.actionOutputReplace, SIGNAL(toggled(bool)), ui.lineEditOutputSearch, SLOT(clear()));
+	connect(ui.actionOutputReplace, SIGNAL(toggled(bool)), ui.lineEditOutputReplace, SLOT(clear()));
+	connect(ui.checkBoxOutputSearchMatchCase, SIGNAL(toggled(bool)), this, SLOT(clearErrorState()));
+	connect(ui.checkBoxOutputSearchMatchCase, SIGNAL(toggled(bool)), this, SLOT(updateSearchHighlight()));
+	connect(ui.lineEditOutputSearch, SIGNAL(textChanged(QString)), this, SLOT(clearErrorState()));
+	connect(ui.lineEditOutputSearch, SIGNAL(textChanged(QString)), this, SLOT(updateSearchHighlight()));
+	connect(ui.lineEditOutputSearch, SIGNAL(returnPressed()), this, SLOT(findNext()));
+	connect(ui.lineEditOutputReplace, SIGNAL(returnPressed()), this, SLOT(replaceNext()));
+	connect(ui.toolButtonOutputFindNext, SIGNAL(clicked()), this, SLOT(findNext()));
+	connect(ui.toolButtonOutputFindPrev, SIGNAL(clicked()), this, SLOT(findPrev()));
+	connect(ui.toolButtonOutputReplace, SIGNAL(clicked()), this, SLOT(replaceNext()));
+	connect(ui.toolButtonOutputReplaceAll, SIGNAL(clicked()), this, SLOT(replaceAll()));
 	connect(MAIN->getConfig()->getSetting<FontSetting>("customoutputfont"), SIGNAL(changed()), this, SLOT(setFont()));
 	connect(MAIN->getConfig()->getSetting<SwitchSetting>("systemoutputfont"), SIGNAL(changed()), this, SLOT(setFont()));
-	connect(ui.treeWidgetItems, SIGNAL(currentItemChanged(QTreeWidgetItem*,QTreeWidgetItem*)), this, SLOT(showItemProperties(QTreeWidgetItem*)));
-	connect(ui.treeWidgetItems, SIGNAL(itemChanged(QTreeWidgetItem*,int)), this, SLOT(itemChanged(QTreeWidgetItem*,int)));
-	connect(ui.treeWidgetItems, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(showTreeWidgetContextMenu(QPoint)));
+	connect(ui.treeViewItems->selectionModel(), SIGNAL(currentChanged(QModelIndex,QModelIndex)), this, SLOT(showItemProperties(QModelIndex)));
+	connect(m_treeModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(itemChanged(QModelIndex)));
+	connect(&m_spellChecker, SIGNAL(wordsChecked()), ui.treeViewItems->viewport(), SLOT(update()));
+	connect(ui.treeViewItems, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(showTreeWidgetContextMenu(QPoint)));
 	connect(ui.tableWidgetProperties, SIGNAL(cellChanged(int,int)), this, SLOT(propertyCellChanged(int,int)));
 	connect(m_pdfExportDialogUi.buttonFont, SIGNAL(clicked()), &m_pdfFontDialog, SLOT(exec()));
 	connect(&m_pdfFontDialog, SIGNAL(fontSelected(QFont)), this, SLOT(updateFontButton(QFont)));
@@ -322,11 +1052,14 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool) {
 	connect(m_pdfExportDialogUi.checkBoxPreview, SIGNAL(toggled(bool)), this, SLOT(updatePreview()));
 	connect(m_tool, SIGNAL(selectionGeometryChanged(QRect)), this, SLOT(updateCurrentItemBBox(QRect)));
 	connect(m_tool, SIGNAL(selectionDrawn(QRect)), this, SLOT(addGraphicRegion(QRect)));
+	connect(m_tool, SIGNAL(positionPicked(QPoint)), this, SLOT(pickItem(QPoint)));
 
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfexportmode", m_pdfExportDialogUi.comboBoxOutputMode));
 	MAIN->getConfig()->addSetting(new FontSetting("pdffont", &m_pdfFontDialog, QFont().toString()));
 	MAIN->getConfig()->addSetting(new SpinSetting("pdfimagecompressionquality", m_pdfExportDialogUi.spinBoxCompressionQuality, 90));
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfimagecompression", m_pdfExportDialogUi.comboBoxImageCompression));
+	MAIN->getConfig()->addSetting(new SpinSetting("pdfimageziplevel", m_pdfExportDialogUi.spinBoxZipLevel, 6));
+	MAIN->getConfig()->addSetting(new SwitchSetting("pdfimagefax4strips", m_pdfExportDialogUi.checkBoxFax4Strips, false));
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfimageformat", m_pdfExportDialogUi.comboBoxImageFormat));
 	MAIN->getConfig()->addSetting(new ComboSetting("pdfimageconversionflags", m_pdfExportDialogUi.comboBoxDithering));
 	MAIN->getConfig()->addSetting(new SpinSetting("pdfimagedpi", m_pdfExportDialogUi.spinBoxDpi, 300));
@@ -351,11 +1084,15 @@ OutputEditorHOCR::OutputEditorHOCR(DisplayerToolHOCR* tool) {
 }
 
 OutputEditorHOCR::~OutputEditorHOCR() {
+	m_document.setObserver(nullptr);
+	qDeleteAll(m_queuedPages);
 	delete m_widget;
 	MAIN->getConfig()->removeSetting("pdfexportmode");
 	MAIN->getConfig()->removeSetting("pdffont");
 	MAIN->getConfig()->removeSetting("pdfimagecompressionquality");
 	MAIN->getConfig()->removeSetting("pdfimagecompression");
+	MAIN->getConfig()->removeSetting("pdfimageziplevel");
+	MAIN->getConfig()->removeSetting("pdfimagefax4strips");
 	MAIN->getConfig()->removeSetting("pdfimageformat");
 	MAIN->getConfig()->removeSetting("pdfimagedpi");
 	MAIN->getConfig()->removeSetting("pdfusedetectedfontsizes");
@@ -379,21 +1116,25 @@ void OutputEditorHOCR::imageFormatChanged() {
 	int zipIdx = m_pdfExportDialogUi.comboBoxImageCompression->findData(PDFSettings::CompressZip);
 	int ccittIdx = m_pdfExportDialogUi.comboBoxImageCompression->findData(PDFSettings::CompressFax4);
 	int jpegIdx = m_pdfExportDialogUi.comboBoxImageCompression->findData(PDFSettings::CompressJpeg);
+	int jbig2Idx = m_pdfExportDialogUi.comboBoxImageCompression->findData(PDFSettings::CompressJbig2);
 	QStandardItem* ccittItem = model->item(ccittIdx);
 	QStandardItem* jpegItem = model->item(jpegIdx);
+	QStandardItem* jbig2Item = model->item(jbig2Idx);
 	if(format == QImage::Format_Mono) {
 		if(m_pdfExportDialogUi.comboBoxImageCompression->currentIndex() == jpegIdx) {
 			m_pdfExportDialogUi.comboBoxImageCompression->setCurrentIndex(zipIdx);
 		}
 		ccittItem->setFlags(ccittItem->flags()|Qt::ItemIsSelectable|Qt::ItemIsEnabled);
+		jbig2Item->setFlags(jbig2Item->flags()|Qt::ItemIsSelectable|Qt::ItemIsEnabled);
 		jpegItem->setFlags(jpegItem->flags() & ~(Qt::ItemIsSelectable|Qt::ItemIsEnabled));
 		m_pdfExportDialogUi.labelDithering->setEnabled(true);
 		m_pdfExportDialogUi.comboBoxDithering->setEnabled(true);
 	} else {
-		if(m_pdfExportDialogUi.comboBoxImageCompression->currentIndex() == ccittIdx) {
+		if(m_pdfExportDialogUi.comboBoxImageCompression->currentIndex() == ccittIdx || m_pdfExportDialogUi.comboBoxImageCompression->currentIndex() == jbig2Idx) {
 			m_pdfExportDialogUi.comboBoxImageCompression->setCurrentIndex(zipIdx);
 		}
 		ccittItem->setFlags(ccittItem->flags() & ~(Qt::ItemIsSelectable|Qt::ItemIsEnabled));
+		jbig2Item->setFlags(jbig2Item->flags() & ~(Qt::ItemIsSelectable|Qt::ItemIsEnabled));
 		jpegItem->setFlags(jpegItem->flags()|Qt::ItemIsSelectable|Qt::ItemIsEnabled);
 		m_pdfExportDialogUi.labelDithering->setEnabled(false);
 		m_pdfExportDialogUi.comboBoxDithering->setEnabled(false);
@@ -405,6 +1146,9 @@ void OutputEditorHOCR::imageCompressionChanged() {
 	bool jpegCompression = compression == PDFSettings::CompressJpeg;
 	m_pdfExportDialogUi.spinBoxCompressionQuality->setEnabled(jpegCompression);
 	m_pdfExportDialogUi.labelCompressionQuality->setEnabled(jpegCompression);
+	m_pdfExportDialogUi.spinBoxZipLevel->setEnabled(compression == PDFSettings::CompressZip);
+	m_pdfExportDialogUi.labelZipLevel->setEnabled(compression == PDFSettings::CompressZip);
+	m_pdfExportDialogUi.checkBoxFax4Strips->setEnabled(compression == PDFSettings::CompressFax4);
 }
 
 OutputEditorHOCR::ReadSessionData* OutputEditorHOCR::initRead(tesseract::TessBaseAPI &tess) {
@@ -415,8 +1159,12 @@ OutputEditorHOCR::ReadSessionData* OutputEditorHOCR::initRead(tesseract::TessBas
 void OutputEditorHOCR::read(tesseract::TessBaseAPI &tess, ReadSessionData *data) {
 	tess.SetVariable("hocr_font_info", "true");
 	char* text = tess.GetHOCRText(data->page);
-	QMetaObject::invokeMethod(this, "addPage", Qt::QueuedConnection, Q_ARG(QString, QString::fromUtf8(text)), Q_ARG(ReadSessionData, *data));
+	HOCRPage* page = parsePage(QString::fromUtf8(text), *data);
 	delete[] text;
+	if(page) {
+		HOCRDocument::preparePage(page, m_document.nextPageId(), true);
+		queuePage(page);
+	}
 }
 
 void OutputEditorHOCR::readError(const QString& errorMsg, ReadSessionData *data) {
@@ -432,282 +1180,163 @@ void OutputEditorHOCR::finalizeRead(ReadSessionData *data) {
 	OutputEditor::finalizeRead(data);
 }
 
-void OutputEditorHOCR::addPage(const QString& hocrText, ReadSessionData data) {
-	QDomDocument doc;
-	doc.setContent(hocrText);
-	QDomElement pageDiv = doc.firstChildElement("div");
-	s_bboxRx.indexIn(pageDiv.attribute("title"));
-	int x1 = s_bboxRx.cap(1).toInt();
-	int y1 = s_bboxRx.cap(2).toInt();
-	int x2 = s_bboxRx.cap(3).toInt();
-	int y2 = s_bboxRx.cap(4).toInt();
-	QString pageTitle = QString("image '%1'; bbox %2 %3 %4 %5; pageno %6; rot %7; res %8")
+HOCRPage* OutputEditorHOCR::parsePage(const QString& hocrText, const ReadSessionData& data) {
+	QXmlStreamReader reader(hocrText);
+	if(!reader.readNextStartElement() || reader.name() != QLatin1String("div") || reader.attributes().value("class") != QLatin1String("ocr_page")) {
+		return nullptr;
+	}
+	HOCRPage* page = static_cast<HOCRPage*>(parseItem(reader));
+	HOCRItem::BBox bbox = page->bbox();
+	if(data.imageWidth > 0 && data.imageHeight > 0) {
+		bbox = HOCRItem::BBox(0, 0, data.imageWidth, data.imageHeight);
+	}
+	QString pageTitle = QString("image '%1'; bbox %2; pageno %3; rot %4; res %5")
 	                    .arg(data.file)
-	                    .arg(x1).arg(y1).arg(x2).arg(y2)
+	                    .arg(fromUtf8String(bbox.toString()))
 	                    .arg(data.page)
 	                    .arg(data.angle)
 	                    .arg(data.resolution);
-	pageDiv.setAttribute("title", pageTitle);
-	addPage(pageDiv, QFileInfo(data.file).fileName(), data.page, true);
-}
-
-void OutputEditorHOCR::addPage(QDomElement pageDiv, const QString& filename, int page, bool cleanGraphics) {
-	pageDiv.setAttribute("id", QString("page_%1").arg(++m_idCounter));
-	s_bboxRx.indexIn(pageDiv.attribute("title"));
-	int x1 = s_bboxRx.cap(1).toInt();
-	int y1 = s_bboxRx.cap(2).toInt();
-	int x2 = s_bboxRx.cap(3).toInt();
-	int y2 = s_bboxRx.cap(4).toInt();
-
-	QTreeWidgetItem* pageItem = new QTreeWidgetItem(QStringList() << QString("%1 [%2]").arg(filename).arg(page));
-	pageItem->setData(0, IdRole, pageDiv.attribute("id"));
-	pageItem->setData(0, BBoxRole, QRect(x1, y1, x2 - x1, y2 - y1));
-	pageItem->setData(0, ClassRole, "ocr_page");
-	pageItem->setIcon(0, QIcon(":/icons/item_page"));
-	pageItem->setCheckState(0, Qt::Checked);
-	m_rootItem->addChild(pageItem);
-	QMap<QString,QString> langCache;
-
-	QVector<QPair<QDomElement,QRect>> graphicElements;
-	QDomElement element = pageDiv.firstChildElement("div");
-	while(!element.isNull()) {
-		// Boxes without text are images
-		if(!addChildItems(element.firstChildElement(), pageItem, langCache) && s_bboxRx.indexIn(element.attribute("title")) != -1) {
-			x1 = s_bboxRx.cap(1).toInt();
-			y1 = s_bboxRx.cap(2).toInt();
-			x2 = s_bboxRx.cap(3).toInt();
-			y2 = s_bboxRx.cap(4).toInt();
-			graphicElements.append(qMakePair(element, QRect(x1, y1, x2 - x1, y2 - y1)));
-		}
-		element = element.nextSiblingElement();
-	}
-
-	// Discard graphic elements which intersect with text block or which are too small
-	int numTextBlocks = pageItem->childCount();
-	for(const QPair<QDomElement,QRect>& pair: graphicElements) {
-		const QDomElement& element = pair.first;
-		const QRect& bbox = pair.second;
-		bool deleteGraphic = false;
-		if(cleanGraphics) {
-			if(bbox.width() < 10 || bbox.height() < 10) {
-				deleteGraphic = true;
-			} else {
-				for(int i = 0; i < numTextBlocks; ++i) {
-					if(bbox.intersects(pageItem->child(i)->data(0, BBoxRole).toRect())) {
-						deleteGraphic = true;
-						break;
-					}
-				}
-			}
-		}
-		if(!deleteGraphic) {
-			QTreeWidgetItem* item = new QTreeWidgetItem(QStringList() << _("Graphic"));
-			item->setCheckState(0, Qt::Checked);
-			item->setIcon(0, QIcon(":/icons/item_halftone"));
-			item->setData(0, IdRole, element.attribute("id"));
-			item->setData(0, ClassRole, "ocr_graphic");
-			item->setData(0, BBoxRole, bbox);
-			pageItem->addChild(item);
-		} else {
-			element.parentNode().removeChild(element);
-		}
+	page->setAttribute("title", toUtf8String(pageTitle));
+	page->setLabel(toUtf8String(QString("%1 [%2]").arg(QFileInfo(data.file).fileName()).arg(data.page)));
+	return page;
+}
+
+void OutputEditorHOCR::queuePage(HOCRPage* page) {
+	QMutexLocker locker(&m_queuedPagesMutex);
+	m_queuedPages.push_back(page);
+	// Pages queued before the call is processed are added along
+	if(m_queuedPages.size() == 1) {
+		QMetaObject::invokeMethod(this, "addQueuedPages", Qt::QueuedConnection);
+	}
+}
+
+void OutputEditorHOCR::addQueuedPages() {
+	std::vector<HOCRPage*> pages;
+	{
+		QMutexLocker locker(&m_queuedPagesMutex);
+		pages.swap(m_queuedPages);
+	}
+	if(pages.empty()) {
+		return;
+	}
+	for(HOCRPage* page : pages) {
+		m_document.addPreparedPage(page);
+	}
+	ui.treeViewItems->expand(m_treeModel->documentIndex());
+	for(HOCRPage* page : pages) {
+		ui.treeViewItems->expand(m_treeModel->indexForItem(page));
 	}
 
-	QString str;
-	QTextStream ss(&str);
-	pageDiv.save(ss, 1);
-	pageItem->setData(0, SourceRole, str);
-	expandChildren(pageItem);
 	MAIN->setOutputPaneVisible(true);
 	m_modified = true;
 	ui.actionOutputSaveHOCR->setEnabled(true);
 	ui.actionOutputExportPDF->setEnabled(true);
 }
 
-void OutputEditorHOCR::expandChildren(QTreeWidgetItem* item) const {
-	if(item->childCount() > 0) {
-		item->setExpanded(true);
-		for(int i = 0, n = item->childCount(); i < n; ++i) {
-			expandChildren(item->child(i));
-		}
-	}
+QString OutputEditorHOCR::journalDirectory() {
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+	QDir cacheDir(QDesktopServices::storageLocation(QDesktopServices::CacheLocation));
+#else
+	QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+#endif
+	cacheDir.mkpath(".");
+	return cacheDir.absolutePath();
 }
 
-void OutputEditorHOCR::collapseChildren(QTreeWidgetItem* item) const {
-	if(item->childCount() > 0) {
-		item->setExpanded(false);
-		for(int i = 0, n = item->childCount(); i < n; ++i) {
-			collapseChildren(item->child(i));
-		}
-	}
+QString OutputEditorHOCR::journalFilename(qint64 pid) {
+	return QDir(journalDirectory()).absoluteFilePath(QString("hocr-journal-%1").arg(pid));
 }
 
-bool OutputEditorHOCR::addChildItems(QDomElement element, QTreeWidgetItem* parentItem, QMap<QString,QString>& langCache) {
-	bool haveWord = false;
-	while(!element.isNull()) {
-		QDomElement nextElement = element.nextSiblingElement();
-		if(s_idRx.indexIn(element.attribute("id")) != -1) {
-			QString newId = QString("%1_%2_%3").arg(s_idRx.cap(1)).arg(m_idCounter).arg(s_idRx.cap(2));
-			element.setAttribute("id", newId);
+bool OutputEditorHOCR::recoverJournal(const std::vector<HOCRJournal::Record>& records) {
+	// The replayed records are journaled anew
+	bool success = m_document.replay(records, [](const std::string& html) -> HOCRPage* {
+		QXmlStreamReader reader(fromUtf8String(html));
+		if(!reader.readNextStartElement() || reader.attributes().value("class") != QLatin1String("ocr_page")) {
+			return nullptr;
 		}
+		return static_cast<HOCRPage*>(parseItem(reader));
+	});
+	if(m_document.pageCount() > 0) {
+		ui.treeViewItems->expand(m_treeModel->documentIndex());
+		MAIN->setOutputPaneVisible(true);
+		m_modified = true;
+		ui.actionOutputSaveHOCR->setEnabled(true);
+		ui.actionOutputExportPDF->setEnabled(true);
+	}
+	return success;
+}
 
-		if(s_bboxRx.indexIn(element.attribute("title")) != -1) {
-			QString type = element.attribute("class");
-			QString icon;
-			QString title;
-			int x1 = s_bboxRx.cap(1).toInt();
-			int y1 = s_bboxRx.cap(2).toInt();
-			int x2 = s_bboxRx.cap(3).toInt();
-			int y2 = s_bboxRx.cap(4).toInt();
-			if(type == "ocr_par") {
-				title = _("Paragraph");
-				icon = "par";
-			} else if(type == "ocr_line") {
-				title = _("Textline");
-				icon = "line";
-			} else if(type == "ocrx_word") {
-				title = element.text();
-				icon = "word";
-			}
-			if(!title.isEmpty()) {
-				QTreeWidgetItem* item = new QTreeWidgetItem(QStringList() << title);
-				if(type == "ocrx_word" || addChildItems(element.firstChildElement(), item, langCache)) {
-					item->setCheckState(0, Qt::Checked);
-					item->setData(0, IdRole, element.attribute("id"));
-					item->setIcon(0, QIcon(QString(":/icons/item_%1").arg(icon)));
-					item->setData(0, BBoxRole, QRect(x1, y1, x2 - x1, y2 - y1));
-					item->setData(0, ClassRole, type);
-					parentItem->addChild(item);
-					haveWord = true;
-					if(type == "ocr_line") {
-						if(s_baseLineRx.indexIn(element.attribute("title")) != -1) {
-							item->setData(0, BaselineRole, s_baseLineRx.cap(2).toInt());
-						}
-					} else if(type == "ocrx_word") {
-						// Ensure correct hyphen char is used on last word of line
-						if(nextElement.isNull()) {
-							title.replace(QRegExp("[-\u2014]\\s*$"), "-");
-							element.replaceChild(element.ownerDocument().createTextNode(title), element.firstChild());
-							item->setText(0, title);
-						}
-
-						if(s_fontSizeRx.indexIn(element.attribute("title")) != -1) {
-							item->setData(0, FontSizeRole, s_fontSizeRx.cap(1).toDouble());
-						}
-						item->setFlags(item->flags() | Qt::ItemIsEditable);
-						QString lang = element.attribute("lang");
-						auto it = langCache.find(lang);
-						if(it == langCache.end()) {
-							it = langCache.insert(lang, Utils::getSpellingLanguage(lang));
-						}
-						QString spellingLang = it.value();
-						if(m_spell.getLanguage() != spellingLang) {
-							m_spell.setLanguage(spellingLang);
-						}
-						if(!m_spell.checkWord(trimWord(title))) {
-							item->setForeground(0, Qt::red);
-						}
-					}
-				} else {
-					delete item;
-				}
-			}
+void OutputEditorHOCR::journalFailed() {
+	QMessageBox::warning(MAIN, _("Journal error"), _("The hOCR output can no longer be recorded in the journal %1: %2.\nUnsaved work will be lost if the application crashes.").arg(QFile::decodeName(m_journal.filename().c_str())).arg(QString::fromLocal8Bit(m_journal.error().c_str())));
+}
+
+void OutputEditorHOCR::expandChildren(const QModelIndex& index) const {
+	// Rows are only created for expanded items, so this populates the entire subtree
+	if(m_treeModel->hasChildren(index)) {
+		ui.treeViewItems->expand(index);
+		for(int i = 0, n = m_treeModel->rowCount(index); i < n; ++i) {
+			expandChildren(m_treeModel->index(i, 0, index));
 		}
-		element = nextElement;
 	}
-	return haveWord;
 }
 
-QDomElement OutputEditorHOCR::elementById(QDomElement element, const QString& id) const {
-	QDomElement child;
-	while(!element.isNull()) {
-		if(element.attribute("id") == id) {
-			return element;
-		} else if(!(child = elementById(element.firstChildElement(), id)).isNull()) {
-			return child;
-		} else {
-			element = element.nextSiblingElement();
+void OutputEditorHOCR::collapseChildren(const QModelIndex& index) const {
+	// Items which were never expanded have no expanded descendants
+	if(ui.treeViewItems->isExpanded(index)) {
+		for(int i = 0, n = m_treeModel->rowCount(index); i < n; ++i) {
+			collapseChildren(m_treeModel->index(i, 0, index));
 		}
+		ui.treeViewItems->collapse(index);
 	}
-	return QDomElement();
 }
 
-void OutputEditorHOCR::showItemProperties(QTreeWidgetItem* item) {
+void OutputEditorHOCR::showItemProperties(const QModelIndex& index) {
 	ui.tableWidgetProperties->blockSignals(true);
 	ui.tableWidgetProperties->setRowCount(0);
 	ui.tableWidgetProperties->blockSignals(false);
 	ui.plainTextEditOutput->setPlainText("");
 	m_tool->clearSelection();
-	m_currentPageItem = nullptr;
-	m_currentItem = item;
-	if(!item || item == m_rootItem) {
-		m_currentDocument = QDomDocument();
-		m_currentElement = QDomElement();
+	m_currentElement = m_treeModel->itemForIndex(index);
+	if(!m_currentElement) {
 		return;
 	}
-	m_currentPageItem = item;
-	while(m_currentPageItem->parent() != m_rootItem) {
-		m_currentPageItem = m_currentPageItem->parent();
-	}
-	QString id = item->data(0, IdRole).toString();
-	m_currentDocument.setContent(m_currentPageItem->data(0, SourceRole).toString());
-	m_currentElement = elementById(m_currentDocument.firstChildElement(), id);
-	if(m_currentElement.isNull()) {
-		m_currentDocument = QDomDocument();
-		m_currentPageItem = nullptr;
-		m_currentItem = nullptr;
-		return;
-	}
-	QDomNamedNodeMap attributes = m_currentElement.attributes();
 	int row = -1;
 	ui.tableWidgetProperties->blockSignals(true);
-	for(int i = 0, n = attributes.count(); i < n; ++i) {
-		QDomNode attribNode = attributes.item(i);
-		if(attribNode.nodeName() == "title") {
-			for(const QString& attrib : attribNode.nodeValue().split(QRegExp("\\s*;\\s*"))) {
-				int splitPos = attrib.indexOf(QRegExp("\\s+"));
+	for(const auto& attrib : m_currentElement->attributes()) {
+		if(attrib.first == "title") {
+			for(const auto& prop : m_currentElement->titleProperties()) {
 				ui.tableWidgetProperties->insertRow(++row);
-				QTableWidgetItem* attrNameItem = new QTableWidgetItem(attrib.left(splitPos));
+				QTableWidgetItem* attrNameItem = new QTableWidgetItem(fromUtf8String(prop.first));
 				attrNameItem->setFlags(attrNameItem->flags() &  ~Qt::ItemIsEditable);
 				attrNameItem->setData(ParentAttrRole, "title");
 				ui.tableWidgetProperties->setItem(row, 0, attrNameItem);
-				ui.tableWidgetProperties->setItem(row, 1, new QTableWidgetItem(attrib.mid(splitPos + 1)));
+				ui.tableWidgetProperties->setItem(row, 1, new QTableWidgetItem(fromUtf8String(prop.second)));
 			}
 		} else {
 			ui.tableWidgetProperties->insertRow(++row);
-			QTableWidgetItem* attrNameItem = new QTableWidgetItem(attribNode.nodeName());
+			QTableWidgetItem* attrNameItem = new QTableWidgetItem(fromUtf8String(attrib.first));
 			attrNameItem->setFlags(attrNameItem->flags() &  ~Qt::ItemIsEditable);
 			ui.tableWidgetProperties->setItem(row, 0, attrNameItem);
-			ui.tableWidgetProperties->setItem(row, 1, new QTableWidgetItem(attribNode.nodeValue()));
+			ui.tableWidgetProperties->setItem(row, 1, new QTableWidgetItem(fromUtf8String(attrib.second)));
 		}
 	}
 	ui.tableWidgetProperties->blockSignals(false);
-	QString str;
-	QTextStream stream(&str);
-	m_currentElement.save(stream, 1);
-	ui.plainTextEditOutput->setPlainText(str);
-
-	if(setCurrentSource(m_currentDocument.firstChildElement("div")) && s_bboxRx.indexIn(m_currentElement.attribute("title")) != -1) {
-		int x1 = s_bboxRx.cap(1).toInt();
-		int y1 = s_bboxRx.cap(2).toInt();
-		int x2 = s_bboxRx.cap(3).toInt();
-		int y2 = s_bboxRx.cap(4).toInt();
-		m_tool->setSelection(QRect(x1, y1, x2-x1, y2-y1));
-	}
-}
-
-bool OutputEditorHOCR::setCurrentSource(const QDomElement& pageElement, int* pageDpi, int* overrideDpi) const {
-	if(s_pageTitleRx.indexIn(pageElement.attribute("title")) != -1) {
-		QString filename = s_pageTitleRx.cap(1);
-		int page = s_pageTitleRx.cap(2).toInt();
-		double angle = s_pageTitleRx.cap(3).toDouble();
-		int res = s_pageTitleRx.cap(4).toInt();
+	ui.plainTextEditOutput->setPlainText(fromUtf8String(m_currentElement->toHtml(1)));
+
+	if(setCurrentSource(m_currentElement->page())) {
+		m_tool->setSelection(toQRect(m_currentElement->bbox()));
+	}
+}
+
+bool OutputEditorHOCR::setCurrentSource(const HOCRPage* page, int* pageDpi) const {
+	if(page && !page->sourceFile().empty()) {
+		QString filename = fromUtf8String(page->sourceFile());
+		int pageNr = page->pageNr();
+		double angle = page->angle();
+		int res = page->resolution();
 		if(pageDpi) {
 			*pageDpi = res;
 		}
-		if(overrideDpi) {
-			res = *overrideDpi;
-		}
 
 		MAIN->getSourceManager()->addSource(filename);
 		QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
@@ -716,8 +1345,8 @@ bool OutputEditorHOCR::setCurrentSource(const QDomElement& pageElement, int* pag
 		if(MAIN->getDisplayer()->getCurrentImage(dummy) != filename) {
 			return false;
 		}
-		if(MAIN->getDisplayer()->getCurrentPage() != page) {
-			MAIN->getDisplayer()->setCurrentPage(page);
+		if(MAIN->getDisplayer()->getCurrentPage() != pageNr) {
+			MAIN->getDisplayer()->setCurrentPage(pageNr);
 		}
 		if(MAIN->getDisplayer()->getCurrentAngle() != angle) {
 			MAIN->getDisplayer()->setAngle(angle);
@@ -730,26 +1359,92 @@ bool OutputEditorHOCR::setCurrentSource(const QDomElement& pageElement, int* pag
 	return false;
 }
 
-void OutputEditorHOCR::itemChanged(QTreeWidgetItem* item, int col) {
-	if(item != m_currentItem) {
+void OutputEditorHOCR::itemChanged(const QModelIndex& index) {
+	HOCRItem* item = m_treeModel->itemForIndex(index);
+	if(!item || item != m_currentElement) {
 		return;
 	}
-	ui.treeWidgetItems->blockSignals(true);
-	bool isWord = item->data(0, ClassRole).toString() == "ocrx_word";
-	if( isWord && item->checkState(col) == Qt::Checked) {
+	if(item->isWord() && item->isEnabled()) {
 		// Update text
-		updateCurrentItemText();
-	} else if(item->checkState(col) == Qt::Checked) {
-		item->setFlags(item->flags() | Qt::ItemIsSelectable);
-		if(!isWord) {
-			item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-		}
+		updateCurrentItem();
+	} else if(!item->isEnabled()) {
+		ui.treeViewItems->collapse(index);
+	}
+}
+
+void OutputEditorHOCR::clearErrorState() {
+	ui.lineEditOutputSearch->setStyleSheet("");
+}
+
+void OutputEditorHOCR::findNext() {
+	findReplace(false, false);
+}
+
+void OutputEditorHOCR::findPrev() {
+	findReplace(true, false);
+}
+
+void OutputEditorHOCR::replaceNext() {
+	findReplace(false, true);
+}
+
+void OutputEditorHOCR::replaceAll() {
+	MAIN->pushState(MainWindow::State::Busy, _("Replacing..."));
+	std::string searchstr = toUtf8String(ui.lineEditOutputSearch->text());
+	std::string replacestr = toUtf8String(ui.lineEditOutputReplace->text());
+	if(m_document.replaceWords(searchstr, replacestr, ui.checkBoxOutputSearchMatchCase->isChecked()) == 0) {
+		ui.lineEditOutputSearch->setStyleSheet("background: #FF7777; color: #FFFFFF;");
 	} else {
-		item->setFlags(item->flags() & ~Qt::ItemIsSelectable);
-		item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicator);
-		item->setExpanded(false);
+		m_modified = true;
+		showItemProperties(ui.treeViewItems->currentIndex());
+	}
+	MAIN->popState();
+}
+
+void OutputEditorHOCR::findReplace(bool backwards, bool replace) {
+	clearErrorState();
+	std::string searchstr = toUtf8String(ui.lineEditOutputSearch->text());
+	std::string replacestr = toUtf8String(ui.lineEditOutputReplace->text());
+	bool matchCase = ui.checkBoxOutputSearchMatchCase->isChecked();
+	HOCRItem* current = m_treeModel->itemForIndex(ui.treeViewItems->currentIndex());
+	if(replace && current && current->isWord() && m_document.replaceWord(current, searchstr, replacestr, matchCase)) {
+		m_modified = true;
+		showItemProperties(ui.treeViewItems->currentIndex());
+	}
+	HOCRItem* word = m_document.findWord(searchstr, matchCase, current, backwards);
+	if(!word) {
+		ui.lineEditOutputSearch->setStyleSheet("background: #FF7777; color: #FFFFFF;");
+		return;
+	}
+	selectItem(word);
+}
+
+void OutputEditorHOCR::selectItem(const HOCRItem* item) {
+	// Scrolling to the item expands its collapsed ancestors
+	QModelIndex index = m_treeModel->indexForItem(item);
+	ui.treeViewItems->scrollTo(index);
+	ui.treeViewItems->setCurrentIndex(index);
+}
+
+void OutputEditorHOCR::pickItem(QPoint point) {
+	// The displayed image is the one of the page of the current item
+	HOCRPage* page = m_currentElement ? m_currentElement->page() : nullptr;
+	if(!page) {
+		return;
 	}
-	ui.treeWidgetItems->blockSignals(false);
+	// Select the innermost item below the point
+	std::vector<HOCRItem*> items = m_document.itemsAt(page, point.x(), point.y());
+	for(auto it = items.rbegin(), itEnd = items.rend(); it != itEnd; ++it) {
+		if(isDisplayed(*it) && (*it)->isEnabled()) {
+			selectItem(*it);
+			return;
+		}
+	}
+}
+
+void OutputEditorHOCR::updateSearchHighlight() {
+	m_treeModel->setSearchText(toUtf8String(ui.lineEditOutputSearch->text()), ui.checkBoxOutputSearchMatchCase->isChecked());
+	ui.treeViewItems->viewport()->update();
 }
 
 void OutputEditorHOCR::propertyCellChanged(int row, int /*col*/) {
@@ -763,41 +1458,31 @@ void OutputEditorHOCR::propertyCellChanged(int row, int /*col*/) {
 	}
 }
 
-void OutputEditorHOCR::updateCurrentItemText() {
-	if(m_currentItem) {
-		QString newText = m_currentItem->text(0);
-		m_currentElement.replaceChild(m_currentDocument.createTextNode(newText), m_currentElement.firstChild());
-		updateCurrentItem();
-	}
-}
-
 void OutputEditorHOCR::updateCurrentItemAttribute(const QString& key, const QString& subkey, const QString& newvalue, bool update) {
-	if(m_currentItem) {
-		if(subkey.isEmpty()) {
-			m_currentElement.setAttribute(key, newvalue);
-		} else {
-			QString value = m_currentElement.attribute(key);
-			QStringList subattrs = value.split(QRegExp("\\s*;\\s*"));
-			for(int i = 0, n = subattrs.size(); i < n; ++i) {
-				int splitPos = subattrs[i].indexOf(QRegExp("\\s+"));
-				if(subattrs[i].left(splitPos) == subkey) {
-					subattrs[i] = subkey + " " + newvalue;
-					break;
-				}
+	if(m_currentElement) {
+		// The current item is refreshed below
+		m_treeModel->blockSignals(true);
+		if(key == "id" && subkey.isEmpty()) {
+			// The id also keys the document index
+			if(!m_document.setItemId(m_currentElement, toUtf8String(newvalue))) {
+				m_treeModel->blockSignals(false);
+				return;
 			}
-			m_currentElement.setAttribute(key, subattrs.join("; "));
+		} else if(subkey.isEmpty()) {
+			m_document.setItemAttribute(m_currentElement, toUtf8String(key), toUtf8String(newvalue));
+		} else {
+			m_document.setItemTitleProperty(m_currentElement, toUtf8String(subkey), toUtf8String(newvalue));
 		}
+		m_treeModel->blockSignals(false);
 		if(update)
 			updateCurrentItem();
 	}
 }
 
 void OutputEditorHOCR::updateCurrentItemBBox(QRect rect) {
-	if(m_currentItem) {
-		ui.treeWidgetItems->blockSignals(true);
-		m_currentItem->setData(0, BBoxRole, rect);
-		ui.treeWidgetItems->blockSignals(false);
-		QString bboxstr = QString("%1 %2 %3 %4").arg(rect.x()).arg(rect.y()).arg(rect.x() + rect.width()).arg(rect.y() + rect.height());
+	if(m_currentElement) {
+		HOCRItem::BBox bbox(rect.x(), rect.y(), rect.x() + rect.width(), rect.y() + rect.height());
+		QString bboxstr = fromUtf8String(bbox.toString());
 		for(int row = 0, n = ui.tableWidgetProperties->rowCount(); row < n; ++row) {
 			QTableWidgetItem* cell = ui.tableWidgetProperties->item(row, 0);
 			if(cell->text() == "bbox" && cell->data(ParentAttrRole).toString() == "title") {
@@ -807,161 +1492,116 @@ void OutputEditorHOCR::updateCurrentItemBBox(QRect rect) {
 				break;
 			}
 		}
-		updateCurrentItemAttribute("title", "bbox", bboxstr, false);
-		QString str;
-		QTextStream stream(&str);
-		m_currentDocument.save(stream, 1);
-		m_currentPageItem->setData(0, SourceRole, str);
-
-		QString elemstr;
-		QTextStream elemstream(&elemstr);
-		m_currentElement.save(elemstream, 1);
-		ui.plainTextEditOutput->setPlainText(elemstr);
+		// Don't reset the selection which is being dragged
+		m_treeModel->blockSignals(true);
+		m_document.setItemBBox(m_currentElement, bbox);
+		m_treeModel->blockSignals(false);
+		ui.plainTextEditOutput->setPlainText(fromUtf8String(m_currentElement->toHtml(1)));
+		m_modified = true;
 	}
 }
 
 void OutputEditorHOCR::updateCurrentItem() {
-	QString spellLang = Utils::getSpellingLanguage(m_currentElement.attribute("lang"));
-	if(m_spell.getLanguage() != spellLang) {
-		m_spell.setLanguage(spellLang);
-	}
-	ui.treeWidgetItems->blockSignals(true); // prevent item changed signal
-	m_currentItem->setForeground(0, m_spell.checkWord(trimWord(m_currentItem->text(0))) ? m_currentItem->parent()->foreground(0) : QBrush(Qt::red));
-	ui.treeWidgetItems->blockSignals(false);
-
-	QString str;
-	QTextStream stream(&str);
-	m_currentDocument.save(stream, 1);
-	m_currentPageItem->setData(0, SourceRole, str);
-
-	QString elemstr;
-	QTextStream elemstream(&elemstr);
-	m_currentElement.save(elemstream, 1);
-	ui.plainTextEditOutput->setPlainText(elemstr);
+	// Spelling highlight is recomputed when the row is repainted
+	ui.treeViewItems->viewport()->update();
+	ui.plainTextEditOutput->setPlainText(fromUtf8String(m_currentElement->toHtml(1)));
 
-	if(setCurrentSource(m_currentDocument.firstChildElement("div")) && s_bboxRx.indexIn(m_currentElement.attribute("title")) != -1) {
-		int x1 = s_bboxRx.cap(1).toInt();
-		int y1 = s_bboxRx.cap(2).toInt();
-		int x2 = s_bboxRx.cap(3).toInt();
-		int y2 = s_bboxRx.cap(4).toInt();
-		m_tool->setSelection(QRect(x1, y1, x2-x1, y2-y1));
+	if(setCurrentSource(m_currentElement->page())) {
+		m_tool->setSelection(toQRect(m_currentElement->bbox()));
 	}
 
 	m_modified = true;
 }
 
 void OutputEditorHOCR::removeCurrentItem() {
-	m_currentElement.parentNode().removeChild(m_currentElement);
-
-	QString str;
-	QTextStream stream(&str);
-	m_currentDocument.save(stream, 1);
-	m_currentPageItem->setData(0, SourceRole, str);
-
-	delete m_currentItem;
-	m_currentItem = nullptr;
+	if(!m_currentElement) {
+		return;
+	}
+	HOCRItem* item = m_currentElement;
+	m_currentElement = nullptr;
+	m_document.removeItem(item);
+	m_modified = true;
 }
 
 void OutputEditorHOCR::addGraphicRegion(QRect rect) {
-	QDomElement pageDiv = m_currentDocument.firstChildElement("div");
-	if(pageDiv.isNull()) {
+	if(!m_currentElement) {
 		return;
 	}
-	// Determine a free block id
-	int pageId = 0;
-	int blockId = 0;
-	QDomElement blockEl = pageDiv.firstChildElement("div");
-	while(!blockEl.isNull()) {
-		if(s_idRx.indexIn(blockEl.attribute("id")) != -1) {
-			pageId = qMax(pageId, s_idRx.cap(1).toInt() + 1);
-			blockId = qMax(blockId, s_idRx.cap(2).toInt() + 1);
-		}
-		blockEl = blockEl.nextSiblingElement();
-	}
-
-	// Add html element
-	QDomElement graphicElement = m_currentDocument.createElement("div");
-	graphicElement.setAttribute("title", QString("bbox %1 %2 %3 %4").arg(rect.x()).arg(rect.y()).arg(rect.x() + rect.width()).arg(rect.y() + rect.height()));
-	graphicElement.setAttribute("class", "ocr_carea");
-	graphicElement.setAttribute("id", QString("block_%1_%2").arg(pageId).arg(blockId));
-	pageDiv.appendChild(graphicElement);
-	QString str;
-	QTextStream stream(&str);
-	m_currentDocument.save(stream, 1);
-	m_currentPageItem->setData(0, SourceRole, str);
-
-	// Add tree item
-	QTreeWidgetItem* item = new QTreeWidgetItem(QStringList() << _("Graphic"));
-	item->setCheckState(0, Qt::Checked);
-	item->setIcon(0, QIcon(":/icons/item_halftone"));
-	item->setData(0, IdRole, graphicElement.attribute("id"));
-	item->setData(0, ClassRole, "ocr_graphic");
-	item->setData(0, BBoxRole, rect);
-	m_currentPageItem->addChild(item);
-
-	ui.treeWidgetItems->setCurrentItem(item);
-}
-
-QString OutputEditorHOCR::trimWord(const QString& word, QString* prefix, QString* suffix) {
-	QRegExp wordRe("^(\\W*)(.*\\w)(\\W*)$");
-	if(wordRe.indexIn(word) != -1) {
-		if(prefix)
-			*prefix = wordRe.cap(1);
-		if(suffix)
-			*suffix = wordRe.cap(3);
-		return wordRe.cap(2);
+	HOCRPage* page = m_currentElement->page();
+	if(!page) {
+		return;
 	}
-	return word;
-}
+	HOCRItem* item = m_document.addGraphic(page, HOCRItem::BBox(rect.x(), rect.y(), rect.x() + rect.width(), rect.y() + rect.height()));
+	m_modified = true;
 
-void OutputEditorHOCR::mergeItems(const QList<QTreeWidgetItem*>& items) {
-	ui.treeWidgetItems->setCurrentItem(items.front());
+	QModelIndex pageIndex = m_treeModel->indexForItem(page);
+	QModelIndex index = m_treeModel->indexForItem(item);
 
-	QRect bbox = items.front()->data(0, BBoxRole).toRect();
-	QString text = items.front()->text(0);
+	ui.treeViewItems->expand(pageIndex);
+	ui.treeViewItems->setCurrentIndex(index);
+}
 
-	for(int i = 1, n = items.size(); i < n; ++i) {
-		bbox = bbox.united(items[i]->data(0, BBoxRole).toRect());
-		text += items[i]->text(0);
-		QDomElement element = elementById(m_currentDocument.firstChildElement(), items[i]->data(0, IdRole).toString());
-		element.parentNode().removeChild(element);
-		delete items[i];
-	}
+QString OutputEditorHOCR::trimWord(const QString& word, QString* prefix, QString* suffix) {
+	// Strips the leading and trailing non-word characters, i.e. punctuation
+	auto isWordChar = [](QChar c) { return c.isLetterOrNumber() || c.isMark() || c == '_'; };
+	int start = 0, end = word.length();
+	while(start < end && !isWordChar(word[start])) {
+		++start;
+	}
+	while(end > start && !isWordChar(word[end - 1])) {
+		--end;
+	}
+	if(start == end) {
+		return word;
+	}
+	if(prefix)
+		*prefix = word.left(start);
+	if(suffix)
+		*suffix = word.mid(end);
+	return word.mid(start, end - start);
+}
 
-	items.front()->setText(0, text);
-	items.front()->setData(0, BBoxRole, bbox);
-	updateCurrentItemText();
-	updateCurrentItemAttribute("title", "bbox", QString("%1 %2 %3 %4").arg(bbox.x()).arg(bbox.y()).arg(bbox.x() + bbox.width()).arg(bbox.y() + bbox.height()));
-	showItemProperties(m_currentItem);
+void OutputEditorHOCR::mergeItems(const QModelIndexList& indices) {
+	std::vector<HOCRItem*> words;
+	for(const QModelIndex& index : indices) {
+		words.push_back(m_treeModel->itemForIndex(index));
+	}
+	std::sort(words.begin(), words.end(), [](const HOCRItem* a, const HOCRItem* b) { return a->index() < b->index(); });
+	m_currentElement = nullptr;
+	QModelIndex merged = m_treeModel->indexForItem(m_document.mergeWords(words));
+	ui.treeViewItems->setCurrentIndex(merged);
+	showItemProperties(merged);
+	updateCurrentItem();
 }
 
 void OutputEditorHOCR::showTreeWidgetContextMenu(const QPoint &point) {
-	QList<QTreeWidgetItem*> items = ui.treeWidgetItems->selectedItems();
+	QModelIndexList indices = ui.treeViewItems->selectionModel()->selectedRows();
 	bool wordsSelected = true;
-	for(QTreeWidgetItem* item : items) {
-		QString itemClass = item->data(0, ClassRole).toString();
-		if(itemClass != "ocrx_word") {
+	for(const QModelIndex& index : indices) {
+		// Only words of the same line can be merged
+		if(index.data(ClassRole).toString() != "ocrx_word" || index.parent() != indices.front().parent()) {
 			wordsSelected = false;
 			break;
 		}
 	}
-	if(items.size() > 1 && wordsSelected) {
+	if(indices.size() > 1 && wordsSelected) {
 		QMenu menu;
 		QAction* actionMerge = menu.addAction(_("Merge"));
-		if(menu.exec(ui.treeWidgetItems->mapToGlobal(point)) == actionMerge) {
-			mergeItems(items);
+		if(menu.exec(ui.treeViewItems->mapToGlobal(point)) == actionMerge) {
+			mergeItems(indices);
 		}
 		return;
-	} else if(items.size() > 1) {
+	} else if(indices.size() > 1) {
 		return;
 	}
 
-	QTreeWidgetItem* item = ui.treeWidgetItems->itemAt(point);
-	if(!item) {
+	QModelIndex index = ui.treeViewItems->indexAt(point);
+	if(!index.isValid()) {
 		return;
 	}
-	QString itemClass = item->data(0, ClassRole).toString();
-	if(itemClass.isEmpty() && item != m_rootItem) {
+	bool isRoot = index == m_treeModel->documentIndex();
+	QString itemClass = index.data(ClassRole).toString();
+	if(itemClass.isEmpty() && !isRoot) {
 		return;
 	}
 	QMenu menu;
@@ -973,24 +1613,37 @@ void OutputEditorHOCR::showTreeWidgetContextMenu(const QPoint &point) {
 	QAction* actionRemovePage = nullptr;
 	QAction* actionExpand = nullptr;
 	QAction* actionCollapse = nullptr;
+	QString spellLang;
 	if(itemClass == "ocr_page") {
 		actionAddGraphic = menu.addAction(_("Add graphic region"));
 	}
 	if(itemClass == "ocrx_word") {
-		QString prefix, suffix, trimmedWord = trimWord(item->text(0), &prefix, &suffix);
-		for(const QString& suggestion : m_spell.getSpellingSuggestions(trimmedWord)) {
+		QString prefix, suffix, trimmedWord = trimWord(index.data().toString(), &prefix, &suffix);
+		spellLang = m_treeModel->spellingLanguage(m_treeModel->itemForIndex(index));
+		QList<QString> suggestions;
+		bool correct;
+		{
+			// The spell checker thread uses the dictionaries as well
+			QMutexLocker locker(&Utils::spellingMutex());
+			if(m_spell.getLanguage() != spellLang) {
+				m_spell.setLanguage(spellLang);
+			}
+			suggestions = m_spell.getSpellingSuggestions(trimmedWord);
+			correct = m_spell.checkWord(trimmedWord);
+		}
+		for(const QString& suggestion : suggestions) {
 			setTextActions.append(menu.addAction(prefix + suggestion + suffix));
 		}
 		if(setTextActions.isEmpty()) {
 			menu.addAction(_("No suggestions"))->setEnabled(false);
 		}
-		if(!m_spell.checkWord(trimWord(item->text(0)))) {
+		if(!correct) {
 			menu.addSeparator();
 			addWordAction = menu.addAction(_("Add to dictionary"));
 			ignoreWordAction = menu.addAction(_("Ignore word"));
 		}
 	}
-	if(item != m_rootItem) {
+	if(!isRoot) {
 		if(!menu.actions().isEmpty()) {
 			menu.addSeparator();
 		}
@@ -1008,7 +1661,7 @@ void OutputEditorHOCR::showTreeWidgetContextMenu(const QPoint &point) {
 		actionCollapse = menu.addAction(_("Collapse all"));
 	}
 
-	QAction* clickedAction = menu.exec(ui.treeWidgetItems->mapToGlobal(point));
+	QAction* clickedAction = menu.exec(ui.treeViewItems->mapToGlobal(point));
 	if(!clickedAction) {
 		return;
 	}
@@ -1016,26 +1669,79 @@ void OutputEditorHOCR::showTreeWidgetContextMenu(const QPoint &point) {
 		m_tool->clearSelection();
 		m_tool->activateDrawSelection();
 	} else if(clickedAction == addWordAction) {
-		m_spell.addWordToDictionary(item->text(0));
-		item->setForeground(0, item->parent()->foreground(0));
+		{
+			QMutexLocker locker(&Utils::spellingMutex());
+			m_spell.addWordToDictionary(index.data().toString());
+		}
+		m_spellChecker.setCorrect(spellLang, trimWord(index.data().toString()));
+		m_treeModel->itemChanged(index);
 	} else if(clickedAction == ignoreWordAction) {
-		m_spell.ignoreWord(item->text(0));
-		item->setForeground(0, item->parent()->foreground(0));
+		{
+			QMutexLocker locker(&Utils::spellingMutex());
+			m_spell.ignoreWord(index.data().toString());
+		}
+		m_spellChecker.setCorrect(spellLang, trimWord(index.data().toString()));
+		m_treeModel->itemChanged(index);
 	} else if(setTextActions.contains(clickedAction)){
-		item->setText(0, clickedAction->text());
+		m_treeModel->setData(index, clickedAction->text(), Qt::EditRole);
 	} else if(clickedAction == actionRemoveItem) {
 		removeCurrentItem();
 	} else if(clickedAction == actionRemovePage) {
-		delete item;
-		ui.actionOutputSaveHOCR->setEnabled(ui.treeWidgetItems->topLevelItemCount() > 0);
-		ui.actionOutputExportPDF->setEnabled(ui.treeWidgetItems->topLevelItemCount() > 0);
+		HOCRItem* pageElement = m_treeModel->itemForIndex(index);
+		if(pageElement == m_currentElement || (m_currentElement && m_currentElement->page() == pageElement)) {
+			m_currentElement = nullptr;
+		}
+		m_document.removeItem(pageElement);
+		m_modified = true;
+		ui.actionOutputSaveHOCR->setEnabled(m_document.pageCount() > 0);
+		ui.actionOutputExportPDF->setEnabled(m_document.pageCount() > 0);
 	} else if(clickedAction == actionExpand) {
-		expandChildren(item);
+		expandChildren(index);
 	} else if(clickedAction == actionCollapse) {
-		collapseChildren(item);
+		collapseChildren(index);
 	}
 }
 
+void OutputEditorHOCR::undo() {
+	m_document.undo();
+	m_modified = true;
+	showItemProperties(ui.treeViewItems->currentIndex());
+}
+
+void OutputEditorHOCR::redo() {
+	m_document.redo();
+	m_modified = true;
+	showItemProperties(ui.treeViewItems->currentIndex());
+}
+
+void OutputEditorHOCR::itemAboutToBeInserted(const HOCRItem* parent, int index, const HOCRItem* item) {
+	m_treeModel->beginInsertItem(parent, index, item);
+}
+
+void OutputEditorHOCR::itemInserted(HOCRItem* /*item*/) {
+	m_treeModel->endInsertItem();
+}
+
+void OutputEditorHOCR::itemAboutToBeRemoved(HOCRItem* item) {
+	m_treeModel->beginRemoveItem(item);
+}
+
+void OutputEditorHOCR::itemRemoved(HOCRItem* /*item*/) {
+	m_treeModel->endRemoveItem();
+}
+
+void OutputEditorHOCR::itemChanged(HOCRItem* item) {
+	m_treeModel->itemChanged(item);
+}
+
+void OutputEditorHOCR::historyChanged() {
+	ui.actionOutputUndo->setEnabled(m_document.canUndo());
+	ui.actionOutputRedo->setEnabled(m_document.canRedo());
+	// Undoing can restore removed pages
+	ui.actionOutputSaveHOCR->setEnabled(m_document.pageCount() > 0);
+	ui.actionOutputExportPDF->setEnabled(m_document.pageCount() > 0);
+}
+
 void OutputEditorHOCR::updateFontButton(const QFont& font) {
 	m_pdfExportDialogUi.buttonFont->setText(QString("%1 %2").arg(font.family()).arg(font.pointSize()));
 	updatePreview();
@@ -1055,18 +1761,26 @@ void OutputEditorHOCR::open() {
 		QMessageBox::critical(MAIN, _("Failed to open file"), _("The file could not be opened: %1.").arg(filename));
 		return;
 	}
-	QDomDocument doc;
-	doc.setContent(&file);
-	QDomElement div = doc.firstChildElement("html").firstChildElement("body").firstChildElement("div");
-	if(div.isNull() || div.attribute("class") != "ocr_page") {
-		QMessageBox::critical(MAIN, _("Invalid hOCR file"), _("The file does not appear to contain valid hOCR HTML: %1").arg(filename));
-		return;
-	}
+	// Parse and prepare the pages in the background, they are added in batches as they are completed
+	QString basename = QFileInfo(filename).fileName();
 	int page = 0;
-	while(!div.isNull()) {
-		++page;
-		addPage(div, QFileInfo(filename).fileName(), page, false);
-		div = div.nextSiblingElement("div");
+	Utils::busyTask([&] {
+		QXmlStreamReader reader(&file);
+		while(!reader.atEnd()) {
+			if(reader.readNext() != QXmlStreamReader::StartElement) {
+				continue;
+			}
+			if(reader.name() == QLatin1String("div") && reader.attributes().value("class") == QLatin1String("ocr_page")) {
+				HOCRPage* pageItem = static_cast<HOCRPage*>(parseItem(reader));
+				pageItem->setLabel(toUtf8String(QString("%1 [%2]").arg(basename).arg(++page)));
+				HOCRDocument::preparePage(pageItem, m_document.nextPageId(), false);
+				queuePage(pageItem);
+			}
+		}
+		return page > 0;
+	}, _("Loading hOCR file..."));
+	if(page == 0) {
+		QMessageBox::critical(MAIN, _("Invalid hOCR file"), _("The file does not appear to contain valid hOCR HTML: %1").arg(filename));
 	}
 }
 
@@ -1099,11 +1813,13 @@ bool OutputEditorHOCR::save(const QString& filename) {
 	                     "  </head>\n"
 	                     "<body>\n").arg(tess.Version());
 	file.write(header.toUtf8());
-	for(int i = 0, n = ui.treeWidgetItems->topLevelItemCount(); i < n; ++i) {
-		file.write(ui.treeWidgetItems->topLevelItem(i)->data(0, SourceRole).toString().toUtf8());
+	for(const HOCRPage* page : m_document.pages()) {
+		std::string pageHtml = page->toHtml(1);
+		file.write(pageHtml.data(), pageHtml.size());
 	}
 	file.write("</body>\n</html>\n");
 	m_modified = false;
+	m_document.markSaved();
 	return true;
 }
 
@@ -1114,7 +1830,9 @@ void OutputEditorHOCR::savePDF() {
 	MAIN->getDisplayer()->scene()->addItem(m_preview);
 
 	bool accepted = false;
-	PoDoFo::PdfStreamedDocument* document = nullptr;
+	bool sourceOverlay = false;
+	QString outname;
+	PoDoFo::PdfDocument* document = nullptr;
 	PoDoFo::PdfFont* font = nullptr;
 #if PODOFO_VERSION >= PODOFO_MAKE_VERSION(0,9,3)
 	const PoDoFo::PdfEncoding* pdfEncoding = PoDoFo::PdfEncodingFactory::GlobalIdentityEncodingInstance();
@@ -1129,7 +1847,7 @@ void OutputEditorHOCR::savePDF() {
 
 		QList<Source*> sources = MAIN->getSourceManager()->getSelectedSources();
 		QString base = !sources.isEmpty() ? QFileInfo(sources.first()->displayname).baseName() : _("output");
-		QString outname = QDir(MAIN->getConfig()->getSetting<VarSetting<QString>>("outputdir")->getValue()).absoluteFilePath(base + ".pdf");
+		outname = QDir(MAIN->getConfig()->getSetting<VarSetting<QString>>("outputdir")->getValue()).absoluteFilePath(base + ".pdf");
 		outname = QFileDialog::getSaveFileName(MAIN, _("Save PDF Output..."), outname, QString("%1 (*.pdf)").arg(_("PDF Files")));
 		if(outname.isEmpty()) {
 			accepted = false;
@@ -1137,8 +1855,14 @@ void OutputEditorHOCR::savePDF() {
 		}
 		MAIN->getConfig()->getSetting<VarSetting<QString>>("outputdir")->setValue(QFileInfo(outname).absolutePath());
 
+		sourceOverlay = m_pdfExportDialogUi.comboBoxOutputMode->currentIndex() == 2;
 		try {
-			document = new PoDoFo::PdfStreamedDocument(outname.toLocal8Bit().data());
+			if(sourceOverlay) {
+				// The source pages are copied in memory, the document is written once complete
+				document = new PoDoFo::PdfMemDocument();
+			} else {
+				document = new PoDoFo::PdfStreamedDocument(outname.toLocal8Bit().data());
+			}
 		} catch(...) {
 			QMessageBox::critical(MAIN, _("Failed to save output"), _("Check that you have writing permissions in the selected folder."));
 			continue;
@@ -1155,7 +1879,9 @@ void OutputEditorHOCR::savePDF() {
 		}
 		if(!font) {
 			QMessageBox::critical(MAIN, _("Error"), _("The PDF library does not support the selected font."));
-			document->Close();
+			if(!sourceOverlay) {
+				static_cast<PoDoFo::PdfStreamedDocument*>(document)->Close();
+			}
 			delete document;
 			continue;
 		}
@@ -1176,97 +1902,204 @@ void OutputEditorHOCR::savePDF() {
 	pdfSettings.conversionFlags = pdfSettings.colorFormat == QImage::Format_Mono ? static_cast<Qt::ImageConversionFlags>(m_pdfExportDialogUi.comboBoxDithering->itemData(m_pdfExportDialogUi.comboBoxDithering->currentIndex()).toInt()) : Qt::AutoColor;
 	pdfSettings.compression = static_cast<PDFSettings::Compression>(m_pdfExportDialogUi.comboBoxImageCompression->itemData(m_pdfExportDialogUi.comboBoxImageCompression->currentIndex()).toInt());
 	pdfSettings.compressionQuality = m_pdfExportDialogUi.spinBoxCompressionQuality->value();
+	pdfSettings.zipLevel = m_pdfExportDialogUi.spinBoxZipLevel->value();
+	pdfSettings.fax4Strips = m_pdfExportDialogUi.checkBoxFax4Strips->isChecked();
 	pdfSettings.useDetectedFontSizes = m_pdfExportDialogUi.checkBoxFontSize->isChecked();
 	pdfSettings.uniformizeLineSpacing = m_pdfExportDialogUi.checkBoxUniformizeSpacing->isChecked();
 	pdfSettings.preserveSpaceWidth = m_pdfExportDialogUi.spinBoxPreserve->value();
-	pdfSettings.overlay = m_pdfExportDialogUi.comboBoxOutputMode->currentIndex() == 1;
+	pdfSettings.overlay = m_pdfExportDialogUi.comboBoxOutputMode->currentIndex() != 0;
 	pdfSettings.detectedFontScaling = m_pdfExportDialogUi.spinFontScaling->value() / 100.;
+	if(sourceOverlay) {
+		saveSourceOverlay(static_cast<PoDoFo::PdfMemDocument*>(document), font, outname, pdfSettings);
+		delete document;
+		return;
+	}
+	// The pages are recorded here while their images are encoded in the background, and written in order
+	WorkerPool pool;
+	PoDoFoGlyphWidths glyphWidths(font);
+	std::deque<PoDoFoPDFPainter*> pendingPages;
+	PageRasterizer rasterizer;
 	QStringList failed;
-	for(int i = 0, n = ui.treeWidgetItems->topLevelItemCount(); i < n; ++i) {
-		QTreeWidgetItem* item = ui.treeWidgetItems->topLevelItem(i);
-		if(item->checkState(0) != Qt::Checked) {
+	for(const HOCRPage* pageItem : m_document.pages()) {
+		if(!pageItem->isEnabled()) {
 			continue;
 		}
-		QRect bbox = item->data(0, BBoxRole).toRect();
-		QDomDocument doc;
-		doc.setContent(item->data(0, SourceRole).toString());
-		int sourceDpi = -1;
+		QRect bbox = toQRect(pageItem->bbox());
+		int sourceDpi = pageItem->resolution();
 		int outputDpi = m_pdfExportDialogUi.spinBoxDpi->value();
-		if(setCurrentSource(doc.firstChildElement("div"), &sourceDpi, &outputDpi)) {
+		if(rasterizePage(rasterizer, pageItem, outputDpi)) {
 			double docScale = (72. / sourceDpi);
 			double imgScale = double(outputDpi) / sourceDpi;
-			PoDoFo::PdfPage* page = document->CreatePage(PoDoFo::PdfRect(0, 0, bbox.width() * docScale, bbox.height() * docScale));
-			painter.SetPage(page);
-			painter.SetFont(font);
-
-			PoDoFoPDFPainter pdfprinter(document, &painter, docScale);
-			pdfprinter.setFontSize(m_pdfFontDialog.currentFont().pointSize());
-			printChildren(pdfprinter, item, pdfSettings, imgScale);
+			PoDoFoPDFPainter* pdfprinter = new PoDoFoPDFPainter(pool, glyphWidths, font, bbox.width() * docScale, bbox.height() * docScale, docScale);
+			pdfprinter->setFontSize(m_pdfFontDialog.currentFont().pointSize());
+			printChildren(*pdfprinter, pageItem, pdfSettings, rasterizer, imgScale);
 			if(pdfSettings.overlay) {
 				QRect scaledBBox(imgScale * bbox.left(), imgScale * bbox.top(), imgScale * bbox.width(), imgScale * bbox.height());
-				pdfprinter.drawImage(bbox, m_tool->getSelection(scaledBBox), pdfSettings);
+				pdfprinter->drawImage(bbox, rasterizer.getRegion(scaledBBox), pdfSettings);
+			}
+			pendingPages.push_back(pdfprinter);
+			// Only render ahead as far as there are threads to encode the pages
+			while(int(pendingPages.size()) > pool.threadCount()) {
+				pendingPages.front()->writePage(document, &painter);
+				delete pendingPages.front();
+				pendingPages.pop_front();
 			}
-			MAIN->getDisplayer()->setResolution(sourceDpi);
-			painter.FinishPage();
 		} else {
-			failed.append(item->text(0));
+			failed.append(fromUtf8String(pageItem->label()));
 		}
 	}
+	for(PoDoFoPDFPainter* pdfprinter : pendingPages) {
+		pdfprinter->writePage(document, &painter);
+		delete pdfprinter;
+	}
 	if(!failed.isEmpty()) {
 		QMessageBox::warning(m_widget, _("Errors occurred"), _("The following pages could not be rendered:\n%1").arg(failed.join("\n")));
 	}
-	document->Close();
+	static_cast<PoDoFo::PdfStreamedDocument*>(document)->Close();
 	delete document;
 }
 
-void OutputEditorHOCR::printChildren(PDFPainter& painter, QTreeWidgetItem* item, const PDFSettings& pdfSettings, double imgScale) const {
-	if(item->checkState(0) != Qt::Checked) {
+// Copies the pages of the source PDF files, and writes the text onto them as an invisible layer,
+// without rasterizing them. Consecutive pages of a source are copied at once, so that the objects
+// they share (fonts, images) are only copied once.
+void OutputEditorHOCR::saveSourceOverlay(PoDoFo::PdfMemDocument* document, PoDoFo::PdfFont* font, const QString& filename, const PDFSettings& pdfSettings) {
+	PoDoFo::PdfPainter painter;
+	// No images are drawn, the pool is only needed by the painter
+	WorkerPool pool(1);
+	PoDoFoGlyphWidths glyphWidths(font);
+	PageRasterizer rasterizer;
+	std::map<std::string, PoDoFo::PdfMemDocument*> sources;
+	std::vector<const HOCRPage*> pages;
+	QStringList failed;
+	bool copied = Utils::busyTask([&] {
+		try {
+			PoDoFo::PdfMemDocument* runSource = nullptr;
+			int runFirst = 0;
+			int runCount = 0;
+			for(const HOCRPage* pageItem : m_document.pages()) {
+				if(!pageItem->isEnabled()) {
+					continue;
+				}
+				auto it = sources.find(pageItem->sourceFile());
+				if(it == sources.end()) {
+					PoDoFo::PdfMemDocument* source = new PoDoFo::PdfMemDocument();
+					try {
+						source->Load(fromUtf8String(pageItem->sourceFile()).toLocal8Bit().data());
+					} catch(...) {
+						// Not a PDF, or not readable
+						delete source;
+						source = nullptr;
+					}
+					it = sources.insert(std::make_pair(pageItem->sourceFile(), source)).first;
+				}
+				PoDoFo::PdfMemDocument* source = it->second;
+				if(!source || pageItem->pageNr() < 1 || pageItem->pageNr() > source->GetPageCount()) {
+					failed.append(fromUtf8String(pageItem->label()));
+					continue;
+				}
+				if(source != runSource || pageItem->pageNr() - 1 != runFirst + runCount) {
+					if(runCount > 0) {
+						document->InsertPages(*runSource, runFirst, runCount);
+					}
+					runSource = source;
+					runFirst = pageItem->pageNr() - 1;
+					runCount = 0;
+				}
+				++runCount;
+				pages.push_back(pageItem);
+			}
+			if(runCount > 0) {
+				document->InsertPages(*runSource, runFirst, runCount);
+			}
+		} catch(...) {
+			return false;
+		}
+		return true;
+	}, _("Copying source pages..."));
+	if(copied) {
+		for(std::size_t i = 0; i < pages.size(); ++i) {
+			const HOCRPage* pageItem = pages[i];
+			QRect bbox = toQRect(pageItem->bbox());
+			double docScale = 72. / pageItem->resolution();
+			PoDoFoPDFPainter pdfprinter(pool, glyphWidths, font, bbox.width() * docScale, bbox.height() * docScale, docScale);
+			pdfprinter.setFontSize(m_pdfFontDialog.currentFont().pointSize());
+			printChildren(pdfprinter, pageItem, pdfSettings, rasterizer);
+			PoDoFo::PdfPage* page = document->GetPage(i);
+			pdfprinter.writeOverlay(document, &painter, page, sourcePageTransform(page, pageItem->angle(), bbox.height() * docScale));
+		}
+	}
+	// The copies are complete, closing the sources allows the output to replace one of them
+	for(const auto& source : sources) {
+		delete source.second;
+	}
+	if(!copied) {
+		QMessageBox::critical(MAIN, _("Failed to save output"), _("The pages could not be copied from the source PDF files."));
+		return;
+	}
+	bool written = Utils::busyTask([&] {
+		try {
+			document->Write(filename.toLocal8Bit().data());
+		} catch(...) {
+			return false;
+		}
+		return true;
+	}, _("Writing PDF..."));
+	if(!written) {
+		QMessageBox::critical(MAIN, _("Failed to save output"), _("Check that you have writing permissions in the selected folder."));
+	} else if(!failed.isEmpty()) {
+		QMessageBox::warning(m_widget, _("Errors occurred"), _("The following pages are not from a PDF file and were skipped:\n%1").arg(failed.join("\n")));
+	}
+}
+
+void OutputEditorHOCR::printChildren(PDFPainter& painter, const HOCRItem* item, const PDFSettings& pdfSettings, const PageRasterizer& rasterizer, double imgScale) const {
+	if(!item->isEnabled()) {
 		return;
 	}
-	QString itemClass = item->data(0, ClassRole).toString();
-	QRect itemRect = item->data(0, BBoxRole).toRect();
-	if(itemClass == "ocr_par" && pdfSettings.uniformizeLineSpacing) {
+	QRect itemRect = toQRect(item->bbox());
+	if(item->isParagraph() && pdfSettings.uniformizeLineSpacing) {
 		double yInc = double(itemRect.height()) / item->childCount();
 		double y = itemRect.top() + yInc;
-		int baseline = item->childCount() > 0 ? item->child(0)->data(0, BaselineRole).toInt() : 0;
-		for(int iLine = 0, nLines = item->childCount(); iLine < nLines; ++iLine, y += yInc) {
-			QTreeWidgetItem* lineItem = item->child(iLine);
+		int baseline = item->childCount() > 0 ? item->child(0)->baseline() : 0;
+		for(const HOCRItem* lineItem : item->children()) {
 			int x = itemRect.x();
 			int prevWordRight = itemRect.x();
-			for(int iWord = 0, nWords = lineItem->childCount(); iWord < nWords; ++iWord) {
-				QTreeWidgetItem* wordItem = lineItem->child(iWord);
-				if(wordItem->checkState(0) == Qt::Checked) {
-					QRect wordRect = wordItem->data(0, BBoxRole).toRect();
+			for(const HOCRItem* wordItem : lineItem->children()) {
+				if(wordItem->isEnabled()) {
+					QRect wordRect = toQRect(wordItem->bbox());
+					QString text = fromUtf8String(wordItem->text());
 					if(pdfSettings.useDetectedFontSizes) {
-						painter.setFontSize(wordItem->data(0, FontSizeRole).toDouble() * pdfSettings.detectedFontScaling);
+						painter.setFontSize(wordItem->fontSize() * pdfSettings.detectedFontScaling);
 					}
 					// If distance from previous word is large, keep the space
 					if(wordRect.x() - prevWordRight > pdfSettings.preserveSpaceWidth * painter.getAverageCharWidth()) {
 						x = wordRect.x();
 					}
 					prevWordRight = wordRect.right();
-					painter.drawText(x, y + baseline, wordItem->text(0));
-					x += painter.getTextWidth(wordItem->text(0) + " ");
+					painter.drawText(x, y + baseline, text);
+					x += painter.getTextWidth(text + " ");
 				}
 			}
+			y += yInc;
 		}
-	} else if(itemClass == "ocr_line" && !pdfSettings.uniformizeLineSpacing) {
-		int baseline = item->data(0, BaselineRole).toInt();
+	} else if(item->isLine() && !pdfSettings.uniformizeLineSpacing) {
+		int baseline = item->baseline();
 		double y = itemRect.bottom() + baseline;
-		for(int iWord = 0, nWords = item->childCount(); iWord < nWords; ++iWord) {
-			QTreeWidgetItem* wordItem = item->child(iWord);
-			QRect wordRect = wordItem->data(0, BBoxRole).toRect();
+		for(const HOCRItem* wordItem : item->children()) {
+			if(!wordItem->isEnabled()) {
+				continue;
+			}
+			QRect wordRect = toQRect(wordItem->bbox());
 			if(pdfSettings.useDetectedFontSizes) {
-				painter.setFontSize(wordItem->data(0, FontSizeRole).toDouble() * pdfSettings.detectedFontScaling);
+				painter.setFontSize(wordItem->fontSize() * pdfSettings.detectedFontScaling);
 			}
-			painter.drawText(wordRect.x(), y, wordItem->text(0));
+			painter.drawText(wordRect.x(), y, fromUtf8String(wordItem->text()));
 		}
-	} else if(itemClass == "ocr_graphic" && !pdfSettings.overlay) {
+	} else if(item->isGraphic() && !pdfSettings.overlay) {
 		QRect scaledItemRect(itemRect.left() * imgScale, itemRect.top() * imgScale, itemRect.width() * imgScale, itemRect.height() * imgScale);
-		painter.drawImage(itemRect, m_tool->getSelection(scaledItemRect), pdfSettings);
+		painter.drawImage(itemRect, rasterizer.getRegion(scaledItemRect), pdfSettings);
 	} else {
-		for(int i = 0, n = item->childCount(); i < n; ++i) {
-			printChildren(painter, item->child(i), pdfSettings, imgScale);
+		for(const HOCRItem* child : item->children()) {
+			printChildren(painter, child, pdfSettings, rasterizer, imgScale);
 		}
 	}
 }
@@ -1276,32 +2109,31 @@ void OutputEditorHOCR::updatePreview() {
 		return;
 	}
 	m_preview->setVisible(m_pdfExportDialogUi.checkBoxPreview->isChecked());
-	if(ui.treeWidgetItems->topLevelItemCount() == 0 || !m_pdfExportDialogUi.checkBoxPreview->isChecked()) {
+	if(m_document.pageCount() == 0 || !m_pdfExportDialogUi.checkBoxPreview->isChecked()) {
 		return;
 	}
-	QTreeWidgetItem* item = ui.treeWidgetItems->currentItem();
-	if(!item) {
-		item = ui.treeWidgetItems->topLevelItem(0);
-	} else {
-		while(item->parent()) {
-			item = item->parent();
-		}
+	const HOCRPage* page = m_currentElement ? m_currentElement->page() : nullptr;
+	if(!page) {
+		page = m_document.page(0);
 	}
-	QRect bbox = item->data(0, BBoxRole).toRect();
-	QDomDocument doc;
+	QRect bbox = toQRect(page->bbox());
 	int pageDpi = -1;
-	doc.setContent(item->data(0, SourceRole).toString());
-	setCurrentSource(doc.firstChildElement("div"), &pageDpi);
+	setCurrentSource(page, &pageDpi);
+	if(!rasterizePage(m_previewRasterizer, page, page->resolution())) {
+		return;
+	}
 
 	PDFSettings pdfSettings;
 	pdfSettings.colorFormat = static_cast<QImage::Format>(m_pdfExportDialogUi.comboBoxImageFormat->itemData(m_pdfExportDialogUi.comboBoxImageFormat->currentIndex()).toInt());
 	pdfSettings.conversionFlags = pdfSettings.colorFormat == QImage::Format_Mono ? static_cast<Qt::ImageConversionFlags>(m_pdfExportDialogUi.comboBoxDithering->itemData(m_pdfExportDialogUi.comboBoxDithering->currentIndex()).toInt()) : Qt::AutoColor;
 	pdfSettings.compression = static_cast<PDFSettings::Compression>(m_pdfExportDialogUi.comboBoxImageCompression->itemData(m_pdfExportDialogUi.comboBoxImageCompression->currentIndex()).toInt());
 	pdfSettings.compressionQuality = m_pdfExportDialogUi.spinBoxCompressionQuality->value();
+	pdfSettings.zipLevel = m_pdfExportDialogUi.spinBoxZipLevel->value();
+	pdfSettings.fax4Strips = m_pdfExportDialogUi.checkBoxFax4Strips->isChecked();
 	pdfSettings.useDetectedFontSizes = m_pdfExportDialogUi.checkBoxFontSize->isChecked();
 	pdfSettings.uniformizeLineSpacing = m_pdfExportDialogUi.checkBoxUniformizeSpacing->isChecked();
 	pdfSettings.preserveSpaceWidth = m_pdfExportDialogUi.spinBoxPreserve->value();
-	pdfSettings.overlay = m_pdfExportDialogUi.comboBoxOutputMode->currentIndex() == 1;
+	pdfSettings.overlay = m_pdfExportDialogUi.comboBoxOutputMode->currentIndex() != 0;
 	pdfSettings.detectedFontScaling = m_pdfExportDialogUi.spinFontScaling->value() / 100.;
 
 	QImage image(bbox.size(), QImage::Format_ARGB32);
@@ -1313,12 +2145,12 @@ void OutputEditorHOCR::updatePreview() {
 	QPainterPDFPainter pdfPrinter(&painter);
 
 	if(pdfSettings.overlay) {
-		pdfPrinter.drawImage(bbox, m_tool->getSelection(bbox), pdfSettings);
+		pdfPrinter.drawImage(bbox, m_previewRasterizer.getRegion(bbox), pdfSettings);
 		painter.fillRect(0, 0, bbox.width(), bbox.height(), QColor(255, 255, 255, 127));
 	} else {
 		image.fill(Qt::white);
 	}
-	printChildren(pdfPrinter, item, pdfSettings);
+	printChildren(pdfPrinter, page, pdfSettings, m_previewRasterizer);
 	m_preview->setPixmap(QPixmap::fromImage(image));
 	m_preview->setPos(-0.5 * bbox.width(), -0.5 * bbox.height());
 }
@@ -1337,10 +2169,9 @@ bool OutputEditorHOCR::clear(bool hide) {
 			return false;
 		}
 	}
-	m_idCounter = 0;
-	while(m_rootItem->childCount() > 0) {
-		delete m_rootItem->child(0);
-	}
+	m_currentElement = nullptr;
+	m_treeModel->clear();
+	ui.treeViewItems->expand(m_treeModel->documentIndex());
 	ui.tableWidgetProperties->setRowCount(0);
 	ui.plainTextEditOutput->clear();
 	m_tool->clearSelection();
@@ -20,18 +20,24 @@
 #ifndef OUTPUTEDITORHOCR_HH
 #define OUTPUTEDITORHOCR_HH
 
+#include "DisplayRenderer.hh"
+#include "HOCRDocument.hh"
+#include "HOCRSpellChecker.hh"
 #include "OutputEditor.hh"
 #include "Ui_OutputEditorHOCR.hh"
 #include "ui_PdfExportDialog.h"
 
-#include <QDomDocument>
-#include <QDomElement>
+#include <QMutex>
 #include <QtSpell.hpp>
 
 class DisplayerToolHOCR;
 class QGraphicsPixmapItem;
+namespace PoDoFo {
+class PdfFont;
+class PdfMemDocument;
+}
 
-class OutputEditorHOCR : public OutputEditor {
+class OutputEditorHOCR : public OutputEditor, private HOCRDocument::Observer {
 	Q_OBJECT
 public:
 	OutputEditorHOCR(DisplayerToolHOCR* tool);
@@ -45,39 +51,40 @@ public:
 	void readError(const QString& errorMsg, ReadSessionData* data) override;
 	void finalizeRead(ReadSessionData *data) override;
 	bool getModified() const override;
+	// Restores the pages and edits recorded in the journal of a session which did not terminate properly
+	bool recoverJournal(const std::vector<HOCRJournal::Record>& records);
+
+	// The directory holding the journals of all running sessions, and of those which crashed
+	static QString journalDirectory();
+	// The journal from which the session of the process can be recovered after a crash
+	static QString journalFilename(qint64 pid);
 
 public slots:
 	bool clear(bool hide = true) override;
 	void open();
 	bool save(const QString& filename = "") override;
 	void savePDF();
+	void undo();
+	void redo();
 
 private:
 	class HTMLHighlighter;
+	class HOCRTreeModel;
 
 	struct HOCRReadSessionData : ReadSessionData {
 		QStringList errors;
 	};
 
-	static const int IdRole = Qt::UserRole + 1;
-	static const int SourceRole = Qt::UserRole + 2;
-	static const int BBoxRole = Qt::UserRole + 3;
-	static const int ClassRole = Qt::UserRole + 4;
-	static const int FontSizeRole = Qt::UserRole + 5;
-	static const int BaselineRole = Qt::UserRole + 6;
+	static const int ClassRole = Qt::UserRole + 2;
 	static const int ParentAttrRole = Qt::UserRole + 1;
 
-	static const QRegExp s_bboxRx;
-	static const QRegExp s_pageTitleRx;
-	static const QRegExp s_idRx;
-	static const QRegExp s_fontSizeRx;
-	static const QRegExp s_baseLineRx;
-
 	struct PDFSettings {
 		QImage::Format colorFormat;
 		Qt::ImageConversionFlags conversionFlags;
-		enum Compression { CompressZip, CompressFax4, CompressJpeg } compression;
+		enum Compression { CompressZip, CompressFax4, CompressJpeg, CompressJbig2 } compression;
 		int compressionQuality;
+		int zipLevel;
+		bool fax4Strips;
 		bool useDetectedFontSizes;
 		bool uniformizeLineSpacing;
 		int preserveSpaceWidth;
@@ -94,7 +101,7 @@ private:
 		virtual double getTextWidth(const QString& text) const = 0;
 	protected:
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
-		QVector<QRgb> createGray8Table() const {
+		static QVector<QRgb> createGray8Table() {
 			QVector<QRgb> colorTable(255);
 			for(int i = 0; i < 255; ++i) {
 				colorTable[i] = qRgb(i, i, i);
@@ -102,7 +109,7 @@ private:
 			return colorTable;
 		}
 #endif
-		QImage convertedImage(const QImage& image, QImage::Format targetFormat, Qt::ImageConversionFlags flags) const {
+		static QImage convertedImage(const QImage& image, QImage::Format targetFormat, Qt::ImageConversionFlags flags) {
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 			if(image.format() == targetFormat) {
 				return image;
@@ -120,46 +127,65 @@ private:
 	class PoDoFoPDFPainter;
 	class QPainterPDFPainter;
 
-	int m_idCounter = 0;
 	DisplayerToolHOCR* m_tool;
 	QWidget* m_widget;
 	UI_OutputEditorHOCR ui;
 	HTMLHighlighter* m_highlighter;
 	QtSpell::TextEditChecker m_spell;
+	HOCRSpellChecker m_spellChecker;
 	bool m_modified = false;
 	QDialog* m_pdfExportDialog;
 	Ui::PdfExportDialog m_pdfExportDialogUi;
 	QFontDialog m_pdfFontDialog;
 
-	QTreeWidgetItem* m_rootItem = nullptr;
-	QTreeWidgetItem* m_currentItem = nullptr;
-	QTreeWidgetItem* m_currentPageItem = nullptr;
-	QDomDocument m_currentDocument;
-	QDomElement m_currentElement;
+	HOCRJournal m_journal;
+	HOCRDocument m_document;
+	HOCRTreeModel* m_treeModel;
+	HOCRItem* m_currentElement = nullptr;
+	// Pages prepared off the GUI thread which are yet to be added
+	QMutex m_queuedPagesMutex;
+	std::vector<HOCRPage*> m_queuedPages;
 
 	QGraphicsPixmapItem* m_preview = nullptr;
+	PageRasterizer m_previewRasterizer;
 
 	void findReplace(bool backwards, bool replace);
-	void addPage(QDomElement pageDiv, const QString& filename, int page, bool cleanGraphics);
-	bool addChildItems(QDomElement element, QTreeWidgetItem* parentItem, QMap<QString, QString>& langCache);
-	QDomElement elementById(QDomElement element, const QString& id) const;
-	void expandChildren(QTreeWidgetItem* item) const;
-	void collapseChildren(QTreeWidgetItem* item) const;
-	void printChildren(PDFPainter& painter, QTreeWidgetItem* item, const PDFSettings& pdfSettings, double imgScale = 1.) const;
-	bool setCurrentSource(const QDomElement& pageElement, int* pageDpi = 0, int* overrideDpi = 0) const;
-	void updateCurrentItemText();
+	// Parses the hOCR text of a recognized page, may be called from any thread
+	static HOCRPage* parsePage(const QString& hocrText, const ReadSessionData& data);
+	// Queues the prepared page for being added in the GUI thread, may be called from any thread
+	void queuePage(HOCRPage* page);
+	void expandChildren(const QModelIndex& index) const;
+	void collapseChildren(const QModelIndex& index) const;
+	void saveSourceOverlay(PoDoFo::PdfMemDocument* document, PoDoFo::PdfFont* font, const QString& filename, const PDFSettings& pdfSettings);
+	void printChildren(PDFPainter& painter, const HOCRItem* item, const PDFSettings& pdfSettings, const PageRasterizer& rasterizer, double imgScale = 1.) const;
+	bool setCurrentSource(const HOCRPage* page, int* pageDpi = 0) const;
 	void updateCurrentItemAttribute(const QString& key, const QString& subkey, const QString& newvalue, bool update=true);
 	void updateCurrentItem();
 	void removeCurrentItem();
-	QString trimWord(const QString& word, QString* prefix = nullptr, QString* suffix = nullptr);
-	void mergeItems(const QList<QTreeWidgetItem*>& items);
+	static QString trimWord(const QString& word, QString* prefix = nullptr, QString* suffix = nullptr);
+	void mergeItems(const QModelIndexList& indices);
+	void selectItem(const HOCRItem* item);
+
+	void itemAboutToBeInserted(const HOCRItem* parent, int index, const HOCRItem* item) override;
+	void itemInserted(HOCRItem* item) override;
+	void itemAboutToBeRemoved(HOCRItem* item) override;
+	void itemRemoved(HOCRItem* item) override;
+	void itemChanged(HOCRItem* item) override;
+	void historyChanged() override;
 
 private slots:
 	void addGraphicRegion(QRect rect);
-	void addPage(const QString& hocrText, ReadSessionData data);
+	void addQueuedPages();
+	void journalFailed();
 	void setFont();
-	void showItemProperties(QTreeWidgetItem* item);
-	void itemChanged(QTreeWidgetItem* item, int col);
+	void showItemProperties(const QModelIndex& index);
+	void itemChanged(const QModelIndex& index);
+	void clearErrorState();
+	void findNext();
+	void findPrev();
+	void replaceNext();
+	void replaceAll();
+	void updateSearchHighlight();
 	void imageFormatChanged();
 	void imageCompressionChanged();
 	void propertyCellChanged(int row, int col);
@@ -167,6 +193,7 @@ private slots:
 	void updateFontButton(const QFont& font);
 	void updatePreview();
 	void updateCurrentItemBBox(QRect rect);
+	void pickItem(QPoint point);
 };
 
 #endif // OUTPUTEDITORHOCR_HH
@@ -102,6 +102,11 @@ Recognizer::Recognizer(const UI_MainWindow& _ui) :
 	MAIN->getConfig()->addSetting(new VarSetting<QString>("language", "eng:en_EN"));
 	MAIN->getConfig()->addSetting(new ComboSetting("ocrregionstrategy", uiPageRangeDialog.comboBoxRecognitionArea, 0));
 	MAIN->getConfig()->addSetting(new VarSetting<int>("psm", 6));
+	MAIN->getConfig()->addSetting(new VarSetting<int>("preprocbinarization", static_cast<int>(ImagePreprocessor::Binarization::None)));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preprocdespeckle", false));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preprocremoveborder", false));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preprocdeskew", false));
+	MAIN->getConfig()->addSetting(new VarSetting<bool>("preproccrop", false));
 }
 
 QStringList Recognizer::getAvailableLanguages() const {
@@ -177,6 +182,9 @@ void Recognizer::updateLanguagesMenu() {
 	delete m_psmCheckGroup;
 	m_psmCheckGroup = new QActionGroup(this);
 	connect(m_psmCheckGroup, SIGNAL(triggered(QAction*)), this, SLOT(psmSelected(QAction*)));
+	delete m_preprocCheckGroup;
+	m_preprocCheckGroup = new QActionGroup(this);
+	connect(m_preprocCheckGroup, SIGNAL(triggered(QAction*)), this, SLOT(preprocBinarizationSelected(QAction*)));
 	m_menuMultilanguage = nullptr;
 	m_curLang = Config::Lang();
 	QAction* curitem = nullptr;
@@ -186,7 +194,11 @@ void Recognizer::updateLanguagesMenu() {
 	QStringList parts = MAIN->getConfig()->getSetting<VarSetting<QString>>("language")->getValue().split(":");
 	Config::Lang curlang = {parts.empty() ? "eng" : parts[0], parts.size() < 2 ? "" : parts[1], parts.size() < 3 ? "" : parts[2]};
 
-	QList<QString> dicts = QtSpell::Checker::getLanguageList();
+	QList<QString> dicts;
+	{
+		QMutexLocker locker(&Utils::spellingMutex());
+		dicts = QtSpell::Checker::getLanguageList();
+	}
 
 	QStringList availLanguages = getAvailableLanguages();
 
@@ -318,6 +330,44 @@ void Recognizer::updateLanguagesMenu() {
 	psmAction->setMenu(psmMenu);
 	ui.menuLanguages->addAction(psmAction);
 
+	// Add preprocessing items
+	QMenu* preprocMenu = new QMenu();
+	int activeBinarization = MAIN->getConfig()->getSetting<VarSetting<int>>("preprocbinarization")->getValue();
+
+	struct BinarizationEntry {
+		QString label;
+		ImagePreprocessor::Binarization binarization;
+	};
+	QVector<BinarizationEntry> binarizationModes = {
+			BinarizationEntry{_("No binarization"), ImagePreprocessor::Binarization::None},
+			BinarizationEntry{_("Global binarization (Otsu)"), ImagePreprocessor::Binarization::Otsu},
+			BinarizationEntry{_("Adaptive binarization (Sauvola)"), ImagePreprocessor::Binarization::Sauvola}};
+	for(const auto& entry : binarizationModes) {
+		QAction* item = preprocMenu->addAction(entry.label);
+		item->setData(static_cast<int>(entry.binarization));
+		item->setCheckable(true);
+		item->setChecked(activeBinarization == static_cast<int>(entry.binarization));
+		m_preprocCheckGroup->addAction(item);
+	}
+	preprocMenu->addSeparator();
+	QAction* deskewItem = preprocMenu->addAction(_("Deskew pages"));
+	deskewItem->setData("preprocdeskew");
+	QAction* despeckleItem = preprocMenu->addAction(_("Remove speckles"));
+	despeckleItem->setData("preprocdespeckle");
+	QAction* removeBorderItem = preprocMenu->addAction(_("Remove dark borders"));
+	removeBorderItem->setData("preprocremoveborder");
+	QAction* cropItem = preprocMenu->addAction(_("Only recognize content area"));
+	cropItem->setData("preproccrop");
+	for(QAction* item : {deskewItem, despeckleItem, removeBorderItem, cropItem}) {
+		item->setCheckable(true);
+		item->setChecked(MAIN->getConfig()->getSetting<VarSetting<bool>>(item->data().toString())->getValue());
+		connect(item, SIGNAL(toggled(bool)), this, SLOT(preprocOptionToggled(bool)));
+	}
+
+	QAction* preprocAction = new QAction(_("Preprocessing"), ui.menuLanguages);
+	preprocAction->setMenu(preprocMenu);
+	ui.menuLanguages->addAction(preprocAction);
+
 
 	// Add installer item
 	ui.menuLanguages->addSeparator();
@@ -372,6 +422,47 @@ void Recognizer::psmSelected(QAction *action) {
 	MAIN->getConfig()->getSetting<VarSetting<int>>("psm")->setValue(action->data().toInt());
 }
 
+void Recognizer::preprocBinarizationSelected(QAction* action) {
+	MAIN->getConfig()->getSetting<VarSetting<int>>("preprocbinarization")->setValue(action->data().toInt());
+}
+
+void Recognizer::preprocOptionToggled(bool active) {
+	QAction* item = qobject_cast<QAction*>(QObject::sender());
+	MAIN->getConfig()->getSetting<VarSetting<bool>>(item->data().toString())->setValue(active);
+}
+
+ImagePreprocessor::Options Recognizer::getPreprocessingOptions() const {
+	ImagePreprocessor::Options options;
+	options.binarization = static_cast<ImagePreprocessor::Binarization>(MAIN->getConfig()->getSetting<VarSetting<int>>("preprocbinarization")->getValue());
+	options.despeckle = MAIN->getConfig()->getSetting<VarSetting<bool>>("preprocdespeckle")->getValue();
+	options.removeBorder = MAIN->getConfig()->getSetting<VarSetting<bool>>("preprocremoveborder")->getValue();
+	options.cropToContent = MAIN->getConfig()->getSetting<VarSetting<bool>>("preproccrop")->getValue();
+	return options;
+}
+
+void Recognizer::setImage(tesseract::TessBaseAPI& tess, const QImage& image, ImagePreprocessor::Options options, int dpi) const {
+	if(!options.isActive()) {
+		tess.SetImage(image.bits(), image.width(), image.height(), 4, image.bytesPerLine());
+	} else {
+		// Sauvola window of about a tenth of an inch
+		if(dpi > 0) {
+			options.sauvolaWindow = qMax(15, dpi / 10) | 1;
+		}
+		ImagePreprocessor::Image processed = ImagePreprocessor::process(image.constBits(), image.width(), image.height(), image.bytesPerLine(), options);
+		// SetImage copies the data
+		tess.SetImage(processed.data.data(), processed.width, processed.height, processed.bytesPerPixel, processed.bytesPerLine);
+	}
+	// If the DPI is unknown, let tesseract estimate it
+	if(dpi > 0) {
+		tess.SetSourceResolution(dpi);
+	}
+	// Restrict recognition to the content area, the results remain in image coordinates
+	int x, y, w, h;
+	if(options.cropToContent && ImagePreprocessor::contentBounds(image.constBits(), image.width(), image.height(), image.bytesPerLine(), x, y, w, h)) {
+		tess.SetRectangle(x, y, w, h);
+	}
+}
+
 QList<int> Recognizer::selectPages(bool& autodetectLayout) {
 	int nPages = MAIN->getDisplayer()->getNPages();
 
@@ -440,6 +531,7 @@ void Recognizer::recognize(const QList<int> &pages, bool autodetectLayout) {
 	if(initTesseract(tess, m_curLang.prefix.toLocal8Bit().constData())) {
 		QString failed;
 		tess.SetPageSegMode(static_cast<tesseract::PageSegMode>(m_psmCheckGroup->checkedAction()->data().toInt()));
+		ImagePreprocessor::Options preprocOptions = getPreprocessingOptions();
 		OutputEditor::ReadSessionData* readSessionData = MAIN->getOutputEditor()->initRead(tess);
 		ProgressMonitor monitor(pages.size());
 		MAIN->showProgress(&monitor);
@@ -461,9 +553,11 @@ void Recognizer::recognize(const QList<int> &pages, bool autodetectLayout) {
 				readSessionData->file = MAIN->getDisplayer()->getCurrentImage(readSessionData->page);
 				readSessionData->angle = MAIN->getDisplayer()->getCurrentAngle();
 				readSessionData->resolution = MAIN->getDisplayer()->getCurrentResolution();
+				int dpi = MAIN->getDisplayer()->getCurrentDpi();
 				for(const QImage& image : MAIN->getDisplayer()->getOCRAreas()) {
-					tess.SetImage(image.bits(), image.width(), image.height(), 4, image.bytesPerLine());
-					tess.SetSourceResolution(MAIN->getDisplayer()->getCurrentResolution());
+					readSessionData->imageWidth = image.width();
+					readSessionData->imageHeight = image.height();
+					setImage(tess, image, preprocOptions, dpi);
 					tess.Recognize(&monitor.desc);
 					if(!monitor.canceled) {
 						MAIN->getOutputEditor()->read(tess, readSessionData);
@@ -491,7 +585,7 @@ bool Recognizer::recognizeImage(const QImage& image, OutputDestination dest) {
 		QMessageBox::critical(MAIN, _("Recognition errors occurred"), _("Failed to initialize tesseract"));
 		return false;
 	}
-	tess.SetImage(image.bits(), image.width(), image.height(), 4, image.bytesPerLine());
+	setImage(tess, image, getPreprocessingOptions(), MAIN->getDisplayer()->getCurrentDpi());
 	ProgressMonitor monitor(1);
 	MAIN->showProgress(&monitor);
 	if(dest == OutputDestination::Buffer) {
@@ -499,6 +593,8 @@ bool Recognizer::recognizeImage(const QImage& image, OutputDestination dest) {
 		readSessionData->file = MAIN->getDisplayer()->getCurrentImage(readSessionData->page);
 		readSessionData->angle = MAIN->getDisplayer()->getCurrentAngle();
 		readSessionData->resolution = MAIN->getDisplayer()->getCurrentResolution();
+		readSessionData->imageWidth = image.width();
+		readSessionData->imageHeight = image.height();
 		Utils::busyTask([&] {
 			tess.Recognize(&monitor.desc);
 			if(!monitor.canceled) {
@@ -532,7 +628,10 @@ bool Recognizer::setPage(int page, bool autodetectLayout) {
 		success = MAIN->getDisplayer()->setCurrentPage(page);
 	}
 	if(success && autodetectLayout) {
+		// Layout detection deskews the page itself
 		MAIN->getDisplayer()->autodetectOCRAreas();
+	} else if(success && MAIN->getConfig()->getSetting<VarSetting<bool>>("preprocdeskew")->getValue()) {
+		MAIN->getDisplayer()->deskew();
 	}
 	return success;
 }
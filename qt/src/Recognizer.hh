@@ -24,6 +24,7 @@
 
 #include "Config.hh"
 #include "Displayer.hh"
+#include "ImagePreprocessor.hh"
 
 namespace tesseract {
 class TessBaseAPI;
@@ -64,18 +65,23 @@ private:
 	QActionGroup* m_langMenuRadioGroup = nullptr;
 	QActionGroup* m_langMenuCheckGroup = nullptr;
 	QActionGroup* m_psmCheckGroup = nullptr;
+	QActionGroup* m_preprocCheckGroup = nullptr;
 	QAction* m_multilingualAction = nullptr;
 	QString m_modeLabel;
 	QString m_langLabel;
 	Config::Lang m_curLang;
 
 	bool initTesseract(tesseract::TessBaseAPI& tess, const char* language = nullptr) const;
+	ImagePreprocessor::Options getPreprocessingOptions() const;
+	void setImage(tesseract::TessBaseAPI& tess, const QImage& image, ImagePreprocessor::Options options, int dpi) const;
 	QList<int> selectPages(bool& autodetectLayout);
 	void recognize(const QList<int>& pages, bool autodetectLayout = false);
 	bool eventFilter(QObject *obj, QEvent *ev) override;
 
 private slots:
 	void clearLineEditPageRangeStyle();
+	void preprocBinarizationSelected(QAction* action);
+	void preprocOptionToggled(bool active);
 	void psmSelected(QAction* action);
 	void recognizeButtonClicked();
 	void recognizeCurrentPage();
@@ -121,6 +121,16 @@ QList<Source*> SourceManager::getSelectedSources() const {
 	return selectedSources;
 }
 
+const Source* SourceManager::getSource(const QString& path) const {
+	for(int row = 0, nRows = ui.listWidgetSources->count(); row < nRows; ++row) {
+		const Source* source = ui.listWidgetSources->item(row)->data(Qt::UserRole).value<Source*>();
+		if(source && source->path == path) {
+			return source;
+		}
+	}
+	return nullptr;
+}
+
 void SourceManager::prepareSourcesMenu() {
 	// Build recent menu
 	m_recentMenu->clear();
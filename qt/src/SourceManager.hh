@@ -38,6 +38,8 @@ struct Source {
 	int brightness = 0;
 	int contrast = 0;
 	int resolution = -1;
+	// The resolution follows the native DPI of each page until it is set by the user
+	bool autoResolution = false;
 	int page = 1;
 	QVector<double> angle;
 	bool invert = false;
@@ -49,6 +51,8 @@ public:
 	SourceManager(const UI_MainWindow& _ui);
 	~SourceManager();
 	QList<Source*> getSelectedSources() const;
+	// The source opened from the file, nullptr if the file is not among the sources
+	const Source* getSource(const QString& path) const;
 	void addSourceImage(const QImage& image);
 
 public slots:
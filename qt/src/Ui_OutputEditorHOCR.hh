@@ -6,14 +6,17 @@
 #include <QCheckBox>
 #include <QComboBox>
 #include <QDoubleSpinBox>
+#include <QFrame>
+#include <QGridLayout>
 #include <QHeaderView>
+#include <QLineEdit>
 #include <QMenu>
 #include <QPushButton>
 #include <QToolBar>
 #include <QToolButton>
 #include <QSplitter>
 #include <QTableWidget>
-#include <QTreeWidget>
+#include <QTreeView>
 #include <QVBoxLayout>
 #include <QWidgetAction>
 
@@ -23,10 +26,22 @@ public:
 	QAction* actionOutputClear;
 	QAction* actionOutputSaveHOCR;
 	QAction* actionOutputExportPDF;
+	QAction* actionOutputUndo;
+	QAction* actionOutputRedo;
+	QAction* actionOutputReplace;
 	QToolBar* toolBarOutput;
 
+	QFrame* frameOutputSearch;
+	QLineEdit* lineEditOutputSearch;
+	QLineEdit* lineEditOutputReplace;
+	QToolButton* toolButtonOutputFindNext;
+	QToolButton* toolButtonOutputFindPrev;
+	QToolButton* toolButtonOutputReplace;
+	QToolButton* toolButtonOutputReplaceAll;
+	QCheckBox* checkBoxOutputSearchMatchCase;
+
 	QSplitter* splitter;
-	QTreeWidget *treeWidgetItems;
+	QTreeView *treeViewItems;
 	QTableWidget *tableWidgetProperties;
 	OutputTextEdit *plainTextEditOutput;
 
@@ -46,6 +61,15 @@ public:
 		actionOutputExportPDF->setEnabled(false);
 		actionOutputClear = new QAction(QIcon::fromTheme("edit-clear"), gettext("Clear output"), widget);
 		actionOutputClear->setToolTip(gettext("Clear output"));
+		actionOutputUndo = new QAction(QIcon::fromTheme("edit-undo"), gettext("Undo"), widget);
+		actionOutputUndo->setToolTip(gettext("Undo"));
+		actionOutputUndo->setEnabled(false);
+		actionOutputRedo = new QAction(QIcon::fromTheme("edit-redo"), gettext("Redo"), widget);
+		actionOutputRedo->setToolTip(gettext("Redo"));
+		actionOutputRedo->setEnabled(false);
+		actionOutputReplace = new QAction(QIcon::fromTheme("edit-find-replace"), gettext("Find and Replace"), widget);
+		actionOutputReplace->setToolTip(gettext("Find and replace"));
+		actionOutputReplace->setCheckable(true);
 
 		toolBarOutput = new QToolBar(widget);
 		toolBarOutput->setToolButtonStyle(Qt::ToolButtonIconOnly);
@@ -54,16 +78,63 @@ public:
 		toolBarOutput->addAction(actionOutputSaveHOCR);
 		toolBarOutput->addAction(actionOutputExportPDF);
 		toolBarOutput->addAction(actionOutputClear);
+		toolBarOutput->addSeparator();
+		toolBarOutput->addAction(actionOutputUndo);
+		toolBarOutput->addAction(actionOutputRedo);
+		toolBarOutput->addAction(actionOutputReplace);
 
 		widget->layout()->addWidget(toolBarOutput);
 
+		// Search/Replace field
+		frameOutputSearch = new QFrame(widget);
+		frameOutputSearch->setFrameShape(QFrame::StyledPanel);
+		frameOutputSearch->setFrameShadow(QFrame::Plain);
+		QGridLayout* frameOutputSearchLayout = new QGridLayout(frameOutputSearch);
+		frameOutputSearchLayout->setSpacing(2);
+		frameOutputSearchLayout->setContentsMargins(2, 2, 2, 2);
+
+		lineEditOutputSearch = new QLineEdit(frameOutputSearch);
+		lineEditOutputSearch->setPlaceholderText(gettext("Find"));
+		frameOutputSearchLayout->addWidget(lineEditOutputSearch, 0, 0, 1, 1);
+
+		lineEditOutputReplace = new QLineEdit(frameOutputSearch);
+		lineEditOutputReplace->setPlaceholderText(gettext("Replace"));
+		frameOutputSearchLayout->addWidget(lineEditOutputReplace, 1, 0, 1, 1);
+
+		toolButtonOutputFindNext = new QToolButton(frameOutputSearch);
+		toolButtonOutputFindNext->setIcon(QIcon::fromTheme("go-down"));
+		toolButtonOutputFindNext->setToolTip(gettext("Find next"));
+		frameOutputSearchLayout->addWidget(toolButtonOutputFindNext, 0, 1, 1, 1);
+
+		toolButtonOutputFindPrev = new QToolButton(frameOutputSearch);
+		toolButtonOutputFindPrev->setIcon(QIcon::fromTheme("go-up"));
+		toolButtonOutputFindPrev->setToolTip(gettext("Find previous"));
+		frameOutputSearchLayout->addWidget(toolButtonOutputFindPrev, 0, 2, 1, 1);
+
+		toolButtonOutputReplace = new QToolButton(frameOutputSearch);
+		toolButtonOutputReplace->setIcon(QIcon::fromTheme("edit-find-replace"));
+		toolButtonOutputReplace->setToolTip(gettext("Replace"));
+		frameOutputSearchLayout->addWidget(toolButtonOutputReplace, 1, 1, 1, 1);
+
+		toolButtonOutputReplaceAll = new QToolButton(frameOutputSearch);
+		toolButtonOutputReplaceAll->setIcon(QIcon::fromTheme("edit-find-replace"));
+		toolButtonOutputReplaceAll->setToolTip(gettext("Replace all"));
+		frameOutputSearchLayout->addWidget(toolButtonOutputReplaceAll, 1, 2, 1, 1);
+
+		checkBoxOutputSearchMatchCase = new QCheckBox(frameOutputSearch);
+		checkBoxOutputSearchMatchCase->setText(gettext("Match case"));
+		frameOutputSearchLayout->addWidget(checkBoxOutputSearchMatchCase, 2, 0, 1, 3);
+
+		widget->layout()->addWidget(frameOutputSearch);
+
 		splitter = new QSplitter(Qt::Vertical, widget);
 		widget->layout()->addWidget(splitter);
 
-		treeWidgetItems = new QTreeWidget(widget);
-		treeWidgetItems->setHeaderHidden(true);
-		treeWidgetItems->setSelectionMode(QTreeWidget::ContiguousSelection);
-		splitter->addWidget(treeWidgetItems);
+		treeViewItems = new QTreeView(widget);
+		treeViewItems->setHeaderHidden(true);
+		treeViewItems->setSelectionMode(QTreeView::ContiguousSelection);
+		treeViewItems->setUniformRowHeights(true);
+		splitter->addWidget(treeViewItems);
 
 		QTabWidget* tabWidget = new QTabWidget(widget);
 
@@ -219,3 +219,8 @@ QString Utils::getSpellingLanguage(const QString& lang) {
 	}
 	return syslang;
 }
+
+QMutex& Utils::spellingMutex() {
+	static QMutex mutex;
+	return mutex;
+}
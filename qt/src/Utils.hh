@@ -46,6 +46,8 @@ void handleSourceDropEvent(const QMimeData* mimeData);
 QByteArray download(QUrl url, QString& messages, int timeout = 60000);
 
 QString getSpellingLanguage(const QString& lang = QString());
+// Held around every enchant call: all spell checkers of the process share one broker, which is not thread-safe
+QMutex& spellingMutex();
 
 template<typename T>
 class AsyncQueue {